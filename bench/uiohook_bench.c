@@ -0,0 +1,519 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uiohook.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sys/resource.h>
+#include <time.h>
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <CoreFoundation/CoreFoundation.h>
+#include <mach/mach_time.h>
+#endif
+#endif
+
+#define NSEC_PER_USEC 1000ULL
+#define NSEC_PER_MSEC 1000000ULL
+#define NSEC_PER_SEC 1000000000ULL
+
+// Time the bench waits for outstanding events once posting has finished.
+#define BENCH_DRAIN_TIMEOUT (1000 * NSEC_PER_MSEC)
+
+// How far ahead of the oldest outstanding event a dispatched event is matched,
+// anything skipped over is counted as dropped.
+#define BENCH_MATCH_WINDOW 64
+
+typedef enum _bench_kind {
+    BENCH_KEY,
+    BENCH_MOTION,
+    BENCH_WHEEL,
+    BENCH_KIND_COUNT
+} bench_kind;
+
+static const char *bench_kind_names[BENCH_KIND_COUNT] = { "key", "motion", "wheel" };
+
+// State shared between the posting thread and the dispatch callback.
+typedef struct _bench_run {
+    bench_kind kind;
+    size_t count;
+    uiohook_event *events;
+    uint64_t *post_time;
+    uint64_t *latency;
+    volatile size_t posted;
+    volatile size_t next;       // Oldest event not matched or skipped yet.
+    volatile size_t matched;
+    volatile uint64_t last_dispatch;
+} bench_run;
+
+static bench_run * volatile current_run = NULL;
+
+// Command line options.
+static bool kinds[BENCH_KIND_COUNT] = { true, true, true };
+static size_t count = 10000;
+static uint64_t rate = 0;
+
+#ifdef _WIN32
+static HANDLE hook_thread;
+static volatile LONG hook_state = 0;
+static uint64_t clock_frequency = 0;
+#else
+static pthread_t hook_thread;
+static volatile int hook_state = 0;
+
+#if defined(__APPLE__) && defined(__MACH__)
+static pthread_t bench_thread;
+static mach_timebase_info_data_t clock_timebase;
+#endif
+#endif
+
+static int bench_status = EXIT_SUCCESS;
+
+
+static void logger_proc(unsigned int level, void *user_data, const char *format, va_list args) {
+    switch (level) {
+        case LOG_LEVEL_WARN:
+        case LOG_LEVEL_ERROR:
+            vfprintf(stderr, format, args);
+            break;
+    }
+}
+
+// Monotonic clock in nanoseconds.
+static uint64_t bench_clock_now() {
+    #ifdef _WIN32
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    return (uint64_t) (counter.QuadPart / clock_frequency) * NSEC_PER_SEC
+            + (uint64_t) (counter.QuadPart % clock_frequency) * NSEC_PER_SEC / clock_frequency;
+    #elif defined(__APPLE__) && defined(__MACH__)
+    return mach_absolute_time() * clock_timebase.numer / clock_timebase.denom;
+    #else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * NSEC_PER_SEC + (uint64_t) now.tv_nsec;
+    #endif
+}
+
+// Process CPU time in nanoseconds, covering both the hook and posting threads.
+static uint64_t bench_cpu_time() {
+    #ifdef _WIN32
+    FILETIME creation_time, exit_time, kernel_time, user_time;
+    GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time);
+
+    uint64_t kernel = ((uint64_t) kernel_time.dwHighDateTime << 32) | kernel_time.dwLowDateTime;
+    uint64_t user = ((uint64_t) user_time.dwHighDateTime << 32) | user_time.dwLowDateTime;
+
+    // FILETIME is in 100 nanosecond intervals.
+    return (kernel + user) * 100;
+    #else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return ((uint64_t) usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * NSEC_PER_SEC
+            + ((uint64_t) usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * NSEC_PER_USEC;
+    #endif
+}
+
+static void bench_sleep(uint64_t ns) {
+    #ifdef _WIN32
+    Sleep((DWORD) (ns / NSEC_PER_MSEC));
+    #else
+    struct timespec ts = {
+        .tv_sec = (time_t) (ns / NSEC_PER_SEC),
+        .tv_nsec = (long) (ns % NSEC_PER_SEC)
+    };
+    nanosleep(&ts, NULL);
+    #endif
+}
+
+// Sleep while the deadline is far away and spin for the last millisecond, the
+// native sleep granularity is too coarse for the higher posting rates.
+static void bench_sleep_until(uint64_t deadline) {
+    uint64_t now = bench_clock_now();
+    while (now < deadline) {
+        if (deadline - now > 2 * NSEC_PER_MSEC) {
+            bench_sleep(deadline - now - NSEC_PER_MSEC);
+        }
+
+        now = bench_clock_now();
+    }
+}
+
+// Build the synthetic event posted as number seq of a run.
+static void build_event(bench_kind kind, size_t seq, uiohook_event *event) {
+    memset(event, 0, sizeof(uiohook_event));
+
+    switch (kind) {
+        case BENCH_KEY:
+            // Right shift does not type anything, so the bench is harmless to
+            // whatever window has focus.
+            event->type = seq % 2 == 0 ? EVENT_KEY_PRESSED : EVENT_KEY_RELEASED;
+            event->data.keyboard.keycode = VC_SHIFT_R;
+            break;
+
+        case BENCH_MOTION:
+            // Every position in the sweep differs from its neighbours so the
+            // dispatched event identifies the posted one.
+            event->type = EVENT_MOUSE_MOVED;
+            event->data.mouse.x = (int16_t) (100 + seq % 64);
+            event->data.mouse.y = (int16_t) (100 + (seq / 64) % 64);
+            break;
+
+        case BENCH_WHEEL:
+            // Alternate the direction so the focused window does not scroll away.
+            event->type = EVENT_MOUSE_WHEEL;
+            event->data.wheel.type = WHEEL_UNIT_SCROLL;
+            event->data.wheel.amount = 1;
+            event->data.wheel.rotation = seq % 2 == 0 ? -1 : 1;
+            event->data.wheel.direction = WHEEL_VERTICAL_DIRECTION;
+            event->data.wheel.x = 100;
+            event->data.wheel.y = 100;
+            break;
+
+        default:
+            break;
+    }
+}
+
+// Returns true if the dispatched event is the native counterpart of the posted one.
+static bool is_match(uiohook_event * const posted, uiohook_event * const event) {
+    switch (posted->type) {
+        case EVENT_KEY_PRESSED:
+        case EVENT_KEY_RELEASED:
+            return event->type == posted->type
+                    && event->data.keyboard.keycode == posted->data.keyboard.keycode;
+
+        case EVENT_MOUSE_MOVED:
+            return (event->type == EVENT_MOUSE_MOVED || event->type == EVENT_MOUSE_DRAGGED)
+                    && event->data.mouse.x == posted->data.mouse.x
+                    && event->data.mouse.y == posted->data.mouse.y;
+
+        case EVENT_MOUSE_WHEEL:
+            return event->type == EVENT_MOUSE_WHEEL
+                    && (event->data.wheel.rotation < 0) == (posted->data.wheel.rotation < 0);
+
+        default:
+            return false;
+    }
+}
+
+static void dispatch_proc(uiohook_event * const event, void *user_data) {
+    uint64_t now = bench_clock_now();
+
+    switch (event->type) {
+        case EVENT_HOOK_ENABLED:
+            hook_state = 1;
+            return;
+
+        case EVENT_HOOK_DISABLED:
+            hook_state = 2;
+            return;
+
+        default:
+            break;
+    }
+
+    bench_run *run = current_run;
+    if (run == NULL) {
+        return;
+    }
+
+    size_t posted = run->posted;
+    size_t limit = run->next + BENCH_MATCH_WINDOW;
+    if (limit > posted) {
+        limit = posted;
+    }
+
+    for (size_t seq = run->next; seq < limit; seq++) {
+        if (is_match(&run->events[seq], event)) {
+            run->latency[run->matched] = now - run->post_time[seq];
+            run->matched++;
+            run->last_dispatch = now;
+            run->next = seq + 1;
+            break;
+        }
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI hook_thread_proc(LPVOID arg) {
+#else
+static void *hook_thread_proc(void *arg) {
+#endif
+    int status = hook_run();
+    if (status != UIOHOOK_SUCCESS) {
+        fprintf(stderr, "hook_run() failed. (%#X)\n", status);
+    }
+
+    hook_state = 2;
+
+    #ifdef _WIN32
+    return status;
+    #else
+    return NULL;
+    #endif
+}
+
+static int compare_latency(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const uint64_t *sorted, size_t length, double p) {
+    if (length == 0) {
+        return 0.0;
+    }
+
+    size_t index = (size_t) (p * (length - 1) + 0.5);
+    return (double) sorted[index] / NSEC_PER_USEC;
+}
+
+static int run_bench(bench_kind kind) {
+    bench_run run = {
+        .kind = kind,
+        .count = count,
+        .posted = 0,
+        .next = 0,
+        .matched = 0,
+        .last_dispatch = 0
+    };
+
+    run.events = malloc(sizeof(uiohook_event) * count);
+    run.post_time = malloc(sizeof(uint64_t) * count);
+    run.latency = malloc(sizeof(uint64_t) * count);
+    if (run.events == NULL || run.post_time == NULL || run.latency == NULL) {
+        free(run.events);
+        free(run.post_time);
+        free(run.latency);
+        return UIOHOOK_ERROR_OUT_OF_MEMORY;
+    }
+
+    for (size_t seq = 0; seq < count; seq++) {
+        build_event(kind, seq, &run.events[seq]);
+    }
+
+    hook_reset_stats();
+    current_run = &run;
+
+    size_t failed = 0;
+    uint64_t interval = rate > 0 ? NSEC_PER_SEC / rate : 0;
+    uint64_t cpu_start = bench_cpu_time();
+    uint64_t start = bench_clock_now();
+
+    for (size_t seq = 0; seq < count; seq++) {
+        if (interval > 0) {
+            bench_sleep_until(start + seq * interval);
+        }
+
+        uiohook_event event = run.events[seq];
+        run.post_time[seq] = bench_clock_now();
+        run.posted = seq + 1;
+
+        if (hook_post_event(&event) != UIOHOOK_SUCCESS) {
+            failed++;
+        }
+    }
+
+    // Wait for the hook to catch up, giving up once nothing arrives for a while.
+    size_t matched = run.matched;
+    uint64_t progress = bench_clock_now();
+    while (matched + failed < count && bench_clock_now() - progress < BENCH_DRAIN_TIMEOUT) {
+        bench_sleep(NSEC_PER_MSEC);
+
+        if (run.matched != matched) {
+            matched = run.matched;
+            progress = bench_clock_now();
+        }
+    }
+
+    current_run = NULL;
+    uint64_t cpu_time = bench_cpu_time() - cpu_start;
+
+    hook_stats stats;
+    hook_get_stats(&stats);
+
+    qsort(run.latency, matched, sizeof(uint64_t), compare_latency);
+
+    double elapsed = (double) (run.last_dispatch > start ? run.last_dispatch - start : 0) / NSEC_PER_SEC;
+    fprintf(stdout, "%-6s posted=%zu failed=%zu dispatched=%zu dropped=%zu"
+            " p50=%.1fus p99=%.1fus p999=%.1fus max=%.1fus"
+            " throughput=%.0f/s cpu=%.2fus/event max_lag=%" PRIu64 "us\n",
+            bench_kind_names[kind], count - failed, failed, matched, count - failed - matched,
+            percentile(run.latency, matched, 0.50),
+            percentile(run.latency, matched, 0.99),
+            percentile(run.latency, matched, 0.999),
+            percentile(run.latency, matched, 1.0),
+            elapsed > 0 ? matched / elapsed : 0.0,
+            matched > 0 ? (double) cpu_time / NSEC_PER_USEC / matched : 0.0,
+            stats.max_dispatch_lag);
+
+    free(run.events);
+    free(run.post_time);
+    free(run.latency);
+
+    return UIOHOOK_SUCCESS;
+}
+
+static void run_benches() {
+    for (int kind = 0; kind < BENCH_KIND_COUNT; kind++) {
+        if (kinds[kind] && run_bench((bench_kind) kind) != UIOHOOK_SUCCESS) {
+            fprintf(stderr, "Failed to allocate memory for %zu %s events.\n", count, bench_kind_names[kind]);
+            bench_status = EXIT_FAILURE;
+        }
+    }
+
+    hook_stop();
+}
+
+#if defined(__APPLE__) && defined(__MACH__)
+static void *bench_thread_proc(void *arg) {
+    run_benches();
+
+    // Stop the main runloop so that this program ends.
+    CFRunLoopStop(CFRunLoopGetMain());
+
+    return NULL;
+}
+#endif
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-t key|motion|wheel] [-n count] [-r rate]\n"
+            "  -t  Event type to measure, may be repeated (default: all)\n"
+            "  -n  Events posted per type (default: 10000)\n"
+            "  -r  Events posted per second, 0 posts as fast as possible (default: 0)\n",
+            name);
+}
+
+static bool parse_args(int argc, char *argv[]) {
+    bool selected = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+
+        if (strcmp(argv[i], "-t") == 0) {
+            if (!selected) {
+                memset(kinds, 0, sizeof(kinds));
+                selected = true;
+            }
+
+            bool found = false;
+            for (int kind = 0; kind < BENCH_KIND_COUNT; kind++) {
+                if (strcmp(argv[i + 1], bench_kind_names[kind]) == 0) {
+                    kinds[kind] = true;
+                    found = true;
+                }
+            }
+
+            if (!found) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "-n") == 0) {
+            count = (size_t) strtoull(argv[i + 1], NULL, 10);
+            if (count == 0) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "-r") == 0) {
+            rate = (uint64_t) strtoull(argv[i + 1], NULL, 10);
+        } else {
+            return false;
+        }
+
+        i++;
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (!parse_args(argc, argv)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    #ifdef _WIN32
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    clock_frequency = (uint64_t) frequency.QuadPart;
+    #elif defined(__APPLE__) && defined(__MACH__)
+    mach_timebase_info(&clock_timebase);
+    #endif
+
+    hook_set_logger_proc(&logger_proc, NULL);
+    hook_set_dispatch_proc(&dispatch_proc, NULL);
+
+    #ifdef _WIN32
+    hook_thread = CreateThread(NULL, 0, hook_thread_proc, NULL, 0, NULL);
+    if (hook_thread == NULL) {
+    #else
+    if (pthread_create(&hook_thread, NULL, hook_thread_proc, NULL) != 0) {
+    #endif
+        fprintf(stderr, "Failed to create the hook thread.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Wait for EVENT_HOOK_ENABLED, or for the hook thread to give up.
+    while (hook_state == 0) {
+        bench_sleep(NSEC_PER_MSEC);
+    }
+
+    if (hook_state == 1) {
+        #if defined(__APPLE__) && defined(__MACH__)
+        // NOTE Darwin requires that you start your own runloop from main.
+        if (pthread_create(&bench_thread, NULL, bench_thread_proc, NULL) == 0) {
+            CFRunLoopRun();
+            pthread_join(bench_thread, NULL);
+        } else {
+            fprintf(stderr, "Failed to create the bench thread.\n");
+            hook_stop();
+            bench_status = EXIT_FAILURE;
+        }
+        #else
+        run_benches();
+        #endif
+    } else {
+        bench_status = EXIT_FAILURE;
+    }
+
+    #ifdef _WIN32
+    WaitForSingleObject(hook_thread, INFINITE);
+    CloseHandle(hook_thread);
+    #else
+    pthread_join(hook_thread, NULL);
+    #endif
+
+    return bench_status;
+}
@@ -0,0 +1,348 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uiohook.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <ApplicationServices/ApplicationServices.h>
+#include <mach/mach_time.h>
+#elif defined(USE_X11)
+#include <X11/Xlib.h>
+#ifdef USE_XKB_COMMON
+#include <X11/Xlib-xcb.h>
+#include <xkbcommon/xkbcommon.h>
+#endif
+#endif
+#endif
+
+#include "input_helper.h"
+
+#define NSEC_PER_SEC 1000000000ULL
+
+// Number of native codes each lookup cycles through.
+#define MICROBENCH_CODES 256
+
+// Runs of each lookup, only the fastest is reported to filter out preemption.
+#define MICROBENCH_RUNS 5
+
+// Consumes every lookup result so the calls are not optimized away.
+static volatile uint32_t sink = 0;
+
+// Command line options.
+static size_t count = 1000000;
+
+// Inputs of the lookups, filled from the tables and keyboard layout in use.
+static uint16_t scancodes[MICROBENCH_CODES];
+#ifdef USE_X11
+static KeySym keysyms[MICROBENCH_CODES];
+#ifdef USE_XKB_COMMON
+static struct xkb_context *context = NULL;
+static struct xkb_state *state = NULL;
+#endif
+#elif defined(__APPLE__) && defined(__MACH__) && defined(USE_APPLICATION_SERVICES)
+static CGEventRef key_events[MICROBENCH_CODES];
+#endif
+
+#ifdef _WIN32
+static uint64_t clock_frequency = 0;
+#elif defined(__APPLE__) && defined(__MACH__)
+static mach_timebase_info_data_t clock_timebase;
+#endif
+
+
+static void logger_proc(unsigned int level, void *user_data, const char *format, va_list args) {
+    switch (level) {
+        case LOG_LEVEL_WARN:
+        case LOG_LEVEL_ERROR:
+            vfprintf(stderr, format, args);
+            break;
+    }
+}
+
+// Monotonic clock in nanoseconds.
+static uint64_t bench_clock_now() {
+    #ifdef _WIN32
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    return (uint64_t) (counter.QuadPart / clock_frequency) * NSEC_PER_SEC
+            + (uint64_t) (counter.QuadPart % clock_frequency) * NSEC_PER_SEC / clock_frequency;
+    #elif defined(__APPLE__) && defined(__MACH__)
+    return mach_absolute_time() * clock_timebase.numer / clock_timebase.denom;
+    #else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * NSEC_PER_SEC + (uint64_t) now.tv_nsec;
+    #endif
+}
+
+
+static void lookup_keycode_to_scancode(size_t i) {
+    #ifdef _WIN32
+    sink += keycode_to_scancode((DWORD) (i % MICROBENCH_CODES), 0x0);
+    #elif defined(__APPLE__) && defined(__MACH__)
+    sink += keycode_to_scancode((UInt64) (i % 128));
+    #elif defined(USE_X11)
+    sink += keycode_to_scancode((KeyCode) (i % MICROBENCH_CODES));
+    #else
+    sink += keycode_to_scancode((uint16_t) (i % MICROBENCH_CODES));
+    #endif
+}
+
+static void lookup_scancode_to_keycode(size_t i) {
+    sink += (uint32_t) scancode_to_keycode(scancodes[i % MICROBENCH_CODES]);
+}
+
+#ifdef USE_X11
+static void lookup_keysym_to_unicode(size_t i) {
+    uint16_t buffer[4];
+    sink += (uint32_t) keysym_to_unicode(keysyms[i % MICROBENCH_CODES], buffer, sizeof(buffer) / sizeof(uint16_t));
+}
+
+static void lookup_keycode_to_keysym_unicode(size_t i) {
+    KeySym keysym;
+    uint16_t buffer[4];
+
+    #ifdef USE_XKB_COMMON
+    sink += (uint32_t) keycode_to_keysym_unicode(state, (KeyCode) (i % MICROBENCH_CODES), &keysym, buffer, sizeof(buffer) / sizeof(uint16_t));
+    #else
+    sink += (uint32_t) keycode_to_keysym_unicode((KeyCode) (i % MICROBENCH_CODES), 0, &keysym, buffer, sizeof(buffer) / sizeof(uint16_t));
+    #endif
+}
+
+#ifdef USE_XKB_COMMON
+static void lookup_keycode_to_unicode(size_t i) {
+    uint16_t buffer[4];
+    sink += (uint32_t) keycode_to_unicode(state, (KeyCode) (i % MICROBENCH_CODES), buffer, sizeof(buffer) / sizeof(uint16_t));
+}
+#endif
+#elif defined(_WIN32)
+static void lookup_keycode_to_unicode(size_t i) {
+    WCHAR buffer[4];
+    sink += (uint32_t) keycode_to_unicode((DWORD) (i % MICROBENCH_CODES), 0x0000, buffer, sizeof(buffer) / sizeof(WCHAR));
+}
+#elif defined(USE_APPLICATION_SERVICES)
+static void lookup_keycode_to_unicode(size_t i) {
+    UniChar buffer[4];
+    sink += (uint32_t) keycode_to_unicode(key_events[i % 128], buffer, sizeof(buffer) / sizeof(UniChar));
+}
+#endif
+
+
+// Time count calls of lookup and print the fastest run in nanoseconds per call.
+static void run_microbench(const char *name, void (*lookup)(size_t)) {
+    // Warm the caches and any lazily loaded state before timing.
+    for (size_t i = 0; i < MICROBENCH_CODES; i++) {
+        lookup(i);
+    }
+
+    uint64_t best = UINT64_MAX;
+    for (int run = 0; run < MICROBENCH_RUNS; run++) {
+        uint64_t start = bench_clock_now();
+        for (size_t i = 0; i < count; i++) {
+            lookup(i);
+        }
+
+        uint64_t elapsed = bench_clock_now() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    fprintf(stdout, "%-26s lookups=%zu time=%.2fns/lookup\n", name, count, (double) best / count);
+}
+
+static bool load_microbench() {
+    #ifdef USE_X11
+    // The library constructor opens the helper display.
+    if (helper_disp == NULL) {
+        fprintf(stderr, "Failed to open the X display.\n");
+        return false;
+    }
+
+    load_input_helper();
+
+    #ifdef USE_XKB_COMMON
+    context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+    if (context != NULL) {
+        state = create_xkb_state(context, XGetXCBConnection(helper_disp));
+    }
+
+    if (state == NULL) {
+        fprintf(stderr, "Failed to create the xkb state.\n");
+        return false;
+    }
+    #endif
+    #elif defined(__APPLE__) && defined(__MACH__)
+    load_input_helper();
+
+    #ifdef USE_APPLICATION_SERVICES
+    refresh_keyboard_layout();
+
+    for (size_t i = 0; i < 128; i++) {
+        key_events[i] = CGEventCreateKeyboardEvent(NULL, (CGKeyCode) i, true);
+        if (key_events[i] == NULL) {
+            fprintf(stderr, "Failed to create the keyboard events.\n");
+            return false;
+        }
+    }
+    #endif
+    #else
+    load_input_helper();
+    #endif
+
+    // Look the scancodes up in reverse the way they are produced by the hook.
+    for (size_t i = 0; i < MICROBENCH_CODES; i++) {
+        #ifdef _WIN32
+        scancodes[i] = keycode_to_scancode((DWORD) i, 0x0);
+        #elif defined(__APPLE__) && defined(__MACH__)
+        scancodes[i] = keycode_to_scancode((UInt64) (i % 128));
+        #elif defined(USE_X11)
+        scancodes[i] = keycode_to_scancode((KeyCode) i);
+        #else
+        scancodes[i] = keycode_to_scancode((uint16_t) i);
+        #endif
+    }
+
+    #ifdef USE_X11
+    // Translate the key symbols of the current layout, falling back to the
+    // Latin-1 range for key codes without one.
+    for (size_t i = 0; i < MICROBENCH_CODES; i++) {
+        uint16_t buffer[4];
+
+        #ifdef USE_XKB_COMMON
+        keycode_to_keysym_unicode(state, (KeyCode) i, &keysyms[i], buffer, sizeof(buffer) / sizeof(uint16_t));
+        #else
+        keycode_to_keysym_unicode((KeyCode) i, 0, &keysyms[i], buffer, sizeof(buffer) / sizeof(uint16_t));
+        #endif
+
+        if (keysyms[i] == NoSymbol) {
+            keysyms[i] = (KeySym) (0x20 + i);
+        }
+    }
+    #endif
+
+    return true;
+}
+
+static void unload_microbench() {
+    #ifdef USE_X11
+    #ifdef USE_XKB_COMMON
+    if (state != NULL) {
+        destroy_xkb_state(state);
+        state = NULL;
+    }
+
+    if (context != NULL) {
+        xkb_context_unref(context);
+        context = NULL;
+    }
+    #endif
+    #elif defined(__APPLE__) && defined(__MACH__) && defined(USE_APPLICATION_SERVICES)
+    for (size_t i = 0; i < 128; i++) {
+        if (key_events[i] != NULL) {
+            CFRelease(key_events[i]);
+            key_events[i] = NULL;
+        }
+    }
+    #endif
+
+    unload_input_helper();
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "Usage: %s [-n count]\n"
+            "  -n  Lookups timed per run of each function (default: 1000000)\n",
+            name);
+}
+
+static bool parse_args(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            return false;
+        }
+
+        if (strcmp(argv[i], "-n") == 0) {
+            count = (size_t) strtoull(argv[i + 1], NULL, 10);
+            if (count == 0) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+
+        i++;
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (!parse_args(argc, argv)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    #ifdef _WIN32
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    clock_frequency = (uint64_t) frequency.QuadPart;
+    #elif defined(__APPLE__) && defined(__MACH__)
+    mach_timebase_info(&clock_timebase);
+    #endif
+
+    hook_set_logger_proc(&logger_proc, NULL);
+
+    int status = EXIT_FAILURE;
+    if (load_microbench()) {
+        run_microbench("keycode_to_scancode", lookup_keycode_to_scancode);
+        run_microbench("scancode_to_keycode", lookup_scancode_to_keycode);
+
+        #ifdef USE_X11
+        run_microbench("keysym_to_unicode", lookup_keysym_to_unicode);
+        run_microbench("keycode_to_keysym_unicode", lookup_keycode_to_keysym_unicode);
+        #ifdef USE_XKB_COMMON
+        run_microbench("keycode_to_unicode", lookup_keycode_to_unicode);
+        #endif
+        #elif defined(_WIN32) || defined(USE_APPLICATION_SERVICES)
+        run_microbench("keycode_to_unicode", lookup_keycode_to_unicode);
+        #endif
+
+        status = EXIT_SUCCESS;
+    }
+
+    unload_microbench();
+
+    return status;
+}
@@ -197,6 +197,10 @@ int main() {
             logger(LOG_LEVEL_ERROR, "Failed to create apple run loop observer. (%#X)", status);
             break;
 
+        case UIOHOOK_ERROR_OPEN_HID_MANAGER:
+            logger(LOG_LEVEL_ERROR, "Failed to open apple hid manager. (%#X)", status);
+            break;
+
         // Default error.
         case UIOHOOK_FAILURE:
         default:
@@ -39,9 +39,6 @@
 #include <pthread.h>
 #endif
 
-// Native thread errors.
-#define UIOHOOK_ERROR_THREAD_CREATE 0x10
-
 // Thread and mutex variables.
 #ifdef _WIN32
 static HANDLE hook_thread;
@@ -429,6 +426,10 @@ int main() {
             logger(LOG_LEVEL_ERROR, "Failed to create apple run loop observer. (%#X)\n", status);
             break;
 
+        case UIOHOOK_ERROR_OPEN_HID_MANAGER:
+            logger(LOG_LEVEL_ERROR, "Failed to open apple hid manager. (%#X)\n", status);
+            break;
+
         // Default error.
         case UIOHOOK_FAILURE:
         default:
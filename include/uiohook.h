@@ -21,6 +21,7 @@
 
 #include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /* Begin Error Codes */
@@ -30,6 +31,9 @@
 // System level errors.
 #define UIOHOOK_ERROR_OUT_OF_MEMORY              0x02
 
+// Native thread errors.
+#define UIOHOOK_ERROR_THREAD_CREATE              0x10
+
 // Unix specific errors.
 #define UIOHOOK_ERROR_X_OPEN_DISPLAY             0x20
 #define UIOHOOK_ERROR_X_RECORD_NOT_FOUND         0x21
@@ -38,6 +42,14 @@
 #define UIOHOOK_ERROR_X_RECORD_ENABLE_CONTEXT    0x24
 #define UIOHOOK_ERROR_X_RECORD_GET_CONTEXT       0x25
 
+// Linux evdev specific errors.
+#define UIOHOOK_ERROR_EPOLL_CREATE               0x26
+#define UIOHOOK_ERROR_OPEN_DEVICE                0x27
+
+// XInput2 specific errors.
+#define UIOHOOK_ERROR_X_INPUT_NOT_FOUND          0x28
+#define UIOHOOK_ERROR_X_INPUT_SELECT_EVENTS      0x29
+
 // Windows specific errors.
 #define UIOHOOK_ERROR_SET_WINDOWS_HOOK_EX        0x30
 #define UIOHOOK_ERROR_GET_MODULE_HANDLE          0x31
@@ -49,6 +61,7 @@
 #define UIOHOOK_ERROR_CREATE_RUN_LOOP_SOURCE     0x42
 #define UIOHOOK_ERROR_GET_RUNLOOP                0x43
 #define UIOHOOK_ERROR_CREATE_OBSERVER            0x44
+#define UIOHOOK_ERROR_OPEN_HID_MANAGER           0x45
 /* End Error Codes */
 
 /* Begin Log Levels and Function Prototype */
@@ -86,6 +99,12 @@ typedef struct _screen_data {
     uint16_t height;
 } screen_data;
 
+typedef struct _screen_snapshot {
+    uint32_t version;
+    uint8_t count;
+    const screen_data *screens;
+} screen_snapshot;
+
 typedef struct _keyboard_event_data {
     uint16_t keycode;
     uint16_t rawcode;
@@ -125,9 +144,71 @@ typedef struct _uiohook_event {
         mouse_event_data mouse;
         mouse_wheel_event_data wheel;
     } data;
+    // Appended so the layout of the fields above is unchanged for bindings.
+    uint64_t capture_time;  // Monotonic nanoseconds when the event was captured, zero if unknown.
 } uiohook_event;
 
 typedef void (*dispatcher_t)(uiohook_event * const, void *);
+typedef void (*batch_dispatcher_t)(uiohook_event * const, size_t, void *);
+
+// A key press that is part of a hotkey, mask holds the MASK_* modifiers.
+typedef struct _hotkey_stroke {
+    uint16_t mask;
+    uint16_t keycode;
+} hotkey_stroke;
+
+// Receives the id of the matched hotkey and the event completing it.
+typedef void (*hotkey_dispatcher_t)(uint32_t, uiohook_event * const, void *);
+
+// Opaque resources reused across calls to hook_post_context_events().
+typedef struct _post_context post_context;
+
+// Opaque handle for independent dispatch, filter and posting state.
+typedef struct _uiohook_ctx uiohook_ctx;
+
+// Opaque handle for a replay started with hook_replay_start().
+typedef struct _replay_context replay_context;
+
+// Opaque handles for binary event journals.
+typedef struct _journal_writer journal_writer;
+typedef struct _journal_reader journal_reader;
+
+// Opaque handles for a shared memory event broadcast.
+typedef struct _broadcast_publisher broadcast_publisher;
+typedef struct _broadcast_subscriber broadcast_subscriber;
+
+// Transports for hook_add_sink().
+typedef enum _sink_type {
+    UIOHOOK_SINK_UDP = 1,       // Address is host:port, IPv6 hosts in brackets.
+    UIOHOOK_SINK_UNIX_DGRAM     // Address is the path of a bound datagram socket.
+} sink_type;
+
+// Opaque handle for an output sink streaming events to a socket.
+typedef struct _event_sink event_sink;
+
+typedef struct _replay_stats {
+    size_t posted;
+    size_t failed;
+    uint64_t mean_drift;    // Nanoseconds events were posted after their schedule.
+    uint64_t max_drift;
+} replay_stats;
+
+// Number of power of two microsecond buckets in the hook_stats histograms.
+#define HOOK_STATS_BUCKETS 20
+
+// Bucket zero counts samples under 1 us, bucket n counts [2^(n-1), 2^n) us
+// and the last bucket counts everything above.
+typedef struct _hook_stats {
+    uint64_t events[EVENT_MOUSE_WHEEL + 1];     // Dispatched events indexed by event_type.
+    uint64_t consumed;                          // Events consumed by setting reserved.
+    uint64_t dispatch_time[HOOK_STATS_BUCKETS]; // Time spent inside the dispatcher.
+    uint64_t max_dispatch_time;                 // Microseconds.
+    uint64_t dispatch_lag[HOOK_STATS_BUCKETS];  // Time from the OS timestamp to dispatch.
+    uint64_t max_dispatch_lag;                  // Microseconds.
+    uint64_t tap_restarts;                      // Event taps re-enabled after a timeout.
+    uint64_t hook_restarts;                     // Native hooks re-registered.
+    uint64_t startup_time;                      // Microseconds from hook_run() to EVENT_HOOK_ENABLED.
+} hook_stats;
 /* End Virtual Event Types and Data Structures */
 
 
@@ -389,6 +470,27 @@ typedef void (*dispatcher_t)(uiohook_event * const, void *);
 /* End Virtual Modifier Masks */
 
 
+/* Begin Event Class Masks */
+#define EVENT_MASK_KEYBOARD                      (1 << 0)    // Key pressed, released and typed.
+#define EVENT_MASK_MOUSE_BUTTON                  (1 << 1)    // Mouse pressed, released and clicked.
+#define EVENT_MASK_MOUSE_MOTION                  (1 << 2)    // Mouse moved and dragged.
+#define EVENT_MASK_MOUSE_WHEEL                   (1 << 3)    // Mouse wheel.
+
+#define EVENT_MASK_MOUSE                         (EVENT_MASK_MOUSE_BUTTON | EVENT_MASK_MOUSE_MOTION | EVENT_MASK_MOUSE_WHEEL)
+#define EVENT_MASK_ALL                           (EVENT_MASK_KEYBOARD | EVENT_MASK_MOUSE)
+/* End Event Class Masks */
+
+
+/* Begin Hotkey Flags */
+#define HOTKEY_CONSUME                           (1 << 0)    // Hold the matching keys back from the system.
+/* End Hotkey Flags */
+
+
+/* Begin Key State */
+#define KEY_STATE_SIZE                           32          // Bytes in a hook_copy_key_state() bitmap.
+/* End Key State */
+
+
 /* Begin Virtual Mouse Buttons */
 #define MOUSE_NOBUTTON                           0    // Any Button
 #define MOUSE_BUTTON1                            1    // Left Button
@@ -418,24 +520,205 @@ extern "C" {
     // Set the logger callback function.
     UIOHOOK_API void hook_set_logger_proc(logger_t logger_proc, void *user_data);
 
+    // Set the lowest log level passed to the logger callback.
+    UIOHOOK_API void hook_set_log_level(log_level level);
+
     // Set the event callback function.
     UIOHOOK_API void hook_set_dispatch_proc(dispatcher_t dispatch_proc, void *user_data);
 
+    // Set the batch event callback function, replaces the event callback when set.
+    UIOHOOK_API void hook_set_batch_dispatch_proc(batch_dispatcher_t dispatch_proc, void *user_data);
+
+    // Deliver at most one mouse motion event per interval, zero disables coalescing.
+    UIOHOOK_API void hook_set_motion_coalescing(uint32_t interval_us);
+
+    // Select the EVENT_MASK_* classes the next hook_run() subscribes to.
+    UIOHOOK_API void hook_set_event_mask(uint32_t mask);
+
+    // Declare that events are never consumed so the next hook_run() may observe passively.
+    UIOHOOK_API void hook_set_listen_only(bool enabled);
+
+    // Set the callback receiving hotkey matches on a dedicated thread.
+    UIOHOOK_API int hook_set_hotkey_proc(hotkey_dispatcher_t dispatch_proc, void *user_data);
+
+    // Register a hotkey, or a chord of up to 4 strokes, replacing any hotkey with the same id.
+    UIOHOOK_API int hook_register_hotkey(uint32_t id, hotkey_stroke * const strokes, size_t count, uint32_t flags);
+
+    // Remove the hotkey registered with the id.
+    UIOHOOK_API int hook_unregister_hotkey(uint32_t id);
+
+    // Remove every registered hotkey.
+    UIOHOOK_API void hook_clear_hotkeys();
+
+    // Returns true if the key is held down, safe to call from any thread while the hook runs.
+    UIOHOOK_API bool hook_get_key_state(uint16_t keycode);
+
+    // Returns the MASK_BUTTON* mask of the mouse buttons held down.
+    UIOHOOK_API uint16_t hook_get_button_state();
+
+    // Copy the held keys into a KEY_STATE_SIZE byte bitmap and return the held buttons.
+    UIOHOOK_API uint16_t hook_copy_key_state(uint8_t *bitmap);
+
+    // Returns the bit used for the keycode in the key state bitmap, or -1 if it is not tracked.
+    UIOHOOK_API int hook_key_state_index(uint16_t keycode);
+
+    // Copy the counters collected by the hook thread since the last reset.
+    UIOHOOK_API void hook_get_stats(hook_stats *stats);
+
+    // Clear the hook statistics.
+    UIOHOOK_API void hook_reset_stats();
+
+    // Convert an event capture_time to the time base of the event time field.
+    UIOHOOK_API uint64_t hook_capture_time_to_event_time(uint64_t capture_time);
+
     // Send a virtual event back to the system.
     UIOHOOK_API int hook_post_event(uiohook_event * const event);
 
+    // Send count virtual events back to the system as a single batch.
+    UIOHOOK_API int hook_post_events(uiohook_event * const events, size_t count);
+
+    // Create a reusable, thread-safe context for posting virtual events.
+    UIOHOOK_API post_context * hook_post_context_create();
+
+    // Release a context created by hook_post_context_create().
+    UIOHOOK_API void hook_post_context_destroy(post_context *context);
+
+    // Send count virtual events back to the system using the context resources.
+    UIOHOOK_API int hook_post_context_events(post_context *context, uiohook_event * const events, size_t count);
+
+    // Post copies of the events from a dedicated thread, spaced by their time fields.
+    UIOHOOK_API replay_context * hook_replay_start(uiohook_event * const events, size_t count);
+
+    // Stop a replay before its remaining events are posted.
+    UIOHOOK_API void hook_replay_cancel(replay_context *replay);
+
+    // Wait for a replay to finish, copy its drift statistics and release it.
+    UIOHOOK_API int hook_replay_wait(replay_context *replay, replay_stats *stats);
+
+    // Open a journal for appending, a new segment is started if the file exists.
+    UIOHOOK_API journal_writer * hook_journal_open_writer(const char *path);
+
+    // Append count events to the journal.
+    UIOHOOK_API int hook_journal_write(journal_writer *writer, uiohook_event * const events, size_t count);
+
+    // Flush buffered journal records to the file.
+    UIOHOOK_API int hook_journal_flush(journal_writer *writer);
+
+    // Flush and close a journal writer.
+    UIOHOOK_API void hook_journal_close_writer(journal_writer *writer);
+
+    // Dispatcher that appends each event to the journal writer passed as user_data.
+    UIOHOOK_API void hook_journal_dispatch_proc(uiohook_event * const event, void *user_data);
+
+    // Batch dispatcher that appends each batch to the journal writer passed as user_data.
+    UIOHOOK_API void hook_journal_batch_dispatch_proc(uiohook_event * const events, size_t count, void *user_data);
+
+    // Memory map a journal for reading.
+    UIOHOOK_API journal_reader * hook_journal_open_reader(const char *path);
+
+    // Decode up to count events from the journal, returns the number decoded.
+    UIOHOOK_API size_t hook_journal_read(journal_reader *reader, uiohook_event *events, size_t count);
+
+    // Unmap and close a journal reader.
+    UIOHOOK_API void hook_journal_close_reader(journal_reader *reader);
+
+    // Create a named shared memory broadcast holding capacity events, 0 selects the default.
+    UIOHOOK_API broadcast_publisher * hook_broadcast_open_publisher(const char *name, size_t capacity);
+
+    // Publish count events to every subscriber of the broadcast.
+    UIOHOOK_API int hook_broadcast_publish(broadcast_publisher *publisher, uiohook_event * const events, size_t count);
+
+    // Dispatcher that publishes each event to the broadcast publisher passed as user_data.
+    UIOHOOK_API void hook_broadcast_dispatch_proc(uiohook_event * const event, void *user_data);
+
+    // Batch dispatcher that publishes each batch to the broadcast publisher passed as user_data.
+    UIOHOOK_API void hook_broadcast_batch_dispatch_proc(uiohook_event * const events, size_t count, void *user_data);
+
+    // Remove the broadcast and release the publisher.
+    UIOHOOK_API void hook_broadcast_close_publisher(broadcast_publisher *publisher);
+
+    // Attach to a named broadcast, optionally starting with the events it still holds.
+    UIOHOOK_API broadcast_subscriber * hook_broadcast_open_subscriber(const char *name, bool from_history);
+
+    // Copy up to count published events without blocking, returns the number copied.
+    UIOHOOK_API size_t hook_broadcast_read(broadcast_subscriber *subscriber, uiohook_event *events, size_t count);
+
+    // Wait up to timeout milliseconds for an unread event, UINT32_MAX waits forever.
+    UIOHOOK_API int hook_broadcast_wait(broadcast_subscriber *subscriber, uint32_t timeout);
+
+    // Number of events the subscriber missed because the publisher overwrote them.
+    UIOHOOK_API uint64_t hook_broadcast_dropped(broadcast_subscriber *subscriber);
+
+    // Detach from the broadcast and release the subscriber.
+    UIOHOOK_API void hook_broadcast_close_subscriber(broadcast_subscriber *subscriber);
+
+    // Stream every delivered event to a socket as journal records from a background thread.
+    UIOHOOK_API event_sink * hook_add_sink(sink_type type, const char *address);
+
+    // Send the events still queued for the sink, then detach and release it.
+    UIOHOOK_API void hook_remove_sink(event_sink *sink);
+
+    // Number of events the sink dropped because it could not keep up.
+    UIOHOOK_API uint64_t hook_sink_dropped(event_sink *sink);
+
     // Send a virtual event back to the system at the current mouse cursor position
     UIOHOOK_API int hook_post_event_at_current_mouse_position(uiohook_event * const event);
 
     // Insert the event hook.
     UIOHOOK_API int hook_run();
 
+    // Insert the event hook and deliver events from a library owned consumer
+    // thread, or queue them for hook_poll_events() if no dispatcher is set.
+    UIOHOOK_API int hook_run_async();
+
+    // Copy up to count queued events into the buffer, returns the number copied.
+    UIOHOOK_API size_t hook_poll_events(uiohook_event *events, size_t count);
+
     // Withdraw the event hook.
     UIOHOOK_API int hook_stop();
 
+    // Create a context with its own dispatcher, event mask and posting connection.
+    UIOHOOK_API uiohook_ctx * hook_ctx_create();
+
+    // Release a context that is not running.
+    UIOHOOK_API int hook_ctx_destroy(uiohook_ctx *ctx);
+
+    // Retrieves the context used by the functions without a context argument.
+    UIOHOOK_API uiohook_ctx * hook_ctx_get_default();
+
+    // Set the event callback function for the context.
+    UIOHOOK_API void hook_ctx_set_dispatch_proc(uiohook_ctx *ctx, dispatcher_t dispatch_proc, void *user_data);
+
+    // Set the batch event callback function for the context.
+    UIOHOOK_API void hook_ctx_set_batch_dispatch_proc(uiohook_ctx *ctx, batch_dispatcher_t dispatch_proc, void *user_data);
+
+    // Select the event classes delivered to the context.
+    UIOHOOK_API void hook_ctx_set_event_mask(uiohook_ctx *ctx, uint32_t mask);
+
+    // Deliver events to the context, sharing the native hook if one is already running.
+    UIOHOOK_API int hook_ctx_run(uiohook_ctx *ctx);
+
+    // Stop delivering events to the context.
+    UIOHOOK_API int hook_ctx_stop(uiohook_ctx *ctx);
+
+    // Send a virtual event back to the system through the context's connection.
+    UIOHOOK_API int hook_ctx_post_event(uiohook_ctx *ctx, uiohook_event * const event);
+
+    // Send virtual events back to the system through the context's connection.
+    UIOHOOK_API int hook_ctx_post_events(uiohook_ctx *ctx, uiohook_event * const events, size_t count);
+
     // Retrieves an array of screen data for each available monitor.
     UIOHOOK_API screen_data* hook_create_screen_info(unsigned char *count);
 
+    // Retrieves a shared, read-only snapshot of the screen layout.
+    UIOHOOK_API const screen_snapshot* hook_acquire_screen_snapshot();
+
+    // Release a snapshot returned by hook_acquire_screen_snapshot().
+    UIOHOOK_API void hook_release_screen_snapshot(const screen_snapshot *snapshot);
+
+    // Retrieves the number of the screen containing the point, or zero if none does.
+    UIOHOOK_API uint8_t hook_screen_at(int16_t x, int16_t y);
+
     // Retrieves the keyboard auto repeat rate.
     UIOHOOK_API long int hook_get_auto_repeat_rate();
 
@@ -0,0 +1,45 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _included_atomic_helper
+#define _included_atomic_helper
+
+// Minimal acquire/release primitives for the lock-free structures shared
+// between the hook thread and the rest of the library.  The target is C99, so
+// we cannot rely on <stdatomic.h> being available.
+#if defined(__GNUC__) || defined(__clang__)
+#define atomic_load_acquire(ptr)        __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+#define atomic_store_release(ptr, val)  __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+#define atomic_thread_fence_full()      __atomic_thread_fence(__ATOMIC_SEQ_CST)
+#define atomic_add_fetch_32(ptr, val)   __atomic_add_fetch((ptr), (val), __ATOMIC_SEQ_CST)
+#define atomic_cas_32(ptr, old, val)    __sync_bool_compare_and_swap((ptr), (old), (val))
+#elif defined(_MSC_VER)
+#include <windows.h>
+
+// NOTE MSVC gives volatile accesses acquire/release semantics (/volatile:ms),
+// so the shared variables must be declared volatile.
+#define atomic_load_acquire(ptr)        (*(ptr))
+#define atomic_store_release(ptr, val)  (*(ptr) = (val))
+#define atomic_thread_fence_full()      MemoryBarrier()
+#define atomic_add_fetch_32(ptr, val)   ((uint32_t) InterlockedAdd((volatile LONG *) (ptr), (LONG) (val)))
+#define atomic_cas_32(ptr, old, val)    (InterlockedCompareExchange((volatile LONG *) (ptr), (LONG) (val), (LONG) (old)) == (LONG) (old))
+#else
+#error "Unsupported compiler, atomic primitives are not available!"
+#endif
+
+#endif
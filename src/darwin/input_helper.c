@@ -22,18 +22,124 @@
 #ifndef USE_WEAK_IMPORT
 #include <dlfcn.h>
 #endif
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include <uiohook.h>
 
 #include "input_helper.h"
 #include "logger.h"
 
 #ifdef USE_APPLICATION_SERVICES
+// Number of virtual key codes and modifier states kept in the layout table.
+#define LAYOUT_KEYCODE_COUNT    128
+#define LAYOUT_STATE_COUNT      2
+#define LAYOUT_CHAR_COUNT       4
+
+// UCKeyTranslate modifier state for the shift key.
+#define LAYOUT_SHIFT_STATE      ((shiftKey >> 8) & 0xFF)
+
+// Snapshot of the selected keyboard layout taken on the main runloop.
+typedef struct _keyboard_layout {
+    CFDataRef data;                         // Copy of kTISPropertyUnicodeKeyLayoutData.
+    UInt32 keyboard_type;                   // LMGetKbdType() at the time of the copy.
+    UniCharCount length[LAYOUT_KEYCODE_COUNT][LAYOUT_STATE_COUNT];
+    UniChar chars[LAYOUT_KEYCODE_COUNT][LAYOUT_STATE_COUNT][LAYOUT_CHAR_COUNT];
+    bool dead[LAYOUT_KEYCODE_COUNT][LAYOUT_STATE_COUNT];
+} keyboard_layout;
+
 // Current dead key state.
 static UInt32 deadkey_state;
 
-// Input source data for the keyboard.
-static TISInputSourceRef prev_keyboard_layout = NULL;
+// Layout used for the last translation, the dead key state belongs to it.
+static keyboard_layout *deadkey_layout = NULL;
+
+// Cached layout, swapped under the mutex so translation never waits on the main runloop.
+static keyboard_layout *current_layout = NULL;
+static pthread_mutex_t layout_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void destroy_keyboard_layout(keyboard_layout *layout) {
+    if (layout != NULL) {
+        if (layout->data != NULL) {
+            CFRelease(layout->data);
+        }
+
+        free(layout);
+    }
+}
+
+void refresh_keyboard_layout() {
+    keyboard_layout *layout = NULL;
+
+    // NOTE The TIS functions must execute on the main runloop to avoid
+    // Exception detected while handling key input and TSMProcessRawKeyCode failed
+    // (-192) errors.
+    TISInputSourceRef source = TISCopyCurrentKeyboardLayoutInputSource();
+    if (source != NULL && CFGetTypeID(source) == TISInputSourceGetTypeID()) {
+        CFDataRef data = (CFDataRef) TISGetInputSourceProperty(source, kTISPropertyUnicodeKeyLayoutData);
+        if (data != NULL && CFGetTypeID(data) == CFDataGetTypeID() && CFDataGetLength(data) > 0) {
+            layout = (keyboard_layout *) calloc(1, sizeof(keyboard_layout));
+            if (layout != NULL) {
+                // Copy the data so it outlives the input source.
+                layout->data = CFDataCreateCopy(kCFAllocatorDefault, data);
+                layout->keyboard_type = LMGetKbdType();
+            } else {
+                logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for keyboard layout!\n",
+                        __FUNCTION__, __LINE__);
+            }
+        }
+    }
+
+    if (source != NULL) {
+        CFRelease(source);
+    }
+
+    if (layout != NULL && layout->data != NULL) {
+        const UCKeyboardLayout *keyboard_layout = (const UCKeyboardLayout *) CFDataGetBytePtr(layout->data);
+
+        // Translate every key without a pending dead key for each modifier state.
+        for (UInt16 keycode = 0; keycode < LAYOUT_KEYCODE_COUNT; keycode++) {
+            for (int state = 0; state < LAYOUT_STATE_COUNT; state++) {
+                UInt32 dead_state = 0;
+                OSStatus status = UCKeyTranslate(
+                        keyboard_layout,
+                        keycode,
+                        kUCKeyActionDown,
+                        state ? LAYOUT_SHIFT_STATE : 0,
+                        layout->keyboard_type,
+                        kNilOptions,
+                        &dead_state,
+                        LAYOUT_CHAR_COUNT,
+                        &layout->length[keycode][state],
+                        layout->chars[keycode][state]);
+
+                if (status != noErr) {
+                    layout->length[keycode][state] = 0;
+                }
+
+                layout->dead[keycode][state] = dead_state != 0;
+            }
+        }
+
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Cached keyboard layout for type %u.\n",
+                __FUNCTION__, __LINE__, (unsigned int) layout->keyboard_type);
+    } else {
+        destroy_keyboard_layout(layout);
+        layout = NULL;
+
+        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to copy the current keyboard layout!\n",
+                __FUNCTION__, __LINE__);
+    }
+
+    // Only hold the lock long enough to swap the layouts.
+    pthread_mutex_lock(&layout_mutex);
+    keyboard_layout *previous = current_layout;
+    current_layout = layout;
+    pthread_mutex_unlock(&layout_mutex);
+
+    destroy_keyboard_layout(previous);
+}
 #endif
 
 bool is_accessibility_enabled() {
@@ -98,95 +204,87 @@ bool is_accessibility_enabled() {
 
 UniCharCount keycode_to_unicode(CGEventRef event_ref, UniChar *buffer, UniCharCount size) {
     UniCharCount count = 0;
-    CFDataRef inputData = NULL;
 
     #ifdef USE_APPLICATION_SERVICES
-    // TODO Try https://developer.apple.com/documentation/coregraphics/1456120-cgeventkeyboardgetunicodestring?language=objc
-    if (CFEqual(CFRunLoopGetCurrent(), CFRunLoopGetMain())) {
-        // NOTE The following block must execute on the main runloop,
-        // Ex: CFEqual(CFRunLoopGetCurrent(), CFRunLoopGetMain()) to avoid 
-        // Exception detected while handling key input and TSMProcessRawKeyCode failed 
-        // (-192) errors.
-        TISInputSourceRef curr_keyboard_layout = TISCopyCurrentKeyboardLayoutInputSource();
-        if (curr_keyboard_layout != NULL && CFGetTypeID(curr_keyboard_layout) == TISInputSourceGetTypeID()) {
-            CFDataRef data = (CFDataRef) TISGetInputSourceProperty(curr_keyboard_layout, kTISPropertyUnicodeKeyLayoutData);
-            if (data != NULL && CFGetTypeID(data) == CFDataGetTypeID() && CFDataGetLength(data) > 0) {
-                inputData = (CFDataRef) data;
-            }
-        }
-        
-        // Check if the keyboard layout has changed to see if the dead key state needs to be discarded.
-        if (prev_keyboard_layout != NULL && curr_keyboard_layout != NULL && CFEqual(curr_keyboard_layout, prev_keyboard_layout) == false) {
+    pthread_mutex_lock(&layout_mutex);
+    if (current_layout != NULL) {
+        // Discard the dead key state if the keyboard layout has changed.
+        if (deadkey_layout != current_layout) {
+            deadkey_layout = current_layout;
             deadkey_state = 0x00;
         }
 
-        // Release the previous keyboard layout.
-        if (prev_keyboard_layout != NULL) {
-            CFRelease(prev_keyboard_layout);
-            prev_keyboard_layout = NULL;
-        }
-
-        // Set the previous keyboard layout to the current layout.
-        if (curr_keyboard_layout != NULL) {
-            prev_keyboard_layout = curr_keyboard_layout;
-        }
-    }
-    #endif
+        //Extract keycode and modifier information.
+        CGKeyCode keycode = CGEventGetIntegerValueField(event_ref, kCGKeyboardEventKeycode);
+        CGEventFlags modifiers = CGEventGetFlags(event_ref);
+
+        // Disable all command modifiers for translation.  This is required
+        // so UCKeyTranslate will provide a keysym for the separate event.
+        static const CGEventFlags cmd_modifiers = kCGEventFlagMaskCommand |
+                kCGEventFlagMaskControl | kCGEventFlagMaskAlternate;
+        modifiers &= ~cmd_modifiers;
+
+        // I don't know why but UCKeyTranslate does not process the
+        // kCGEventFlagMaskAlphaShift (A.K.A. Caps Lock Mask) correctly.
+        // We need to basically turn off the mask and process the capital
+        // letters after UCKeyTranslate().
+        bool is_caps_lock = modifiers & kCGEventFlagMaskAlphaShift;
+        modifiers &= ~kCGEventFlagMaskAlphaShift;
+
+        UInt32 modifier_state = (modifiers >> 16) & 0xFF;
+        int state = modifier_state == LAYOUT_SHIFT_STATE ? 1 : 0;
+
+        OSStatus status = noErr;
+        if (deadkey_state == 0x00 && keycode < LAYOUT_KEYCODE_COUNT
+                && (modifier_state == 0x00 || modifier_state == LAYOUT_SHIFT_STATE)
+                && !current_layout->dead[keycode][state]) {
+            // Use the precomputed translation.
+            count = current_layout->length[keycode][state];
+            if (count > size) {
+                count = size;
+            }
 
-    #ifdef USE_APPLICATION_SERVICES
-    if (inputData != NULL) {
-        const UCKeyboardLayout *keyboard_layout = (const UCKeyboardLayout*) CFDataGetBytePtr(inputData);
-
-        if (keyboard_layout != NULL) {
-            //Extract keycode and modifier information.
-            CGKeyCode keycode = CGEventGetIntegerValueField(event_ref, kCGKeyboardEventKeycode);
-            CGEventFlags modifiers = CGEventGetFlags(event_ref);
-
-            // Disable all command modifiers for translation.  This is required
-            // so UCKeyTranslate will provide a keysym for the separate event.
-            static const CGEventFlags cmd_modifiers = kCGEventFlagMaskCommand |
-                    kCGEventFlagMaskControl | kCGEventFlagMaskAlternate;
-            modifiers &= ~cmd_modifiers;
-
-            // I don't know why but UCKeyTranslate does not process the
-            // kCGEventFlagMaskAlphaShift (A.K.A. Caps Lock Mask) correctly.
-            // We need to basically turn off the mask and process the capital
-            // letters after UCKeyTranslate().
-            bool is_caps_lock = modifiers & kCGEventFlagMaskAlphaShift;
-            modifiers &= ~kCGEventFlagMaskAlphaShift;
-
-            // Run the translation with the saved deadkey_state.
-            OSStatus status = UCKeyTranslate(
-                    keyboard_layout,
+            memcpy(buffer, current_layout->chars[keycode][state], sizeof(UniChar) * count);
+        } else {
+            // Run the translation with the saved deadkey_state.  UCKeyTranslate
+            // only reads the copied layout data, so it is safe on any thread.
+            status = UCKeyTranslate(
+                    (const UCKeyboardLayout *) CFDataGetBytePtr(current_layout->data),
                     keycode,
                     kUCKeyActionDown, //kUCKeyActionDisplay,
-                    (modifiers >> 16) & 0xFF, //(modifiers >> 16) & 0xFF, || (modifiers >> 8) & 0xFF,
-                    LMGetKbdType(),
+                    modifier_state, //(modifiers >> 16) & 0xFF, || (modifiers >> 8) & 0xFF,
+                    current_layout->keyboard_type,
                     kNilOptions, //kNilOptions, //kUCKeyTranslateNoDeadKeysMask
                     &deadkey_state,
                     size,
                     &count,
                     buffer);
+        }
 
-            if (status == noErr && count > 0) {
-                if (is_caps_lock) {
-                    // We *had* a caps lock mask so we need to convert to uppercase.
-                    CFMutableStringRef keytxt = CFStringCreateMutableWithExternalCharactersNoCopy(kCFAllocatorDefault, buffer, count, size, kCFAllocatorNull);
-                    if (keytxt != NULL) {
-                        CFLocaleRef locale = CFLocaleCopyCurrent();
-                        CFStringUppercase(keytxt, locale);
-                        CFRelease(locale);
-                        CFRelease(keytxt);
-                    } else {
-                        // There was an problem creating the CFMutableStringRef.
-                        count = 0;
-                    }
+        if (status == noErr && count > 0) {
+            if (is_caps_lock) {
+                // We *had* a caps lock mask so we need to convert to uppercase.
+                CFMutableStringRef keytxt = CFStringCreateMutableWithExternalCharactersNoCopy(kCFAllocatorDefault, buffer, count, size, kCFAllocatorNull);
+                if (keytxt != NULL) {
+                    CFLocaleRef locale = CFLocaleCopyCurrent();
+                    CFStringUppercase(keytxt, locale);
+                    CFRelease(locale);
+                    CFRelease(keytxt);
+                } else {
+                    // There was an problem creating the CFMutableStringRef.
+                    count = 0;
                 }
-            } else {
-                // Make sure the buffer count is zero if an error occurred.
-                count = 0;
             }
+        } else {
+            // Make sure the buffer count is zero if an error occurred.
+            count = 0;
         }
+        pthread_mutex_unlock(&layout_mutex);
+    } else {
+        pthread_mutex_unlock(&layout_mutex);
+
+        // The layout has not been cached by the main runloop yet.
+        CGEventKeyboardGetUnicodeString(event_ref, size, &count, buffer);
     }
     #else
     CGEventKeyboardGetUnicodeString(event_ref, size, &count, buffer);
@@ -505,16 +603,19 @@ UInt64 scancode_to_keycode(uint16_t scancode) {
 void load_input_helper() {
     #ifdef USE_APPLICATION_SERVICES
     // Start with a fresh dead key state.
-    //curr_deadkey_state = 0;
+    deadkey_state = 0x00;
     #endif
 }
 
 void unload_input_helper() {
     #ifdef USE_APPLICATION_SERVICES
-    if (prev_keyboard_layout != NULL) {
-        // Cleanup tracking of the previous layout.
-        CFRelease(prev_keyboard_layout);
-        prev_keyboard_layout = NULL;
-    }
+    // Cleanup the cached layout.
+    pthread_mutex_lock(&layout_mutex);
+    keyboard_layout *previous = current_layout;
+    current_layout = NULL;
+    deadkey_layout = NULL;
+    pthread_mutex_unlock(&layout_mutex);
+
+    destroy_keyboard_layout(previous);
     #endif
 }
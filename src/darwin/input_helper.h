@@ -177,6 +177,13 @@ extern bool is_accessibility_enabled();
  */
 extern UniCharCount keycode_to_unicode(CGEventRef event_ref, UniChar *buffer, UniCharCount size);
 
+#ifdef USE_APPLICATION_SERVICES
+/* Copy the selected keyboard layout and precompute its translation tables.
+ * This function must be called on the main runloop.
+ */
+extern void refresh_keyboard_layout();
+#endif
+
 /* Converts an OSX keycode to the appropriate UIOHook scancode constant.
  */
 extern uint16_t keycode_to_scancode(UInt64 keycode);
@@ -29,8 +29,14 @@
 #include <sys/time.h>
 #include <uiohook.h>
 
+#include "dispatch_event.h"
+#include "event_clock.h"
+#include "hook_context.h"
+#include "hook_stats.h"
 #include "input_helper.h"
+#include "key_state.h"
 #include "logger.h"
+#include "property_cache.h"
 
 #ifdef USE_EPOCH_TIME
 #define TIMER_RESOLUTION_MS 1
@@ -61,34 +67,30 @@ CFRunLoopRef event_loop;
 // Flag to restart the event tap incase of timeout.
 static Boolean restart_tap = false;
 
+// Converts CGEvent timestamps to and from nanoseconds.
+static mach_timebase_info_data_t event_timebase;
+
 // Modifiers for tracking key masks.
 static uint16_t current_modifiers = 0x0000;
 
-// Required to transport messages between the main runloop and our thread for
-// Unicode lookups.
+// Size of the buffer used for Unicode lookups.
 #define KEY_BUFFER_SIZE 4
-typedef struct {
-    CGEventRef event;
-    UniChar buffer[KEY_BUFFER_SIZE];
-    UniCharCount length;
-} TISKeycodeMessage;
-TISKeycodeMessage *tis_keycode_message;
 
 #if __MAC_OS_X_VERSION_MAX_ALLOWED <= 1050
 typedef void* dispatch_queue_t;
 #endif
 static struct dispatch_queue_s *dispatch_main_queue_s;
 static void (*dispatch_sync_f_f)(dispatch_queue_t, void *, void (*function)(void *));
+static void (*dispatch_async_f_f)(dispatch_queue_t, void *, void (*function)(void *));
 
 #if defined(USE_APPLICATION_SERVICES)
 typedef struct _main_runloop_info {
     CFRunLoopSourceRef source;
-    CFRunLoopObserverRef observer;
 } main_runloop_info;
 
-main_runloop_info *main_runloop_keycode = NULL;
+// Fallback used to refresh the keyboard layout on the main runloop without libdispatch.
+main_runloop_info *main_runloop_layout = NULL;
 
-static pthread_cond_t main_runloop_cond = PTHREAD_COND_INITIALIZER;
 static pthread_mutex_t main_runloop_mutex = PTHREAD_MUTEX_INITIALIZER;
 #endif
 
@@ -106,31 +108,8 @@ static struct timeval system_time;
 // Virtual event pointer.
 static uiohook_event event;
 
-// Event dispatch callback.
-static dispatcher_t dispatch = NULL;
-static void *dispatch_data = NULL;
-
-UIOHOOK_API void hook_set_dispatch_proc(dispatcher_t dispatch_proc, void *user_data) {
-    logger(LOG_LEVEL_DEBUG, "%s [%u]: Setting new dispatch callback to %#p.\n",
-            __FUNCTION__, __LINE__, dispatch_proc);
-
-    dispatch = dispatch_proc;
-    dispatch_data = user_data;
-}
-
-// Send out an event if a dispatcher was set.
-static void dispatch_event(uiohook_event *const event) {
-    if (dispatch != NULL) {
-        logger(LOG_LEVEL_DEBUG, "%s [%u]: Dispatching event type %u.\n",
-                __FUNCTION__, __LINE__, event->type);
-
-        dispatch(event, dispatch_data);
-    } else {
-        logger(LOG_LEVEL_WARN, "%s [%u]: No dispatch callback set!\n",
-                __FUNCTION__, __LINE__);
-    }
-}
-
+// Event source for the keyboard events fabricated from system key events.
+static CGEventSourceRef system_key_source = NULL;
 
 // Set the native modifier mask for future events.
 static inline void set_modifier_mask(uint16_t mask) {
@@ -202,19 +181,11 @@ static void initialize_modifiers() {
     // Best I can tell, OS X does not support Num or Scroll lock.
     unset_modifier_mask(MASK_NUM_LOCK);
     unset_modifier_mask(MASK_SCROLL_LOCK);
-}
 
-
-// Wrap keycode_to_unicode with some null checks.
-static void keycode_to_lookup(void *info) {
-    TISKeycodeMessage *data = (TISKeycodeMessage *) info;
-
-    if (data != NULL && data->event != NULL) {
-        // Preform Unicode lookup.
-        data->length = keycode_to_unicode(data->event, data->buffer, KEY_BUFFER_SIZE);
-    }
+    reset_key_state(get_modifiers());
 }
 
+
 #ifdef USE_EPOCH_TIME
 static uint64_t get_unix_timestamp() {
 	// Get the local system time in UTC.
@@ -227,6 +198,19 @@ static uint64_t get_unix_timestamp() {
 }
 #endif
 
+UIOHOOK_API uint64_t hook_capture_time_to_event_time(uint64_t capture_time) {
+    #ifdef USE_EPOCH_TIME
+    return (uint64_t) ((int64_t) capture_time + get_realtime_offset()) / NSEC_PER_MSEC;
+    #else
+    // The event time is the CGEvent timestamp in mach_absolute_time() units.
+    if (event_timebase.denom == 0) {
+        mach_timebase_info(&event_timebase);
+    }
+
+    return capture_time * event_timebase.denom / event_timebase.numer;
+    #endif
+}
+
 static void hook_status_proc(CFRunLoopObserverRef observer, CFRunLoopActivity activity, void *info) {
     #ifdef USE_EPOCH_TIME
 	uint64_t timestamp = get_unix_timestamp();
@@ -241,6 +225,7 @@ static void hook_status_proc(CFRunLoopObserverRef observer, CFRunLoopActivity ac
 
             // Populate the hook start event.
             event.time = timestamp;
+            event.capture_time = get_monotonic_time();
             event.reserved = 0x00;
 
             event.type = EVENT_HOOK_ENABLED;
@@ -253,6 +238,7 @@ static void hook_status_proc(CFRunLoopObserverRef observer, CFRunLoopActivity ac
         case kCFRunLoopExit:
             // Populate the hook stop event.
             event.time = timestamp;
+            event.capture_time = get_monotonic_time();
             event.reserved = 0x00;
 
             event.type = EVENT_HOOK_DISABLED;
@@ -294,63 +280,11 @@ static inline void process_key_pressed(uint64_t timestamp, CGEventRef event_ref)
 
     // If the pressed event was not consumed...
     if (event.reserved ^ 0x01) {
-        tis_keycode_message->event = event_ref;
-        tis_keycode_message->length = 0;
-        bool is_runloop_main = CFEqual(event_loop, CFRunLoopGetMain());
-
-        if (dispatch_sync_f_f != NULL && dispatch_main_queue_s != NULL && !is_runloop_main) {
-            logger(LOG_LEVEL_DEBUG, "%s [%u]: Using dispatch_sync_f for key typed events.\n",
-                    __FUNCTION__, __LINE__);
-            (*dispatch_sync_f_f)(dispatch_main_queue_s, tis_keycode_message, &keycode_to_lookup);
-        }
-        #ifdef USE_APPLICATION_SERVICES
-        else if (!is_runloop_main) {
-            logger(LOG_LEVEL_DEBUG, "%s [%u]: Using CFRunLoopWakeUp for key typed events.\n",
-                    __FUNCTION__, __LINE__);
-
-            // Lock for code dealing with the main runloop.
-            pthread_mutex_lock(&main_runloop_mutex);
-
-            // Check to see if the main runloop is still running.
-            // TODO I would rather this be a check on hook_enable(),
-            // but it makes the usage complicated by requiring a separate
-            // thread for the main runloop and hook registration.
-            CFStringRef mode = CFRunLoopCopyCurrentMode(CFRunLoopGetMain());
-            if (mode != NULL) {
-                CFRelease(mode);
+        // The layout is cached by the main runloop so the lookup never waits on it.
+        UniChar buffer[KEY_BUFFER_SIZE];
+        UniCharCount length = keycode_to_unicode(event_ref, buffer, KEY_BUFFER_SIZE);
 
-                // Lookup the Unicode representation for this event.
-                //CFRunLoopSourceContext context = { .version = 0 };
-                //CFRunLoopSourceGetContext(main_runloop_keycode->source, &context);
-
-                // Get the run loop context info pointer.
-                //TISKeycodeMessage *info = (TISKeycodeMessage *) context.info;
-
-                // Set the event pointer.
-                //info->event = event_ref;
-
-
-                // Signal the custom source and wakeup the main runloop.
-                CFRunLoopSourceSignal(main_runloop_keycode->source);
-                CFRunLoopWakeUp(CFRunLoopGetMain());
-
-                // Wait for a lock while the main runloop processes they key typed event.
-                pthread_cond_wait(&main_runloop_cond, &main_runloop_mutex);
-            }
-            else {
-                logger(LOG_LEVEL_WARN, "%s [%u]: Failed to signal RunLoop main!\n",
-                        __FUNCTION__, __LINE__);
-            }
-
-            // Unlock for code dealing with the main runloop.
-            pthread_mutex_unlock(&main_runloop_mutex);
-        }
-        #endif
-        else {
-            keycode_to_lookup(tis_keycode_message);
-        }
-
-        for (unsigned int i = 0; i < tis_keycode_message->length; i++) {
+        for (unsigned int i = 0; i < length; i++) {
             // Populate key typed event.
             event.time = timestamp;
             event.reserved = 0x00;
@@ -360,7 +294,7 @@ static inline void process_key_pressed(uint64_t timestamp, CGEventRef event_ref)
 
             event.data.keyboard.keycode = VC_UNDEFINED;
             event.data.keyboard.rawcode = keycode;
-            event.data.keyboard.keychar = tis_keycode_message->buffer[i];
+            event.data.keyboard.keychar = buffer[i];
 
             logger(LOG_LEVEL_DEBUG, "%s [%u]: Key %#X typed. (%lc)\n",
                     __FUNCTION__, __LINE__, event.data.keyboard.keycode,
@@ -590,108 +524,55 @@ static inline void process_system_key(uint64_t timestamp, CGEventRef event_ref)
             int key_state = (key_flags & 0xFF00) >> 8;
             bool key_down = (key_state & 0x1) == 0;
 
-            if (key_code == NX_KEYTYPE_CAPS_LOCK) {
-                // It doesn't appear like we can modify the event coming in, so we will fabricate a new event.
-                CGEventSourceRef src = CGEventSourceCreate(kCGEventSourceStateHIDSystemState);
-                CGEventRef ns_event = CGEventCreateKeyboardEvent(src, kVK_CapsLock, key_down);
-                CGEventSetFlags(ns_event, CGEventGetFlags(event_ref));
+            CGKeyCode keycode = kVK_Undefined;
+            switch (key_code) {
+                case NX_KEYTYPE_CAPS_LOCK:
+                    keycode = kVK_CapsLock;
+                    break;
 
-                if (key_down) {
-                    process_key_pressed(timestamp, ns_event);
-                } else {
-                    process_key_released(timestamp, ns_event);
-                }
+                case NX_KEYTYPE_SOUND_UP:
+                    keycode = kVK_VolumeUp;
+                    break;
 
-                CFRelease(ns_event);
-                CFRelease(src);
-            } else if (key_code == NX_KEYTYPE_SOUND_UP) {
-                // It doesn't appear like we can modify the event coming in, so we will fabricate a new event.
-                CGEventSourceRef src = CGEventSourceCreate(kCGEventSourceStateHIDSystemState);
-                CGEventRef ns_event = CGEventCreateKeyboardEvent(src, kVK_VolumeUp, key_down);
-                CGEventSetFlags(ns_event, CGEventGetFlags(event_ref));
+                case NX_KEYTYPE_SOUND_DOWN:
+                    keycode = kVK_VolumeDown;
+                    break;
 
-                if (key_down) {
-                    process_key_pressed(timestamp, ns_event);
-                } else {
-                    process_key_released(timestamp, ns_event);
-                }
+                case NX_KEYTYPE_MUTE:
+                    keycode = kVK_Mute;
+                    break;
 
-                CFRelease(ns_event);
-                CFRelease(src);
-            } else if (key_code == NX_KEYTYPE_SOUND_DOWN) {
-                // It doesn't appear like we can modify the event coming in, so we will fabricate a new event.
-                CGEventSourceRef src = CGEventSourceCreate(kCGEventSourceStateHIDSystemState);
-                CGEventRef ns_event = CGEventCreateKeyboardEvent(src, kVK_VolumeDown, key_down);
-                CGEventSetFlags(ns_event, CGEventGetFlags(event_ref));
+                case NX_KEYTYPE_EJECT:
+                    keycode = kVK_NX_Eject;
+                    break;
 
-                if (key_down) {
-                    process_key_pressed(timestamp, ns_event);
-                } else {
-                    process_key_released(timestamp, ns_event);
-                }
+                case NX_KEYTYPE_PLAY:
+                    keycode = kVK_MEDIA_Play;
+                    break;
 
-                CFRelease(ns_event);
-                CFRelease(src);
-            } else if (key_code == NX_KEYTYPE_MUTE) {
-                // It doesn't appear like we can modify the event coming in, so we will fabricate a new event.
-                CGEventSourceRef src = CGEventSourceCreate(kCGEventSourceStateHIDSystemState);
-                CGEventRef ns_event = CGEventCreateKeyboardEvent(src, kVK_Mute, key_down);
-                CGEventSetFlags(ns_event, CGEventGetFlags(event_ref));
+                case NX_KEYTYPE_FAST:
+                    keycode = kVK_MEDIA_Next;
+                    break;
 
-                if (key_down) {
-                    process_key_pressed(timestamp, ns_event);
-                } else {
-                    process_key_released(timestamp, ns_event);
-                }
+                case NX_KEYTYPE_REWIND:
+                    keycode = kVK_MEDIA_Previous;
+                    break;
+            }
 
-                CFRelease(ns_event);
-                CFRelease(src);
-            } else if (key_code == NX_KEYTYPE_EJECT) {
+            if (keycode != kVK_Undefined) {
                 // It doesn't appear like we can modify the event coming in, so we will fabricate a new event.
-                CGEventSourceRef src = CGEventSourceCreate(kCGEventSourceStateHIDSystemState);
-                CGEventRef ns_event = CGEventCreateKeyboardEvent(src, kVK_NX_Eject, key_down);
-                CGEventSetFlags(ns_event, CGEventGetFlags(event_ref));
-
-                if (key_down) {
-                    process_key_pressed(timestamp, ns_event);
-                } else {
-                    process_key_released(timestamp, ns_event);
+                // The event source is created once per hook and reused for every fabricated event.
+                if (system_key_source == NULL) {
+                    system_key_source = CGEventSourceCreate(kCGEventSourceStateHIDSystemState);
                 }
 
-                CFRelease(ns_event);
-                CFRelease(src);
-            } else if (key_code == NX_KEYTYPE_PLAY) {
-                // It doesn't appear like we can modify the event coming in, so we will fabricate a new event.
-                CGEventSourceRef src = CGEventSourceCreate(kCGEventSourceStateHIDSystemState);
-                CGEventRef ns_event = CGEventCreateKeyboardEvent(src, kVK_MEDIA_Play, key_down);
-                CGEventSetFlags(ns_event, CGEventGetFlags(event_ref));
-
-                if (key_down) {
-                    process_key_pressed(timestamp, ns_event);
-                } else {
-                    process_key_released(timestamp, ns_event);
-                }
-
-                CFRelease(ns_event);
-                CFRelease(src);
-            } else if (key_code == NX_KEYTYPE_FAST) {
-                // It doesn't appear like we can modify the event coming in, so we will fabricate a new event.
-                CGEventSourceRef src = CGEventSourceCreate(kCGEventSourceStateHIDSystemState);
-                CGEventRef ns_event = CGEventCreateKeyboardEvent(src, kVK_MEDIA_Next, key_down);
-                CGEventSetFlags(ns_event, CGEventGetFlags(event_ref));
-
-                if (key_down) {
-                    process_key_pressed(timestamp, ns_event);
-                } else {
-                    process_key_released(timestamp, ns_event);
+                CGEventRef ns_event = CGEventCreateKeyboardEvent(system_key_source, keycode, key_down);
+                if (ns_event == NULL) {
+                    logger(LOG_LEVEL_ERROR, "%s [%u]: CGEventCreateKeyboardEvent failed!\n",
+                            __FUNCTION__, __LINE__);
+                    return;
                 }
 
-                CFRelease(ns_event);
-                CFRelease(src);
-            } else if (key_code == NX_KEYTYPE_REWIND) {
-                // It doesn't appear like we can modify the event coming in, so we will fabricate a new event.
-                CGEventSourceRef src = CGEventSourceCreate(kCGEventSourceStateHIDSystemState);
-                CGEventRef ns_event = CGEventCreateKeyboardEvent(src, kVK_MEDIA_Previous, key_down);
                 CGEventSetFlags(ns_event, CGEventGetFlags(event_ref));
 
                 if (key_down) {
@@ -701,7 +582,6 @@ static inline void process_system_key(uint64_t timestamp, CGEventRef event_ref)
                 }
 
                 CFRelease(ns_event);
-                CFRelease(src);
             }
         }
     }
@@ -916,6 +796,23 @@ CGEventRef hook_event_proc(CGEventTapProxy tap_proxy, CGEventType type, CGEventR
     uint64_t timestamp = (uint64_t) CGEventGetTimestamp(event_ref);
     #endif
 
+    // The event timestamp shares the mach_absolute_time() time base.
+    if (event_timebase.denom == 0) {
+        mach_timebase_info(&event_timebase);
+    }
+
+    uint64_t event_ticks = (uint64_t) CGEventGetTimestamp(event_ref);
+    if (event_ticks != 0) {
+        event.capture_time = event_ticks * event_timebase.numer / event_timebase.denom;
+    } else {
+        event.capture_time = get_monotonic_time();
+    }
+
+    uint64_t now = get_monotonic_time();
+    if (now >= event.capture_time) {
+        stats_record_lag((now - event.capture_time) / NSEC_PER_USEC);
+    }
+
     // Get the event class.
     switch (type) {
         case kCGEventKeyDown:
@@ -1016,6 +913,7 @@ CGEventRef hook_event_proc(CGEventTapProxy tap_proxy, CGEventType type, CGEventR
 
                 // We need to restart the tap!
                 restart_tap = true;
+                stats_record_tap_restart();
                 CFRunLoopStop(CFRunLoopGetCurrent());
             } else {
                 // In theory this *should* never execute.
@@ -1025,6 +923,9 @@ CGEventRef hook_event_proc(CGEventTapProxy tap_proxy, CGEventType type, CGEventR
             break;
     }
 
+    // Deliver anything collected for the batch callback.
+    dispatch_flush();
+
     CGEventRef result_ref = NULL;
     if (event.reserved ^ 0x01) {
         result_ref = event_ref;
@@ -1038,28 +939,42 @@ CGEventRef hook_event_proc(CGEventTapProxy tap_proxy, CGEventType type, CGEventR
 
 
 #ifdef USE_APPLICATION_SERVICES
-void main_runloop_status_proc(CFRunLoopObserverRef observer, CFRunLoopActivity activity, void *info) {
-    switch (activity) {
-        case kCFRunLoopExit:
-            // Acquire a lock on the msg_port and signal that anyone waiting should continue.
-            pthread_mutex_lock(&main_runloop_mutex);
-            pthread_cond_broadcast(&main_runloop_cond);
-            pthread_mutex_unlock(&main_runloop_mutex);
-            break;
-    }
+// Runloop to refresh the keyboard layout on the "Main" runloop due to an undocumented thread safety requirement.
+static void main_runloop_layout_proc(void *info) {
+    refresh_keyboard_layout();
 }
 
-// Runloop to execute KeyCodeToString on the "Main" runloop due to an undocumented thread safety requirement.
-static void main_runloop_keycode_proc(void *info) {
-    // Lock the msg_port mutex as we enter the main runloop.
-    pthread_mutex_lock(&main_runloop_mutex);
+// Schedule a refresh of the cached keyboard layout without waiting for it to complete.
+static void request_keyboard_layout_refresh() {
+    if (CFEqual(CFRunLoopGetCurrent(), CFRunLoopGetMain())) {
+        refresh_keyboard_layout();
+    } else if (dispatch_async_f_f != NULL && dispatch_main_queue_s != NULL) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Using dispatch_async_f for keyboard layout refresh.\n",
+                __FUNCTION__, __LINE__);
+
+        (*dispatch_async_f_f)(dispatch_main_queue_s, NULL, &main_runloop_layout_proc);
+    } else {
+        pthread_mutex_lock(&main_runloop_mutex);
+        if (main_runloop_layout != NULL) {
+            logger(LOG_LEVEL_DEBUG, "%s [%u]: Using CFRunLoopWakeUp for keyboard layout refresh.\n",
+                    __FUNCTION__, __LINE__);
 
-    keycode_to_lookup(info);
+            // Signal the custom source and wakeup the main runloop.
+            CFRunLoopSourceSignal(main_runloop_layout->source);
+            CFRunLoopWakeUp(CFRunLoopGetMain());
+        } else {
+            logger(LOG_LEVEL_WARN, "%s [%u]: Failed to signal RunLoop main!\n",
+                    __FUNCTION__, __LINE__);
+        }
+        pthread_mutex_unlock(&main_runloop_mutex);
+    }
+}
 
-    // Unlock the msg_port mutex to signal to the hook_thread that we have
-    // finished on the main runloop.
-    pthread_cond_broadcast(&main_runloop_cond);
-    pthread_mutex_unlock(&main_runloop_mutex);
+static void keyboard_layout_change_proc(CFNotificationCenterRef center, void *observer, CFStringRef name, const void *object, CFDictionaryRef user_info) {
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Received kTISNotifySelectedKeyboardInputSourceChanged.\n",
+            __FUNCTION__, __LINE__);
+
+    request_keyboard_layout_refresh();
 }
 
 static int create_main_runloop_info(main_runloop_info **main, CFRunLoopSourceContext *context) {
@@ -1079,25 +994,6 @@ static int create_main_runloop_info(main_runloop_info **main, CFRunLoopSourceCon
         return UIOHOOK_ERROR_OUT_OF_MEMORY;
     }
 
-    // Create a runloop observer for the main runloop.
-    (*main)->observer = CFRunLoopObserverCreate(
-            kCFAllocatorDefault,
-            kCFRunLoopExit, //kCFRunLoopEntry | kCFRunLoopExit, //kCFRunLoopAllActivities,
-            true,
-            0,
-            main_runloop_status_proc,
-            NULL
-        );
-    if ((*main)->observer == NULL) {
-        logger(LOG_LEVEL_ERROR, "%s [%u]: CFRunLoopObserverCreate failure!\n",
-                __FUNCTION__, __LINE__);
-
-        return UIOHOOK_ERROR_CREATE_OBSERVER;
-    } else {
-        logger(LOG_LEVEL_DEBUG, "%s [%u]: CFRunLoopObserverCreate success!\n",
-                __FUNCTION__, __LINE__);
-    }
-
     (*main)->source = CFRunLoopSourceCreate(kCFAllocatorDefault, 0, context);
 
     if ((*main)->source == NULL) {
@@ -1116,7 +1012,6 @@ static int create_main_runloop_info(main_runloop_info **main, CFRunLoopSourceCon
     pthread_mutex_lock(&main_runloop_mutex);
 
     CFRunLoopAddSource(main_loop, (*main)->source, kCFRunLoopDefaultMode);
-    CFRunLoopAddObserver(main_loop, (*main)->observer, kCFRunLoopDefaultMode);
 
     pthread_mutex_unlock(&main_runloop_mutex);
 
@@ -1127,16 +1022,6 @@ static void destroy_main_runloop_info(main_runloop_info **main) {
     if (*main != NULL) {
          CFRunLoopRef main_loop = CFRunLoopGetMain();
 
-         if ((*main)->observer != NULL) {
-             if (CFRunLoopContainsObserver(main_loop, (*main)->observer, kCFRunLoopDefaultMode)) {
-                 CFRunLoopRemoveObserver(main_loop, (*main)->observer, kCFRunLoopDefaultMode);
-             }
-
-             CFRunLoopObserverInvalidate((*main)->observer);
-             CFRelease((*main)->observer);
-             (*main)->observer = NULL;
-         }
-
          if ((*main)->source != NULL) {
              if (CFRunLoopContainsSource(main_loop, (*main)->source, kCFRunLoopDefaultMode)) {
                  CFRunLoopRemoveSource(main_loop, (*main)->source, kCFRunLoopDefaultMode);
@@ -1172,34 +1057,50 @@ static int create_event_runloop_info(event_runloop_info **hook) {
     }
 
     // Setup the event mask to listen for.
-    CGEventMask event_mask = CGEventMaskBit(kCGEventKeyDown) |
-            CGEventMaskBit(kCGEventKeyUp) |
-            CGEventMaskBit(kCGEventFlagsChanged) |
+    uint32_t class_mask = get_event_mask();
+    CGEventMask event_mask = 0;
+    if (class_mask & EVENT_MASK_KEYBOARD) {
+        event_mask |= CGEventMaskBit(kCGEventKeyDown) |
+                CGEventMaskBit(kCGEventKeyUp) |
+                CGEventMaskBit(kCGEventFlagsChanged) |
+
+                // NOTE This event is undocumented and used
+                // for caps-lock release and multi-media keys.
+                CGEventMaskBit(NX_SYSDEFINED);
+    }
+
+    if (class_mask & EVENT_MASK_MOUSE_BUTTON) {
+        event_mask |= CGEventMaskBit(kCGEventLeftMouseDown) |
+                CGEventMaskBit(kCGEventLeftMouseUp) |
 
-            CGEventMaskBit(kCGEventLeftMouseDown) |
-            CGEventMaskBit(kCGEventLeftMouseUp) |
-            CGEventMaskBit(kCGEventLeftMouseDragged) |
+                CGEventMaskBit(kCGEventRightMouseDown) |
+                CGEventMaskBit(kCGEventRightMouseUp) |
 
-            CGEventMaskBit(kCGEventRightMouseDown) |
-            CGEventMaskBit(kCGEventRightMouseUp) |
-            CGEventMaskBit(kCGEventRightMouseDragged) |
+                CGEventMaskBit(kCGEventOtherMouseDown) |
+                CGEventMaskBit(kCGEventOtherMouseUp);
+    }
 
-            CGEventMaskBit(kCGEventOtherMouseDown) |
-            CGEventMaskBit(kCGEventOtherMouseUp) |
-            CGEventMaskBit(kCGEventOtherMouseDragged) |
+    if (class_mask & EVENT_MASK_MOUSE_MOTION) {
+        event_mask |= CGEventMaskBit(kCGEventLeftMouseDragged) |
+                CGEventMaskBit(kCGEventRightMouseDragged) |
+                CGEventMaskBit(kCGEventOtherMouseDragged) |
 
-            CGEventMaskBit(kCGEventMouseMoved) |
-            CGEventMaskBit(kCGEventScrollWheel) |
+                CGEventMaskBit(kCGEventMouseMoved);
+    }
 
-            // NOTE This event is undocumented and used
-            // for caps-lock release and multi-media keys.
-            CGEventMaskBit(NX_SYSDEFINED);
+    if (class_mask & EVENT_MASK_MOUSE_WHEEL) {
+        event_mask |= CGEventMaskBit(kCGEventScrollWheel);
+    }
+
+    // A listen only tap is not waited on by the window server, but it can not
+    // consume events.  See https://github.com/kwhat/jnativehook/issues/22
+    CGEventTapOptions tap_options = is_listen_only() ? kCGEventTapOptionListenOnly : kCGEventTapOptionDefault;
 
     // Create the event tap.
     (*hook)->port = CGEventTapCreate(
             kCGSessionEventTap,       // kCGHIDEventTap
             kCGHeadInsertEventTap,    // kCGTailAppendEventTap
-            kCGEventTapOptionDefault, // kCGEventTapOptionListenOnly See https://github.com/kwhat/jnativehook/issues/22
+            tap_options,
             event_mask,
             hook_event_proc,
             NULL);
@@ -1286,9 +1187,12 @@ static void destroy_event_runloop_info(event_runloop_info **hook) {
     }
 }
 
-UIOHOOK_API int hook_run() {
+int run_native_hook() {
     int status = UIOHOOK_SUCCESS;
 
+    // Not every setting reports changes, so start each hook with fresh values.
+    invalidate_property_cache();
+
     // Check for accessibility before we start the loop.
     if (is_accessibility_enabled()) {
         logger(LOG_LEVEL_DEBUG, "%s [%u]: Accessibility API is enabled.\n",
@@ -1314,15 +1218,6 @@ UIOHOOK_API int hook_run() {
                     return event_runloop_status;
                 }
 
-
-                tis_keycode_message = (TISKeycodeMessage *) calloc(1, sizeof(TISKeycodeMessage));
-                if (tis_keycode_message == NULL) {
-                    logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for TIS message structure!\n",
-                            __FUNCTION__, __LINE__);
-
-                    return UIOHOOK_ERROR_OUT_OF_MEMORY;
-                }
-
                 #ifdef USE_APPKIT
                 tis_event_message = (TISEventMessage *) calloc(1, sizeof(TISEventMessage));
                 if (tis_event_message == NULL) {
@@ -1343,6 +1238,13 @@ UIOHOOK_API int hook_run() {
                                 __FUNCTION__, __LINE__, dlError);
                     }
 
+                    *(void **) (&dispatch_async_f_f) = dlsym(RTLD_DEFAULT, "dispatch_async_f");
+                    dlError = dlerror();
+                    if (dlError != NULL) {
+                        logger(LOG_LEVEL_DEBUG, "%s [%u]: %s.\n",
+                                __FUNCTION__, __LINE__, dlError);
+                    }
+
                     // This load is equivalent to calling dispatch_get_main_queue().  We use
                     // _dispatch_main_q because dispatch_get_main_queue is not exported from
                     // libdispatch.dylib and the upstream function only dereferences the pointer.
@@ -1356,15 +1258,20 @@ UIOHOOK_API int hook_run() {
                     if (dispatch_sync_f_f == NULL || dispatch_main_queue_s == NULL) {
                         logger(LOG_LEVEL_DEBUG, "%s [%u]: Failed to locate dispatch_sync_f() or dispatch_get_main_queue()!\n",
                                 __FUNCTION__, __LINE__);
+                    }
+
+                    if (dispatch_async_f_f == NULL || dispatch_main_queue_s == NULL) {
+                        logger(LOG_LEVEL_DEBUG, "%s [%u]: Failed to locate dispatch_async_f() or dispatch_get_main_queue()!\n",
+                                __FUNCTION__, __LINE__);
 
                         #ifdef USE_APPLICATION_SERVICES
                         logger(LOG_LEVEL_DEBUG, "%s [%u]: Falling back to runloop signaling.\n",
                                 __FUNCTION__, __LINE__);
 
                         // TODO The only thing that maybe needed in this struct is the .perform
-                        CFRunLoopSourceContext main_runloop_keycode_context = {
+                        CFRunLoopSourceContext main_runloop_layout_context = {
                             .version         = 0,
-                            .info            = tis_keycode_message,
+                            .info            = NULL,
                             .retain          = NULL,
                             .release         = NULL,
                             .copyDescription = NULL,
@@ -1372,18 +1279,32 @@ UIOHOOK_API int hook_run() {
                             .hash            = NULL,
                             .schedule        = NULL,
                             .cancel          = NULL,
-                            .perform         = main_runloop_keycode_proc
+                            .perform         = main_runloop_layout_proc
                         };
 
-                        int keycode_runloop_status = create_main_runloop_info(&main_runloop_keycode, &main_runloop_keycode_context);
-                        if (keycode_runloop_status != UIOHOOK_SUCCESS) {
-                            destroy_main_runloop_info(&main_runloop_keycode);
-                            return keycode_runloop_status;
+                        int layout_runloop_status = create_main_runloop_info(&main_runloop_layout, &main_runloop_layout_context);
+                        if (layout_runloop_status != UIOHOOK_SUCCESS) {
+                            destroy_main_runloop_info(&main_runloop_layout);
+                            return layout_runloop_status;
                         }
                         #endif
                     }
                 }
 
+                #ifdef USE_APPLICATION_SERVICES
+                // Keep the cached keyboard layout in sync with the selected input source.
+                CFNotificationCenterAddObserver(
+                        CFNotificationCenterGetDistributedCenter(),
+                        (const void *) keyboard_layout_change_proc,
+                        keyboard_layout_change_proc,
+                        kTISNotifySelectedKeyboardInputSourceChanged,
+                        NULL,
+                        CFNotificationSuspensionBehaviorDeliverImmediately);
+
+                // Cache the current keyboard layout before any keys are typed.
+                request_keyboard_layout_refresh();
+                #endif
+
                 #ifdef USE_APPKIT
                 // Contributed by Alex <universailp@web.de>
                 // Create a garbage collector to handle Cocoa events correctly.
@@ -1405,22 +1326,28 @@ UIOHOOK_API int hook_run() {
                 #endif
 
                 #ifdef USE_APPLICATION_SERVICES
+                CFNotificationCenterRemoveObserver(
+                        CFNotificationCenterGetDistributedCenter(),
+                        (const void *) keyboard_layout_change_proc,
+                        kTISNotifySelectedKeyboardInputSourceChanged,
+                        NULL);
+
                 pthread_mutex_lock(&main_runloop_mutex);
-                if (!CFEqual(event_loop, CFRunLoopGetMain())) {
-                    if (dispatch_sync_f_f == NULL || dispatch_main_queue_s == NULL) {
-                        destroy_main_runloop_info(&main_runloop_keycode);
-                    }
-                }
+                destroy_main_runloop_info(&main_runloop_layout);
                 pthread_mutex_unlock(&main_runloop_mutex);
                 #endif
 
                 #ifdef USE_APPKIT
                 free(tis_event_message);
                 #endif
-                free(tis_keycode_message);
 
                 destroy_event_runloop_info(&hook);
             } while (restart_tap);
+
+            if (system_key_source != NULL) {
+                CFRelease(system_key_source);
+                system_key_source = NULL;
+            }
         } else {
             logger(LOG_LEVEL_ERROR, "%s [%u]: CFRunLoopGetCurrent failure!\n",
                     __FUNCTION__, __LINE__);
@@ -1440,7 +1367,7 @@ UIOHOOK_API int hook_run() {
     return status;
 }
 
-UIOHOOK_API int hook_stop() {
+int stop_native_hook() {
     int status = UIOHOOK_FAILURE;
 
     CFStringRef mode = CFRunLoopCopyCurrentMode(event_loop);
@@ -17,6 +17,7 @@
  */
 
 #include <ApplicationServices/ApplicationServices.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -25,12 +26,29 @@
 #include "input_helper.h"
 #include "logger.h"
 
-static CGEventFlags current_modifier_mask = 0x00;
-static CGEventType current_motion_event = kCGEventMouseMoved;
-static CGMouseButton current_motion_button = 0;
-
-
-static int post_key_event(uiohook_event * const event, CGEventSourceRef src) {
+struct _post_context {
+    pthread_mutex_t lock;
+    CGEventSourceRef src;
+
+    // Modifiers held and the drag in progress for the events posted so far,
+    // guarded by the lock.
+    CGEventFlags modifier_mask;
+    CGEventType motion_event;
+    CGMouseButton motion_button;
+};
+
+// Context used by the context free post functions, its source is created once.
+static pthread_once_t default_source_once = PTHREAD_ONCE_INIT;
+static post_context default_context = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .src = NULL,
+    .modifier_mask = 0x00,
+    .motion_event = kCGEventMouseMoved,
+    .motion_button = 0
+};
+
+
+static int post_key_event(uiohook_event * const event, post_context *context) {
     bool is_pressed;
 
     if (event->type == EVENT_KEY_PRESSED) {
@@ -38,22 +56,22 @@ static int post_key_event(uiohook_event * const event, CGEventSourceRef src) {
         switch (event->data.keyboard.keycode) {
             case VC_SHIFT_L:
             case VC_SHIFT_R:
-                current_modifier_mask |= kCGEventFlagMaskShift;
+                context->modifier_mask |= kCGEventFlagMaskShift;
                 break;
 
             case VC_CONTROL_L:
             case VC_CONTROL_R:
-                current_modifier_mask |= kCGEventFlagMaskControl;
+                context->modifier_mask |= kCGEventFlagMaskControl;
                 break;
 
             case VC_META_L:
             case VC_META_R:
-                current_modifier_mask |= kCGEventFlagMaskCommand;
+                context->modifier_mask |= kCGEventFlagMaskCommand;
                 break;
 
             case VC_ALT_L:
             case VC_ALT_R:
-                current_modifier_mask |= kCGEventFlagMaskAlternate;
+                context->modifier_mask |= kCGEventFlagMaskAlternate;
                 break;
         }
     } else if (event->type == EVENT_KEY_RELEASED) {
@@ -61,22 +79,22 @@ static int post_key_event(uiohook_event * const event, CGEventSourceRef src) {
         switch (event->data.keyboard.keycode) {
             case VC_SHIFT_L:
             case VC_SHIFT_R:
-                current_modifier_mask &= ~kCGEventFlagMaskShift;
+                context->modifier_mask &= ~kCGEventFlagMaskShift;
                 break;
 
             case VC_CONTROL_L:
             case VC_CONTROL_R:
-                current_modifier_mask &= ~kCGEventFlagMaskControl;
+                context->modifier_mask &= ~kCGEventFlagMaskControl;
                 break;
 
             case VC_META_L:
             case VC_META_R:
-                current_modifier_mask &= ~kCGEventFlagMaskCommand;
+                context->modifier_mask &= ~kCGEventFlagMaskCommand;
                 break;
 
             case VC_ALT_L:
             case VC_ALT_R:
-                current_modifier_mask &= ~kCGEventFlagMaskAlternate;
+                context->modifier_mask &= ~kCGEventFlagMaskAlternate;
                 break;
         }
     } else {
@@ -85,7 +103,7 @@ static int post_key_event(uiohook_event * const event, CGEventSourceRef src) {
         return UIOHOOK_FAILURE;
     }
 
-    CGEventFlags event_mask = current_modifier_mask;
+    CGEventFlags event_mask = context->modifier_mask;
     switch (event->data.keyboard.keycode) {
         case VC_KP_0:
         case VC_KP_1:
@@ -118,7 +136,7 @@ static int post_key_event(uiohook_event * const event, CGEventSourceRef src) {
     }
 
     CGEventRef cg_event = CGEventCreateKeyboardEvent(
-        src,
+        context->src,
         keycode,
         is_pressed
     );
@@ -137,7 +155,7 @@ static int post_key_event(uiohook_event * const event, CGEventSourceRef src) {
     return UIOHOOK_SUCCESS;
 }
 
-static int post_mouse_event(uiohook_event * const event, CGEventSourceRef src, bool move_mouse) {
+static int post_mouse_event(uiohook_event * const event, post_context *context, bool move_mouse) {
     CGEventType type = kCGEventNull;
     CGMouseButton button = 0;
 
@@ -149,17 +167,17 @@ static int post_mouse_event(uiohook_event * const event, CGEventSourceRef src, b
             } else if (event->data.mouse.button == MOUSE_BUTTON1) {
                 type = kCGEventLeftMouseDown;
                 button = kCGMouseButtonLeft;
-                current_motion_event = kCGEventLeftMouseDragged;
+                context->motion_event = kCGEventLeftMouseDragged;
             } else if (event->data.mouse.button == MOUSE_BUTTON2) {
                 type = kCGEventRightMouseDown;
                 button = kCGMouseButtonRight;
-                current_motion_event = kCGEventRightMouseDragged;
+                context->motion_event = kCGEventRightMouseDragged;
             } else {
                 type = kCGEventOtherMouseDown;
                 button = event->data.mouse.button - 1;
-                current_motion_event = kCGEventOtherMouseDragged;
+                context->motion_event = kCGEventOtherMouseDragged;
             }
-            current_motion_button = button;
+            context->motion_button = button;
             break;
 
         case EVENT_MOUSE_RELEASED:
@@ -169,29 +187,29 @@ static int post_mouse_event(uiohook_event * const event, CGEventSourceRef src, b
             } else if (event->data.mouse.button == MOUSE_BUTTON1) {
                 type = kCGEventLeftMouseUp;
                 button = kCGMouseButtonLeft;
-                if (current_motion_event == kCGEventLeftMouseDragged) {
-                    current_motion_event = kCGEventMouseMoved;
+                if (context->motion_event == kCGEventLeftMouseDragged) {
+                    context->motion_event = kCGEventMouseMoved;
                 }
             } else if (event->data.mouse.button == MOUSE_BUTTON2) {
                 type = kCGEventRightMouseUp;
                 button = kCGMouseButtonRight;
-                if (current_motion_event == kCGEventRightMouseDragged) {
-                    current_motion_event = kCGEventMouseMoved;
+                if (context->motion_event == kCGEventRightMouseDragged) {
+                    context->motion_event = kCGEventMouseMoved;
                 }
             } else {
                 type = kCGEventOtherMouseUp;
                 button = event->data.mouse.button - 1;
-                if (current_motion_event == kCGEventOtherMouseDragged) {
-                    current_motion_event = kCGEventMouseMoved;
+                if (context->motion_event == kCGEventOtherMouseDragged) {
+                    context->motion_event = kCGEventMouseMoved;
                 }
             }
-            current_motion_button = button;
+            context->motion_button = button;
             break;
 
         case EVENT_MOUSE_MOVED:
         case EVENT_MOUSE_DRAGGED:
-            type = current_motion_event;
-            button = current_motion_button;
+            type = context->motion_event;
+            button = context->motion_button;
             break;
 
         default:
@@ -202,7 +220,7 @@ static int post_mouse_event(uiohook_event * const event, CGEventSourceRef src, b
     CGEventRef cg_event;
     if (move_mouse) {
         cg_event = CGEventCreateMouseEvent(
-                src,
+                context->src,
                 type,
                 CGPointMake(
                         (CGFloat) event->data.mouse.x,
@@ -213,7 +231,7 @@ static int post_mouse_event(uiohook_event * const event, CGEventSourceRef src, b
     } else {
         CGEventRef null_event = CGEventCreate(NULL);
         cg_event = CGEventCreateMouseEvent(
-                src,
+                context->src,
                 type,
                 CGEventGetLocation(null_event),
                 button
@@ -234,7 +252,7 @@ static int post_mouse_event(uiohook_event * const event, CGEventSourceRef src, b
     return UIOHOOK_SUCCESS;
 }
 
-static int post_mouse_wheel_event(uiohook_event * const event, CGEventSourceRef src) {
+static int post_mouse_wheel_event(uiohook_event * const event, post_context *context) {
     // FIXME Should I create a source event with the coords?
     // It seems to automagically use the current location of the cursor.
     // Two options: Query the mouse, move it to x/y, scroll, then move back
@@ -249,7 +267,7 @@ static int post_mouse_wheel_event(uiohook_event * const event, CGEventSourceRef
     }
 
     CGEventRef cg_event = CGEventCreateScrollWheelEvent(
-        src,
+        context->src,
         kCGScrollEventUnitLine,
         // TODO Currently only support 1 wheel axis.
         (CGWheelCount) 1, // 1 for Y-only, 2 for Y-X, 3 for Y-X-Z
@@ -268,19 +286,12 @@ static int post_mouse_wheel_event(uiohook_event * const event, CGEventSourceRef
     return UIOHOOK_SUCCESS;
 }
 
-UIOHOOK_API int do_hook_post_event(uiohook_event * const event, bool move_mouse) {
-    CGEventSourceRef src = CGEventSourceCreate(kCGEventSourceStateHIDSystemState);
-    if (src == NULL) {
-        logger(LOG_LEVEL_ERROR, "%s [%u]: CGEventSourceCreate failed!\n",
-               __FUNCTION__, __LINE__);
-        return UIOHOOK_ERROR_OUT_OF_MEMORY;
-    }
-
+static int post_event(uiohook_event * const event, post_context *context, bool move_mouse) {
     int status = UIOHOOK_FAILURE;
     switch (event->type) {
         case EVENT_KEY_PRESSED:
         case EVENT_KEY_RELEASED:
-            status = post_key_event(event, src);
+            status = post_key_event(event, context);
             break;
 
         case EVENT_MOUSE_PRESSED:
@@ -288,11 +299,11 @@ UIOHOOK_API int do_hook_post_event(uiohook_event * const event, bool move_mouse)
 
         case EVENT_MOUSE_MOVED:
         case EVENT_MOUSE_DRAGGED:
-            status = post_mouse_event(event, src, move_mouse);
+            status = post_mouse_event(event, context, move_mouse);
             break;
 
         case EVENT_MOUSE_WHEEL:
-            status = post_mouse_wheel_event(event, src);
+            status = post_mouse_wheel_event(event, context);
             break;
 
         case EVENT_KEY_TYPED:
@@ -307,15 +318,95 @@ UIOHOOK_API int do_hook_post_event(uiohook_event * const event, bool move_mouse)
             status = UIOHOOK_FAILURE;
     }
 
-    CFRelease(src);
+    return status;
+}
+
+// The caller must hold the context lock.
+static int post_events(post_context *context, uiohook_event * const events, size_t count, bool move_mouse) {
+    int status = UIOHOOK_SUCCESS;
+    for (size_t i = 0; i < count && status == UIOHOOK_SUCCESS; i++) {
+        status = post_event(&events[i], context, move_mouse);
+    }
+
+    return status;
+}
+
+static void create_default_source() {
+    default_context.src = CGEventSourceCreate(kCGEventSourceStateHIDSystemState);
+    if (default_context.src == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: CGEventSourceCreate failed!\n",
+               __FUNCTION__, __LINE__);
+    }
+}
+
+static int do_hook_post_events(uiohook_event * const events, size_t count, bool move_mouse) {
+    // The default event source is created once and shared by every post call.
+    pthread_once(&default_source_once, create_default_source);
+    if (default_context.src == NULL) {
+        return UIOHOOK_ERROR_OUT_OF_MEMORY;
+    }
+
+    pthread_mutex_lock(&default_context.lock);
+    int status = post_events(&default_context, events, count, move_mouse);
+    pthread_mutex_unlock(&default_context.lock);
 
     return status;
 }
 
 UIOHOOK_API int hook_post_event(uiohook_event * const event) {
-    return do_hook_post_event(event, true);
+    return do_hook_post_events(event, 1, true);
 }
 
 UIOHOOK_API int hook_post_event_at_current_mouse_position(uiohook_event * const event) {
-    return do_hook_post_event(event, false);
+    return do_hook_post_events(event, 1, false);
+}
+
+UIOHOOK_API int hook_post_events(uiohook_event * const events, size_t count) {
+    return do_hook_post_events(events, count, true);
+}
+
+UIOHOOK_API post_context * hook_post_context_create() {
+    post_context *context = malloc(sizeof(post_context));
+    if (context == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for post context!\n",
+               __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    context->src = CGEventSourceCreate(kCGEventSourceStateHIDSystemState);
+    if (context->src == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: CGEventSourceCreate failed!\n",
+               __FUNCTION__, __LINE__);
+        free(context);
+        return NULL;
+    }
+
+    pthread_mutex_init(&context->lock, NULL);
+    context->modifier_mask = 0x00;
+    context->motion_event = kCGEventMouseMoved;
+    context->motion_button = 0;
+
+    return context;
+}
+
+UIOHOOK_API void hook_post_context_destroy(post_context *context) {
+    if (context != NULL) {
+        pthread_mutex_destroy(&context->lock);
+        CFRelease(context->src);
+        free(context);
+    }
+}
+
+UIOHOOK_API int hook_post_context_events(post_context *context, uiohook_event * const events, size_t count) {
+    if (context == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Invalid post context!\n",
+               __FUNCTION__, __LINE__);
+        return UIOHOOK_FAILURE;
+    }
+
+    pthread_mutex_lock(&context->lock);
+    int status = post_events(context, events, count, true);
+    pthread_mutex_unlock(&context->lock);
+
+    return status;
 }
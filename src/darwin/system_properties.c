@@ -30,6 +30,8 @@
 #include <uiohook.h>
 
 #include "logger.h"
+#include "property_cache.h"
+#include "screen_cache.h"
 #include "input_helper.h"
 
 #ifdef USE_IOKIT
@@ -38,12 +40,45 @@ static io_connect_t connection;
 
 #define MOUSE_ACCELERATION_MULTIPLIER 65536
 
+#if defined(USE_APPLICATION_SERVICES) || defined(USE_IOKIT)
+// Distributed notifications posted by the keyboard, mouse and trackpad settings
+// when the cached preferences change.  A change that is not announced is picked
+// up when the next hook starts, see run_native_hook().
+static const char *settings_notifications[] = {
+    "com.apple.KeyRepeatChanged",
+    "com.apple.InitialKeyRepeatChanged",
+    "com.apple.mouse.scalingChanged",
+    "com.apple.trackpad.scalingChanged",
+    "com.apple.mouse.doubleClickThresholdChanged"
+};
+
+#define SETTINGS_NOTIFICATION_COUNT (sizeof(settings_notifications) / sizeof(settings_notifications[0]))
+
+static void settings_change_proc(CFNotificationCenterRef center, void *observer, CFStringRef name, const void *object, CFDictionaryRef user_info) {
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Received a settings change notification.\n",
+            __FUNCTION__, __LINE__);
+
+    invalidate_property_cache();
+}
+#endif
+
+static void display_reconfiguration_proc(CGDirectDisplayID display, CGDisplayChangeSummaryFlags flags, void *user_info) {
+    // Every change is announced twice, wait for the configuration to complete.
+    if (!(flags & kCGDisplayBeginConfigurationFlag)) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Received display reconfiguration for %#X. (%#X)\n",
+                __FUNCTION__, __LINE__, (unsigned int) display, (unsigned int) flags);
+
+        invalidate_screen_cache();
+    }
+}
+
 /* The following function was contributed by Anthony Liguori Jan 18 2015.
  * https://github.com/kwhat/libuiohook/pull/18
  */
-UIOHOOK_API screen_data* hook_create_screen_info(unsigned char *count) {
+screen_data* query_screen_info(unsigned char *count) {
     CGError status = kCGErrorFailure;
     screen_data* screens = NULL;
+    uint32_t display_count = 0;
 
     // Initialize count to zero.
     *count = 0;
@@ -56,7 +91,8 @@ UIOHOOK_API screen_data* hook_create_screen_info(unsigned char *count) {
     if (display_ids != NULL) {
         // NOTE Pass UCHAR_MAX to make sure uint32_t doesn't overflow uint8_t.
         // TOOD Test/Check whether CGGetOnlineDisplayList is more suitable...
-        status = CGGetActiveDisplayList(UCHAR_MAX, display_ids, (uint32_t *) count);
+        status = CGGetActiveDisplayList(UCHAR_MAX, display_ids, &display_count);
+        *count = (unsigned char) display_count;
 
         // If there is no error and at least one monitor.
         if (status == kCGErrorSuccess && *count > 0) {
@@ -142,7 +178,7 @@ UIOHOOK_API screen_data* hook_create_screen_info(unsigned char *count) {
  * CharSec = 66 / V
  * CharSec = 66 / (MS / 15)
  */
-UIOHOOK_API long int hook_get_auto_repeat_rate() {
+static long int query_auto_repeat_rate() {
     #if defined(USE_APPLICATION_SERVICES) || defined(USE_IOKIT)
     bool successful = false;
     SInt64 rate;
@@ -206,7 +242,7 @@ UIOHOOK_API long int hook_get_auto_repeat_rate() {
     return value;
 }
 
-UIOHOOK_API long int hook_get_auto_repeat_delay() {
+static long int query_auto_repeat_delay() {
     #if defined(USE_APPLICATION_SERVICES) || defined(USE_IOKIT)
     bool successful = false;
     SInt64 delay;
@@ -269,7 +305,7 @@ UIOHOOK_API long int hook_get_auto_repeat_delay() {
     return value;
 }
 
-UIOHOOK_API long int hook_get_pointer_acceleration_multiplier() {
+static long int query_pointer_acceleration_multiplier() {
     // OS X doesn't currently have an acceleration multiplier so we are using the constant from IOHIDGetMouseAcceleration.
     long int value = MOUSE_ACCELERATION_MULTIPLIER;
     if (hook_get_pointer_sensitivity() < 0) {
@@ -279,7 +315,7 @@ UIOHOOK_API long int hook_get_pointer_acceleration_multiplier() {
     return value;
 }
 
-UIOHOOK_API long int hook_get_pointer_acceleration_threshold() {
+static long int query_pointer_acceleration_threshold() {
     // OS X doesn't currently have an acceleration threshold so we are using 1 as a placeholder.
     long int value = 1;
     if (hook_get_pointer_sensitivity() < 0) {
@@ -289,7 +325,7 @@ UIOHOOK_API long int hook_get_pointer_acceleration_threshold() {
     return value;
 }
 
-UIOHOOK_API long int hook_get_pointer_sensitivity() {
+static long int query_pointer_sensitivity() {
     #if defined(USE_APPLICATION_SERVICES) || defined(USE_IOKIT)
     bool successful = false;
     Float32 sensitivity;
@@ -338,7 +374,7 @@ UIOHOOK_API long int hook_get_pointer_sensitivity() {
     return value;
 }
 
-UIOHOOK_API long int hook_get_multi_click_time() {
+static long int query_multi_click_time() {
     #if defined(USE_APPLICATION_SERVICES) || defined(USE_IOKIT)
     bool successful = false;
     Float64 time;
@@ -390,9 +426,62 @@ UIOHOOK_API long int hook_get_multi_click_time() {
 }
 
 
+// Property values are cached until the platform reports a settings change.
+UIOHOOK_API long int hook_get_auto_repeat_rate() {
+    return get_cached_property(PROPERTY_AUTO_REPEAT_RATE, query_auto_repeat_rate);
+}
+
+UIOHOOK_API long int hook_get_auto_repeat_delay() {
+    return get_cached_property(PROPERTY_AUTO_REPEAT_DELAY, query_auto_repeat_delay);
+}
+
+UIOHOOK_API long int hook_get_pointer_acceleration_multiplier() {
+    return get_cached_property(PROPERTY_POINTER_ACCELERATION_MULTIPLIER, query_pointer_acceleration_multiplier);
+}
+
+UIOHOOK_API long int hook_get_pointer_acceleration_threshold() {
+    return get_cached_property(PROPERTY_POINTER_ACCELERATION_THRESHOLD, query_pointer_acceleration_threshold);
+}
+
+UIOHOOK_API long int hook_get_pointer_sensitivity() {
+    return get_cached_property(PROPERTY_POINTER_SENSITIVITY, query_pointer_sensitivity);
+}
+
+UIOHOOK_API long int hook_get_multi_click_time() {
+    return get_cached_property(PROPERTY_MULTI_CLICK_TIME, query_multi_click_time);
+}
+
 // Create a shared object constructor.
 __attribute__ ((constructor))
 void on_library_load() {
+    #if defined(USE_APPLICATION_SERVICES) || defined(USE_IOKIT)
+    // Listen for system preference changes so the cached properties are
+    // refreshed, the local center only reports this process's own defaults.
+    CFNotificationCenterRef center = CFNotificationCenterGetDistributedCenter();
+    for (size_t i = 0; i < SETTINGS_NOTIFICATION_COUNT; i++) {
+        CFStringRef name = CFStringCreateWithCString(kCFAllocatorDefault, settings_notifications[i], kCFStringEncodingUTF8);
+        if (name != NULL) {
+            CFNotificationCenterAddObserver(
+                    center,
+                    (const void *) settings_change_proc,
+                    settings_change_proc,
+                    name,
+                    NULL,
+                    CFNotificationSuspensionBehaviorDeliverImmediately);
+            CFRelease(name);
+        }
+    }
+    track_property_changes(true);
+    #endif
+
+    // Rebuild the screen snapshot only after the display configuration changes.
+    if (CGDisplayRegisterReconfigurationCallback(display_reconfiguration_proc, NULL) == kCGErrorSuccess) {
+        track_screen_changes(true);
+    } else {
+        logger(LOG_LEVEL_WARN, "%s [%u]: CGDisplayRegisterReconfigurationCallback failure!\n",
+                __FUNCTION__, __LINE__);
+    }
+
     #ifdef USE_IOKIT
     io_service_t service = IOServiceGetMatchingService(kIOMasterPortDefault, IOServiceMatching(kIOHIDSystemClass));
     if (service) {
@@ -411,6 +500,18 @@ void on_library_unload() {
     // Disable the event hook.
     //hook_stop();
 
+    #if defined(USE_APPLICATION_SERVICES) || defined(USE_IOKIT)
+    CFNotificationCenterRemoveObserver(
+            CFNotificationCenterGetDistributedCenter(),
+            (const void *) settings_change_proc,
+            NULL,
+            NULL);
+    track_property_changes(false);
+    #endif
+
+    track_screen_changes(false);
+    CGDisplayRemoveReconfigurationCallback(display_reconfiguration_proc, NULL);
+
     #ifdef USE_IOKIT
     if (connection) {
         kern_return_t kren_ret = IOServiceClose(connection);
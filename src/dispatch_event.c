@@ -0,0 +1,864 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <uiohook.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#include "atomic_helper.h"
+#include "dispatch_event.h"
+#include "event_clock.h"
+#include "event_ring.h"
+#include "event_sink.h"
+#include "hook_stats.h"
+#include "hotkey.h"
+#include "key_state.h"
+#include "logger.h"
+
+// The context used by the functions that predate hook_ctx_create().
+static uiohook_ctx default_context = {
+    .event_mask = EVENT_MASK_ALL,
+    .refs = 1
+};
+
+// Every live context, the default context always holds the first slot.
+static uiohook_ctx *contexts[UIOHOOK_MAX_CONTEXTS] = { &default_context };
+
+// The context whose hook_ctx_run() is running the native hook, if any.
+static uiohook_ctx * volatile driver_context = NULL;
+
+#ifdef _WIN32
+static SRWLOCK context_mutex = SRWLOCK_INIT;
+static CONDITION_VARIABLE context_cond = CONDITION_VARIABLE_INIT;
+#else
+static pthread_mutex_t context_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t context_cond = PTHREAD_COND_INITIALIZER;
+#endif
+
+// Serializes delivery between the hook thread and the motion thread.  It is
+// held while dispatchers run, so nothing else ever waits on it.
+#ifdef _WIN32
+static SRWLOCK dispatch_mutex = SRWLOCK_INIT;
+static volatile DWORD dispatch_owner;
+#else
+static pthread_mutex_t dispatch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile pthread_t dispatch_owner;
+#endif
+
+// The lock may be taken again by the thread holding it, a dispatcher may
+// pump messages that re-enter the native hook callback.
+static volatile bool dispatch_owned = false;
+static unsigned int dispatch_depth = 0;
+
+// Contexts taken for one delivery.  Each holds a reference, so a context
+// destroyed in the meantime is only freed once the delivery is done with it.
+typedef struct {
+    uiohook_ctx *contexts[UIOHOOK_MAX_CONTEXTS];
+    size_t count;
+} context_snapshot;
+
+// Mouse motion coalescing window in microseconds, zero disables coalescing.
+static volatile uint32_t motion_interval = 0;
+
+// Latest motion event held back during the current coalescing window, the
+// window starts at the monotonic capture time of the last delivered motion.
+static uiohook_event motion_event;
+static bool motion_pending = false;
+static uint64_t motion_window_time = 0;
+
+// Delivers a held motion once its window has passed without another event,
+// so the final pointer position is not held back until the next input.
+static volatile bool motion_running = false;
+static volatile uint64_t motion_deadline = 0;
+
+#ifdef _WIN32
+static HANDLE motion_thread = NULL;
+static SRWLOCK motion_mutex = SRWLOCK_INIT;
+static CONDITION_VARIABLE motion_cond = CONDITION_VARIABLE_INIT;
+#else
+static pthread_t motion_thread;
+static pthread_mutex_t motion_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t motion_cond = PTHREAD_COND_INITIALIZER;
+#endif
+
+// Set when the application never consumes events by setting reserved.
+static volatile bool listen_only = false;
+
+void lock_contexts() {
+    #ifdef _WIN32
+    AcquireSRWLockExclusive(&context_mutex);
+    #else
+    pthread_mutex_lock(&context_mutex);
+    #endif
+}
+
+void unlock_contexts() {
+    #ifdef _WIN32
+    ReleaseSRWLockExclusive(&context_mutex);
+    #else
+    pthread_mutex_unlock(&context_mutex);
+    #endif
+}
+
+static inline bool is_dispatch_owner() {
+    // Only the owner stores itself and it clears the flag before unlocking,
+    // so no other thread can observe a match.
+    #ifdef _WIN32
+    return atomic_load_acquire(&dispatch_owned) && dispatch_owner == GetCurrentThreadId();
+    #else
+    return atomic_load_acquire(&dispatch_owned) && pthread_equal(dispatch_owner, pthread_self());
+    #endif
+}
+
+static inline void claim_dispatch() {
+    #ifdef _WIN32
+    dispatch_owner = GetCurrentThreadId();
+    #else
+    dispatch_owner = pthread_self();
+    #endif
+
+    dispatch_depth = 1;
+    atomic_store_release(&dispatch_owned, true);
+}
+
+static void lock_dispatch() {
+    if (is_dispatch_owner()) {
+        dispatch_depth++;
+        return;
+    }
+
+    #ifdef _WIN32
+    AcquireSRWLockExclusive(&dispatch_mutex);
+    #else
+    pthread_mutex_lock(&dispatch_mutex);
+    #endif
+
+    claim_dispatch();
+}
+
+// Returns false instead of waiting if another thread is delivering.
+static bool try_lock_dispatch() {
+    if (is_dispatch_owner()) {
+        dispatch_depth++;
+        return true;
+    }
+
+    #ifdef _WIN32
+    if (!TryAcquireSRWLockExclusive(&dispatch_mutex)) {
+    #else
+    if (pthread_mutex_trylock(&dispatch_mutex) != 0) {
+    #endif
+        return false;
+    }
+
+    claim_dispatch();
+
+    return true;
+}
+
+static void unlock_dispatch() {
+    if (--dispatch_depth > 0) {
+        return;
+    }
+
+    atomic_store_release(&dispatch_owned, false);
+
+    #ifdef _WIN32
+    ReleaseSRWLockExclusive(&dispatch_mutex);
+    #else
+    pthread_mutex_unlock(&dispatch_mutex);
+    #endif
+}
+
+// The caller must hold the context lock.
+static inline void take_context(context_snapshot *snapshot, uiohook_ctx *ctx) {
+    ctx->refs++;
+    snapshot->contexts[snapshot->count++] = ctx;
+}
+
+static void free_context(uiohook_ctx *ctx) {
+    if (ctx->post != NULL) {
+        hook_post_context_destroy(ctx->post);
+    }
+    free(ctx);
+}
+
+// Drop the references taken for a delivery, the last one frees a destroyed context.
+static void release_contexts(context_snapshot *snapshot) {
+    if (snapshot->count == 0) {
+        return;
+    }
+
+    uiohook_ctx *unused[UIOHOOK_MAX_CONTEXTS];
+    size_t unused_count = 0;
+
+    lock_contexts();
+    for (size_t i = 0; i < snapshot->count; i++) {
+        if (--snapshot->contexts[i]->refs == 0) {
+            unused[unused_count++] = snapshot->contexts[i];
+        }
+    }
+
+    // Wake any hook_ctx_run() waiting for its stopped context.
+    #ifdef _WIN32
+    WakeAllConditionVariable(&context_cond);
+    #else
+    pthread_cond_broadcast(&context_cond);
+    #endif
+    unlock_contexts();
+
+    for (size_t i = 0; i < unused_count; i++) {
+        free_context(unused[i]);
+    }
+}
+
+void wait_context_idle(uiohook_ctx *ctx) {
+    lock_contexts();
+    // Only the context list holds a reference once no delivery is using it.
+    while (ctx->refs > 1) {
+        #ifdef _WIN32
+        SleepConditionVariableSRW(&context_cond, &context_mutex, INFINITE, 0);
+        #else
+        pthread_cond_wait(&context_cond, &context_mutex);
+        #endif
+    }
+    unlock_contexts();
+}
+
+uiohook_ctx * get_default_context() {
+    return &default_context;
+}
+
+void set_driver_context(uiohook_ctx *ctx) {
+    atomic_store_release(&driver_context, ctx);
+}
+
+uiohook_ctx * get_driver_context() {
+    return atomic_load_acquire(&driver_context);
+}
+
+void set_context_running(uiohook_ctx *ctx, bool running) {
+    atomic_store_release(&ctx->is_receiving, running);
+    atomic_store_release(&ctx->is_running, running);
+}
+
+void stop_contexts() {
+    for (size_t i = 0; i < UIOHOOK_MAX_CONTEXTS; i++) {
+        if (contexts[i] != NULL) {
+            set_context_running(contexts[i], false);
+        }
+    }
+}
+
+static inline void motion_lock() {
+    #ifdef _WIN32
+    AcquireSRWLockExclusive(&motion_mutex);
+    #else
+    pthread_mutex_lock(&motion_mutex);
+    #endif
+}
+
+static inline void motion_unlock() {
+    #ifdef _WIN32
+    ReleaseSRWLockExclusive(&motion_mutex);
+    #else
+    pthread_mutex_unlock(&motion_mutex);
+    #endif
+}
+
+static inline void motion_signal() {
+    #ifdef _WIN32
+    WakeConditionVariable(&motion_cond);
+    #else
+    pthread_cond_signal(&motion_cond);
+    #endif
+}
+
+// Wait for a signal or until timeout nanoseconds have passed, UINT64_MAX
+// waits for a signal only.
+static inline void motion_wait(uint64_t timeout) {
+    #ifdef _WIN32
+    DWORD ms = timeout == UINT64_MAX ? INFINITE : (DWORD) ((timeout + NSEC_PER_MSEC - 1) / NSEC_PER_MSEC);
+    SleepConditionVariableSRW(&motion_cond, &motion_mutex, ms, 0);
+    #else
+    if (timeout == UINT64_MAX) {
+        pthread_cond_wait(&motion_cond, &motion_mutex);
+    } else {
+        // The condition variable waits on the realtime clock.
+        struct timespec ts;
+        clock_gettime(CLOCK_REALTIME, &ts);
+
+        uint64_t wake = (uint64_t) ts.tv_nsec + timeout;
+        ts.tv_sec += (time_t) (wake / NSEC_PER_SEC);
+        ts.tv_nsec = (long) (wake % NSEC_PER_SEC);
+        pthread_cond_timedwait(&motion_cond, &motion_mutex, &ts);
+    }
+    #endif
+}
+
+// Ask the motion thread to deliver the held motion at deadline.  The caller
+// must hold the dispatch lock.
+static void schedule_motion_flush(uint64_t deadline) {
+    if (atomic_load_acquire(&motion_running)) {
+        motion_lock();
+        atomic_store_release(&motion_deadline, deadline);
+        motion_signal();
+        motion_unlock();
+    }
+}
+
+static void deliver_event(uiohook_event *const event);
+static void flush_contexts();
+
+// Deliver the held motion if its window has passed, or unconditionally if
+// forced.  The caller must hold the dispatch lock.
+static bool deliver_held_motion(bool force) {
+    uint64_t interval = (uint64_t) atomic_load_acquire(&motion_interval) * NSEC_PER_USEC;
+    if (!motion_pending || (!force && get_monotonic_time() - motion_window_time < interval)) {
+        return false;
+    }
+
+    motion_pending = false;
+    deliver_event(&motion_event);
+
+    return true;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI motion_thread_proc(LPVOID arg) {
+#else
+static void *motion_thread_proc(void *arg) {
+#endif
+    motion_lock();
+    while (atomic_load_acquire(&motion_running)) {
+        uint64_t deadline = atomic_load_acquire(&motion_deadline);
+        uint64_t now = get_monotonic_time();
+
+        if (deadline == 0) {
+            motion_wait(UINT64_MAX);
+        } else if (now < deadline) {
+            motion_wait(deadline - now);
+        } else {
+            atomic_store_release(&motion_deadline, 0);
+            motion_unlock();
+
+            // The hook thread may have delivered or replaced the motion since.
+            // If it is delivering right now, try again rather than waiting on
+            // its dispatchers.
+            bool delivered = try_lock_dispatch();
+            if (delivered) {
+                if (deliver_held_motion(false)) {
+                    flush_contexts();
+                }
+                unlock_dispatch();
+            }
+
+            motion_lock();
+            if (!delivered && atomic_load_acquire(&motion_deadline) == 0) {
+                uint64_t interval = (uint64_t) atomic_load_acquire(&motion_interval) * NSEC_PER_USEC;
+                atomic_store_release(&motion_deadline, now + interval);
+            }
+        }
+    }
+    motion_unlock();
+
+    // Nothing is held back once coalescing is disabled.  If the hook thread is
+    // delivering, its dispatch_flush() passes the motion on instead.
+    if (try_lock_dispatch()) {
+        if (deliver_held_motion(true)) {
+            flush_contexts();
+        }
+        unlock_dispatch();
+    }
+
+    #ifdef _WIN32
+    return 0;
+    #else
+    return arg;
+    #endif
+}
+
+static void start_motion_thread() {
+    atomic_store_release(&motion_deadline, 0);
+    atomic_store_release(&motion_running, true);
+
+    #ifdef _WIN32
+    motion_thread = CreateThread(NULL, 0, motion_thread_proc, NULL, 0, NULL);
+    if (motion_thread == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: CreateThread failure! (%#lX)\n",
+                __FUNCTION__, __LINE__, (unsigned long) GetLastError());
+    #else
+    if (pthread_create(&motion_thread, NULL, motion_thread_proc, NULL) != 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: pthread_create failure!\n",
+                __FUNCTION__, __LINE__);
+    #endif
+
+        // Held motion is still delivered by the next event.
+        atomic_store_release(&motion_running, false);
+    }
+}
+
+static void stop_motion_thread() {
+    motion_lock();
+    atomic_store_release(&motion_running, false);
+    motion_signal();
+    motion_unlock();
+
+    // A dispatcher run by the motion thread may disable coalescing itself.
+    #ifdef _WIN32
+    if (GetThreadId(motion_thread) != GetCurrentThreadId()) {
+        WaitForSingleObject(motion_thread, INFINITE);
+    }
+    CloseHandle(motion_thread);
+    motion_thread = NULL;
+    #else
+    if (pthread_equal(motion_thread, pthread_self())) {
+        pthread_detach(motion_thread);
+    } else {
+        pthread_join(motion_thread, NULL);
+    }
+    #endif
+}
+
+// Without a running context the default context receives every event, so
+// dispatch_event() keeps working for code that never calls hook_ctx_run().
+static inline bool is_context_receiving(uiohook_ctx *ctx) {
+    return (atomic_load_acquire(&ctx->is_running) && atomic_load_acquire(&ctx->is_receiving))
+            || (ctx == &default_context && atomic_load_acquire(&driver_context) == NULL);
+}
+
+UIOHOOK_API uiohook_ctx * hook_ctx_get_default() {
+    return &default_context;
+}
+
+UIOHOOK_API uiohook_ctx * hook_ctx_create() {
+    uiohook_ctx *ctx = calloc(1, sizeof(uiohook_ctx));
+    if (ctx == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for hook context!\n",
+                __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    ctx->event_mask = EVENT_MASK_ALL;
+    ctx->refs = 1;
+
+    lock_contexts();
+    size_t i = 1;
+    while (i < UIOHOOK_MAX_CONTEXTS && contexts[i] != NULL) {
+        i++;
+    }
+
+    if (i < UIOHOOK_MAX_CONTEXTS) {
+        contexts[i] = ctx;
+    }
+    unlock_contexts();
+
+    if (i >= UIOHOOK_MAX_CONTEXTS) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Hook context limit of %u reached!\n",
+                __FUNCTION__, __LINE__, (unsigned int) UIOHOOK_MAX_CONTEXTS);
+
+        free(ctx);
+        return NULL;
+    }
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Created hook context %#p.\n",
+            __FUNCTION__, __LINE__, ctx);
+
+    return ctx;
+}
+
+UIOHOOK_API int hook_ctx_destroy(uiohook_ctx *ctx) {
+    if (ctx == NULL || ctx == &default_context) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Invalid hook context, the default context can not be destroyed!\n",
+                __FUNCTION__, __LINE__);
+        return UIOHOOK_FAILURE;
+    }
+
+    // Once the slot is cleared no new delivery takes the context, one still
+    // holding it frees the context when it is done.
+    int status = UIOHOOK_FAILURE;
+    bool is_unused = false;
+    lock_contexts();
+    if (!atomic_load_acquire(&ctx->is_running)) {
+        for (size_t i = 1; i < UIOHOOK_MAX_CONTEXTS; i++) {
+            if (contexts[i] == ctx) {
+                contexts[i] = NULL;
+                is_unused = --ctx->refs == 0;
+                status = UIOHOOK_SUCCESS;
+                break;
+            }
+        }
+    }
+    unlock_contexts();
+
+    if (status != UIOHOOK_SUCCESS) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Hook context %#p is running or unknown!\n",
+                __FUNCTION__, __LINE__, ctx);
+        return status;
+    }
+
+    if (is_unused) {
+        free_context(ctx);
+    }
+
+    return status;
+}
+
+UIOHOOK_API void hook_ctx_set_dispatch_proc(uiohook_ctx *ctx, dispatcher_t dispatch_proc, void *user_data) {
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Setting new dispatch callback to %#p.\n",
+            __FUNCTION__, __LINE__, dispatch_proc);
+
+    ctx->dispatch = dispatch_proc;
+    ctx->dispatch_data = user_data;
+}
+
+UIOHOOK_API void hook_ctx_set_batch_dispatch_proc(uiohook_ctx *ctx, batch_dispatcher_t dispatch_proc, void *user_data) {
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Setting new batch dispatch callback to %#p.\n",
+            __FUNCTION__, __LINE__, dispatch_proc);
+
+    ctx->batch_dispatch = dispatch_proc;
+    ctx->batch_dispatch_data = user_data;
+}
+
+UIOHOOK_API void hook_ctx_set_event_mask(uiohook_ctx *ctx, uint32_t mask) {
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Setting event class mask to %#X.\n",
+            __FUNCTION__, __LINE__, mask);
+
+    ctx->event_mask = mask;
+}
+
+UIOHOOK_API void hook_set_dispatch_proc(dispatcher_t dispatch_proc, void *user_data) {
+    hook_ctx_set_dispatch_proc(&default_context, dispatch_proc, user_data);
+}
+
+UIOHOOK_API void hook_set_batch_dispatch_proc(batch_dispatcher_t dispatch_proc, void *user_data) {
+    hook_ctx_set_batch_dispatch_proc(&default_context, dispatch_proc, user_data);
+}
+
+UIOHOOK_API void hook_set_motion_coalescing(uint32_t interval_us) {
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Setting mouse motion coalescing interval to %u us.\n",
+            __FUNCTION__, __LINE__, interval_us);
+
+    atomic_store_release(&motion_interval, interval_us);
+
+    // The motion thread delivers anything still held on its way out.
+    if (interval_us == 0 && atomic_load_acquire(&motion_running)) {
+        stop_motion_thread();
+    } else if (interval_us > 0 && !atomic_load_acquire(&motion_running)) {
+        start_motion_thread();
+    }
+}
+
+UIOHOOK_API void hook_set_event_mask(uint32_t mask) {
+    hook_ctx_set_event_mask(&default_context, mask);
+}
+
+// The union of the classes wanted by every receiving context, the caller
+// must hold the context lock.
+static uint32_t get_receiving_mask() {
+    // Hotkeys are matched on the hook thread even if no context wants the keys.
+    uint32_t mask = has_hotkeys() ? EVENT_MASK_KEYBOARD : 0;
+
+    // Sinks stream every event class.
+    if (has_sinks()) {
+        mask |= EVENT_MASK_ALL;
+    }
+    for (size_t i = 0; i < UIOHOOK_MAX_CONTEXTS; i++) {
+        if (contexts[i] != NULL && is_context_receiving(contexts[i])) {
+            mask |= contexts[i]->event_mask;
+        }
+    }
+
+    return mask;
+}
+
+uint32_t get_event_mask() {
+    lock_contexts();
+    uint32_t mask = get_receiving_mask();
+    unlock_contexts();
+
+    return mask;
+}
+
+UIOHOOK_API void hook_set_listen_only(bool enabled) {
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Setting listen only mode to %s.\n",
+            __FUNCTION__, __LINE__, enabled ? "on" : "off");
+
+    listen_only = enabled;
+}
+
+bool is_listen_only() {
+    return listen_only;
+}
+
+// Returns the EVENT_MASK_* class of the event, or zero for hook state events.
+static uint32_t get_event_class(event_type type) {
+    switch (type) {
+        case EVENT_KEY_TYPED:
+        case EVENT_KEY_PRESSED:
+        case EVENT_KEY_RELEASED:
+            return EVENT_MASK_KEYBOARD;
+
+        case EVENT_MOUSE_CLICKED:
+        case EVENT_MOUSE_PRESSED:
+        case EVENT_MOUSE_RELEASED:
+            return EVENT_MASK_MOUSE_BUTTON;
+
+        case EVENT_MOUSE_MOVED:
+        case EVENT_MOUSE_DRAGGED:
+            return EVENT_MASK_MOUSE_MOTION;
+
+        case EVENT_MOUSE_WHEEL:
+            return EVENT_MASK_MOUSE_WHEEL;
+
+        default:
+            return 0;
+    }
+}
+
+bool has_dispatch_proc() {
+    return default_context.dispatch != NULL || default_context.batch_dispatch != NULL;
+}
+
+void dispatch_context_callback(uiohook_ctx *ctx, uiohook_event *const events, size_t count) {
+    if (ctx->batch_dispatch != NULL) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Dispatching batch of %u events.\n",
+                __FUNCTION__, __LINE__, (unsigned int) count);
+
+        ctx->batch_dispatch(events, count, ctx->batch_dispatch_data);
+    } else if (ctx->dispatch != NULL) {
+        for (size_t i = 0; i < count; i++) {
+            logger(LOG_LEVEL_DEBUG, "%s [%u]: Dispatching event type %u.\n",
+                    __FUNCTION__, __LINE__, events[i].type);
+
+            ctx->dispatch(&events[i], ctx->dispatch_data);
+        }
+    } else if (ctx == &default_context) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: No dispatch callback set!\n",
+                __FUNCTION__, __LINE__);
+    }
+}
+
+// Send out events if a dispatcher was set.
+void dispatch_callback(uiohook_event *const events, size_t count) {
+    dispatch_context_callback(&default_context, events, count);
+}
+
+void dispatch_context_flush(uiohook_ctx *ctx) {
+    if (ctx->batch_count > 0) {
+        size_t count = ctx->batch_count;
+        ctx->batch_count = 0;
+
+        uint64_t start = get_monotonic_time();
+        dispatch_context_callback(ctx, ctx->batch_events, count);
+        stats_record_dispatch_time(get_monotonic_time() - start);
+    }
+}
+
+// Flush every receiving context's batch, the caller must hold the dispatch
+// lock.  A stopped context is flushed by its own hook_ctx_run().
+static void flush_contexts() {
+    context_snapshot snapshot = { .count = 0 };
+
+    lock_contexts();
+    for (size_t i = 0; i < UIOHOOK_MAX_CONTEXTS; i++) {
+        uiohook_ctx *ctx = contexts[i];
+        if (ctx != NULL && is_context_receiving(ctx) && ctx->batch_count > 0) {
+            take_context(&snapshot, ctx);
+        }
+    }
+    unlock_contexts();
+
+    for (size_t i = 0; i < snapshot.count; i++) {
+        dispatch_context_flush(snapshot.contexts[i]);
+    }
+
+    release_contexts(&snapshot);
+}
+
+void dispatch_flush() {
+    lock_dispatch();
+    // Deliver a motion whose window has passed while the hook is here anyway.
+    deliver_held_motion(false);
+    flush_contexts();
+    unlock_dispatch();
+}
+
+static void deliver_context_event(uiohook_ctx *ctx, uiohook_event *const event) {
+    if (ctx == &default_context && event_ring_is_enabled()) {
+        // The event is copied into the ring and delivered off the hook thread.
+        // NOTE Queued events can not be consumed by setting reserved.
+        event_ring_push(event);
+    } else if (ctx->batch_dispatch != NULL) {
+        // NOTE Batched events are copied and can not be consumed by setting reserved.
+        ctx->batch_events[ctx->batch_count++] = *event;
+
+        // Hook state changes are delivered right away so that callers waiting
+        // on EVENT_HOOK_ENABLED are not held up until the next input event.
+        if (ctx->batch_count >= UIOHOOK_BATCH_SIZE
+                || event->type == EVENT_HOOK_ENABLED || event->type == EVENT_HOOK_DISABLED) {
+            dispatch_context_flush(ctx);
+        }
+    } else {
+        uint64_t start = get_monotonic_time();
+        dispatch_context_callback(ctx, event, 1);
+        stats_record_dispatch_time(get_monotonic_time() - start);
+    }
+}
+
+// Deliver the event to every receiving context, the caller must hold the
+// dispatch lock.  The context lock is only held to take the contexts.
+static void deliver_event(uiohook_event *const event) {
+    stats_record_event(event->type);
+
+    uint32_t event_class = get_event_class(event->type);
+    if (event->type == EVENT_HOOK_ENABLED) {
+        stats_record_startup();
+    }
+
+    context_snapshot snapshot = { .count = 0 };
+
+    lock_contexts();
+    // Sinks only queue a copy, the event is encoded on their own threads.
+    if (has_sinks()) {
+        sink_event(event);
+    }
+
+    if (event_class == 0) {
+        // Contexts sharing the native hook get their own hook state events
+        // from hook_ctx_run(), so these only belong to the driving context.
+        uiohook_ctx *driver = atomic_load_acquire(&driver_context);
+        take_context(&snapshot, driver != NULL ? driver : &default_context);
+    } else {
+        for (size_t i = 0; i < UIOHOOK_MAX_CONTEXTS; i++) {
+            uiohook_ctx *ctx = contexts[i];
+            if (ctx != NULL && is_context_receiving(ctx) && !(event_class & ~ctx->event_mask)) {
+                take_context(&snapshot, ctx);
+            }
+        }
+    }
+    unlock_contexts();
+
+    for (size_t i = 0; i < snapshot.count; i++) {
+        deliver_context_event(snapshot.contexts[i], event);
+    }
+
+    release_contexts(&snapshot);
+
+    // Any context handling the event directly may consume it.
+    if (event->reserved & 0x01) {
+        if (listen_only) {
+            // The native hook may not be able to hold the event back.
+            event->reserved &= ~0x01;
+        } else {
+            stats_record_consumed();
+        }
+    }
+}
+
+void dispatch_event(uiohook_event *const event) {
+    // Keys are tracked whether or not anybody receives the event.
+    update_key_state(event);
+
+    uint32_t event_class = get_event_class(event->type);
+
+    lock_dispatch();
+
+    // Consumed hotkeys only reach the hotkey callback.  The native hook may not
+    // be able to hold events back in listen only mode, so they are passed on.
+    lock_contexts();
+    bool is_hotkey = event_class == EVENT_MASK_KEYBOARD && has_hotkeys()
+            && match_hotkeys(event) && !listen_only;
+
+    // Some native hooks can only be narrowed to a range of event classes.
+    bool is_unwanted = !is_hotkey && (event_class & ~get_receiving_mask());
+    unlock_contexts();
+
+    if (is_hotkey) {
+        // The held motion came first, so it is not left behind this event.
+        if (motion_pending) {
+            motion_pending = false;
+            deliver_event(&motion_event);
+        }
+
+        stats_record_event(event->type);
+        stats_record_consumed();
+        event->reserved |= 0x01;
+
+        unlock_dispatch();
+        return;
+    }
+
+    if (is_unwanted) {
+        unlock_dispatch();
+        return;
+    }
+
+    bool is_motion = event->type == EVENT_MOUSE_MOVED || event->type == EVENT_MOUSE_DRAGGED;
+
+    uint64_t interval = (uint64_t) atomic_load_acquire(&motion_interval) * NSEC_PER_USEC;
+    if (is_motion && interval > 0) {
+        // The window is timed on the monotonic capture time, event->time is
+        // not in milliseconds on every platform.
+        uint64_t capture_time = event->capture_time != 0 ? event->capture_time : get_monotonic_time();
+
+        if (!motion_pending || motion_event.type == event->type) {
+            if (capture_time - motion_window_time < interval) {
+                if (!motion_pending) {
+                    schedule_motion_flush(motion_window_time + interval);
+                }
+
+                // Only the latest position is kept, the positions are absolute
+                // so no movement is lost by replacing the held event.
+                // NOTE Held events can not be consumed by setting reserved.
+                motion_event = *event;
+                motion_pending = true;
+
+                logger(LOG_LEVEL_DEBUG, "%s [%u]: Coalesced mouse motion to %i, %i.\n",
+                        __FUNCTION__, __LINE__, event->data.mouse.x, event->data.mouse.y);
+
+                unlock_dispatch();
+                return;
+            }
+
+            // This event replaces any motion still held from the last window.
+            motion_pending = false;
+        }
+
+        motion_window_time = capture_time;
+    }
+
+    // Deliver the held motion before anything else so that ordering is kept.
+    if (motion_pending) {
+        motion_pending = false;
+        deliver_event(&motion_event);
+    }
+
+    deliver_event(event);
+
+    unlock_dispatch();
+}
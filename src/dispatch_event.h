@@ -0,0 +1,117 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _included_dispatch_event
+#define _included_dispatch_event
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <uiohook.h>
+
+// Maximum number of events collected before the batch callback is invoked.
+#ifndef UIOHOOK_BATCH_SIZE
+#define UIOHOOK_BATCH_SIZE 64
+#endif
+
+// Maximum number of live contexts, including the default context.
+#ifndef UIOHOOK_MAX_CONTEXTS
+#define UIOHOOK_MAX_CONTEXTS 16
+#endif
+
+struct _uiohook_ctx {
+    // Event dispatch callback.
+    dispatcher_t dispatch;
+    void *dispatch_data;
+
+    // Batch event dispatch callback.
+    batch_dispatcher_t batch_dispatch;
+    void *batch_dispatch_data;
+
+    // Events collected for the batch callback since the last flush.
+    uiohook_event batch_events[UIOHOOK_BATCH_SIZE];
+    size_t batch_count;
+
+    // Event classes delivered to this context.
+    volatile uint32_t event_mask;
+
+    // Set while hook_ctx_run() is running this context.
+    volatile bool is_running;
+
+    // Set once a running context may be handed events.
+    volatile bool is_receiving;
+
+    // References held by the context list and by deliveries in progress,
+    // guarded by the context lock.
+    unsigned int refs;
+
+    // Connection used by hook_ctx_post_events(), opened on first use.
+    post_context *post;
+};
+
+// Returns the context used by hook_set_dispatch_proc() and friends.
+extern uiohook_ctx * get_default_context();
+
+// Guard the context list, the hotkeys and the sinks.  Only held briefly and
+// never while a callback runs.
+extern void lock_contexts();
+extern void unlock_contexts();
+
+// Wait until no delivery still holds the stopped context.
+extern void wait_context_idle(uiohook_ctx *ctx);
+
+// Record the context running the native hook, or NULL once it has returned.
+extern void set_driver_context(uiohook_ctx *ctx);
+
+// Returns the context running the native hook, or NULL if it is not running.
+extern uiohook_ctx * get_driver_context();
+
+// Start or stop running the context and delivering events to it.
+extern void set_context_running(uiohook_ctx *ctx, bool running);
+
+// Stop delivering events to every context.  The caller must hold the context lock.
+extern void stop_contexts();
+
+// Returns true if an event or batch dispatch callback has been set on the
+// default context.
+extern bool has_dispatch_proc();
+
+// Returns the EVENT_MASK_* classes wanted by the contexts receiving events.
+extern uint32_t get_event_mask();
+
+// Returns true if hook_set_listen_only() declared that events are never consumed.
+extern bool is_listen_only();
+
+// Deliver events directly to the default context's callbacks on the calling thread.
+extern void dispatch_callback(uiohook_event *const events, size_t count);
+
+// Deliver events directly to the context's callbacks on the calling thread.
+extern void dispatch_context_callback(uiohook_ctx *ctx, uiohook_event *const events, size_t count);
+
+// Deliver any events collected for the context's batch callback.  The caller
+// must be the only one delivering to the context.
+extern void dispatch_context_flush(uiohook_ctx *ctx);
+
+// Send out an event generated by the native hook.
+extern void dispatch_event(uiohook_event *const event);
+
+// Deliver any events collected for the batch callback.  Each backend calls
+// this once it has finished processing a native callback.
+extern void dispatch_flush();
+
+#endif
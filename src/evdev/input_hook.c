@@ -0,0 +1,1178 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <linux/input.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <uiohook.h>
+#include <unistd.h>
+
+#ifdef USE_XKB_COMMON
+#include <xkbcommon/xkbcommon.h>
+#endif
+
+#include "dispatch_event.h"
+#include "event_clock.h"
+#include "hook_context.h"
+#include "hook_stats.h"
+#include "input_helper.h"
+#include "key_state.h"
+#include "logger.h"
+
+// Directory containing the kernel event devices.
+#define EVDEV_INPUT_DIR             "/dev/input"
+#define EVDEV_DEVICE_PREFIX         "event"
+
+// Maximum number of kernel events read from a device per read() call.
+#define EVDEV_READ_SIZE             64
+
+// Maximum number of epoll events handled per wakeup.
+#define EVDEV_EPOLL_SIZE            16
+
+// X11 and xkbcommon key codes are offset from evdev codes by 8.
+#define EVDEV_KEYCODE_OFFSET        8
+
+// Fallback when the multi-click time cannot be determined without X11.
+#define EVDEV_MULTI_CLICK_TIME      200
+
+#define test_bit(bit, array)        ((array)[(bit) / (sizeof(unsigned long) * 8)] & (1UL << ((bit) % (sizeof(unsigned long) * 8))))
+#define bits_size(max)              ((max) / (sizeof(unsigned long) * 8) + 1)
+
+// No touch position is known yet for a pointer pad.
+#define EVDEV_NO_POSITION           INT32_MIN
+
+typedef struct _evdev_device {
+    int fd;
+    char path[PATH_MAX];
+    bool has_abs;
+    struct input_absinfo abs_x;
+    struct input_absinfo abs_y;
+    // Touchpads move the pointer by how far the touch moved instead of
+    // placing it at the touch, the last scaled touch position.
+    bool is_pointer;
+    int32_t touch_x, touch_y;
+    // Set after SYN_DROPPED until the next SYN_REPORT.
+    bool is_dropped;
+    // Keys and buttons currently held on the device.
+    unsigned long key_bits[bits_size(KEY_MAX)];
+    struct _evdev_device *next;
+} evdev_device;
+
+typedef struct _hook_info {
+    int epoll_fd;
+    int stop_fd;
+    int notify_fd;
+    evdev_device *devices;
+    struct _input {
+        #ifdef USE_XKB_COMMON
+        struct xkb_context *context;
+        struct xkb_keymap *keymap;
+        struct xkb_state *state;
+        #endif
+        uint16_t mask;
+        struct _pointer {
+            // Bounding box of all screens, used to clamp the pointer.
+            int32_t min_x, min_y, max_x, max_y;
+            int32_t x, y;
+            bool moved;
+            int32_t wheel_v, wheel_h;
+        } pointer;
+        struct _mouse {
+            bool is_dragged;
+            struct _click {
+                unsigned short int count;
+                uint64_t time;
+                unsigned short int button;
+                long int interval;
+            } click;
+        } mouse;
+    } input;
+} hook_info;
+static hook_info *hook;
+
+// Unique addresses used to tag the non-device epoll sources.
+static int stop_source, notify_source;
+
+// Virtual event pointer.
+static uiohook_event event;
+
+
+// Set the native modifier mask for future events.
+static inline void set_modifier_mask(uint16_t mask) {
+    hook->input.mask |= mask;
+}
+
+// Unset the native modifier mask for future events.
+static inline void unset_modifier_mask(uint16_t mask) {
+    hook->input.mask &= ~mask;
+}
+
+// Get the current native modifier mask state.
+static inline uint16_t get_modifiers() {
+    return hook->input.mask;
+}
+
+static inline uint64_t get_event_timestamp(struct input_event *ev) {
+    // NOTE The kernel stamps events with CLOCK_REALTIME unless EVIOCSCLOCKID
+    // is used, so this is always a Unix epoch in MS.
+    return ((uint64_t) ev->time.tv_sec * 1000) + (ev->time.tv_usec / 1000);
+}
+
+static inline uint64_t get_unix_timestamp() {
+    struct timeval system_time;
+    gettimeofday(&system_time, NULL);
+
+    return ((uint64_t) system_time.tv_sec * 1000) + (system_time.tv_usec / 1000);
+}
+
+UIOHOOK_API uint64_t hook_capture_time_to_event_time(uint64_t capture_time) {
+    return (uint64_t) ((int64_t) capture_time + get_realtime_offset()) / NSEC_PER_MSEC;
+}
+
+static uint16_t scancode_to_modifier(uint16_t scancode) {
+    switch (scancode) {
+        case VC_SHIFT_L:   return MASK_SHIFT_L;
+        case VC_SHIFT_R:   return MASK_SHIFT_R;
+        case VC_CONTROL_L: return MASK_CTRL_L;
+        case VC_CONTROL_R: return MASK_CTRL_R;
+        case VC_ALT_L:     return MASK_ALT_L;
+        case VC_ALT_R:     return MASK_ALT_R;
+        case VC_META_L:    return MASK_META_L;
+        case VC_META_R:    return MASK_META_R;
+    }
+
+    return 0x0000;
+}
+
+static void initialize_locks(int fd) {
+    unsigned long led_bits[bits_size(LED_MAX)];
+    memset(led_bits, 0, sizeof(led_bits));
+
+    if (ioctl(fd, EVIOCGLED(sizeof(led_bits)), led_bits) >= 0) {
+        if (test_bit(LED_CAPSL, led_bits))   { set_modifier_mask(MASK_CAPS_LOCK);   }
+        if (test_bit(LED_NUML, led_bits))    { set_modifier_mask(MASK_NUM_LOCK);    }
+        if (test_bit(LED_SCROLLL, led_bits)) { set_modifier_mask(MASK_SCROLL_LOCK); }
+    }
+}
+
+// Initialize the modifier mask to the current modifiers of a device.
+static void initialize_modifiers(evdev_device *device) {
+    unsigned long *key_bits = device->key_bits;
+
+    if (ioctl(device->fd, EVIOCGKEY(sizeof(device->key_bits)), key_bits) < 0) {
+        memset(key_bits, 0, sizeof(device->key_bits));
+        return;
+    }
+
+    static const unsigned short int modifier_codes[] = {
+        KEY_LEFTSHIFT, KEY_RIGHTSHIFT, KEY_LEFTCTRL, KEY_RIGHTCTRL,
+        KEY_LEFTALT, KEY_RIGHTALT, KEY_LEFTMETA, KEY_RIGHTMETA
+    };
+
+    for (size_t i = 0; i < sizeof(modifier_codes) / sizeof(modifier_codes[0]); i++) {
+        if (test_bit(modifier_codes[i], key_bits)) {
+            set_modifier_mask(scancode_to_modifier(evdev_code_to_scancode(modifier_codes[i])));
+
+            #ifdef USE_XKB_COMMON
+            if (hook->input.state != NULL) {
+                xkb_state_update_key(hook->input.state, modifier_codes[i] + EVDEV_KEYCODE_OFFSET, XKB_KEY_DOWN);
+            }
+            #endif
+        }
+    }
+
+    if (test_bit(BTN_LEFT, key_bits))   { set_modifier_mask(MASK_BUTTON1); }
+    if (test_bit(BTN_RIGHT, key_bits))  { set_modifier_mask(MASK_BUTTON2); }
+    if (test_bit(BTN_MIDDLE, key_bits)) { set_modifier_mask(MASK_BUTTON3); }
+    if (test_bit(BTN_SIDE, key_bits))   { set_modifier_mask(MASK_BUTTON4); }
+    if (test_bit(BTN_EXTRA, key_bits))  { set_modifier_mask(MASK_BUTTON5); }
+
+    // Every key held on the device starts out pressed, not just the modifiers.
+    for (unsigned short int code = 0; code < BTN_MISC; code++) {
+        if (test_bit(code, key_bits)) {
+            set_key_state(evdev_code_to_scancode(code), true);
+        }
+    }
+    seed_key_state(get_modifiers());
+}
+
+// Compute the pointer bounds and starting position.
+static void initialize_pointer() {
+    hook->input.pointer.min_x = 0;
+    hook->input.pointer.min_y = 0;
+    hook->input.pointer.max_x = INT16_MAX;
+    hook->input.pointer.max_y = INT16_MAX;
+
+    unsigned char count = 0;
+    screen_data *screens = hook_create_screen_info(&count);
+    if (screens != NULL) {
+        if (count > 0) {
+            int32_t min_x = INT16_MAX, min_y = INT16_MAX, max_x = INT16_MIN, max_y = INT16_MIN;
+            for (unsigned char i = 0; i < count; i++) {
+                if (screens[i].x < min_x) { min_x = screens[i].x; }
+                if (screens[i].y < min_y) { min_y = screens[i].y; }
+                if (screens[i].x + screens[i].width - 1 > max_x) { max_x = screens[i].x + screens[i].width - 1; }
+                if (screens[i].y + screens[i].height - 1 > max_y) { max_y = screens[i].y + screens[i].height - 1; }
+            }
+
+            hook->input.pointer.min_x = min_x;
+            hook->input.pointer.min_y = min_y;
+            hook->input.pointer.max_x = max_x;
+            hook->input.pointer.max_y = max_y;
+        }
+
+        free(screens);
+    }
+
+    // NOTE Relative devices are integrated without pointer acceleration, so
+    // start in the center and let absolute devices correct the position.  The
+    // kernel does not know where the compositor put the pointer, so without an
+    // X server the center is where it starts.
+    hook->input.pointer.x = (hook->input.pointer.min_x + hook->input.pointer.max_x) / 2;
+    hook->input.pointer.y = (hook->input.pointer.min_y + hook->input.pointer.max_y) / 2;
+
+    #ifdef USE_X11
+    if (helper_disp != NULL) {
+        Window unused_win;
+        int root_x, root_y, unused_int;
+        unsigned int unused_mask;
+
+        XLockDisplay(helper_disp);
+        if (XQueryPointer(helper_disp, DefaultRootWindow(helper_disp), &unused_win, &unused_win, &root_x, &root_y, &unused_int, &unused_int, &unused_mask)) {
+            hook->input.pointer.x = root_x;
+            hook->input.pointer.y = root_y;
+        }
+        XUnlockDisplay(helper_disp);
+    }
+    #endif
+}
+
+static inline int32_t clamp_coordinate(int32_t value, int32_t min, int32_t max) {
+    if (value < min) {
+        value = min;
+    } else if (value > max) {
+        value = max;
+    }
+
+    return value;
+}
+
+// Scale an absolute axis value to the span of the screen bounds.
+static inline int32_t scale_abs(int32_t value, struct input_absinfo *info, int32_t span) {
+    int64_t range = (int64_t) info->maximum - info->minimum;
+
+    return (int32_t) (((int64_t) value - info->minimum) * span / range);
+}
+
+static bool has_device(const char *path) {
+    for (evdev_device *device = hook->devices; device != NULL; device = device->next) {
+        if (strcmp(device->path, path) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void close_device(evdev_device *target) {
+    evdev_device **link = &hook->devices;
+    while (*link != NULL && *link != target) {
+        link = &(*link)->next;
+    }
+
+    if (*link != NULL) {
+        *link = target->next;
+    }
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Closing input device %s.\n",
+            __FUNCTION__, __LINE__, target->path);
+
+    epoll_ctl(hook->epoll_fd, EPOLL_CTL_DEL, target->fd, NULL);
+    close(target->fd);
+    free(target);
+}
+
+static bool open_device(const char *path) {
+    if (has_device(path)) {
+        return true;
+    }
+
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Could not open %s! (%s)\n",
+                __FUNCTION__, __LINE__, path, strerror(errno));
+        return false;
+    }
+
+    unsigned long ev_bits[bits_size(EV_MAX)];
+    memset(ev_bits, 0, sizeof(ev_bits));
+    if (ioctl(fd, EVIOCGBIT(0, sizeof(ev_bits)), ev_bits) < 0
+            || !(test_bit(EV_KEY, ev_bits) || test_bit(EV_REL, ev_bits) || test_bit(EV_ABS, ev_bits))) {
+        close(fd);
+        return false;
+    }
+
+    // Skip devices that can not produce any of the subscribed event classes.
+    unsigned long key_bits[bits_size(KEY_MAX)];
+    memset(key_bits, 0, sizeof(key_bits));
+    if (test_bit(EV_KEY, ev_bits)) {
+        ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(key_bits)), key_bits);
+    }
+
+    bool has_keys = false, has_buttons = false;
+    for (unsigned int code = KEY_ESC; code < BTN_MISC && !has_keys; code++) {
+        has_keys = test_bit(code, key_bits);
+    }
+
+    for (unsigned int code = BTN_MOUSE; code < BTN_JOYSTICK && !has_buttons; code++) {
+        has_buttons = test_bit(code, key_bits);
+    }
+
+    uint32_t event_mask = get_event_mask();
+    if (!((event_mask & EVENT_MASK_KEYBOARD) && has_keys)
+            && !((event_mask & EVENT_MASK_MOUSE) && (has_buttons || test_bit(EV_REL, ev_bits) || test_bit(EV_ABS, ev_bits)))) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Skipping input device %s.\n",
+                __FUNCTION__, __LINE__, path);
+
+        close(fd);
+        return false;
+    }
+
+    evdev_device *device = calloc(1, sizeof(evdev_device));
+    if (device == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for input device!\n",
+                __FUNCTION__, __LINE__);
+
+        close(fd);
+        return false;
+    }
+
+    device->fd = fd;
+    snprintf(device->path, sizeof(device->path), "%s", path);
+
+    if (test_bit(EV_ABS, ev_bits)
+            && ioctl(fd, EVIOCGABS(ABS_X), &device->abs_x) >= 0
+            && ioctl(fd, EVIOCGABS(ABS_Y), &device->abs_y) >= 0
+            && device->abs_x.maximum > device->abs_x.minimum
+            && device->abs_y.maximum > device->abs_y.minimum) {
+        device->has_abs = true;
+
+        // Only touch screens and tablets map a touch to a screen position.
+        unsigned long prop_bits[bits_size(INPUT_PROP_MAX)];
+        memset(prop_bits, 0, sizeof(prop_bits));
+        if (ioctl(fd, EVIOCGPROP(sizeof(prop_bits)), prop_bits) >= 0) {
+            device->is_pointer = test_bit(INPUT_PROP_POINTER, prop_bits) && !test_bit(INPUT_PROP_DIRECT, prop_bits);
+        }
+    }
+    device->touch_x = EVDEV_NO_POSITION;
+    device->touch_y = EVDEV_NO_POSITION;
+
+    struct epoll_event ready = { .events = EPOLLIN, .data.ptr = device };
+    if (epoll_ctl(hook->epoll_fd, EPOLL_CTL_ADD, fd, &ready) < 0) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: epoll_ctl failure for %s! (%s)\n",
+                __FUNCTION__, __LINE__, path, strerror(errno));
+
+        close(fd);
+        free(device);
+        return false;
+    }
+
+    if (test_bit(EV_KEY, ev_bits)) {
+        initialize_modifiers(device);
+        initialize_locks(fd);
+    }
+
+    device->next = hook->devices;
+    hook->devices = device;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Opened input device %s.\n",
+            __FUNCTION__, __LINE__, path);
+
+    return true;
+}
+
+static unsigned int open_devices() {
+    unsigned int count = 0;
+
+    DIR *dir = opendir(EVDEV_INPUT_DIR);
+    if (dir == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Could not open %s! (%s)\n",
+                __FUNCTION__, __LINE__, EVDEV_INPUT_DIR, strerror(errno));
+        return count;
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, EVDEV_DEVICE_PREFIX, strlen(EVDEV_DEVICE_PREFIX)) == 0) {
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), "%s/%s", EVDEV_INPUT_DIR, entry->d_name);
+
+            if (open_device(path)) {
+                count++;
+            }
+        }
+    }
+
+    closedir(dir);
+
+    return count;
+}
+
+// Pick up devices that were plugged in, or became readable, after the hook started.
+static void process_notify() {
+    char buffer[sizeof(struct inotify_event) + NAME_MAX + 1]
+            __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+    ssize_t size;
+    while ((size = read(hook->notify_fd, buffer, sizeof(buffer))) > 0) {
+        for (char *ptr = buffer; ptr < buffer + size; ) {
+            struct inotify_event *notify = (struct inotify_event *) ptr;
+
+            if (notify->len > 0 && strncmp(notify->name, EVDEV_DEVICE_PREFIX, strlen(EVDEV_DEVICE_PREFIX)) == 0) {
+                char path[PATH_MAX];
+                snprintf(path, sizeof(path), "%s/%s", EVDEV_INPUT_DIR, notify->name);
+
+                open_device(path);
+            }
+
+            ptr += sizeof(struct inotify_event) + notify->len;
+        }
+    }
+}
+
+static void process_key(struct input_event *ev, uint64_t timestamp) {
+    uint16_t scancode = evdev_code_to_scancode(ev->code);
+    bool is_press = ev->value != 0;
+
+    uint16_t modifier = scancode_to_modifier(scancode);
+    if (is_press) {
+        set_modifier_mask(modifier);
+    } else {
+        unset_modifier_mask(modifier);
+    }
+
+    unsigned int rawcode = ev->code;
+    uint16_t buffer[2];
+    size_t count = 0;
+
+    #ifdef USE_XKB_COMMON
+    xkb_keycode_t keycode = (xkb_keycode_t) (ev->code + EVDEV_KEYCODE_OFFSET);
+    if (hook->input.state != NULL) {
+        rawcode = xkb_state_key_get_one_sym(hook->input.state, keycode);
+
+        if (is_press) {
+            count = keycode_to_unicode(hook->input.state, keycode, buffer, sizeof(buffer) / sizeof(uint16_t));
+        }
+
+        // Auto repeat does not change the keyboard state.
+        if (ev->value != 2) {
+            xkb_state_update_key(hook->input.state, keycode, is_press ? XKB_KEY_DOWN : XKB_KEY_UP);
+        }
+
+        if (xkb_state_led_name_is_active(hook->input.state, XKB_LED_NAME_CAPS) > 0) {
+            set_modifier_mask(MASK_CAPS_LOCK);
+        } else {
+            unset_modifier_mask(MASK_CAPS_LOCK);
+        }
+
+        if (xkb_state_led_name_is_active(hook->input.state, XKB_LED_NAME_NUM) > 0) {
+            set_modifier_mask(MASK_NUM_LOCK);
+        } else {
+            unset_modifier_mask(MASK_NUM_LOCK);
+        }
+
+        if (xkb_state_led_name_is_active(hook->input.state, XKB_LED_NAME_SCROLL) > 0) {
+            set_modifier_mask(MASK_SCROLL_LOCK);
+        } else {
+            unset_modifier_mask(MASK_SCROLL_LOCK);
+        }
+    } else
+    #endif
+    if (ev->value == 1) {
+        // Without a keymap the lock state is toggled by the lock keys.
+        if      (scancode == VC_CAPS_LOCK)   { hook->input.mask ^= MASK_CAPS_LOCK;   }
+        else if (scancode == VC_NUM_LOCK)    { hook->input.mask ^= MASK_NUM_LOCK;    }
+        else if (scancode == VC_SCROLL_LOCK) { hook->input.mask ^= MASK_SCROLL_LOCK; }
+    }
+
+    if ((get_modifiers() & MASK_NUM_LOCK) == 0) {
+        switch (scancode) {
+            case VC_KP_SEPARATOR:
+            case VC_KP_1:
+            case VC_KP_2:
+            case VC_KP_3:
+            case VC_KP_4:
+            case VC_KP_5:
+            case VC_KP_6:
+            case VC_KP_7:
+            case VC_KP_8:
+            case VC_KP_0:
+            case VC_KP_9:
+                scancode |= 0xEE00;
+                break;
+        }
+    }
+
+    // Populate key pressed or released event.
+    event.time = timestamp;
+    event.reserved = 0x00;
+
+    event.type = is_press ? EVENT_KEY_PRESSED : EVENT_KEY_RELEASED;
+    event.mask = get_modifiers();
+
+    event.data.keyboard.keycode = scancode;
+    event.data.keyboard.rawcode = rawcode;
+    event.data.keyboard.keychar = CHAR_UNDEFINED;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Key %#X %s. (%#X)\n",
+            __FUNCTION__, __LINE__, event.data.keyboard.keycode,
+            is_press ? "pressed" : "released", event.data.keyboard.rawcode);
+
+    // Fire key pressed or released event.
+    dispatch_event(&event);
+
+    for (unsigned int i = 0; i < count; i++) {
+        // Populate key typed event.
+        event.time = timestamp;
+        event.reserved = 0x00;
+
+        event.type = EVENT_KEY_TYPED;
+        event.mask = get_modifiers();
+
+        event.data.keyboard.keycode = VC_UNDEFINED;
+        event.data.keyboard.rawcode = rawcode;
+        event.data.keyboard.keychar = buffer[i];
+
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Key %#X typed. (%lc)\n",
+                __FUNCTION__, __LINE__, event.data.keyboard.keycode, (uint16_t) event.data.keyboard.keychar);
+
+        // Fire key typed event.
+        dispatch_event(&event);
+    }
+}
+
+static void process_motion(uint64_t timestamp) {
+    hook->input.pointer.moved = false;
+
+    // Reset the click count.
+    if (hook->input.mouse.click.count != 0 && (long int) (timestamp - hook->input.mouse.click.time) > hook->input.mouse.click.interval) {
+        hook->input.mouse.click.count = 0;
+    }
+
+    // Populate mouse move event.
+    event.time = timestamp;
+    event.reserved = 0x00;
+
+    event.mask = get_modifiers();
+
+    // Check the upper half of virtual modifiers for non-zero values and set the mouse
+    // dragged flag.  The last 3 bits are reserved for lock masks.
+    hook->input.mouse.is_dragged = ((event.mask & 0x1F00) > 0);
+    if (hook->input.mouse.is_dragged) {
+        // Create Mouse Dragged event.
+        event.type = EVENT_MOUSE_DRAGGED;
+    } else {
+        // Create a Mouse Moved event.
+        event.type = EVENT_MOUSE_MOVED;
+    }
+
+    event.data.mouse.button = MOUSE_NOBUTTON;
+    event.data.mouse.clicks = hook->input.mouse.click.count;
+    event.data.mouse.x = hook->input.pointer.x - hook->input.pointer.min_x;
+    event.data.mouse.y = hook->input.pointer.y - hook->input.pointer.min_y;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Mouse %s to %i, %i. (%#X)\n",
+            __FUNCTION__, __LINE__, hook->input.mouse.is_dragged ? "dragged" : "moved",
+            event.data.mouse.x, event.data.mouse.y, event.mask);
+
+    // Fire mouse move event.
+    dispatch_event(&event);
+}
+
+static void process_wheel(uint64_t timestamp, int32_t value, uint8_t direction) {
+    // Reset the click count and previous button.
+    hook->input.mouse.click.count = 1;
+    hook->input.mouse.click.button = MOUSE_NOBUTTON;
+
+    // Populate mouse wheel event.
+    event.time = timestamp;
+    event.reserved = 0x00;
+
+    event.type = EVENT_MOUSE_WHEEL;
+    event.mask = get_modifiers();
+
+    event.data.wheel.clicks = hook->input.mouse.click.count;
+    event.data.wheel.x = hook->input.pointer.x - hook->input.pointer.min_x;
+    event.data.wheel.y = hook->input.pointer.y - hook->input.pointer.min_y;
+
+    // Match the static unit scroll values used by the X11 backend.
+    event.data.wheel.type = WHEEL_UNIT_SCROLL;
+    event.data.wheel.amount = 3;
+
+    // Positive REL_WHEEL is up and away, positive REL_HWHEEL is to the right.
+    if (direction == WHEEL_VERTICAL_DIRECTION) {
+        event.data.wheel.rotation = (int16_t) -value;
+    } else {
+        event.data.wheel.rotation = (int16_t) value;
+    }
+    event.data.wheel.direction = direction;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Mouse wheel type %u, rotated %i units in the %u direction at %u, %u.\n",
+            __FUNCTION__, __LINE__, event.data.wheel.type,
+            event.data.wheel.amount * event.data.wheel.rotation,
+            event.data.wheel.direction,
+            event.data.wheel.x, event.data.wheel.y);
+
+    // Fire mouse wheel event.
+    dispatch_event(&event);
+}
+
+static void process_button(struct input_event *ev, uint64_t timestamp) {
+    uint16_t button = MOUSE_NOBUTTON, mask = 0x0000;
+    switch (ev->code) {
+        case BTN_LEFT:
+        case BTN_TOUCH:
+            button = MOUSE_BUTTON1;
+            mask = MASK_BUTTON1;
+            break;
+
+        case BTN_RIGHT:
+            button = MOUSE_BUTTON2;
+            mask = MASK_BUTTON2;
+            break;
+
+        case BTN_MIDDLE:
+            button = MOUSE_BUTTON3;
+            mask = MASK_BUTTON3;
+            break;
+
+        case BTN_SIDE:
+            button = MOUSE_BUTTON4;
+            mask = MASK_BUTTON4;
+            break;
+
+        case BTN_EXTRA:
+            button = MOUSE_BUTTON5;
+            mask = MASK_BUTTON5;
+            break;
+
+        default:
+            // Ignore tool and gamepad buttons.
+            return;
+    }
+
+    // Deliver any pending motion first so the button has the new position.
+    if (hook->input.pointer.moved) {
+        process_motion(timestamp);
+    }
+
+    if (ev->value) {
+        set_modifier_mask(mask);
+
+        // Track the number of clicks, the button must match the previous button.
+        if (button == hook->input.mouse.click.button && (long int) (timestamp - hook->input.mouse.click.time) <= hook->input.mouse.click.interval) {
+            if (hook->input.mouse.click.count < USHRT_MAX) {
+                hook->input.mouse.click.count++;
+            } else {
+                logger(LOG_LEVEL_WARN, "%s [%u]: Click count overflow detected!\n",
+                        __FUNCTION__, __LINE__);
+            }
+        } else {
+            // Reset the click count.
+            hook->input.mouse.click.count = 1;
+
+            // Set the previous button.
+            hook->input.mouse.click.button = button;
+        }
+
+        // Save this events time to calculate the hook->input.mouse.click.count.
+        hook->input.mouse.click.time = timestamp;
+    } else {
+        unset_modifier_mask(mask);
+    }
+
+    // Populate mouse pressed or released event.
+    event.time = timestamp;
+    event.reserved = 0x00;
+
+    event.type = ev->value ? EVENT_MOUSE_PRESSED : EVENT_MOUSE_RELEASED;
+    event.mask = get_modifiers();
+
+    event.data.mouse.button = button;
+    event.data.mouse.clicks = hook->input.mouse.click.count;
+    event.data.mouse.x = hook->input.pointer.x - hook->input.pointer.min_x;
+    event.data.mouse.y = hook->input.pointer.y - hook->input.pointer.min_y;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Button %u %s %u time(s). (%u, %u)\n",
+            __FUNCTION__, __LINE__, event.data.mouse.button,
+            ev->value ? "pressed" : "released", event.data.mouse.clicks,
+            event.data.mouse.x, event.data.mouse.y);
+
+    // Fire mouse pressed or released event.
+    dispatch_event(&event);
+
+    if (!ev->value) {
+        if (hook->input.mouse.is_dragged != true) {
+            // Populate mouse clicked event.
+            event.time = timestamp;
+            event.reserved = 0x00;
+
+            event.type = EVENT_MOUSE_CLICKED;
+            event.mask = get_modifiers();
+
+            event.data.mouse.button = button;
+            event.data.mouse.clicks = hook->input.mouse.click.count;
+            event.data.mouse.x = hook->input.pointer.x - hook->input.pointer.min_x;
+            event.data.mouse.y = hook->input.pointer.y - hook->input.pointer.min_y;
+
+            logger(LOG_LEVEL_DEBUG, "%s [%u]: Button %u clicked %u time(s). (%u, %u)\n",
+                    __FUNCTION__, __LINE__, event.data.mouse.button,
+                    event.data.mouse.clicks,
+                    event.data.mouse.x, event.data.mouse.y);
+
+            // Fire mouse clicked event.
+            dispatch_event(&event);
+        }
+
+        // Reset the number of clicks.
+        if (button == hook->input.mouse.click.button && (long int) (timestamp - hook->input.mouse.click.time) > hook->input.mouse.click.interval) {
+            // Reset the click count.
+            hook->input.mouse.click.count = 0;
+        }
+    }
+}
+
+static void process_input_event(evdev_device *device, struct input_event *ev, int64_t realtime_offset);
+
+// The kernel dropped events, so replay every key and button that changed
+// meanwhile to keep the modifiers and held keys in line with the device.
+static void resync_device(evdev_device *device, struct input_event *report, int64_t realtime_offset) {
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Resynchronizing input device %s.\n",
+            __FUNCTION__, __LINE__, device->path);
+
+    unsigned long key_bits[bits_size(KEY_MAX)];
+    memset(key_bits, 0, sizeof(key_bits));
+    if (ioctl(device->fd, EVIOCGKEY(sizeof(key_bits)), key_bits) >= 0) {
+        for (unsigned short int code = 0; code < KEY_OK; code++) {
+            bool is_down = test_bit(code, key_bits) != 0;
+            if (is_down != (test_bit(code, device->key_bits) != 0)) {
+                struct input_event ev = {
+                    .time = report->time,
+                    .type = EV_KEY,
+                    .code = code,
+                    .value = is_down ? 1 : 0
+                };
+
+                process_input_event(device, &ev, realtime_offset);
+            }
+        }
+    }
+
+    // The touch may have ended or moved while events were dropped.
+    device->touch_x = EVDEV_NO_POSITION;
+    device->touch_y = EVDEV_NO_POSITION;
+
+    if (device->has_abs && !device->is_pointer) {
+        struct input_absinfo info;
+        if (ioctl(device->fd, EVIOCGABS(ABS_X), &info) >= 0) {
+            struct input_event ev = { .time = report->time, .type = EV_ABS, .code = ABS_X, .value = info.value };
+            process_input_event(device, &ev, realtime_offset);
+        }
+
+        if (ioctl(device->fd, EVIOCGABS(ABS_Y), &info) >= 0) {
+            struct input_event ev = { .time = report->time, .type = EV_ABS, .code = ABS_Y, .value = info.value };
+            process_input_event(device, &ev, realtime_offset);
+        }
+    }
+}
+
+static void process_input_event(evdev_device *device, struct input_event *ev, int64_t realtime_offset) {
+    // Everything up to the report after SYN_DROPPED is incomplete, the device
+    // state is queried instead and that report delivers the new position.
+    if (device->is_dropped) {
+        if (ev->type != EV_SYN || ev->code != SYN_REPORT) {
+            return;
+        }
+
+        device->is_dropped = false;
+        resync_device(device, ev, realtime_offset);
+    }
+
+    uint64_t timestamp = get_event_timestamp(ev);
+
+    // Move the microsecond kernel time over to the monotonic clock.
+    event.capture_time = (uint64_t) ((int64_t) ev->time.tv_sec * (int64_t) NSEC_PER_SEC
+            + (int64_t) ev->time.tv_usec * (int64_t) NSEC_PER_USEC - realtime_offset);
+
+    switch (ev->type) {
+        case EV_KEY:
+            if (ev->code <= KEY_MAX && ev->value != 2) {
+                unsigned long bit = 1UL << (ev->code % (sizeof(unsigned long) * 8));
+                if (ev->value) {
+                    device->key_bits[ev->code / (sizeof(unsigned long) * 8)] |= bit;
+                } else {
+                    device->key_bits[ev->code / (sizeof(unsigned long) * 8)] &= ~bit;
+                }
+            }
+
+            if (ev->code == BTN_TOUCH && device->is_pointer) {
+                // Touchpads click with BTN_LEFT, a touch only starts a new stroke.
+                device->touch_x = EVDEV_NO_POSITION;
+                device->touch_y = EVDEV_NO_POSITION;
+            } else if (ev->code >= BTN_MISC && ev->code < KEY_OK) {
+                if (ev->value != 2) {
+                    process_button(ev, timestamp);
+                }
+            } else if (ev->code + EVDEV_KEYCODE_OFFSET <= UINT8_MAX) {
+                process_key(ev, timestamp);
+            }
+            break;
+
+        case EV_REL:
+            if (ev->code == REL_X) {
+                hook->input.pointer.x = clamp_coordinate(hook->input.pointer.x + ev->value,
+                        hook->input.pointer.min_x, hook->input.pointer.max_x);
+                hook->input.pointer.moved = true;
+            } else if (ev->code == REL_Y) {
+                hook->input.pointer.y = clamp_coordinate(hook->input.pointer.y + ev->value,
+                        hook->input.pointer.min_y, hook->input.pointer.max_y);
+                hook->input.pointer.moved = true;
+            } else if (ev->code == REL_WHEEL) {
+                hook->input.pointer.wheel_v += ev->value;
+            } else if (ev->code == REL_HWHEEL) {
+                hook->input.pointer.wheel_h += ev->value;
+            }
+            break;
+
+        case EV_ABS:
+            if (device->has_abs && ev->code == ABS_X) {
+                int32_t x = scale_abs(ev->value, &device->abs_x, hook->input.pointer.max_x - hook->input.pointer.min_x);
+                if (!device->is_pointer) {
+                    // Scale absolute devices, like touch screens, to the screen bounds.
+                    hook->input.pointer.x = hook->input.pointer.min_x + x;
+                    hook->input.pointer.moved = true;
+                } else {
+                    // Touchpads move the pointer like a mouse, across the pad is across the screens.
+                    if (device->touch_x != EVDEV_NO_POSITION && x != device->touch_x) {
+                        hook->input.pointer.x = clamp_coordinate(hook->input.pointer.x + x - device->touch_x,
+                                hook->input.pointer.min_x, hook->input.pointer.max_x);
+                        hook->input.pointer.moved = true;
+                    }
+                    device->touch_x = x;
+                }
+            } else if (device->has_abs && ev->code == ABS_Y) {
+                int32_t y = scale_abs(ev->value, &device->abs_y, hook->input.pointer.max_y - hook->input.pointer.min_y);
+                if (!device->is_pointer) {
+                    hook->input.pointer.y = hook->input.pointer.min_y + y;
+                    hook->input.pointer.moved = true;
+                } else {
+                    if (device->touch_y != EVDEV_NO_POSITION && y != device->touch_y) {
+                        hook->input.pointer.y = clamp_coordinate(hook->input.pointer.y + y - device->touch_y,
+                                hook->input.pointer.min_y, hook->input.pointer.max_y);
+                        hook->input.pointer.moved = true;
+                    }
+                    device->touch_y = y;
+                }
+            }
+            break;
+
+        case EV_SYN:
+            if (ev->code == SYN_REPORT) {
+                // Skip reports stamped in the future by a realtime clock step.
+                uint64_t now = get_monotonic_time();
+                if (now >= event.capture_time) {
+                    stats_record_lag((now - event.capture_time) / NSEC_PER_USEC);
+                }
+
+                // Motion and wheel values are accumulated until the end of each report.
+                if (hook->input.pointer.moved) {
+                    process_motion(timestamp);
+                }
+
+                if (hook->input.pointer.wheel_v != 0) {
+                    process_wheel(timestamp, hook->input.pointer.wheel_v, WHEEL_VERTICAL_DIRECTION);
+                    hook->input.pointer.wheel_v = 0;
+                }
+
+                if (hook->input.pointer.wheel_h != 0) {
+                    process_wheel(timestamp, hook->input.pointer.wheel_h, WHEEL_HORIZONTAL_DIRECTION);
+                    hook->input.pointer.wheel_h = 0;
+                }
+            } else if (ev->code == SYN_DROPPED) {
+                logger(LOG_LEVEL_WARN, "%s [%u]: Kernel event buffer overrun on %s!\n",
+                        __FUNCTION__, __LINE__, device->path);
+
+                // Drop the partial report, the device is queried at its end.
+                hook->input.pointer.wheel_v = 0;
+                hook->input.pointer.wheel_h = 0;
+                device->is_dropped = true;
+            }
+            break;
+    }
+}
+
+// Read all pending events from a device in batches.
+static void read_device(evdev_device *device) {
+    struct input_event buffer[EVDEV_READ_SIZE];
+
+    ssize_t size;
+    while ((size = read(device->fd, buffer, sizeof(buffer))) > 0) {
+        // The kernel stamps events with CLOCK_REALTIME, sample the offset to the
+        // monotonic clock once per batch.
+        int64_t realtime_offset = get_realtime_offset();
+
+        size_t count = (size_t) size / sizeof(struct input_event);
+        for (size_t i = 0; i < count; i++) {
+            process_input_event(device, &buffer[i], realtime_offset);
+        }
+
+        if ((size_t) size < sizeof(buffer)) {
+            break;
+        }
+    }
+
+    if (size < 0 && errno != EAGAIN && errno != EINTR) {
+        // ENODEV is expected when the device is unplugged.
+        close_device(device);
+    }
+}
+
+static int evdev_block() {
+    int status = UIOHOOK_SUCCESS;
+    struct epoll_event ready[EVDEV_EPOLL_SIZE];
+
+    bool running = true;
+    while (running) {
+        int count = epoll_wait(hook->epoll_fd, ready, EVDEV_EPOLL_SIZE, -1);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            logger(LOG_LEVEL_ERROR, "%s [%u]: epoll_wait failure! (%s)\n",
+                    __FUNCTION__, __LINE__, strerror(errno));
+
+            status = UIOHOOK_FAILURE;
+            break;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (ready[i].data.ptr == &stop_source) {
+                running = false;
+            } else if (ready[i].data.ptr == &notify_source) {
+                process_notify();
+            } else {
+                read_device((evdev_device *) ready[i].data.ptr);
+            }
+        }
+
+        // Deliver anything collected for the batch callback.
+        dispatch_flush();
+    }
+
+    return status;
+}
+
+static int evdev_start() {
+    int status = UIOHOOK_FAILURE;
+
+    hook->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (hook->epoll_fd < 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: epoll_create1 failure! (%s)\n",
+                __FUNCTION__, __LINE__, strerror(errno));
+
+        return UIOHOOK_ERROR_EPOLL_CREATE;
+    }
+
+    hook->stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (hook->stop_fd >= 0) {
+        struct epoll_event ready = { .events = EPOLLIN, .data.ptr = &stop_source };
+        epoll_ctl(hook->epoll_fd, EPOLL_CTL_ADD, hook->stop_fd, &ready);
+    } else {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: eventfd failure! (%s)\n",
+                __FUNCTION__, __LINE__, strerror(errno));
+
+        status = UIOHOOK_ERROR_EPOLL_CREATE;
+    }
+
+    // Hotplug support is optional.
+    hook->notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (hook->notify_fd >= 0 && inotify_add_watch(hook->notify_fd, EVDEV_INPUT_DIR, IN_CREATE | IN_ATTRIB) >= 0) {
+        struct epoll_event ready = { .events = EPOLLIN, .data.ptr = &notify_source };
+        epoll_ctl(hook->epoll_fd, EPOLL_CTL_ADD, hook->notify_fd, &ready);
+    } else {
+        logger(LOG_LEVEL_WARN, "%s [%u]: inotify failure, input devices will not be hot plugged!\n",
+                __FUNCTION__, __LINE__);
+    }
+
+    #ifdef USE_XKB_COMMON
+    // Compile the keymap from the XKB_DEFAULT_* environment or the system defaults.
+    hook->input.context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+    if (hook->input.context != NULL) {
+        hook->input.keymap = xkb_keymap_new_from_names(hook->input.context, NULL, XKB_KEYMAP_COMPILE_NO_FLAGS);
+        if (hook->input.keymap != NULL) {
+            hook->input.state = xkb_state_new(hook->input.keymap);
+        } else {
+            logger(LOG_LEVEL_WARN, "%s [%u]: xkb_keymap_new_from_names failure, key typed events are unavailable!\n",
+                    __FUNCTION__, __LINE__);
+        }
+    } else {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: xkb_context_new failure!\n",
+                __FUNCTION__, __LINE__);
+    }
+    #endif
+
+    hook->input.mouse.click.interval = hook_get_multi_click_time();
+    if (hook->input.mouse.click.interval < 0) {
+        hook->input.mouse.click.interval = EVDEV_MULTI_CLICK_TIME;
+    }
+
+    initialize_pointer();
+
+    if (hook->stop_fd >= 0) {
+        // Devices add the keys they report as held while they are opened.
+        reset_key_state(0x0000);
+
+        if (open_devices() > 0) {
+            // Populate the hook start event.
+            event.time = get_unix_timestamp();
+            event.capture_time = get_monotonic_time();
+            event.reserved = 0x00;
+
+            event.type = EVENT_HOOK_ENABLED;
+            event.mask = 0x00;
+
+            // Fire the hook start event.
+            dispatch_event(&event);
+
+            // Block until hook_stop() is called.
+            status = evdev_block();
+
+            // Populate the hook stop event.
+            event.time = get_unix_timestamp();
+            event.capture_time = get_monotonic_time();
+            event.reserved = 0x00;
+
+            event.type = EVENT_HOOK_DISABLED;
+            event.mask = 0x00;
+
+            // Fire the hook stop event.
+            dispatch_event(&event);
+        } else {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: No readable input devices in %s!\n",
+                    __FUNCTION__, __LINE__, EVDEV_INPUT_DIR);
+
+            status = UIOHOOK_ERROR_OPEN_DEVICE;
+        }
+    }
+
+    while (hook->devices != NULL) {
+        close_device(hook->devices);
+    }
+
+    #ifdef USE_XKB_COMMON
+    if (hook->input.state != NULL) {
+        xkb_state_unref(hook->input.state);
+        hook->input.state = NULL;
+    }
+
+    if (hook->input.keymap != NULL) {
+        xkb_keymap_unref(hook->input.keymap);
+        hook->input.keymap = NULL;
+    }
+
+    if (hook->input.context != NULL) {
+        xkb_context_unref(hook->input.context);
+        hook->input.context = NULL;
+    }
+    #endif
+
+    if (hook->notify_fd >= 0) {
+        close(hook->notify_fd);
+        hook->notify_fd = -1;
+    }
+
+    if (hook->stop_fd >= 0) {
+        close(hook->stop_fd);
+        hook->stop_fd = -1;
+    }
+
+    close(hook->epoll_fd);
+    hook->epoll_fd = -1;
+
+    return status;
+}
+
+int run_native_hook() {
+    // Hook data for future cleanup.
+    hook = calloc(1, sizeof(hook_info));
+    if (hook == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for hook structure!\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_ERROR_OUT_OF_MEMORY;
+    }
+
+    hook->epoll_fd = -1;
+    hook->stop_fd = -1;
+    hook->notify_fd = -1;
+    hook->input.mouse.click.button = MOUSE_NOBUTTON;
+
+    int status = evdev_start();
+
+    // Free data associated with this hook.
+    free(hook);
+    hook = NULL;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Something, something, something, complete.\n",
+            __FUNCTION__, __LINE__);
+
+    return status;
+}
+
+int stop_native_hook() {
+    int status = UIOHOOK_FAILURE;
+
+    if (hook != NULL && hook->stop_fd >= 0) {
+        uint64_t value = 1;
+        if (write(hook->stop_fd, &value, sizeof(value)) == sizeof(value)) {
+            status = UIOHOOK_SUCCESS;
+        } else {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to signal the hook thread! (%s)\n",
+                    __FUNCTION__, __LINE__, strerror(errno));
+        }
+    }
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Status: %#X.\n",
+            __FUNCTION__, __LINE__, status);
+
+    return status;
+}
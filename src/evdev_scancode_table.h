@@ -0,0 +1,319 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _included_evdev_scancode_table
+#define _included_evdev_scancode_table
+
+#include <stdint.h>
+#include <uiohook.h>
+
+// Shared by the X11 and Linux input helpers, which define SCANCODE_TABLE_SIZE
+// and SCANCODE_TABLE_ALIGN before including this header.
+
+/* The following table is based on QEMU's x_keymap.c, under the following
+ * terms:
+ *
+ * Copyright (C) 2003 Fabrice Bellard <fabrice@bellard.org>
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/* This table is generated based off the evdev -> scancode mapping
+ * and the keycode mappings in the following files:
+ *    /usr/include/linux/input.h
+ *    /usr/share/X11/xkb/keycodes/evdev
+ *
+ * NOTE This table only works for Linux.
+ */
+static SCANCODE_TABLE_ALIGN const uint16_t evdev_scancode_table[SCANCODE_TABLE_SIZE] = {
+    /* idx        keycode,                      evdev code */
+    /*   0 */    VC_UNDEFINED,
+    /*   1 */    VC_UNDEFINED,
+    /*   2 */    VC_UNDEFINED,
+    /*   3 */    VC_UNDEFINED,
+    /*   4 */    VC_UNDEFINED,
+    /*   5 */    VC_UNDEFINED,
+    /*   6 */    VC_UNDEFINED,
+    /*   7 */    VC_UNDEFINED,
+    /*   8 */    VC_UNDEFINED,                 /* 0x00    KEY_RESERVED */
+    /*   9 */    VC_ESCAPE,                    /* 0x01    KEY_ESC */
+    /*  10 */    VC_1,                         /* 0x02    KEY_1 */
+    /*  11 */    VC_2,                         /* 0x03    KEY_2 */
+    /*  12 */    VC_3,                         /* 0x04    KEY_3 */
+    /*  13 */    VC_4,                         /* 0x05    KEY_4 */
+    /*  14 */    VC_5,                         /* 0x06    KEY_5 */
+    /*  15 */    VC_6,                         /* 0x07    KEY_6 */
+    /*  16 */    VC_7,                         /* 0x08    KEY_7 */
+    /*  17 */    VC_8,                         /* 0x09    KEY_8 */
+    /*  18 */    VC_9,                         /* 0x0A    KEY_9 */
+    /*  19 */    VC_0,                         /* 0x0B    KEY_0 */
+    /*  20 */    VC_MINUS,                     /* 0x0C    KEY_MINUS */
+    /*  21 */    VC_EQUALS,                    /* 0x0D    KEY_EQUAL */
+    /*  22 */    VC_BACKSPACE,                 /* 0x0E    KEY_BACKSPACE */
+    /*  23 */    VC_TAB,                       /* 0x0F    KEY_TAB */
+    /*  24 */    VC_Q,                         /* 0x10    KEY_Q */
+    /*  25 */    VC_W,                         /* 0x11    KEY_W */
+    /*  26 */    VC_E,                         /* 0x12    KEY_E */
+    /*  27 */    VC_R,                         /* 0x13    KEY_R */
+    /*  28 */    VC_T,                         /* 0x14    KEY_T */
+    /*  29 */    VC_Y,                         /* 0x15    KEY_Y */
+    /*  30 */    VC_U,                         /* 0x16    KEY_U */
+    /*  31 */    VC_I,                         /* 0x17    KEY_I */
+    /*  32 */    VC_O,                         /* 0x18    KEY_O */
+    /*  33 */    VC_P,                         /* 0x19    KEY_P */
+    /*  34 */    VC_OPEN_BRACKET,              /* 0x1A    KEY_LEFTBRACE */
+    /*  35 */    VC_CLOSE_BRACKET,             /* 0x1B    KEY_RIGHTBRACE */
+    /*  36 */    VC_ENTER,                     /* 0x1C    KEY_ENTER */
+    /*  37 */    VC_CONTROL_L,                 /* 0x1D    KEY_LEFTCTRL */
+    /*  38 */    VC_A,                         /* 0x1E    KEY_A */
+    /*  39 */    VC_S,                         /* 0x1F    KEY_S */
+    /*  40 */    VC_D,                         /* 0x20    KEY_D */
+    /*  41 */    VC_F,                         /* 0x21    KEY_F */
+    /*  42 */    VC_G,                         /* 0x22    KEY_G */
+    /*  43 */    VC_H,                         /* 0x23    KEY_H */
+    /*  44 */    VC_J,                         /* 0x24    KEY_J */
+    /*  45 */    VC_K,                         /* 0x25    KEY_K */
+    /*  46 */    VC_L,                         /* 0x26    KEY_L */
+    /*  47 */    VC_SEMICOLON,                 /* 0x27    KEY_SEMICOLON */
+    /*  48 */    VC_QUOTE,                     /* 0x28    KEY_APOSTROPHE */
+    /*  49 */    VC_BACKQUOTE,                 /* 0x29    KEY_GRAVE */
+    /*  50 */    VC_SHIFT_L,                   /* 0x2A    KEY_LEFTSHIFT */
+    /*  51 */    VC_BACK_SLASH,                /* 0x2B    KEY_BACKSLASH */
+    /*  52 */    VC_Z,                         /* 0x2C    KEY_Z */
+    /*  53 */    VC_X,                         /* 0x2D    KEY_X */
+    /*  54 */    VC_C,                         /* 0x2E    KEY_C */
+    /*  55 */    VC_V,                         /* 0x2F    KEY_V */
+    /*  56 */    VC_B,                         /* 0x30    KEY_B */
+    /*  57 */    VC_N,                         /* 0x31    KEY_N */
+    /*  58 */    VC_M,                         /* 0x32    KEY_M */
+    /*  59 */    VC_COMMA,                     /* 0x33    KEY_COMMA */
+    /*  60 */    VC_PERIOD,                    /* 0x34    KEY_DOT */
+    /*  61 */    VC_SLASH,                     /* 0x35    KEY_SLASH */
+    /*  62 */    VC_SHIFT_R,                   /* 0x36    KEY_RIGHTSHIFT */
+    /*  63 */    VC_KP_MULTIPLY,               /* 0x37    KEY_KPASTERISK */
+    /*  64 */    VC_ALT_L,                     /* 0x38    KEY_LEFTALT */
+    /*  65 */    VC_SPACE,                     /* 0x39    KEY_SPACE */
+    /*  66 */    VC_CAPS_LOCK,                 /* 0x3A    KEY_CAPSLOCK */
+    /*  67 */    VC_F1,                        /* 0x3B    KEY_F1 */
+    /*  68 */    VC_F2,                        /* 0x3C    KEY_F2 */
+    /*  69 */    VC_F3,                        /* 0x3D    KEY_F3 */
+    /*  70 */    VC_F4,                        /* 0x3E    KEY_F4 */
+    /*  71 */    VC_F5,                        /* 0x3F    KEY_F5 */
+    /*  72 */    VC_F6,                        /* 0x40    KEY_F6 */
+    /*  73 */    VC_F7,                        /* 0x41    KEY_F7 */
+    /*  74 */    VC_F8,                        /* 0x42    KEY_F8 */
+    /*  75 */    VC_F9,                        /* 0x43    KEY_F9 */
+    /*  76 */    VC_F10,                       /* 0x44    KEY_F10 */
+    /*  77 */    VC_NUM_LOCK,                  /* 0x45    KEY_NUMLOCK */
+    /*  78 */    VC_SCROLL_LOCK,               /* 0x46    KEY_SCROLLLOCK */
+    /*  79 */    VC_KP_7,                      /* 0x47    KEY_KP7 */
+    /*  80 */    VC_KP_8,                      /* 0x48    KEY_KP8 */
+    /*  81 */    VC_KP_9,                      /* 0x49    KEY_KP9 */
+    /*  82 */    VC_KP_SUBTRACT,               /* 0x4A    KEY_KPMINUS */
+    /*  83 */    VC_KP_4,                      /* 0x4B    KEY_KP4 */
+    /*  84 */    VC_KP_5,                      /* 0x4C    KEY_KP5 */
+    /*  85 */    VC_KP_6,                      /* 0x4D    KEY_KP6 */
+    /*  86 */    VC_KP_ADD,                    /* 0x4E    KEY_KPPLUS */
+    /*  87 */    VC_KP_1,                      /* 0x4F    KEY_KP1 */
+    /*  88 */    VC_KP_2,                      /* 0x50    KEY_KP2 */
+    /*  89 */    VC_KP_3,                      /* 0x51    KEY_KP3 */
+    /*  90 */    VC_KP_0,                      /* 0x52    KEY_KP0 */
+    /*  91 */    VC_KP_SEPARATOR,              /* 0x53    KEY_KPDOT */
+    /*  92 */    VC_UNDEFINED,                 /* 0x54 */
+    /*  93 */    VC_UNDEFINED,                 /* 0x55    KEY_ZENKAKUHANKAKU    TODO No virtual code */
+    /*  94 */    VC_UNDEFINED,                 /* 0x56    KEY_102ND    TODO No virtual code */
+    /*  95 */    VC_F11,                       /* 0x57    KEY_F11 */
+    /*  96 */    VC_F12,                       /* 0x58    KEY_F12 */
+    /*  97 */    VC_UNDEFINED,                 /* 0x59    KEY_RO    TODO No virtual code */
+    /*  98 */    VC_KATAKANA,                  /* 0x5A    KEY_KATAKANA */
+    /*  99 */    VC_HIRAGANA,                  /* 0x5B    KEY_HIRAGANA */
+    /* 100 */    VC_KANJI,                     /* 0x5C    KEY_HENKAN */
+    /* 101 */    VC_UNDEFINED,                 /* 0x5D    KEY_KATAKANAHIRAGANA */
+    /* 102 */    VC_UNDEFINED,                 /* 0x5E    KEY_MUHENKAN    TODO No virtual code */
+    /* 103 */    VC_KP_COMMA,                  /* 0x5F    KEY_KPJPCOMMA */
+    /* 104 */    VC_KP_ENTER,                  /* 0x60    KEY_KPENTER */
+    /* 105 */    VC_CONTROL_R,                 /* 0x61    KEY_RIGHTCTRL */
+    /* 106 */    VC_KP_DIVIDE,                 /* 0x62    KEY_KPSLASH */
+    /* 107 */    VC_PRINTSCREEN,               /* 0x63    KEY_SYSRQ */
+    /* 108 */    VC_ALT_R,                     /* 0x64    KEY_RIGHTALT */
+    /* 109 */    VC_UNDEFINED,                 /* 0x65    KEY_LINEFEED */
+    /* 110 */    VC_HOME,                      /* 0x66    KEY_HOME */
+    /* 111 */    VC_UP,                        /* 0x67    KEY_UP */
+    /* 112 */    VC_PAGE_UP,                   /* 0x68    KEY_PAGEUP */
+    /* 113 */    VC_LEFT,                      /* 0x69    KEY_LEFT */
+    /* 114 */    VC_RIGHT,                     /* 0x6A    KEY_RIGHT */
+    /* 115 */    VC_END,                       /* 0x6B    KEY_END */
+    /* 116 */    VC_DOWN,                      /* 0x6C    KEY_DOWN */
+    /* 117 */    VC_PAGE_DOWN,                 /* 0x6D    KEY_PAGEDOWN */
+    /* 118 */    VC_INSERT,                    /* 0x6E    KEY_INSERT */
+    /* 119 */    VC_DELETE,                    /* 0x6F    KEY_DELETE */
+    /* 120 */    VC_UNDEFINED,                 /* 0x70    KEY_MACRO */
+    /* 121 */    VC_VOLUME_MUTE,               /* 0x71    KEY_MUTE */
+    /* 122 */    VC_VOLUME_DOWN,               /* 0x72    KEY_VOLUMEDOWN */
+    /* 123 */    VC_VOLUME_UP,                 /* 0x73    KEY_VOLUMEUP */
+    /* 124 */    VC_POWER,                     /* 0x74    KEY_POWER */
+    /* 125 */    VC_KP_EQUALS,                 /* 0x75    KEY_KPEQUAL */
+    /* 126 */    VC_UNDEFINED,                 /* 0x76    KEY_KPPLUSMINUS    TODO No virtual code */
+    /* 127 */    VC_PAUSE,                     /* 0x77    KEY_PAUSE */
+    /* 128 */    VC_UNDEFINED,                 /* 0x78    KEY_SCALE    TODO No virtual code */
+    /* 129 */    VC_UNDEFINED,                 /* 0x79    KEY_KPCOMMA */
+    /* 130 */    VC_UNDEFINED,                 /* 0x7A    KEY_HANGEUL */
+    /* 131 */    VC_UNDEFINED,                 /* 0x7B    KEY_HANJA */
+    /* 132 */    VC_YEN,                       /* 0x7C    KEY_YEN */
+    /* 133 */    VC_META_L,                    /* 0x7D    KEY_LEFTMETA */
+    /* 134 */    VC_META_R,                    /* 0x7E    KEY_RIGHTMETA */
+    /* 135 */    VC_CONTEXT_MENU,              /* 0x7F    KEY_COMPOSE */
+    /* 136 */    VC_SUN_STOP,                  /* 0x80    KEY_STOP */
+    /* 137 */    VC_SUN_AGAIN,                 /* 0x81    KEY_AGAIN */
+    /* 138 */    VC_SUN_PROPS,                 /* 0x82    KEY_PROPS */
+    /* 139 */    VC_SUN_UNDO,                  /* 0x83    KEY_UNDO */
+    /* 140 */    VC_SUN_FRONT,                 /* 0x84    KEY_FRONT */
+    /* 141 */    VC_SUN_COPY,                  /* 0x85    KEY_COPY */
+    /* 142 */    VC_SUN_OPEN,                  /* 0x86    KEY_OPEN */
+    /* 143 */    VC_SUN_INSERT,                /* 0x87    KEY_PASTE */
+    /* 144 */    VC_SUN_FIND,                  /* 0x88    KEY_FIND */
+    /* 145 */    VC_SUN_CUT,                   /* 0x89    KEY_CUT */
+    /* 146 */    VC_SUN_HELP,                  /* 0x8A    KEY_HELP */
+    /* 147 */    VC_UNDEFINED,                 /* 0x8B    KEY_MENU */
+    /* 148 */    VC_APP_CALCULATOR,            /* 0x8C    KEY_CALC */
+    /* 149 */    VC_UNDEFINED,                 /* 0x8D    KEY_SETUP */
+    /* 150 */    VC_SLEEP,                     /* 0x8E    KEY_SLEEP */
+    /* 151 */    VC_UNDEFINED,                 /* 0x8F    KEY_WAKEUP */
+    /* 152 */    VC_UNDEFINED,                 /* 0x90    KEY_FILE */
+    /* 153 */    VC_UNDEFINED,                 /* 0x91    KEY_SENDFILE */
+    /* 154 */    VC_UNDEFINED,                 /* 0x92    KEY_DELETEFILE */
+    /* 155 */    VC_UNDEFINED,                 /* 0x93    KEY_XFER */
+    /* 156 */    VC_UNDEFINED,                 /* 0x94    KEY_PROG1 */
+    /* 157 */    VC_UNDEFINED,                 /* 0x95    KEY_PROG2 */
+    /* 158 */    VC_UNDEFINED,                 /* 0x96    KEY_WWW */
+    /* 159 */    VC_UNDEFINED,                 /* 0x97    KEY_MSDOS */
+    /* 160 */    VC_UNDEFINED,                 /* 0x98    KEY_COFFEE */
+    /* 161 */    VC_UNDEFINED,                 /* 0x99    KEY_ROTATE_DISPLAY */
+    /* 162 */    VC_UNDEFINED,                 /* 0x9A    KEY_CYCLEWINDOWS */
+    /* 163 */    VC_UNDEFINED,                 /* 0x9B    KEY_MAIL */
+    /* 164 */    VC_UNDEFINED,                 /* 0x9C    KEY_BOOKMARKS */
+    /* 165 */    VC_UNDEFINED,                 /* 0x9D    KEY_COMPUTER */
+    /* 166 */    VC_APP_MAIL,                  /* 0x9E    KEY_BACK */
+    /* 167 */    VC_MEDIA_PLAY,                /* 0x9F    KEY_FORWARD */
+    /* 168 */    VC_UNDEFINED,                 /* 0xA0    KEY_CLOSECD */
+    /* 169 */    VC_UNDEFINED,                 /* 0xA1    KEY_EJECTCD */
+    /* 170 */    VC_UNDEFINED,                 /* 0xA2    KEY_EJECTCLOSECD */
+    /* 171 */    VC_UNDEFINED,                 /* 0xA3    KEY_NEXTSONG */
+    /* 172 */    VC_UNDEFINED,                 /* 0xA4    KEY_PLAYPAUSE */
+    /* 173 */    VC_UNDEFINED,                 /* 0xA5    KEY_PREVIOUSSONG */
+    /* 174 */    VC_UNDEFINED,                 /* 0xA6    KEY_STOPCD */
+    /* 175 */    VC_UNDEFINED,                 /* 0xA7    KEY_RECORD */
+    /* 176 */    VC_UNDEFINED,                 /* 0xA8    KEY_REWIND */
+    /* 177 */    VC_UNDEFINED,                 /* 0xA9    KEY_PHONE */
+    /* 178 */    VC_UNDEFINED,                 /* 0xAA    KEY_ISO */
+    /* 179 */    VC_UNDEFINED,                 /* 0xAB    KEY_CONFIG */
+    /* 180 */    VC_UNDEFINED,                 /* 0xAC    KEY_HOMEPAGE */
+    /* 181 */    VC_UNDEFINED,                 /* 0xAD    KEY_REFRESH */
+    /* 182 */    VC_UNDEFINED,                 /* 0xAE    KEY_EXIT */
+    /* 183 */    VC_UNDEFINED,                 /* 0xAF    KEY_MOVE */
+    /* 184 */    VC_UNDEFINED,                 /* 0xB0    KEY_EDIT */
+    /* 185 */    VC_UNDEFINED,                 /* 0xB1    KEY_SCROLLUP */
+    /* 186 */    VC_BROWSER_HOME,              /* 0xB2    KEY_SCROLLDOWN */
+    /* 187 */    VC_UNDEFINED,                 /* 0xB3    KEY_KPLEFTPAREN */
+    /* 188 */    VC_UNDEFINED,                 /* 0xB4    KEY_KPRIGHTPAREN */
+    /* 189 */    VC_UNDEFINED,                 /* 0xB5    KEY_NEW */
+    /* 190 */    VC_UNDEFINED,                 /* 0xB6    KEY_REDO */
+    /* 191 */    VC_F13,                       /* 0xB7    KEY_F13 */
+    /* 192 */    VC_F14,                       /* 0xB8    KEY_F14 */
+    /* 193 */    VC_F15,                       /* 0xB9    KEY_F15 */
+    /* 194 */    VC_F16,                       /* 0xBA    KEY_F16 */
+    /* 195 */    VC_F17,                       /* 0xBB    KEY_F17 */
+    /* 196 */    VC_F18,                       /* 0xBC    KEY_F18 */
+    /* 197 */    VC_F19,                       /* 0xBD    KEY_F19 */
+    /* 198 */    VC_F20,                       /* 0xBE    KEY_F20 */
+    /* 199 */    VC_F21,                       /* 0xBF    KEY_F21 */
+    /* 200 */    VC_F22,                       /* 0xC0    KEY_F22 */
+    /* 201 */    VC_F23,                       /* 0xC1    KEY_F23 */
+    /* 202 */    VC_F24,                       /* 0xC2    KEY_F24 */
+    /* 203 */    VC_UNDEFINED,                 /* 0xC3 */
+    /* 204 */    VC_UNDEFINED,                 /* 0xC4 */
+    /* 205 */    VC_UNDEFINED,                 /* 0xC5 */
+    /* 206 */    VC_UNDEFINED,                 /* 0xC6 */
+    /* 207 */    VC_UNDEFINED,                 /* 0xC7 */
+    /* 208 */    VC_UNDEFINED,                 /* 0xC8    KEY_PLAYCD */
+    /* 209 */    VC_UNDEFINED,                 /* 0xC9    KEY_PAUSECD */
+    /* 210 */    VC_UNDEFINED,                 /* 0xCA    KEY_PROG3 */
+    /* 211 */    VC_UNDEFINED,                 /* 0xCB    KEY_PROG4 */
+    /* 212 */    VC_UNDEFINED,                 /* 0xCC    KEY_ALL_APPLICATIONS */
+    /* 213 */    VC_UNDEFINED,                 /* 0xCD    KEY_SUSPEND */
+    /* 214 */    VC_UNDEFINED,                 /* 0xCE    KEY_CLOSE */
+    /* 215 */    VC_UNDEFINED,                 /* 0xCF    KEY_PLAY */
+    /* 216 */    VC_UNDEFINED,                 /* 0xD0    KEY_FASTFORWARD */
+    /* 217 */    VC_UNDEFINED,                 /* 0xD1    KEY_BASSBOOST */
+    /* 218 */    VC_UNDEFINED,                 /* 0xD2    KEY_PRINT */
+    /* 219 */    VC_UNDEFINED,                 /* 0xD3    KEY_HP */
+    /* 220 */    VC_UNDEFINED,                 /* 0xD4    KEY_CAMERA */
+    /* 221 */    VC_UNDEFINED,                 /* 0xD5    KEY_SOUND */
+    /* 222 */    VC_UNDEFINED,                 /* 0xD6    KEY_QUESTION */
+    /* 223 */    VC_UNDEFINED,                 /* 0xD7    KEY_EMAIL */
+    /* 224 */    VC_UNDEFINED,                 /* 0xD8    KEY_CHAT */
+    /* 225 */    VC_BROWSER_SEARCH,            /* 0xD9    KEY_SEARCH */
+    /* 226 */    VC_LESSER_GREATER,            /* 0xDA    KEY_CONNECT */
+    /* 227 */    VC_UNDEFINED,                 /* 0xDB    KEY_FINANCE */
+    /* 228 */    VC_UNDEFINED,                 /* 0xDC    KEY_SPORT */
+    /* 229 */    VC_UNDEFINED,                 /* 0xDD    KEY_SHOP */
+    /* 230 */    VC_UNDEFINED,                 /* 0xDE    KEY_ALTERASE */
+    /* 231 */    VC_UNDEFINED,                 /* 0xDF    KEY_CANCEL */
+    /* 232 */    VC_UNDEFINED,                 /* 0xE0    KEY_BRIGHTNESSDOWN */
+    /* 233 */    VC_UNDEFINED,                 /* 0xE1    KEY_BRIGHTNESSUP */
+    /* 234 */    VC_UNDEFINED,                 /* 0xE2    KEY_MEDIA */
+    /* 235 */    VC_UNDEFINED,                 /* 0xE3    KEY_SWITCHVIDEOMODE */
+    /* 236 */    VC_UNDEFINED,                 /* 0xE4    KEY_KBDILLUMTOGGLE */
+    /* 237 */    VC_UNDEFINED,                 /* 0xE5    KEY_KBDILLUMDOWN */
+    /* 238 */    VC_UNDEFINED,                 /* 0xE6    KEY_KBDILLUMUP */
+    /* 239 */    VC_UNDEFINED,                 /* 0xE7    KEY_SEND */
+    /* 240 */    VC_UNDEFINED,                 /* 0xE8    KEY_REPLY */
+    /* 241 */    VC_UNDEFINED,                 /* 0xE9    KEY_FORWARDMAIL */
+    /* 242 */    VC_UNDEFINED,                 /* 0xEA    KEY_SAVE */
+    /* 243 */    VC_UNDEFINED,                 /* 0xEB    KEY_DOCUMENTS */
+    /* 244 */    VC_UNDEFINED,                 /* 0xEC    KEY_BATTERY */
+    /* 245 */    VC_UNDEFINED,                 /* 0xED    KEY_BLUETOOTH */
+    /* 246 */    VC_UNDEFINED,                 /* 0xEE    KEY_WLAN */
+    /* 247 */    VC_UNDEFINED,                 /* 0xEF    KEY_UWB */
+    /* 248 */    VC_UNDEFINED,                 /* 0xF0    KEY_UNKNOWN */
+    /* 249 */    VC_UNDEFINED,                 /* 0xF1    KEY_VIDEO_NEXT */
+    /* 250 */    VC_UNDEFINED,                 /* 0xF2    KEY_VIDEO_PREV */
+    /* 251 */    VC_UNDEFINED,                 /* 0xF3    KEY_BRIGHTNESS_CYCLE */
+    /* 252 */    VC_UNDEFINED,                 /* 0xF4    KEY_BRIGHTNESS_AUTO */
+    /* 253 */    VC_UNDEFINED,                 /* 0xF5    KEY_DISPLAY_OFF */
+    /* 254 */    VC_UNDEFINED,                 /* 0xF6    KEY_WWAN */
+    /* 255 */    VC_UNDEFINED,                 /* 0xF7    KEY_RFKILL */
+};
+
+#endif
@@ -0,0 +1,588 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uiohook.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#include "atomic_helper.h"
+#include "logger.h"
+
+/* A broadcast is a named shared memory segment holding a header followed by a
+ * power of two number of slots.  The publisher is the only writer: it stamps
+ * every event with a sequence number, stores it in the slot selected by the
+ * low bits and then advances head.  Subscribers keep their own position and
+ * copy each event once out of the mapped slots into their own buffer, so
+ * nothing passes through the kernel and the publisher never waits on a slow
+ * subscriber.  A slot carries the sequence
+ * number of the event it holds plus one, zero while it is being written, and
+ * a subscriber validates it before and after copying the event out to detect
+ * that it was lapped.
+ *
+ * Waiting subscribers sleep on a futex word in the header on Linux and on a
+ * named semaphore on Windows.  Other platforms poll.  The publisher releases
+ * the semaphore once for every counted waiter, so a waiter that timed out in
+ * the meantime leaves its count behind.  A wait that wakes without a new
+ * event goes back to sleep, and the last waiter to time out drains the rest.
+ */
+#define BROADCAST_MAGIC             "UIOB"
+#define BROADCAST_VERSION           1
+
+#define BROADCAST_DEFAULT_CAPACITY  4096
+#define BROADCAST_MAX_CAPACITY      (1 << 20)
+
+#define BROADCAST_NAME_SIZE         256
+
+// Interval used by the polling fallback when no wait primitive is available.
+#define BROADCAST_POLL_INTERVAL     1
+
+typedef struct _broadcast_header {
+    char magic[4];
+    uint16_t version;
+    uint16_t event_size;
+    uint32_t capacity;
+    volatile uint32_t waiters;
+    volatile uint32_t futex_word;
+    uint32_t reserved;
+    volatile uint64_t head;
+} broadcast_header;
+
+typedef struct _broadcast_slot {
+    volatile uint64_t sequence;
+    uiohook_event event;
+} broadcast_slot;
+
+// Mapping shared by the publisher and subscriber handles.
+typedef struct _broadcast_mapping {
+    broadcast_header *header;
+    broadcast_slot *slots;
+    size_t size;
+    #ifdef _WIN32
+    HANDLE mapping;
+    HANDLE semaphore;
+    #endif
+} broadcast_mapping;
+
+struct _broadcast_publisher {
+    broadcast_mapping map;
+    #ifndef _WIN32
+    char name[BROADCAST_NAME_SIZE];
+    #endif
+};
+
+struct _broadcast_subscriber {
+    broadcast_mapping map;
+    uint64_t position;
+    uint64_t dropped;
+};
+
+
+static bool format_name(char *buffer, const char *name, const char *suffix) {
+    if (name == NULL || *name == '\0' || strchr(name, '/') != NULL || strchr(name, '\\') != NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Invalid broadcast name!\n",
+                __FUNCTION__, __LINE__);
+        return false;
+    }
+
+    #ifdef _WIN32
+    int length = snprintf(buffer, BROADCAST_NAME_SIZE, "Local\\uiohook-%s%s", name, suffix);
+    #else
+    int length = snprintf(buffer, BROADCAST_NAME_SIZE, "/uiohook-%s%s", name, suffix);
+    #endif
+
+    if (length < 0 || length >= BROADCAST_NAME_SIZE) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Broadcast name '%s' is too long!\n",
+                __FUNCTION__, __LINE__, name);
+        return false;
+    }
+
+    return true;
+}
+
+static uint32_t round_capacity(size_t capacity) {
+    if (capacity == 0) {
+        return BROADCAST_DEFAULT_CAPACITY;
+    } else if (capacity > BROADCAST_MAX_CAPACITY) {
+        return BROADCAST_MAX_CAPACITY;
+    }
+
+    uint32_t rounded = 1;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+
+    return rounded;
+}
+
+static void unmap_broadcast(broadcast_mapping *map) {
+    #ifdef _WIN32
+    if (map->header != NULL) {
+        UnmapViewOfFile(map->header);
+    }
+
+    if (map->mapping != NULL) {
+        CloseHandle(map->mapping);
+    }
+
+    if (map->semaphore != NULL) {
+        CloseHandle(map->semaphore);
+    }
+    #else
+    if (map->header != NULL) {
+        munmap(map->header, map->size);
+    }
+    #endif
+
+    map->header = NULL;
+    map->slots = NULL;
+}
+
+static void wake_subscribers(broadcast_mapping *map) {
+    broadcast_header *header = map->header;
+
+    atomic_add_fetch_32(&header->futex_word, 1);
+
+    // Pairs with the fence in hook_broadcast_wait(), either the subscriber
+    // sees the new head or we see it counted as a waiter.
+    atomic_thread_fence_full();
+    uint32_t waiters = atomic_load_acquire(&header->waiters);
+    if (waiters == 0) {
+        return;
+    }
+
+    #ifdef _WIN32
+    ReleaseSemaphore(map->semaphore, (LONG) waiters, NULL);
+    #elif defined(__linux__)
+    syscall(SYS_futex, &header->futex_word, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    #endif
+}
+
+
+UIOHOOK_API broadcast_publisher * hook_broadcast_open_publisher(const char *name, size_t capacity) {
+    char path[BROADCAST_NAME_SIZE];
+    if (!format_name(path, name, "")) {
+        return NULL;
+    }
+
+    broadcast_publisher *publisher = calloc(1, sizeof(broadcast_publisher));
+    if (publisher == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for broadcast publisher!\n",
+                __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    uint32_t slots = round_capacity(capacity);
+    publisher->map.size = sizeof(broadcast_header) + (size_t) slots * sizeof(broadcast_slot);
+
+    #ifdef _WIN32
+    char wake[BROADCAST_NAME_SIZE];
+    if (!format_name(wake, name, "-wake")) {
+        free(publisher);
+        return NULL;
+    }
+
+    publisher->map.mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+            0, (DWORD) publisher->map.size, path);
+    if (publisher->map.mapping != NULL && GetLastError() == ERROR_ALREADY_EXISTS) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Broadcast '%s' already has a publisher!\n",
+                __FUNCTION__, __LINE__, name);
+
+        CloseHandle(publisher->map.mapping);
+        free(publisher);
+        return NULL;
+    }
+
+    if (publisher->map.mapping != NULL) {
+        publisher->map.header = (broadcast_header *) MapViewOfFile(publisher->map.mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+        publisher->map.semaphore = CreateSemaphoreA(NULL, 0, LONG_MAX, wake);
+    }
+
+    if (publisher->map.header == NULL || publisher->map.semaphore == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create broadcast '%s'! (%#lX)\n",
+                __FUNCTION__, __LINE__, name, (unsigned long) GetLastError());
+
+        unmap_broadcast(&publisher->map);
+        free(publisher);
+        return NULL;
+    }
+    #else
+    // A segment left behind by a publisher that did not exit cleanly is
+    // replaced, subscribers still attached to it keep their old mapping.
+    shm_unlink(path);
+
+    int fd = shm_open(path, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR);
+    if (fd < 0 || ftruncate(fd, (off_t) publisher->map.size) != 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create broadcast '%s'! (%d)\n",
+                __FUNCTION__, __LINE__, name, errno);
+
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(path);
+        }
+        free(publisher);
+        return NULL;
+    }
+
+    void *data = mmap(NULL, publisher->map.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to map broadcast '%s'! (%d)\n",
+                __FUNCTION__, __LINE__, name, errno);
+
+        shm_unlink(path);
+        free(publisher);
+        return NULL;
+    }
+
+    publisher->map.header = (broadcast_header *) data;
+    strcpy(publisher->name, path);
+    #endif
+
+    // The new segment is zero filled, so every slot starts out empty.
+    broadcast_header *header = publisher->map.header;
+    header->version = BROADCAST_VERSION;
+    header->event_size = (uint16_t) sizeof(uiohook_event);
+    header->capacity = slots;
+    atomic_store_release(&header->head, 0);
+
+    // Subscribers check the magic last, it is only written once the rest of
+    // the header is valid.
+    atomic_thread_fence_full();
+    memcpy(header->magic, BROADCAST_MAGIC, sizeof(header->magic));
+
+    publisher->map.slots = (broadcast_slot *) (header + 1);
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Created broadcast '%s' with %u slots.\n",
+            __FUNCTION__, __LINE__, name, slots);
+
+    return publisher;
+}
+
+UIOHOOK_API int hook_broadcast_publish(broadcast_publisher *publisher, uiohook_event * const events, size_t count) {
+    if (publisher == NULL || publisher->map.header == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Invalid broadcast publisher!\n",
+                __FUNCTION__, __LINE__);
+        return UIOHOOK_FAILURE;
+    }
+
+    if (count == 0) {
+        return UIOHOOK_SUCCESS;
+    }
+
+    broadcast_header *header = publisher->map.header;
+    uint64_t mask = header->capacity - 1;
+    uint64_t head = header->head;
+
+    for (size_t i = 0; i < count; i++, head++) {
+        broadcast_slot *slot = &publisher->map.slots[head & mask];
+
+        // Mark the slot as busy before any of the event is overwritten.
+        atomic_store_release(&slot->sequence, 0);
+        atomic_thread_fence_full();
+
+        memcpy(&slot->event, &events[i], sizeof(uiohook_event));
+        atomic_store_release(&slot->sequence, head + 1);
+    }
+
+    atomic_store_release(&header->head, head);
+    wake_subscribers(&publisher->map);
+
+    return UIOHOOK_SUCCESS;
+}
+
+UIOHOOK_API void hook_broadcast_dispatch_proc(uiohook_event * const event, void *user_data) {
+    hook_broadcast_publish((broadcast_publisher *) user_data, event, 1);
+}
+
+UIOHOOK_API void hook_broadcast_batch_dispatch_proc(uiohook_event * const events, size_t count, void *user_data) {
+    hook_broadcast_publish((broadcast_publisher *) user_data, events, count);
+}
+
+UIOHOOK_API void hook_broadcast_close_publisher(broadcast_publisher *publisher) {
+    if (publisher == NULL) {
+        return;
+    }
+
+    #ifndef _WIN32
+    // Attached subscribers keep their mapping, new ones can no longer find it.
+    shm_unlink(publisher->name);
+    #endif
+
+    unmap_broadcast(&publisher->map);
+    free(publisher);
+}
+
+
+UIOHOOK_API broadcast_subscriber * hook_broadcast_open_subscriber(const char *name, bool from_history) {
+    char path[BROADCAST_NAME_SIZE];
+    if (!format_name(path, name, "")) {
+        return NULL;
+    }
+
+    broadcast_subscriber *subscriber = calloc(1, sizeof(broadcast_subscriber));
+    if (subscriber == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for broadcast subscriber!\n",
+                __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    #ifdef _WIN32
+    char wake[BROADCAST_NAME_SIZE];
+    if (!format_name(wake, name, "-wake")) {
+        free(subscriber);
+        return NULL;
+    }
+
+    MEMORY_BASIC_INFORMATION info;
+    subscriber->map.mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, path);
+    if (subscriber->map.mapping != NULL) {
+        subscriber->map.header = (broadcast_header *) MapViewOfFile(subscriber->map.mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+        subscriber->map.semaphore = OpenSemaphoreA(SYNCHRONIZE | SEMAPHORE_MODIFY_STATE, FALSE, wake);
+    }
+
+    if (subscriber->map.header == NULL || subscriber->map.semaphore == NULL
+            || VirtualQuery(subscriber->map.header, &info, sizeof(info)) == 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to open broadcast '%s'! (%#lX)\n",
+                __FUNCTION__, __LINE__, name, (unsigned long) GetLastError());
+
+        unmap_broadcast(&subscriber->map);
+        free(subscriber);
+        return NULL;
+    }
+
+    subscriber->map.size = (size_t) info.RegionSize;
+    #else
+    int fd = shm_open(path, O_RDWR, 0);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(broadcast_header)) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to open broadcast '%s'!\n",
+                __FUNCTION__, __LINE__, name);
+
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(subscriber);
+        return NULL;
+    }
+
+    subscriber->map.size = (size_t) info.st_size;
+    void *data = mmap(NULL, subscriber->map.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to map broadcast '%s'! (%d)\n",
+                __FUNCTION__, __LINE__, name, errno);
+
+        free(subscriber);
+        return NULL;
+    }
+
+    subscriber->map.header = (broadcast_header *) data;
+    #endif
+
+    broadcast_header *header = subscriber->map.header;
+    atomic_thread_fence_full();
+    if (memcmp(header->magic, BROADCAST_MAGIC, sizeof(header->magic)) != 0
+            || header->version != BROADCAST_VERSION
+            || header->event_size != sizeof(uiohook_event)
+            || header->capacity == 0 || (header->capacity & (header->capacity - 1)) != 0
+            || subscriber->map.size < sizeof(broadcast_header) + (size_t) header->capacity * sizeof(broadcast_slot)) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Broadcast '%s' has an incompatible format!\n",
+                __FUNCTION__, __LINE__, name);
+
+        unmap_broadcast(&subscriber->map);
+        free(subscriber);
+        return NULL;
+    }
+
+    subscriber->map.slots = (broadcast_slot *) (header + 1);
+
+    uint64_t head = atomic_load_acquire(&header->head);
+    if (!from_history) {
+        subscriber->position = head;
+    } else if (head > header->capacity) {
+        subscriber->position = head - header->capacity;
+    }
+
+    return subscriber;
+}
+
+UIOHOOK_API size_t hook_broadcast_read(broadcast_subscriber *subscriber, uiohook_event *events, size_t count) {
+    if (subscriber == NULL || subscriber->map.header == NULL) {
+        return 0;
+    }
+
+    broadcast_header *header = subscriber->map.header;
+    uint64_t capacity = header->capacity;
+
+    size_t total = 0;
+    uint64_t head = atomic_load_acquire(&header->head);
+    while (total < count && subscriber->position < head) {
+        // Skip events that have already been overwritten.
+        if (head - subscriber->position > capacity) {
+            subscriber->dropped += head - capacity - subscriber->position;
+            subscriber->position = head - capacity;
+        }
+
+        broadcast_slot *slot = &subscriber->map.slots[subscriber->position & (capacity - 1)];
+        uint64_t expected = subscriber->position + 1;
+
+        uint64_t before = atomic_load_acquire(&slot->sequence);
+        memcpy(&events[total], (const void *) &slot->event, sizeof(uiohook_event));
+        atomic_thread_fence_full();
+        uint64_t after = atomic_load_acquire(&slot->sequence);
+
+        if (before == expected && after == expected) {
+            subscriber->position++;
+            total++;
+        } else {
+            // The publisher lapped us while copying, catch up with its head.
+            head = atomic_load_acquire(&header->head);
+            if (head - subscriber->position <= capacity) {
+                subscriber->dropped++;
+                subscriber->position++;
+            }
+        }
+    }
+
+    return total;
+}
+
+UIOHOOK_API int hook_broadcast_wait(broadcast_subscriber *subscriber, uint32_t timeout) {
+    if (subscriber == NULL || subscriber->map.header == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Invalid broadcast subscriber!\n",
+                __FUNCTION__, __LINE__);
+        return UIOHOOK_FAILURE;
+    }
+
+    broadcast_header *header = subscriber->map.header;
+    if (atomic_load_acquire(&header->head) > subscriber->position) {
+        return UIOHOOK_SUCCESS;
+    } else if (timeout == 0) {
+        return UIOHOOK_FAILURE;
+    }
+
+    #if defined(_WIN32) || defined(__linux__)
+    uint32_t word = atomic_load_acquire(&header->futex_word);
+    atomic_add_fetch_32(&header->waiters, 1);
+    atomic_thread_fence_full();
+
+    #ifdef _WIN32
+    // A count left behind by a waiter that timed out wakes us without a new
+    // event, so it is consumed and the wait goes on for the rest of the timeout.
+    bool is_timed_out = false;
+    ULONGLONG start = GetTickCount64();
+    while (atomic_load_acquire(&header->head) == subscriber->position) {
+        DWORD remaining = INFINITE;
+        if (timeout != UINT32_MAX) {
+            ULONGLONG elapsed = GetTickCount64() - start;
+            if (elapsed >= timeout) {
+                is_timed_out = true;
+                break;
+            }
+
+            remaining = (DWORD) (timeout - elapsed);
+        }
+
+        if (WaitForSingleObject(subscriber->map.semaphore, remaining) != WAIT_OBJECT_0) {
+            is_timed_out = true;
+            break;
+        }
+    }
+    #else
+    if (atomic_load_acquire(&header->head) == subscriber->position) {
+        struct timespec delay = {
+            .tv_sec = timeout / 1000,
+            .tv_nsec = (long) (timeout % 1000) * 1000000L
+        };
+        syscall(SYS_futex, &header->futex_word, FUTEX_WAIT, word, timeout == UINT32_MAX ? NULL : &delay, NULL, 0);
+    }
+    #endif
+
+    #ifdef _WIN32
+    // The last waiter to time out drains the counts left behind so they do
+    // not pile up, unless another waiter has registered meanwhile.
+    if (atomic_add_fetch_32(&header->waiters, (uint32_t) -1) == 0 && is_timed_out) {
+        while (atomic_load_acquire(&header->waiters) == 0
+                && WaitForSingleObject(subscriber->map.semaphore, 0) == WAIT_OBJECT_0) {
+            continue;
+        }
+    }
+    #else
+    atomic_add_fetch_32(&header->waiters, (uint32_t) -1);
+    #endif
+    #else
+    // No cross process wait primitive we can rely on, poll the head instead.
+    struct timespec delay = {
+        .tv_sec = 0,
+        .tv_nsec = BROADCAST_POLL_INTERVAL * 1000000L
+    };
+
+    for (uint32_t waited = 0; waited < timeout; waited += BROADCAST_POLL_INTERVAL) {
+        if (atomic_load_acquire(&header->head) > subscriber->position) {
+            break;
+        }
+
+        nanosleep(&delay, NULL);
+    }
+    #endif
+
+    if (atomic_load_acquire(&header->head) > subscriber->position) {
+        return UIOHOOK_SUCCESS;
+    }
+
+    return UIOHOOK_FAILURE;
+}
+
+UIOHOOK_API uint64_t hook_broadcast_dropped(broadcast_subscriber *subscriber) {
+    if (subscriber == NULL) {
+        return 0;
+    }
+
+    return subscriber->dropped;
+}
+
+UIOHOOK_API void hook_broadcast_close_subscriber(broadcast_subscriber *subscriber) {
+    if (subscriber == NULL) {
+        return;
+    }
+
+    unmap_broadcast(&subscriber->map);
+    free(subscriber);
+}
@@ -0,0 +1,88 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#include <sys/time.h>
+#else
+#include <time.h>
+#endif
+
+#include "event_clock.h"
+
+#ifdef _WIN32
+static uint64_t clock_frequency = 0;
+#elif defined(__APPLE__)
+static mach_timebase_info_data_t clock_timebase;
+#endif
+
+uint64_t get_monotonic_time() {
+    #ifdef _WIN32
+    if (clock_frequency == 0) {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+        clock_frequency = (uint64_t) frequency.QuadPart;
+    }
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    return (uint64_t) (counter.QuadPart / clock_frequency) * NSEC_PER_SEC
+            + (uint64_t) (counter.QuadPart % clock_frequency) * NSEC_PER_SEC / clock_frequency;
+    #elif defined(__APPLE__)
+    if (clock_timebase.denom == 0) {
+        mach_timebase_info(&clock_timebase);
+    }
+
+    return mach_absolute_time() * clock_timebase.numer / clock_timebase.denom;
+    #else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec * NSEC_PER_SEC + (uint64_t) now.tv_nsec;
+    #endif
+}
+
+int64_t get_realtime_offset() {
+    uint64_t monotonic = get_monotonic_time();
+
+    #ifdef _WIN32
+    FILETIME system_time;
+    GetSystemTimeAsFileTime(&system_time);
+
+    // Convert 100-nanoseconds since 1601 to nanoseconds since 1970.
+    uint64_t realtime = ((((uint64_t) system_time.dwHighDateTime << 32) | system_time.dwLowDateTime)
+            - 116444736000000000ULL) * 100;
+    #elif defined(__APPLE__)
+    struct timeval system_time;
+    gettimeofday(&system_time, NULL);
+
+    uint64_t realtime = (uint64_t) system_time.tv_sec * NSEC_PER_SEC + (uint64_t) system_time.tv_usec * NSEC_PER_USEC;
+    #else
+    struct timespec system_time;
+    clock_gettime(CLOCK_REALTIME, &system_time);
+
+    uint64_t realtime = (uint64_t) system_time.tv_sec * NSEC_PER_SEC + (uint64_t) system_time.tv_nsec;
+    #endif
+
+    return (int64_t) (realtime - monotonic);
+}
@@ -0,0 +1,319 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <uiohook.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "atomic_helper.h"
+#include "dispatch_event.h"
+#include "event_clock.h"
+#include "event_ring.h"
+#include "logger.h"
+
+#define EVENT_RING_MASK (UIOHOOK_EVENT_RING_SIZE - 1)
+
+// The ring is claimed with a compare and swap so only one hook_run_async() can
+// own it, events are only routed to it once the owner has reset the indices.
+#define RING_FREE       0
+#define RING_CLAIMED    1
+#define RING_ENABLED    2
+
+// Fail the build if the ring size is not a power of two.
+typedef char event_ring_size_check[(UIOHOOK_EVENT_RING_SIZE & EVENT_RING_MASK) == 0 ? 1 : -1];
+
+// Single producer (the hook thread), single consumer (the consumer thread or
+// the caller of hook_poll_events) ring of events.  The head is only written by
+// the producer and the tail is only written by the consumer.
+static uiohook_event ring_events[UIOHOOK_EVENT_RING_SIZE];
+static volatile size_t ring_head = 0;
+static volatile size_t ring_tail = 0;
+static volatile uint32_t ring_enabled = RING_FREE;
+static volatile uint64_t ring_dropped = 0;
+
+// Drops are reported by the consumer, at most once per interval, so that an
+// overloaded hook thread is not slowed down further by logging.
+#define EVENT_RING_REPORT_INTERVAL NSEC_PER_SEC
+static uint64_t reported_dropped = 0;
+static uint64_t reported_time = 0;
+
+// Consumer thread state.  The producer only touches the mutex when the
+// consumer has announced that it is about to sleep.
+static volatile bool consumer_running = false;
+static volatile bool consumer_waiting = false;
+
+#ifdef _WIN32
+static HANDLE consumer_thread = NULL;
+static CRITICAL_SECTION consumer_mutex;
+static CONDITION_VARIABLE consumer_cond;
+#else
+static pthread_t consumer_thread;
+static pthread_mutex_t consumer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t consumer_cond = PTHREAD_COND_INITIALIZER;
+#endif
+
+
+bool event_ring_is_enabled() {
+    return atomic_load_acquire(&ring_enabled) == RING_ENABLED;
+}
+
+uint64_t event_ring_get_dropped() {
+    return atomic_load_acquire(&ring_dropped);
+}
+
+static inline void consumer_lock() {
+    #ifdef _WIN32
+    EnterCriticalSection(&consumer_mutex);
+    #else
+    pthread_mutex_lock(&consumer_mutex);
+    #endif
+}
+
+static inline void consumer_unlock() {
+    #ifdef _WIN32
+    LeaveCriticalSection(&consumer_mutex);
+    #else
+    pthread_mutex_unlock(&consumer_mutex);
+    #endif
+}
+
+static inline void consumer_signal() {
+    #ifdef _WIN32
+    WakeConditionVariable(&consumer_cond);
+    #else
+    pthread_cond_signal(&consumer_cond);
+    #endif
+}
+
+static inline void consumer_wait() {
+    #ifdef _WIN32
+    SleepConditionVariableCS(&consumer_cond, &consumer_mutex, INFINITE);
+    #else
+    pthread_cond_wait(&consumer_cond, &consumer_mutex);
+    #endif
+}
+
+bool event_ring_push(uiohook_event *const event) {
+    size_t head = ring_head;
+    if (head - atomic_load_acquire(&ring_tail) >= UIOHOOK_EVENT_RING_SIZE) {
+        // Never block the hook thread, the consumer is too slow.
+        atomic_store_release(&ring_dropped, ring_dropped + 1);
+        return false;
+    }
+
+    ring_events[head & EVENT_RING_MASK] = *event;
+    atomic_store_release(&ring_head, head + 1);
+
+    // Pairs with the fence in the consumer so that either it sees the new
+    // head or we see that it is waiting.
+    atomic_thread_fence_full();
+    if (atomic_load_acquire(&consumer_waiting)) {
+        consumer_lock();
+        consumer_signal();
+        consumer_unlock();
+    }
+
+    return true;
+}
+
+// Log the events dropped since the last report.  Only the consumer may call this.
+static void report_dropped() {
+    uint64_t dropped = atomic_load_acquire(&ring_dropped);
+    if (dropped == reported_dropped) {
+        return;
+    }
+
+    uint64_t now = get_monotonic_time();
+    if (reported_time == 0 || now - reported_time >= EVENT_RING_REPORT_INTERVAL) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Event ring was full, dropped %" PRIu64 " events!\n",
+                __FUNCTION__, __LINE__, dropped - reported_dropped);
+
+        reported_dropped = dropped;
+        reported_time = now;
+    }
+}
+
+// Copy up to count events out of the ring.  Only one consumer may call this.
+static size_t event_ring_pop(uiohook_event *events, size_t count) {
+    report_dropped();
+
+    size_t tail = ring_tail;
+    size_t available = atomic_load_acquire(&ring_head) - tail;
+    if (count > available) {
+        count = available;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        events[i] = ring_events[(tail + i) & EVENT_RING_MASK];
+    }
+    atomic_store_release(&ring_tail, tail + count);
+
+    return count;
+}
+
+static inline bool event_ring_is_empty() {
+    return atomic_load_acquire(&ring_head) == ring_tail;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI consumer_thread_proc(LPVOID arg) {
+#else
+static void *consumer_thread_proc(void *arg) {
+#endif
+    uiohook_event events[UIOHOOK_BATCH_SIZE];
+
+    while (true) {
+        size_t count = event_ring_pop(events, sizeof(events) / sizeof(uiohook_event));
+        if (count > 0) {
+            dispatch_callback(events, count);
+        } else {
+            consumer_lock();
+            atomic_store_release(&consumer_waiting, true);
+            atomic_thread_fence_full();
+
+            bool running = atomic_load_acquire(&consumer_running);
+            if (running && event_ring_is_empty()) {
+                consumer_wait();
+            }
+
+            atomic_store_release(&consumer_waiting, false);
+            consumer_unlock();
+
+            if (!running && event_ring_is_empty()) {
+                break;
+            }
+        }
+    }
+
+    #ifdef _WIN32
+    return 0;
+    #else
+    return arg;
+    #endif
+}
+
+static int start_consumer_thread() {
+    int status = UIOHOOK_SUCCESS;
+
+    atomic_store_release(&consumer_running, true);
+
+    #ifdef _WIN32
+    InitializeCriticalSection(&consumer_mutex);
+    InitializeConditionVariable(&consumer_cond);
+
+    consumer_thread = CreateThread(NULL, 0, consumer_thread_proc, NULL, 0, NULL);
+    if (consumer_thread == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: CreateThread failure! (%#lX)\n",
+                __FUNCTION__, __LINE__, (unsigned long) GetLastError());
+
+        DeleteCriticalSection(&consumer_mutex);
+        status = UIOHOOK_ERROR_THREAD_CREATE;
+    }
+    #else
+    if (pthread_create(&consumer_thread, NULL, consumer_thread_proc, NULL) != 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: pthread_create failure!\n",
+                __FUNCTION__, __LINE__);
+
+        status = UIOHOOK_ERROR_THREAD_CREATE;
+    }
+    #endif
+
+    if (status != UIOHOOK_SUCCESS) {
+        atomic_store_release(&consumer_running, false);
+    }
+
+    return status;
+}
+
+static void stop_consumer_thread() {
+    consumer_lock();
+    atomic_store_release(&consumer_running, false);
+    consumer_signal();
+    consumer_unlock();
+
+    // The consumer will drain any remaining events before it exits.
+    #ifdef _WIN32
+    WaitForSingleObject(consumer_thread, INFINITE);
+    CloseHandle(consumer_thread);
+    consumer_thread = NULL;
+
+    DeleteCriticalSection(&consumer_mutex);
+    #else
+    pthread_join(consumer_thread, NULL);
+    #endif
+}
+
+UIOHOOK_API int hook_run_async() {
+    if (!atomic_cas_32(&ring_enabled, RING_FREE, RING_CLAIMED)) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: The event ring is already in use!\n",
+                __FUNCTION__, __LINE__);
+        return UIOHOOK_FAILURE;
+    }
+
+    // Discard anything left over from a previous run that was never polled,
+    // only the thread that claimed the ring may touch the indices.
+    ring_head = 0;
+    ring_tail = 0;
+    atomic_store_release(&ring_dropped, 0);
+    reported_dropped = 0;
+    reported_time = 0;
+
+    // Without a dispatcher the application is expected to hook_poll_events().
+    bool use_consumer = has_dispatch_proc();
+    if (use_consumer) {
+        int status = start_consumer_thread();
+        if (status != UIOHOOK_SUCCESS) {
+            atomic_store_release(&ring_enabled, RING_FREE);
+            return status;
+        }
+    }
+
+    atomic_store_release(&ring_enabled, RING_ENABLED);
+    int status = hook_run();
+    atomic_store_release(&ring_enabled, RING_CLAIMED);
+
+    // Keep the claim until the consumer has drained the ring.
+    if (use_consumer) {
+        stop_consumer_thread();
+    }
+
+    atomic_store_release(&ring_enabled, RING_FREE);
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Hook returned %#X, %" PRIu64 " events dropped.\n",
+            __FUNCTION__, __LINE__, status, (uint64_t) ring_dropped);
+
+    return status;
+}
+
+UIOHOOK_API size_t hook_poll_events(uiohook_event *events, size_t count) {
+    if (atomic_load_acquire(&consumer_running)) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Events are being delivered to the dispatch callback!\n",
+                __FUNCTION__, __LINE__);
+        return 0;
+    }
+
+    return event_ring_pop(events, count);
+}
@@ -0,0 +1,42 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _included_event_ring
+#define _included_event_ring
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <uiohook.h>
+
+// Number of events the ring can hold, must be a power of two.
+#ifndef UIOHOOK_EVENT_RING_SIZE
+#define UIOHOOK_EVENT_RING_SIZE 4096
+#endif
+
+// Returns true while hook_run_async() is routing events through the ring.
+extern bool event_ring_is_enabled();
+
+// Copy an event into the ring.  Only the hook thread may call this function.
+// Returns false and counts the event as dropped if the ring is full.
+extern bool event_ring_push(uiohook_event *const event);
+
+// Returns the number of events dropped because the ring was full.
+extern uint64_t event_ring_get_dropped();
+
+#endif
@@ -0,0 +1,593 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// sendmmsg() is a GNU extension.
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uiohook.h>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "atomic_helper.h"
+#include "dispatch_event.h"
+#include "event_sink.h"
+#include "journal.h"
+#include "logger.h"
+
+/* Every sink owns a single producer, single consumer queue of raw events and
+ * a thread that drains it.  The hook thread only copies the event into the
+ * queue, the sink thread encodes the events and sends them without blocking,
+ * so neither a slow peer nor a missing one can hold up input.  Events that do
+ * not fit in the queue, or whose datagram the socket would not take, are
+ * dropped and counted.
+ *
+ * Each datagram is a complete journal segment: the segment header followed by
+ * records delta encoded from a fresh state.  A lost datagram therefore never
+ * corrupts the ones after it, and the payloads of a capture can be appended
+ * to a file and read back with hook_journal_open_reader().
+ */
+#define SINK_QUEUE_MASK (UIOHOOK_SINK_QUEUE_SIZE - 1)
+
+// Fail the build if the queue size is not a power of two.
+typedef char sink_queue_size_check[(UIOHOOK_SINK_QUEUE_SIZE & SINK_QUEUE_MASK) == 0 ? 1 : -1];
+
+// Payload size of a datagram, small enough to avoid IP fragmentation.
+#define SINK_DATAGRAM_SIZE 1400
+
+// Datagrams handed to the kernel in one call.
+#define SINK_BATCH_SIZE 16
+
+// Longest accepted UDP address string.
+#define SINK_ADDRESS_MAX 256
+
+#ifdef _WIN32
+typedef SOCKET sink_socket;
+#define SINK_INVALID_SOCKET INVALID_SOCKET
+#else
+typedef int sink_socket;
+#define SINK_INVALID_SOCKET -1
+#endif
+
+struct _event_sink {
+    sink_type type;
+    sink_socket socket;
+    struct sockaddr_storage address;
+    socklen_t address_size;
+
+    // The head is only written by the hook thread and the tail is only
+    // written by the sink thread.
+    uiohook_event queue[UIOHOOK_SINK_QUEUE_SIZE];
+    volatile size_t head;
+    volatile size_t tail;
+
+    // Events dropped by the hook thread because the queue was full, and by
+    // the sink thread because the socket did not take them.
+    volatile uint64_t queue_dropped;
+    volatile uint64_t send_dropped;
+
+    // Datagrams encoded by the sink thread for the next send.
+    uint8_t datagrams[SINK_BATCH_SIZE][SINK_DATAGRAM_SIZE];
+    size_t datagram_size[SINK_BATCH_SIZE];
+    size_t datagram_events[SINK_BATCH_SIZE];
+
+    // Sink thread state.  The hook thread only touches the mutex when the
+    // sink thread has announced that it is about to sleep.
+    volatile bool running;
+    volatile bool waiting;
+
+    #ifdef _WIN32
+    HANDLE thread;
+    CRITICAL_SECTION mutex;
+    CONDITION_VARIABLE cond;
+    #else
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    #endif
+};
+
+// The sink table is guarded by the context lock, which the hook thread
+// already holds while it delivers events.
+static event_sink *sinks[UIOHOOK_MAX_SINKS];
+static size_t sink_count = 0;
+
+
+static inline void sink_lock(event_sink *sink) {
+    #ifdef _WIN32
+    EnterCriticalSection(&sink->mutex);
+    #else
+    pthread_mutex_lock(&sink->mutex);
+    #endif
+}
+
+static inline void sink_unlock(event_sink *sink) {
+    #ifdef _WIN32
+    LeaveCriticalSection(&sink->mutex);
+    #else
+    pthread_mutex_unlock(&sink->mutex);
+    #endif
+}
+
+static inline void sink_signal(event_sink *sink) {
+    #ifdef _WIN32
+    WakeConditionVariable(&sink->cond);
+    #else
+    pthread_cond_signal(&sink->cond);
+    #endif
+}
+
+static inline void sink_wait(event_sink *sink) {
+    #ifdef _WIN32
+    SleepConditionVariableCS(&sink->cond, &sink->mutex, INFINITE);
+    #else
+    pthread_cond_wait(&sink->cond, &sink->mutex);
+    #endif
+}
+
+static inline void sink_sleep(unsigned int ms) {
+    #ifdef _WIN32
+    Sleep(ms);
+    #else
+    struct timespec ts = {
+        .tv_sec = ms / 1000,
+        .tv_nsec = (long) (ms % 1000) * 1000000L
+    };
+    nanosleep(&ts, NULL);
+    #endif
+}
+
+static inline bool is_sink_empty(event_sink *sink) {
+    return atomic_load_acquire(&sink->head) == sink->tail;
+}
+
+static inline void close_socket(sink_socket handle) {
+    #ifdef _WIN32
+    closesocket(handle);
+    #else
+    close(handle);
+    #endif
+}
+
+static inline int get_socket_error() {
+    #ifdef _WIN32
+    return WSAGetLastError();
+    #else
+    return errno;
+    #endif
+}
+
+
+bool has_sinks() {
+    return sink_count > 0;
+}
+
+void sink_event(uiohook_event *const event) {
+    for (size_t i = 0; i < UIOHOOK_MAX_SINKS; i++) {
+        event_sink *sink = sinks[i];
+        if (sink == NULL) {
+            continue;
+        }
+
+        size_t head = sink->head;
+        if (head - atomic_load_acquire(&sink->tail) >= UIOHOOK_SINK_QUEUE_SIZE) {
+            // Never block the hook thread, the sink is too slow.
+            atomic_store_release(&sink->queue_dropped, sink->queue_dropped + 1);
+            continue;
+        }
+
+        sink->queue[head & SINK_QUEUE_MASK] = *event;
+        atomic_store_release(&sink->head, head + 1);
+
+        // Pairs with the fence in the sink thread so that either it sees the
+        // new head or we see that it is waiting.
+        atomic_thread_fence_full();
+        if (atomic_load_acquire(&sink->waiting)) {
+            sink_lock(sink);
+            sink_signal(sink);
+            sink_unlock(sink);
+        }
+    }
+}
+
+
+// Hand count encoded datagrams to the socket, anything it does not take is
+// dropped.  Only the sink thread may call this function.
+static void send_datagrams(event_sink *sink, size_t count) {
+    size_t sent = 0;
+    int error = 0;
+
+    #if defined(__linux__)
+    struct mmsghdr messages[SINK_BATCH_SIZE];
+    struct iovec vectors[SINK_BATCH_SIZE];
+    memset(messages, 0, sizeof(messages));
+
+    for (size_t i = 0; i < count; i++) {
+        vectors[i].iov_base = sink->datagrams[i];
+        vectors[i].iov_len = sink->datagram_size[i];
+
+        messages[i].msg_hdr.msg_name = &sink->address;
+        messages[i].msg_hdr.msg_namelen = sink->address_size;
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    while (sent < count) {
+        int status = sendmmsg(sink->socket, &messages[sent], (unsigned int) (count - sent), MSG_DONTWAIT);
+        if (status < 0) {
+            error = errno;
+            if (error == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        sent += (size_t) status;
+    }
+    #else
+    for (; sent < count; sent++) {
+        #ifdef _WIN32
+        int status = sendto(sink->socket, (const char *) sink->datagrams[sent], (int) sink->datagram_size[sent], 0,
+                (const struct sockaddr *) &sink->address, sink->address_size);
+        #else
+        ssize_t status = sendto(sink->socket, sink->datagrams[sent], sink->datagram_size[sent], 0,
+                (const struct sockaddr *) &sink->address, sink->address_size);
+        #endif
+
+        if (status < 0) {
+            error = get_socket_error();
+            break;
+        }
+    }
+    #endif
+
+    if (sent < count) {
+        uint64_t dropped = 0;
+        for (size_t i = sent; i < count; i++) {
+            dropped += sink->datagram_events[i];
+        }
+        atomic_store_release(&sink->send_dropped, sink->send_dropped + dropped);
+
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Sink %#p dropped %" PRIu64 " events. (%d)\n",
+                __FUNCTION__, __LINE__, sink, dropped, error);
+    }
+}
+
+// Encode and send everything queued for the sink.  Only the sink thread may
+// call this function.
+static void flush_sink(event_sink *sink) {
+    size_t tail = sink->tail;
+    size_t head = atomic_load_acquire(&sink->head);
+
+    while (tail != head) {
+        size_t count = 0;
+        while (count < SINK_BATCH_SIZE && tail != head) {
+            uint8_t *datagram = sink->datagrams[count];
+            size_t size = journal_encode_segment(datagram);
+            size_t events = 0;
+
+            journal_state state;
+            journal_reset_state(&state);
+            while (tail != head && size + JOURNAL_RECORD_MAX <= SINK_DATAGRAM_SIZE) {
+                size += journal_encode_event(&state, &sink->queue[tail & SINK_QUEUE_MASK], &datagram[size]);
+                tail++;
+                events++;
+            }
+
+            sink->datagram_size[count] = size;
+            sink->datagram_events[count] = events;
+            count++;
+        }
+
+        // Release the queue before sending, the events are encoded.
+        atomic_store_release(&sink->tail, tail);
+        send_datagrams(sink, count);
+
+        head = atomic_load_acquire(&sink->head);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI sink_thread_proc(LPVOID arg) {
+#else
+static void *sink_thread_proc(void *arg) {
+#endif
+    event_sink *sink = (event_sink *) arg;
+
+    while (true) {
+        flush_sink(sink);
+
+        sink_lock(sink);
+        atomic_store_release(&sink->waiting, true);
+        atomic_thread_fence_full();
+
+        bool running = atomic_load_acquire(&sink->running);
+        if (running && is_sink_empty(sink)) {
+            sink_wait(sink);
+        }
+
+        atomic_store_release(&sink->waiting, false);
+        running = atomic_load_acquire(&sink->running);
+        sink_unlock(sink);
+
+        if (!running) {
+            // Send whatever is left before the sink is released.
+            flush_sink(sink);
+            break;
+        }
+
+        // Let the rest of a burst arrive so it shares the datagrams.
+        sink_sleep(UIOHOOK_SINK_LINGER);
+    }
+
+    #ifdef _WIN32
+    return 0;
+    #else
+    return NULL;
+    #endif
+}
+
+
+// Resolve the sink address and open a non-blocking socket for it.
+static int open_sink_socket(event_sink *sink, const char *address) {
+    if (sink->type == UIOHOOK_SINK_UDP) {
+        char host[SINK_ADDRESS_MAX];
+        size_t length = strlen(address);
+        const char *port = strrchr(address, ':');
+        if (length >= SINK_ADDRESS_MAX || port == NULL) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: Invalid UDP sink address '%s', expected host:port!\n",
+                    __FUNCTION__, __LINE__, address);
+            return UIOHOOK_FAILURE;
+        }
+
+        // IPv6 hosts are written in brackets.
+        const char *start = address;
+        const char *end = port;
+        if (*start == '[' && end > start && *(end - 1) == ']') {
+            start++;
+            end--;
+        }
+
+        memcpy(host, start, (size_t) (end - start));
+        host[end - start] = '\0';
+        port++;
+
+        struct addrinfo hints, *info = NULL;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+
+        int status = getaddrinfo(host, port, &hints, &info);
+        if (status != 0 || info == NULL) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to resolve UDP sink address '%s'! (%d)\n",
+                    __FUNCTION__, __LINE__, address, status);
+            return UIOHOOK_FAILURE;
+        }
+
+        memcpy(&sink->address, info->ai_addr, info->ai_addrlen);
+        sink->address_size = (socklen_t) info->ai_addrlen;
+        sink->socket = socket(info->ai_family, SOCK_DGRAM, IPPROTO_UDP);
+        freeaddrinfo(info);
+    } else if (sink->type == UIOHOOK_SINK_UNIX_DGRAM) {
+        #ifdef _WIN32
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Unix datagram sinks are not supported on this platform!\n",
+                __FUNCTION__, __LINE__);
+        return UIOHOOK_FAILURE;
+        #else
+        struct sockaddr_un *unix_address = (struct sockaddr_un *) &sink->address;
+        if (strlen(address) >= sizeof(unix_address->sun_path)) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: Unix sink path '%s' is too long!\n",
+                    __FUNCTION__, __LINE__, address);
+            return UIOHOOK_FAILURE;
+        }
+
+        unix_address->sun_family = AF_UNIX;
+        strcpy(unix_address->sun_path, address);
+        sink->address_size = (socklen_t) sizeof(struct sockaddr_un);
+        sink->socket = socket(AF_UNIX, SOCK_DGRAM, 0);
+        #endif
+    } else {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Unknown sink type %#X!\n",
+                __FUNCTION__, __LINE__, (unsigned int) sink->type);
+        return UIOHOOK_FAILURE;
+    }
+
+    if (sink->socket == SINK_INVALID_SOCKET) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create sink socket! (%d)\n",
+                __FUNCTION__, __LINE__, get_socket_error());
+        return UIOHOOK_FAILURE;
+    }
+
+    // The peer is not connected, sends go to the address every time so that
+    // a restarted receiver picks the stream back up.
+    #ifdef _WIN32
+    u_long non_blocking = 1;
+    ioctlsocket(sink->socket, FIONBIO, &non_blocking);
+    #else
+    fcntl(sink->socket, F_SETFL, fcntl(sink->socket, F_GETFL) | O_NONBLOCK);
+    fcntl(sink->socket, F_SETFD, FD_CLOEXEC);
+    #endif
+
+    return UIOHOOK_SUCCESS;
+}
+
+static void free_sink(event_sink *sink) {
+    if (sink->socket != SINK_INVALID_SOCKET) {
+        close_socket(sink->socket);
+    }
+
+    #ifdef _WIN32
+    DeleteCriticalSection(&sink->mutex);
+    WSACleanup();
+    #else
+    pthread_mutex_destroy(&sink->mutex);
+    pthread_cond_destroy(&sink->cond);
+    #endif
+
+    free(sink);
+}
+
+UIOHOOK_API event_sink * hook_add_sink(sink_type type, const char *address) {
+    if (address == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Invalid sink address!\n",
+                __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    event_sink *sink = calloc(1, sizeof(event_sink));
+    if (sink == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for event sink!\n",
+                __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    sink->type = type;
+    sink->socket = SINK_INVALID_SOCKET;
+
+    #ifdef _WIN32
+    InitializeCriticalSection(&sink->mutex);
+    InitializeConditionVariable(&sink->cond);
+
+    WSADATA wsa_data;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: WSAStartup failure!\n",
+                __FUNCTION__, __LINE__);
+
+        DeleteCriticalSection(&sink->mutex);
+        free(sink);
+        return NULL;
+    }
+    #else
+    pthread_mutex_init(&sink->mutex, NULL);
+    pthread_cond_init(&sink->cond, NULL);
+    #endif
+
+    if (open_sink_socket(sink, address) != UIOHOOK_SUCCESS) {
+        free_sink(sink);
+        return NULL;
+    }
+
+    atomic_store_release(&sink->running, true);
+
+    #ifdef _WIN32
+    sink->thread = CreateThread(NULL, 0, sink_thread_proc, sink, 0, NULL);
+    if (sink->thread == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: CreateThread failure! (%#lX)\n",
+                __FUNCTION__, __LINE__, (unsigned long) GetLastError());
+    #else
+    if (pthread_create(&sink->thread, NULL, sink_thread_proc, sink) != 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: pthread_create failure!\n",
+                __FUNCTION__, __LINE__);
+    #endif
+
+        free_sink(sink);
+        return NULL;
+    }
+
+    lock_contexts();
+    size_t i = 0;
+    while (i < UIOHOOK_MAX_SINKS && sinks[i] != NULL) {
+        i++;
+    }
+
+    if (i < UIOHOOK_MAX_SINKS) {
+        sinks[i] = sink;
+        sink_count++;
+    }
+    unlock_contexts();
+
+    if (i >= UIOHOOK_MAX_SINKS) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Event sink limit of %u reached!\n",
+                __FUNCTION__, __LINE__, (unsigned int) UIOHOOK_MAX_SINKS);
+
+        hook_remove_sink(sink);
+        return NULL;
+    }
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Added event sink %#p for '%s'.\n",
+            __FUNCTION__, __LINE__, sink, address);
+
+    return sink;
+}
+
+UIOHOOK_API void hook_remove_sink(event_sink *sink) {
+    if (sink == NULL) {
+        return;
+    }
+
+    // The hook thread only reads sinks while holding the lock, so once the
+    // slot is cleared nothing is queued for the sink again.
+    lock_contexts();
+    for (size_t i = 0; i < UIOHOOK_MAX_SINKS; i++) {
+        if (sinks[i] == sink) {
+            sinks[i] = NULL;
+            sink_count--;
+            break;
+        }
+    }
+    unlock_contexts();
+
+    sink_lock(sink);
+    atomic_store_release(&sink->running, false);
+    sink_signal(sink);
+    sink_unlock(sink);
+
+    // The sink thread sends any remaining events before it exits.
+    #ifdef _WIN32
+    WaitForSingleObject(sink->thread, INFINITE);
+    CloseHandle(sink->thread);
+    #else
+    pthread_join(sink->thread, NULL);
+    #endif
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Removed event sink %#p, %" PRIu64 " events dropped.\n",
+            __FUNCTION__, __LINE__, sink, hook_sink_dropped(sink));
+
+    free_sink(sink);
+}
+
+UIOHOOK_API uint64_t hook_sink_dropped(event_sink *sink) {
+    if (sink == NULL) {
+        return 0;
+    }
+
+    return atomic_load_acquire(&sink->queue_dropped) + atomic_load_acquire(&sink->send_dropped);
+}
@@ -0,0 +1,48 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _included_event_sink
+#define _included_event_sink
+
+#include <stdbool.h>
+#include <uiohook.h>
+
+// Maximum number of sinks attached at the same time.
+#ifndef UIOHOOK_MAX_SINKS
+#define UIOHOOK_MAX_SINKS 8
+#endif
+
+// Number of events queued for each sink, must be a power of two.
+#ifndef UIOHOOK_SINK_QUEUE_SIZE
+#define UIOHOOK_SINK_QUEUE_SIZE 1024
+#endif
+
+// Milliseconds a woken sink waits for more events before sending, so that
+// bursts of input leave in as few datagrams as possible.
+#ifndef UIOHOOK_SINK_LINGER
+#define UIOHOOK_SINK_LINGER 5
+#endif
+
+// Returns true if any sink is attached.  The caller must hold the context lock.
+extern bool has_sinks();
+
+// Queue the event for every attached sink without blocking.  Events that do
+// not fit are counted as dropped.  The caller must hold the context lock.
+extern void sink_event(uiohook_event *const event);
+
+#endif
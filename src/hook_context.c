@@ -0,0 +1,244 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <uiohook.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "atomic_helper.h"
+#include "dispatch_event.h"
+#include "event_clock.h"
+#include "hook_context.h"
+#include "hook_stats.h"
+#include "logger.h"
+
+// Contexts sharing the native hook wait here until they are stopped.
+#ifdef _WIN32
+static SRWLOCK run_mutex = SRWLOCK_INIT;
+static CONDITION_VARIABLE run_cond = CONDITION_VARIABLE_INIT;
+#else
+static pthread_mutex_t run_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t run_cond = PTHREAD_COND_INITIALIZER;
+#endif
+
+// Serializes opening each context's posting connection.
+#ifdef _WIN32
+static SRWLOCK post_mutex = SRWLOCK_INIT;
+#else
+static pthread_mutex_t post_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+
+static inline void run_lock() {
+    #ifdef _WIN32
+    AcquireSRWLockExclusive(&run_mutex);
+    #else
+    pthread_mutex_lock(&run_mutex);
+    #endif
+}
+
+static inline void run_unlock() {
+    #ifdef _WIN32
+    ReleaseSRWLockExclusive(&run_mutex);
+    #else
+    pthread_mutex_unlock(&run_mutex);
+    #endif
+}
+
+static inline void run_broadcast() {
+    #ifdef _WIN32
+    WakeAllConditionVariable(&run_cond);
+    #else
+    pthread_cond_broadcast(&run_cond);
+    #endif
+}
+
+static inline void run_wait() {
+    #ifdef _WIN32
+    SleepConditionVariableSRW(&run_cond, &run_mutex, INFINITE, 0);
+    #else
+    pthread_cond_wait(&run_cond, &run_mutex);
+    #endif
+}
+
+// Deliver a hook state change to a context that shares the native hook, the
+// native EVENT_HOOK_ENABLED and EVENT_HOOK_DISABLED only reach the driver.
+static void dispatch_state_event(uiohook_ctx *ctx, event_type type) {
+    uiohook_event event = {
+        .type = type,
+        .capture_time = get_monotonic_time(),
+        .mask = 0x00,
+        .reserved = 0x00
+    };
+    event.time = hook_capture_time_to_event_time(event.capture_time);
+
+    dispatch_context_callback(ctx, &event, 1);
+}
+
+UIOHOOK_API int hook_ctx_run(uiohook_ctx *ctx) {
+    if (ctx == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Invalid hook context!\n",
+                __FUNCTION__, __LINE__);
+        return UIOHOOK_FAILURE;
+    }
+
+    lock_contexts();
+    if (atomic_load_acquire(&ctx->is_running)) {
+        unlock_contexts();
+
+        logger(LOG_LEVEL_WARN, "%s [%u]: Hook context %#p is already running!\n",
+                __FUNCTION__, __LINE__, ctx);
+        return UIOHOOK_FAILURE;
+    }
+
+    // The first context to run installs the native hook, the rest share it.
+    bool is_driver = get_driver_context() == NULL;
+    if (is_driver) {
+        set_driver_context(ctx);
+        set_context_running(ctx, true);
+    } else {
+        // Claim the context, it is not handed events until it is enabled.
+        atomic_store_release(&ctx->is_receiving, false);
+        atomic_store_release(&ctx->is_running, true);
+    }
+    unlock_contexts();
+
+    if (!is_driver) {
+        // The context is not receiving yet, so the hook thread can not deliver
+        // ahead of this while the callback runs without the context lock.
+        dispatch_state_event(ctx, EVENT_HOOK_ENABLED);
+        atomic_store_release(&ctx->is_receiving, true);
+    }
+
+    int status = UIOHOOK_SUCCESS;
+    if (is_driver) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Hook context %#p is running the native hook.\n",
+                __FUNCTION__, __LINE__, ctx);
+
+        stats_begin_startup();
+        status = run_native_hook();
+
+        // Every context sharing the native hook stops with it.
+        lock_contexts();
+        stop_contexts();
+        set_driver_context(NULL);
+        unlock_contexts();
+
+        run_lock();
+        run_broadcast();
+        run_unlock();
+    } else {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Hook context %#p is sharing the native hook.\n",
+                __FUNCTION__, __LINE__, ctx);
+
+        run_lock();
+        while (atomic_load_acquire(&ctx->is_running)) {
+            run_wait();
+        }
+        run_unlock();
+
+        // Nothing is appended to the batch once no delivery holds the stopped
+        // context, so it is flushed here without the context lock.
+        wait_context_idle(ctx);
+        dispatch_context_flush(ctx);
+        dispatch_state_event(ctx, EVENT_HOOK_DISABLED);
+    }
+
+    return status;
+}
+
+UIOHOOK_API int hook_ctx_stop(uiohook_ctx *ctx) {
+    if (ctx == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Invalid hook context!\n",
+                __FUNCTION__, __LINE__);
+        return UIOHOOK_FAILURE;
+    }
+
+    if (get_driver_context() == ctx) {
+        return stop_native_hook();
+    }
+
+    if (!atomic_load_acquire(&ctx->is_running)) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Hook context %#p is not running.\n",
+                __FUNCTION__, __LINE__, ctx);
+        return UIOHOOK_FAILURE;
+    }
+
+    // NOTE This may be called from the context's own dispatcher on the hook
+    // thread, so it must never wait on the context lock.
+    set_context_running(ctx, false);
+
+    run_lock();
+    run_broadcast();
+    run_unlock();
+
+    return UIOHOOK_SUCCESS;
+}
+
+UIOHOOK_API int hook_run() {
+    return hook_ctx_run(get_default_context());
+}
+
+UIOHOOK_API int hook_stop() {
+    return hook_ctx_stop(get_default_context());
+}
+
+UIOHOOK_API int hook_ctx_post_events(uiohook_ctx *ctx, uiohook_event * const events, size_t count) {
+    if (ctx == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Invalid hook context!\n",
+                __FUNCTION__, __LINE__);
+        return UIOHOOK_FAILURE;
+    }
+
+    // The default context keeps posting through the shared helper connection.
+    if (ctx == get_default_context()) {
+        return hook_post_events(events, count);
+    }
+
+    #ifdef _WIN32
+    AcquireSRWLockExclusive(&post_mutex);
+    #else
+    pthread_mutex_lock(&post_mutex);
+    #endif
+    if (ctx->post == NULL) {
+        ctx->post = hook_post_context_create();
+    }
+    post_context *post = ctx->post;
+    #ifdef _WIN32
+    ReleaseSRWLockExclusive(&post_mutex);
+    #else
+    pthread_mutex_unlock(&post_mutex);
+    #endif
+
+    if (post == NULL) {
+        return UIOHOOK_FAILURE;
+    }
+
+    return hook_post_context_events(post, events, count);
+}
+
+UIOHOOK_API int hook_ctx_post_event(uiohook_ctx *ctx, uiohook_event * const event) {
+    return hook_ctx_post_events(ctx, event, 1);
+}
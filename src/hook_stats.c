@@ -0,0 +1,141 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <uiohook.h>
+
+#include "atomic_helper.h"
+#include "event_clock.h"
+#include "hook_stats.h"
+#include "logger.h"
+
+static hook_stats stats;
+
+// hook_reset_stats() bumps the requested generation and the hook thread clears
+// the counters the next time it records, so it remains the only writer.
+static volatile uint32_t reset_generation = 0;
+static volatile uint32_t stats_generation = 0;
+
+// Monotonic time the native hook started, zero once it has been enabled.
+static uint64_t startup_begin = 0;
+
+// Apply a pending reset before the next counter update.
+static inline void sync_stats() {
+    uint32_t generation = atomic_load_acquire(&reset_generation);
+    if (generation != stats_generation) {
+        memset(&stats, 0, sizeof(stats));
+        atomic_store_release(&stats_generation, generation);
+    }
+}
+
+// Histogram bucket for a sample, see hook_stats in uiohook.h.
+static inline unsigned int get_bucket(uint64_t us) {
+    unsigned int bucket = 0;
+    while (us > 0 && bucket < HOOK_STATS_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+
+    return bucket;
+}
+
+void stats_record_event(event_type type) {
+    sync_stats();
+
+    if ((unsigned int) type <= EVENT_MOUSE_WHEEL) {
+        stats.events[type]++;
+    }
+}
+
+void stats_record_consumed() {
+    sync_stats();
+    stats.consumed++;
+}
+
+void stats_record_dispatch_time(uint64_t elapsed_ns) {
+    sync_stats();
+
+    uint64_t us = elapsed_ns / NSEC_PER_USEC;
+    stats.dispatch_time[get_bucket(us)]++;
+    if (us > stats.max_dispatch_time) {
+        stats.max_dispatch_time = us;
+    }
+}
+
+void stats_record_lag(uint64_t lag_us) {
+    sync_stats();
+
+    stats.dispatch_lag[get_bucket(lag_us)]++;
+    if (lag_us > stats.max_dispatch_lag) {
+        stats.max_dispatch_lag = lag_us;
+    }
+}
+
+void stats_record_tap_restart() {
+    sync_stats();
+    stats.tap_restarts++;
+}
+
+void stats_record_hook_restart() {
+    sync_stats();
+    stats.hook_restarts++;
+}
+
+void stats_begin_startup() {
+    startup_begin = get_monotonic_time();
+}
+
+void stats_record_startup() {
+    if (startup_begin == 0) {
+        return;
+    }
+
+    sync_stats();
+    stats.startup_time = (get_monotonic_time() - startup_begin) / NSEC_PER_USEC;
+    startup_begin = 0;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Hook enabled after %llu us.\n",
+            __FUNCTION__, __LINE__, (unsigned long long) stats.startup_time);
+}
+
+UIOHOOK_API void hook_get_stats(hook_stats *out) {
+    if (out == NULL) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Invalid stats pointer!\n",
+                __FUNCTION__, __LINE__);
+        return;
+    }
+
+    // NOTE The counters are copied while the hook thread may be updating them,
+    // each one is current to within a few events.
+    if (atomic_load_acquire(&stats_generation) != atomic_load_acquire(&reset_generation)) {
+        memset(out, 0, sizeof(hook_stats));
+    } else {
+        memcpy(out, (const void *) &stats, sizeof(hook_stats));
+    }
+}
+
+UIOHOOK_API void hook_reset_stats() {
+    atomic_store_release(&reset_generation, atomic_load_acquire(&reset_generation) + 1);
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Hook statistics reset requested.\n",
+            __FUNCTION__, __LINE__);
+}
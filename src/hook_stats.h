@@ -0,0 +1,56 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _included_hook_stats
+#define _included_hook_stats
+
+#include <stddef.h>
+#include <stdint.h>
+#include <uiohook.h>
+
+/* The record functions are only called from the hook thread, which is the
+ * single writer of the counters.  Events delivered through the event ring are
+ * counted but their dispatcher time is not, it is spent on the ring thread. */
+
+// Count an event handed to the dispatch callbacks.
+extern void stats_record_event(event_type type);
+
+// Count an event the dispatcher consumed by setting reserved.
+extern void stats_record_consumed();
+
+// Add a sample to the time spent inside the dispatcher.
+extern void stats_record_dispatch_time(uint64_t elapsed_ns);
+
+// Add a sample to the time between the OS event timestamp and its dispatch.
+extern void stats_record_lag(uint64_t lag_us);
+
+// Count an event tap the OS disabled and the hook had to restart.
+extern void stats_record_tap_restart();
+
+// Count a native hook that was removed and registered again.
+extern void stats_record_hook_restart();
+
+// Mark the native hook as starting, the startup time runs until the next
+// stats_record_startup().
+extern void stats_begin_startup();
+
+// Record the time since stats_begin_startup() once the hook is enabled.
+extern void stats_record_startup();
+
+#endif
@@ -0,0 +1,521 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <uiohook.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "atomic_helper.h"
+#include "dispatch_event.h"
+#include "event_clock.h"
+#include "hotkey.h"
+#include "logger.h"
+
+// Hotkeys are bucketed by the low byte of the first stroke's keycode, so most
+// key presses are passed through after a single table lookup.
+#define HOTKEY_BUCKETS      256
+#define HOTKEY_BUCKET(code) ((code) & (HOTKEY_BUCKETS - 1))
+
+// Number of consumed keys remembered so that their releases are consumed too.
+#define HOTKEY_HELD_KEYS    8
+
+#define HOTKEY_QUEUE_MASK   (UIOHOOK_HOTKEY_QUEUE_SIZE - 1)
+
+// Fail the build if the queue size is not a power of two.
+typedef char hotkey_queue_size_check[(UIOHOOK_HOTKEY_QUEUE_SIZE & HOTKEY_QUEUE_MASK) == 0 ? 1 : -1];
+
+// The modifier groups, each holding the left and right key.
+static const uint16_t modifier_groups[] = {
+    MASK_SHIFT_L | MASK_SHIFT_R,
+    MASK_CTRL_L | MASK_CTRL_R,
+    MASK_META_L | MASK_META_R,
+    MASK_ALT_L | MASK_ALT_R
+};
+
+// A stroke compiled to the masks compared on the hook thread.
+typedef struct _hotkey_match {
+    uint16_t keycode;
+    uint16_t exact_mask;    // Modifiers that must match the event exactly.
+    uint16_t exact_groups;  // Groups compared through exact_mask.
+    uint16_t either_groups; // Groups where either side may be held.
+} hotkey_match;
+
+typedef struct _hotkey_entry {
+    uint32_t id;
+    uint32_t flags;
+    size_t count;
+    hotkey_match strokes[UIOHOOK_HOTKEY_MAX_STROKES];
+
+    // Chord progress, the next stroke to match and when the last one matched.
+    size_t step;
+    uint64_t step_time;     // Capture time of the last matched stroke.
+} hotkey_entry;
+
+typedef struct _hotkey_queue_entry {
+    uint32_t id;
+    uiohook_event event;
+} hotkey_queue_entry;
+
+// The hotkey table is guarded by the context lock, which the hook thread
+// already holds while it matches events.
+static hotkey_entry hotkeys[UIOHOOK_MAX_HOTKEYS];
+static size_t hotkey_count = 0;
+static uint64_t hotkey_buckets[HOTKEY_BUCKETS];
+
+// Hotkeys part way through a chord.
+static uint64_t hotkey_pending = 0;
+
+// Keys whose press was consumed, their repeats and releases are consumed too.
+static uint16_t held_keys[HOTKEY_HELD_KEYS];
+static size_t held_count = 0;
+static bool consume_typed = false;
+
+// Matches waiting for the hotkey callback thread.
+static hotkey_queue_entry queue_entries[UIOHOOK_HOTKEY_QUEUE_SIZE];
+static size_t queue_head = 0;
+static size_t queue_tail = 0;
+
+static hotkey_dispatcher_t hotkey_dispatch = NULL;
+static void *hotkey_dispatch_data = NULL;
+static volatile bool hotkey_running = false;
+
+#ifdef _WIN32
+static HANDLE hotkey_thread = NULL;
+static SRWLOCK queue_mutex = SRWLOCK_INIT;
+static CONDITION_VARIABLE queue_cond = CONDITION_VARIABLE_INIT;
+#else
+static pthread_t hotkey_thread;
+static pthread_mutex_t queue_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+#endif
+
+
+static inline void queue_lock() {
+    #ifdef _WIN32
+    AcquireSRWLockExclusive(&queue_mutex);
+    #else
+    pthread_mutex_lock(&queue_mutex);
+    #endif
+}
+
+static inline void queue_unlock() {
+    #ifdef _WIN32
+    ReleaseSRWLockExclusive(&queue_mutex);
+    #else
+    pthread_mutex_unlock(&queue_mutex);
+    #endif
+}
+
+static inline void queue_signal() {
+    #ifdef _WIN32
+    WakeConditionVariable(&queue_cond);
+    #else
+    pthread_cond_signal(&queue_cond);
+    #endif
+}
+
+static inline void queue_wait() {
+    #ifdef _WIN32
+    SleepConditionVariableSRW(&queue_cond, &queue_mutex, INFINITE, 0);
+    #else
+    pthread_cond_wait(&queue_cond, &queue_mutex);
+    #endif
+}
+
+static void queue_match(uint32_t id, uiohook_event *const event) {
+    if (!atomic_load_acquire(&hotkey_running)) {
+        return;
+    }
+
+    queue_lock();
+    if (queue_head - queue_tail >= UIOHOOK_HOTKEY_QUEUE_SIZE) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Hotkey queue is full, dropping match for hotkey %u!\n",
+                __FUNCTION__, __LINE__, id);
+    } else {
+        hotkey_queue_entry *entry = &queue_entries[queue_head++ & HOTKEY_QUEUE_MASK];
+        entry->id = id;
+        entry->event = *event;
+        queue_signal();
+    }
+    queue_unlock();
+}
+
+#ifdef _WIN32
+static DWORD WINAPI hotkey_thread_proc(LPVOID arg) {
+#else
+static void *hotkey_thread_proc(void *arg) {
+#endif
+    queue_lock();
+    while (true) {
+        if (queue_head != queue_tail) {
+            hotkey_queue_entry entry = queue_entries[queue_tail++ & HOTKEY_QUEUE_MASK];
+
+            // The callback may take as long as it likes without holding up
+            // the hook thread.
+            queue_unlock();
+            logger(LOG_LEVEL_DEBUG, "%s [%u]: Dispatching hotkey %u.\n",
+                    __FUNCTION__, __LINE__, entry.id);
+
+            hotkey_dispatch(entry.id, &entry.event, hotkey_dispatch_data);
+            queue_lock();
+        } else if (atomic_load_acquire(&hotkey_running)) {
+            queue_wait();
+        } else {
+            break;
+        }
+    }
+    queue_unlock();
+
+    #ifdef _WIN32
+    return 0;
+    #else
+    return arg;
+    #endif
+}
+
+static int start_hotkey_thread() {
+    queue_head = 0;
+    queue_tail = 0;
+    atomic_store_release(&hotkey_running, true);
+
+    #ifdef _WIN32
+    hotkey_thread = CreateThread(NULL, 0, hotkey_thread_proc, NULL, 0, NULL);
+    if (hotkey_thread == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: CreateThread failure! (%#lX)\n",
+                __FUNCTION__, __LINE__, (unsigned long) GetLastError());
+
+        atomic_store_release(&hotkey_running, false);
+        return UIOHOOK_ERROR_THREAD_CREATE;
+    }
+    #else
+    if (pthread_create(&hotkey_thread, NULL, hotkey_thread_proc, NULL) != 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: pthread_create failure!\n",
+                __FUNCTION__, __LINE__);
+
+        atomic_store_release(&hotkey_running, false);
+        return UIOHOOK_ERROR_THREAD_CREATE;
+    }
+    #endif
+
+    return UIOHOOK_SUCCESS;
+}
+
+static void stop_hotkey_thread() {
+    queue_lock();
+    atomic_store_release(&hotkey_running, false);
+    queue_signal();
+    queue_unlock();
+
+    // The thread delivers any remaining matches before it exits.
+    #ifdef _WIN32
+    WaitForSingleObject(hotkey_thread, INFINITE);
+    CloseHandle(hotkey_thread);
+    hotkey_thread = NULL;
+    #else
+    pthread_join(hotkey_thread, NULL);
+    #endif
+}
+
+UIOHOOK_API int hook_set_hotkey_proc(hotkey_dispatcher_t dispatch_proc, void *user_data) {
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Setting new hotkey callback to %#p.\n",
+            __FUNCTION__, __LINE__, dispatch_proc);
+
+    if (atomic_load_acquire(&hotkey_running)) {
+        stop_hotkey_thread();
+    }
+
+    hotkey_dispatch = dispatch_proc;
+    hotkey_dispatch_data = user_data;
+
+    if (dispatch_proc == NULL) {
+        return UIOHOOK_SUCCESS;
+    }
+
+    return start_hotkey_thread();
+}
+
+
+static bool is_modifier_key(uint16_t keycode) {
+    switch (keycode) {
+        case VC_SHIFT_L:
+        case VC_SHIFT_R:
+        case VC_CONTROL_L:
+        case VC_CONTROL_R:
+        case VC_META_L:
+        case VC_META_R:
+        case VC_ALT_L:
+        case VC_ALT_R:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+static void compile_stroke(hotkey_match *match, hotkey_stroke * const stroke) {
+    match->keycode = stroke->keycode;
+    match->exact_mask = 0;
+    match->exact_groups = 0;
+    match->either_groups = 0;
+
+    // Naming both sides of a group, MASK_CTRL for example, accepts either
+    // side.  A group that is not named must not be held.
+    for (size_t i = 0; i < sizeof(modifier_groups) / sizeof(modifier_groups[0]); i++) {
+        uint16_t group = modifier_groups[i];
+        if ((stroke->mask & group) == group) {
+            match->either_groups |= group;
+        } else {
+            match->exact_groups |= group;
+            match->exact_mask |= stroke->mask & group;
+        }
+    }
+}
+
+static inline bool is_stroke_match(hotkey_match *match, uiohook_event *const event) {
+    if (match->keycode != event->data.keyboard.keycode
+            || ((event->mask ^ match->exact_mask) & match->exact_groups) != 0) {
+        return false;
+    }
+
+    for (size_t i = 0; i < sizeof(modifier_groups) / sizeof(modifier_groups[0]); i++) {
+        uint16_t group = modifier_groups[i];
+        if ((match->either_groups & group) && !(event->mask & group)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Rebuild the bucket lookup from the hotkey table.
+static void compile_hotkeys() {
+    memset(hotkey_buckets, 0, sizeof(hotkey_buckets));
+    for (size_t i = 0; i < hotkey_count; i++) {
+        hotkey_buckets[HOTKEY_BUCKET(hotkeys[i].strokes[0].keycode)] |= (uint64_t) 1 << i;
+        hotkeys[i].step = 0;
+    }
+
+    hotkey_pending = 0;
+}
+
+UIOHOOK_API int hook_register_hotkey(uint32_t id, hotkey_stroke * const strokes, size_t count, uint32_t flags) {
+    if (strokes == NULL || count == 0 || count > UIOHOOK_HOTKEY_MAX_STROKES) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Hotkeys need between 1 and %u strokes!\n",
+                __FUNCTION__, __LINE__, UIOHOOK_HOTKEY_MAX_STROKES);
+        return UIOHOOK_FAILURE;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (strokes[i].keycode == VC_UNDEFINED || is_modifier_key(strokes[i].keycode)) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: Hotkey %u stroke %u has an invalid keycode %#X!\n",
+                    __FUNCTION__, __LINE__, id, (unsigned int) i, strokes[i].keycode);
+            return UIOHOOK_FAILURE;
+        }
+    }
+
+    int status = UIOHOOK_SUCCESS;
+
+    lock_contexts();
+    size_t index = 0;
+    while (index < hotkey_count && hotkeys[index].id != id) {
+        index++;
+    }
+
+    if (index >= UIOHOOK_MAX_HOTKEYS) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Only %u hotkeys can be registered!\n",
+                __FUNCTION__, __LINE__, UIOHOOK_MAX_HOTKEYS);
+        status = UIOHOOK_FAILURE;
+    } else {
+        // Registering an existing id replaces its strokes.
+        hotkey_entry *entry = &hotkeys[index];
+        entry->id = id;
+        entry->flags = flags;
+        entry->count = count;
+        for (size_t i = 0; i < count; i++) {
+            compile_stroke(&entry->strokes[i], &strokes[i]);
+        }
+
+        if (index == hotkey_count) {
+            hotkey_count++;
+        }
+
+        compile_hotkeys();
+    }
+    unlock_contexts();
+
+    return status;
+}
+
+UIOHOOK_API int hook_unregister_hotkey(uint32_t id) {
+    int status = UIOHOOK_FAILURE;
+
+    lock_contexts();
+    for (size_t i = 0; i < hotkey_count; i++) {
+        if (hotkeys[i].id == id) {
+            memmove(&hotkeys[i], &hotkeys[i + 1], sizeof(hotkey_entry) * (hotkey_count - i - 1));
+            hotkey_count--;
+
+            compile_hotkeys();
+            status = UIOHOOK_SUCCESS;
+            break;
+        }
+    }
+    unlock_contexts();
+
+    return status;
+}
+
+UIOHOOK_API void hook_clear_hotkeys() {
+    lock_contexts();
+    hotkey_count = 0;
+    compile_hotkeys();
+    unlock_contexts();
+}
+
+bool has_hotkeys() {
+    return hotkey_count > 0;
+}
+
+
+static bool remove_held_key(uint16_t keycode) {
+    for (size_t i = 0; i < held_count; i++) {
+        if (held_keys[i] == keycode) {
+            held_keys[i] = held_keys[--held_count];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void add_held_key(uint16_t keycode) {
+    remove_held_key(keycode);
+
+    // Forget the oldest key if too many are held, its release will pass.
+    if (held_count >= HOTKEY_HELD_KEYS) {
+        memmove(&held_keys[0], &held_keys[1], sizeof(uint16_t) * (HOTKEY_HELD_KEYS - 1));
+        held_count--;
+    }
+
+    held_keys[held_count++] = keycode;
+}
+
+// The monotonic capture time of the event.  event->time is not in
+// milliseconds on every platform, so chords are not timed on it.
+static inline uint64_t get_capture_time(uiohook_event *const event) {
+    return event->capture_time != 0 ? event->capture_time : get_monotonic_time();
+}
+
+// Advance the hotkey by one stroke, returns true if it consumes the event.
+static bool advance_hotkey(size_t index, uiohook_event *const event, uint64_t capture_time) {
+    hotkey_entry *entry = &hotkeys[index];
+
+    if (++entry->step >= entry->count) {
+        entry->step = 0;
+        hotkey_pending &= ~((uint64_t) 1 << index);
+
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Matched hotkey %u.\n",
+                __FUNCTION__, __LINE__, entry->id);
+
+        queue_match(entry->id, event);
+    } else {
+        entry->step_time = capture_time;
+        hotkey_pending |= (uint64_t) 1 << index;
+    }
+
+    return (entry->flags & HOTKEY_CONSUME) != 0;
+}
+
+bool match_hotkeys(uiohook_event *const event) {
+    switch (event->type) {
+        case EVENT_KEY_TYPED:
+            // Characters typed by a consumed press belong to the hotkey.
+            return consume_typed;
+
+        case EVENT_KEY_RELEASED:
+            consume_typed = false;
+            return remove_held_key(event->data.keyboard.keycode);
+
+        case EVENT_KEY_PRESSED:
+            break;
+
+        default:
+            return false;
+    }
+
+    uint16_t keycode = event->data.keyboard.keycode;
+    if (is_modifier_key(keycode)) {
+        // Modifiers are part of the strokes, holding one does not break a chord.
+        consume_typed = false;
+        return false;
+    }
+
+    bool consume = false;
+    bool advanced = false;
+    uint64_t capture_time = get_capture_time(event);
+
+    // A chord in progress takes priority over starting a new hotkey.
+    uint64_t pending = hotkey_pending;
+    while (pending != 0) {
+        size_t index = 0;
+        while (!(pending & ((uint64_t) 1 << index))) {
+            index++;
+        }
+        pending &= ~((uint64_t) 1 << index);
+
+        hotkey_entry *entry = &hotkeys[index];
+        if (capture_time - entry->step_time <= UIOHOOK_HOTKEY_CHORD_TIMEOUT
+                && is_stroke_match(&entry->strokes[entry->step], event)) {
+            consume |= advance_hotkey(index, event, capture_time);
+            advanced = true;
+        } else {
+            entry->step = 0;
+            hotkey_pending &= ~((uint64_t) 1 << index);
+        }
+    }
+
+    if (!advanced) {
+        uint64_t candidates = hotkey_buckets[HOTKEY_BUCKET(keycode)];
+        for (size_t index = 0; candidates != 0; index++, candidates >>= 1) {
+            if ((candidates & 1) && is_stroke_match(&hotkeys[index].strokes[0], event)) {
+                consume |= advance_hotkey(index, event, capture_time);
+            }
+        }
+    }
+
+    // Auto repeat of a consumed key stays consumed even if the modifiers changed.
+    if (consume) {
+        add_held_key(keycode);
+    } else {
+        for (size_t i = 0; i < held_count && !consume; i++) {
+            consume = held_keys[i] == keycode;
+        }
+    }
+
+    consume_typed = consume;
+
+    return consume;
+}
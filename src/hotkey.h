@@ -0,0 +1,52 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _included_hotkey
+#define _included_hotkey
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <uiohook.h>
+
+// Maximum number of registered hotkeys, one bit each in the lookup table.
+#define UIOHOOK_MAX_HOTKEYS 64
+
+// Maximum number of strokes in a chord.
+#ifndef UIOHOOK_HOTKEY_MAX_STROKES
+#define UIOHOOK_HOTKEY_MAX_STROKES 4
+#endif
+
+// Nanoseconds of capture time allowed between the strokes of a chord.
+#ifndef UIOHOOK_HOTKEY_CHORD_TIMEOUT
+#define UIOHOOK_HOTKEY_CHORD_TIMEOUT (1500 * 1000000ULL)
+#endif
+
+// Number of matches queued for the hotkey callback.
+#ifndef UIOHOOK_HOTKEY_QUEUE_SIZE
+#define UIOHOOK_HOTKEY_QUEUE_SIZE 64
+#endif
+
+// Returns true if any hotkey is registered.  The caller must hold the context lock.
+extern bool has_hotkeys();
+
+// Match a keyboard event against the registered hotkeys and queue any match
+// for the hotkey callback.  Returns true if the event should be consumed.  The
+// caller must hold the context lock.
+extern bool match_hotkeys(uiohook_event *const event);
+
+#endif
@@ -0,0 +1,907 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <dispatch/dispatch.h>
+#include <IOKit/hid/IOHIDManager.h>
+#include <IOKit/hid/IOHIDUsageTables.h>
+#include <limits.h>
+#include <mach/mach_time.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <uiohook.h>
+
+#include "dispatch_event.h"
+#include "event_clock.h"
+#include "hook_context.h"
+#include "hook_stats.h"
+#include "input_helper.h"
+#include "key_state.h"
+#include "logger.h"
+#include "property_cache.h"
+
+#ifdef USE_EPOCH_TIME
+#define TIMER_RESOLUTION_MS 1
+#else
+#define TIMER_RESOLUTION_MS 1000000
+#endif
+
+// Maximum number of characters typed by a single key press.
+#define KEY_BUFFER_SIZE 4
+
+// HID keyboard usages past the right GUI key are reserved.
+#define HID_KEYBOARD_USAGE_MAX 0xE8
+
+typedef struct _hook_info {
+    IOHIDManagerRef manager;
+    CFRunLoopObserverRef observer;
+    struct _input {
+        uint16_t mask;
+        struct _pointer {
+            // HID pointers only report deltas, so the cursor location is read
+            // once for every runloop pass that moved the pointer.
+            bool is_moved;
+            uint64_t time;
+            uint64_t capture_time;
+        } pointer;
+        struct _mouse {
+            bool is_dragged;
+            struct _click {
+                unsigned short int count;
+                uint64_t time;
+                unsigned short int button;
+            } click;
+        } mouse;
+    } input;
+} hook_info;
+static hook_info *hook;
+
+// The runloop of the thread blocked in hook_run().
+static CFRunLoopRef event_loop = NULL;
+
+// Converts HID timestamps to nanoseconds.
+static mach_timebase_info_data_t event_timebase;
+
+// HID keyboard usage to virtual keycode lookup, built when the hook starts.
+static uint8_t hid_keycode_map[HID_KEYBOARD_USAGE_MAX];
+
+static const struct {
+    uint8_t usage;
+    uint8_t keycode;
+} hid_keycode_table[] = {
+    { kHIDUsage_KeyboardA,                  kVK_ANSI_A              },
+    { kHIDUsage_KeyboardB,                  kVK_ANSI_B              },
+    { kHIDUsage_KeyboardC,                  kVK_ANSI_C              },
+    { kHIDUsage_KeyboardD,                  kVK_ANSI_D              },
+    { kHIDUsage_KeyboardE,                  kVK_ANSI_E              },
+    { kHIDUsage_KeyboardF,                  kVK_ANSI_F              },
+    { kHIDUsage_KeyboardG,                  kVK_ANSI_G              },
+    { kHIDUsage_KeyboardH,                  kVK_ANSI_H              },
+    { kHIDUsage_KeyboardI,                  kVK_ANSI_I              },
+    { kHIDUsage_KeyboardJ,                  kVK_ANSI_J              },
+    { kHIDUsage_KeyboardK,                  kVK_ANSI_K              },
+    { kHIDUsage_KeyboardL,                  kVK_ANSI_L              },
+    { kHIDUsage_KeyboardM,                  kVK_ANSI_M              },
+    { kHIDUsage_KeyboardN,                  kVK_ANSI_N              },
+    { kHIDUsage_KeyboardO,                  kVK_ANSI_O              },
+    { kHIDUsage_KeyboardP,                  kVK_ANSI_P              },
+    { kHIDUsage_KeyboardQ,                  kVK_ANSI_Q              },
+    { kHIDUsage_KeyboardR,                  kVK_ANSI_R              },
+    { kHIDUsage_KeyboardS,                  kVK_ANSI_S              },
+    { kHIDUsage_KeyboardT,                  kVK_ANSI_T              },
+    { kHIDUsage_KeyboardU,                  kVK_ANSI_U              },
+    { kHIDUsage_KeyboardV,                  kVK_ANSI_V              },
+    { kHIDUsage_KeyboardW,                  kVK_ANSI_W              },
+    { kHIDUsage_KeyboardX,                  kVK_ANSI_X              },
+    { kHIDUsage_KeyboardY,                  kVK_ANSI_Y              },
+    { kHIDUsage_KeyboardZ,                  kVK_ANSI_Z              },
+    { kHIDUsage_Keyboard1,                  kVK_ANSI_1              },
+    { kHIDUsage_Keyboard2,                  kVK_ANSI_2              },
+    { kHIDUsage_Keyboard3,                  kVK_ANSI_3              },
+    { kHIDUsage_Keyboard4,                  kVK_ANSI_4              },
+    { kHIDUsage_Keyboard5,                  kVK_ANSI_5              },
+    { kHIDUsage_Keyboard6,                  kVK_ANSI_6              },
+    { kHIDUsage_Keyboard7,                  kVK_ANSI_7              },
+    { kHIDUsage_Keyboard8,                  kVK_ANSI_8              },
+    { kHIDUsage_Keyboard9,                  kVK_ANSI_9              },
+    { kHIDUsage_Keyboard0,                  kVK_ANSI_0              },
+    { kHIDUsage_KeyboardReturnOrEnter,      kVK_Return              },
+    { kHIDUsage_KeyboardEscape,             kVK_Escape              },
+    { kHIDUsage_KeyboardDeleteOrBackspace,  kVK_Delete              },
+    { kHIDUsage_KeyboardTab,                kVK_Tab                 },
+    { kHIDUsage_KeyboardSpacebar,           kVK_Space               },
+    { kHIDUsage_KeyboardHyphen,             kVK_ANSI_Minus          },
+    { kHIDUsage_KeyboardEqualSign,          kVK_ANSI_Equal          },
+    { kHIDUsage_KeyboardOpenBracket,        kVK_ANSI_LeftBracket    },
+    { kHIDUsage_KeyboardCloseBracket,       kVK_ANSI_RightBracket   },
+    { kHIDUsage_KeyboardBackslash,          kVK_ANSI_Backslash      },
+    { kHIDUsage_KeyboardNonUSPound,         kVK_ANSI_Backslash      },
+    { kHIDUsage_KeyboardSemicolon,          kVK_ANSI_Semicolon      },
+    { kHIDUsage_KeyboardQuote,              kVK_ANSI_Quote          },
+    { kHIDUsage_KeyboardGraveAccentAndTilde, kVK_ANSI_Grave         },
+    { kHIDUsage_KeyboardComma,              kVK_ANSI_Comma          },
+    { kHIDUsage_KeyboardPeriod,             kVK_ANSI_Period         },
+    { kHIDUsage_KeyboardSlash,              kVK_ANSI_Slash          },
+    { kHIDUsage_KeyboardCapsLock,           kVK_CapsLock            },
+    { kHIDUsage_KeyboardF1,                 kVK_F1                  },
+    { kHIDUsage_KeyboardF2,                 kVK_F2                  },
+    { kHIDUsage_KeyboardF3,                 kVK_F3                  },
+    { kHIDUsage_KeyboardF4,                 kVK_F4                  },
+    { kHIDUsage_KeyboardF5,                 kVK_F5                  },
+    { kHIDUsage_KeyboardF6,                 kVK_F6                  },
+    { kHIDUsage_KeyboardF7,                 kVK_F7                  },
+    { kHIDUsage_KeyboardF8,                 kVK_F8                  },
+    { kHIDUsage_KeyboardF9,                 kVK_F9                  },
+    { kHIDUsage_KeyboardF10,                kVK_F10                 },
+    { kHIDUsage_KeyboardF11,                kVK_F11                 },
+    { kHIDUsage_KeyboardF12,                kVK_F12                 },
+    { kHIDUsage_KeyboardPrintScreen,        kVK_F13                 },
+    { kHIDUsage_KeyboardScrollLock,         kVK_F14                 },
+    { kHIDUsage_KeyboardPause,              kVK_F15                 },
+    { kHIDUsage_KeyboardInsert,             kVK_Help                },
+    { kHIDUsage_KeyboardHome,               kVK_Home                },
+    { kHIDUsage_KeyboardPageUp,             kVK_PageUp              },
+    { kHIDUsage_KeyboardDeleteForward,      kVK_ForwardDelete       },
+    { kHIDUsage_KeyboardEnd,                kVK_End                 },
+    { kHIDUsage_KeyboardPageDown,           kVK_PageDown            },
+    { kHIDUsage_KeyboardRightArrow,         kVK_RightArrow          },
+    { kHIDUsage_KeyboardLeftArrow,          kVK_LeftArrow           },
+    { kHIDUsage_KeyboardDownArrow,          kVK_DownArrow           },
+    { kHIDUsage_KeyboardUpArrow,            kVK_UpArrow             },
+    { kHIDUsage_KeypadNumLock,              kVK_ANSI_KeypadClear    },
+    { kHIDUsage_KeypadSlash,                kVK_ANSI_KeypadDivide   },
+    { kHIDUsage_KeypadAsterisk,             kVK_ANSI_KeypadMultiply },
+    { kHIDUsage_KeypadHyphen,               kVK_ANSI_KeypadMinus    },
+    { kHIDUsage_KeypadPlus,                 kVK_ANSI_KeypadPlus     },
+    { kHIDUsage_KeypadEnter,                kVK_ANSI_KeypadEnter    },
+    { kHIDUsage_Keypad1,                    kVK_ANSI_Keypad1        },
+    { kHIDUsage_Keypad2,                    kVK_ANSI_Keypad2        },
+    { kHIDUsage_Keypad3,                    kVK_ANSI_Keypad3        },
+    { kHIDUsage_Keypad4,                    kVK_ANSI_Keypad4        },
+    { kHIDUsage_Keypad5,                    kVK_ANSI_Keypad5        },
+    { kHIDUsage_Keypad6,                    kVK_ANSI_Keypad6        },
+    { kHIDUsage_Keypad7,                    kVK_ANSI_Keypad7        },
+    { kHIDUsage_Keypad8,                    kVK_ANSI_Keypad8        },
+    { kHIDUsage_Keypad9,                    kVK_ANSI_Keypad9        },
+    { kHIDUsage_Keypad0,                    kVK_ANSI_Keypad0        },
+    { kHIDUsage_KeypadPeriod,               kVK_ANSI_KeypadDecimal  },
+    { kHIDUsage_KeyboardNonUSBackslash,     kVK_ISO_Section         },
+    { kHIDUsage_KeyboardApplication,        kVK_ContextMenu         },
+    { kHIDUsage_KeypadEqualSign,            kVK_ANSI_KeypadEquals   },
+    { kHIDUsage_KeyboardF13,                kVK_F13                 },
+    { kHIDUsage_KeyboardF14,                kVK_F14                 },
+    { kHIDUsage_KeyboardF15,                kVK_F15                 },
+    { kHIDUsage_KeyboardF16,                kVK_F16                 },
+    { kHIDUsage_KeyboardF17,                kVK_F17                 },
+    { kHIDUsage_KeyboardF18,                kVK_F18                 },
+    { kHIDUsage_KeyboardF19,                kVK_F19                 },
+    { kHIDUsage_KeyboardF20,                kVK_F20                 },
+    { kHIDUsage_KeyboardMute,               kVK_Mute                },
+    { kHIDUsage_KeyboardVolumeUp,           kVK_VolumeUp            },
+    { kHIDUsage_KeyboardVolumeDown,         kVK_VolumeDown          },
+    { kHIDUsage_KeypadComma,                kVK_JIS_KeypadComma     },
+    { kHIDUsage_KeyboardInternational1,     kVK_JIS_Underscore      },
+    { kHIDUsage_KeyboardInternational3,     kVK_JIS_Yen             },
+    { kHIDUsage_KeyboardLANG1,              kVK_JIS_Kana            },
+    { kHIDUsage_KeyboardLANG2,              kVK_JIS_Eisu            },
+    { kHIDUsage_KeyboardLeftControl,        kVK_Control             },
+    { kHIDUsage_KeyboardLeftShift,          kVK_Shift               },
+    { kHIDUsage_KeyboardLeftAlt,            kVK_Option              },
+    { kHIDUsage_KeyboardLeftGUI,            kVK_Command             },
+    { kHIDUsage_KeyboardRightControl,       kVK_RightControl        },
+    { kHIDUsage_KeyboardRightShift,         kVK_RightShift          },
+    { kHIDUsage_KeyboardRightAlt,           kVK_RightOption         },
+    { kHIDUsage_KeyboardRightGUI,           kVK_RightCommand        }
+};
+
+// Virtual event pointer.
+static uiohook_event event;
+
+// Set the native modifier mask for future events.
+static inline void set_modifier_mask(uint16_t mask) {
+    hook->input.mask |= mask;
+}
+
+// Unset the native modifier mask for future events.
+static inline void unset_modifier_mask(uint16_t mask) {
+    hook->input.mask &= ~mask;
+}
+
+// Get the current native modifier mask state.
+static inline uint16_t get_modifiers() {
+    return hook->input.mask;
+}
+
+// Initialize the modifier mask to the current modifiers.
+static void initialize_modifiers() {
+    hook->input.mask = 0x0000;
+
+    if (CGEventSourceKeyState(kCGEventSourceStateHIDSystemState, kVK_Shift))        { set_modifier_mask(MASK_SHIFT_L); }
+    if (CGEventSourceKeyState(kCGEventSourceStateHIDSystemState, kVK_RightShift))   { set_modifier_mask(MASK_SHIFT_R); }
+    if (CGEventSourceKeyState(kCGEventSourceStateHIDSystemState, kVK_Control))      { set_modifier_mask(MASK_CTRL_L);  }
+    if (CGEventSourceKeyState(kCGEventSourceStateHIDSystemState, kVK_RightControl)) { set_modifier_mask(MASK_CTRL_R);  }
+    if (CGEventSourceKeyState(kCGEventSourceStateHIDSystemState, kVK_Option))       { set_modifier_mask(MASK_ALT_L);   }
+    if (CGEventSourceKeyState(kCGEventSourceStateHIDSystemState, kVK_RightOption))  { set_modifier_mask(MASK_ALT_R);   }
+    if (CGEventSourceKeyState(kCGEventSourceStateHIDSystemState, kVK_Command))      { set_modifier_mask(MASK_META_L);  }
+    if (CGEventSourceKeyState(kCGEventSourceStateHIDSystemState, kVK_RightCommand)) { set_modifier_mask(MASK_META_R);  }
+
+    if (CGEventSourceButtonState(kCGEventSourceStateHIDSystemState, kVK_LBUTTON))   { set_modifier_mask(MASK_BUTTON1); }
+    if (CGEventSourceButtonState(kCGEventSourceStateHIDSystemState, kVK_RBUTTON))   { set_modifier_mask(MASK_BUTTON2); }
+    if (CGEventSourceButtonState(kCGEventSourceStateHIDSystemState, kVK_MBUTTON))   { set_modifier_mask(MASK_BUTTON3); }
+    if (CGEventSourceButtonState(kCGEventSourceStateHIDSystemState, kVK_XBUTTON1))  { set_modifier_mask(MASK_BUTTON4); }
+    if (CGEventSourceButtonState(kCGEventSourceStateHIDSystemState, kVK_XBUTTON2))  { set_modifier_mask(MASK_BUTTON5); }
+
+    if (CGEventSourceFlagsState(kCGEventSourceStateHIDSystemState) & kCGEventFlagMaskAlphaShift) {
+        set_modifier_mask(MASK_CAPS_LOCK);
+    }
+
+    reset_key_state(get_modifiers());
+}
+
+// Build the CGEvent flags that match our modifier mask.
+static CGEventFlags get_event_flags() {
+    CGEventFlags flags = 0;
+    uint16_t mask = get_modifiers();
+
+    if (mask & (MASK_SHIFT_L | MASK_SHIFT_R)) { flags |= kCGEventFlagMaskShift;      }
+    if (mask & (MASK_CTRL_L  | MASK_CTRL_R))  { flags |= kCGEventFlagMaskControl;    }
+    if (mask & (MASK_ALT_L   | MASK_ALT_R))   { flags |= kCGEventFlagMaskAlternate;  }
+    if (mask & (MASK_META_L  | MASK_META_R))  { flags |= kCGEventFlagMaskCommand;    }
+    if (mask & MASK_CAPS_LOCK)                { flags |= kCGEventFlagMaskAlphaShift; }
+
+    return flags;
+}
+
+#ifdef USE_EPOCH_TIME
+static uint64_t get_unix_timestamp() {
+    struct timeval system_time;
+
+    // Get the local system time in UTC.
+    gettimeofday(&system_time, NULL);
+
+    // Convert the local system time to a Unix epoch in MS.
+    return (system_time.tv_sec * 1000) + (system_time.tv_usec / 1000);
+}
+#endif
+
+UIOHOOK_API uint64_t hook_capture_time_to_event_time(uint64_t capture_time) {
+    #ifdef USE_EPOCH_TIME
+    return (uint64_t) ((int64_t) capture_time + get_realtime_offset()) / NSEC_PER_MSEC;
+    #else
+    // The event time is the HID timestamp already converted to nanoseconds.
+    return capture_time;
+    #endif
+}
+
+#ifdef USE_APPLICATION_SERVICES
+// The keyboard layout must be refreshed on the main runloop.
+static void main_runloop_layout_proc(void *info) {
+    refresh_keyboard_layout();
+}
+
+// Schedule a refresh of the cached keyboard layout without waiting for it to complete.
+static void request_keyboard_layout_refresh() {
+    if (CFEqual(CFRunLoopGetCurrent(), CFRunLoopGetMain())) {
+        refresh_keyboard_layout();
+    } else {
+        dispatch_async_f(dispatch_get_main_queue(), NULL, &main_runloop_layout_proc);
+    }
+}
+
+static void keyboard_layout_change_proc(CFNotificationCenterRef center, void *observer, CFStringRef name, const void *object, CFDictionaryRef user_info) {
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Received kTISNotifySelectedKeyboardInputSourceChanged.\n",
+            __FUNCTION__, __LINE__);
+
+    request_keyboard_layout_refresh();
+}
+#endif
+
+// Read the current cursor location, HID pointers only report relative motion.
+static CGPoint get_cursor_location() {
+    CGPoint location = CGPointZero;
+
+    CGEventRef location_ref = CGEventCreate(NULL);
+    if (location_ref != NULL) {
+        location = CGEventGetLocation(location_ref);
+        CFRelease(location_ref);
+    }
+
+    return location;
+}
+
+// Deliver the motion collected since the last pointer event, if any.
+static void flush_motion() {
+    if (!hook->input.pointer.is_moved) {
+        return;
+    }
+
+    hook->input.pointer.is_moved = false;
+
+    uint64_t timestamp = hook->input.pointer.time;
+
+    // Reset the click count.
+    if (hook->input.mouse.click.count != 0 && (long int) (timestamp - hook->input.mouse.click.time) / TIMER_RESOLUTION_MS > hook_get_multi_click_time()) {
+        hook->input.mouse.click.count = 0;
+    }
+
+    CGPoint event_point = get_cursor_location();
+
+    // Populate mouse motion event.
+    event.time = timestamp;
+    event.capture_time = hook->input.pointer.capture_time;
+    event.reserved = 0x00;
+
+    event.mask = get_modifiers();
+
+    // Check the modifier mask range for MASK_BUTTON1 - 5.
+    hook->input.mouse.is_dragged = (event.mask & (MASK_BUTTON1 | MASK_BUTTON2 | MASK_BUTTON3 | MASK_BUTTON4 | MASK_BUTTON5)) > 0;
+    if (hook->input.mouse.is_dragged) {
+        event.type = EVENT_MOUSE_DRAGGED;
+    } else {
+        event.type = EVENT_MOUSE_MOVED;
+    }
+
+    event.data.mouse.button = MOUSE_NOBUTTON;
+    event.data.mouse.clicks = hook->input.mouse.click.count;
+    event.data.mouse.x = event_point.x;
+    event.data.mouse.y = event_point.y;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Mouse %s to %u, %u.\n",
+            __FUNCTION__, __LINE__, hook->input.mouse.is_dragged ? "dragged" : "moved",
+            event.data.mouse.x, event.data.mouse.y);
+
+    // Fire mouse motion event.
+    dispatch_event(&event);
+}
+
+static void process_key(uint64_t timestamp, uint32_t usage, bool is_press) {
+    if (usage >= HID_KEYBOARD_USAGE_MAX || hid_keycode_map[usage] == kVK_Undefined) {
+        // Roll over errors and reserved usages do not describe a key.
+        return;
+    }
+
+    UInt64 keycode = hid_keycode_map[usage];
+    uint16_t scancode = keycode_to_scancode(keycode);
+
+    uint16_t modifier = 0x0000;
+    if      (keycode == kVK_Shift)        { modifier = MASK_SHIFT_L; }
+    else if (keycode == kVK_RightShift)   { modifier = MASK_SHIFT_R; }
+    else if (keycode == kVK_Control)      { modifier = MASK_CTRL_L;  }
+    else if (keycode == kVK_RightControl) { modifier = MASK_CTRL_R;  }
+    else if (keycode == kVK_Option)       { modifier = MASK_ALT_L;   }
+    else if (keycode == kVK_RightOption)  { modifier = MASK_ALT_R;   }
+    else if (keycode == kVK_Command)      { modifier = MASK_META_L;  }
+    else if (keycode == kVK_RightCommand) { modifier = MASK_META_R;  }
+
+    if (is_press) {
+        set_modifier_mask(modifier);
+
+        // The HID value is the physical key, the lock toggles on every press.
+        if (keycode == kVK_CapsLock) {
+            hook->input.mask ^= MASK_CAPS_LOCK;
+        }
+    } else {
+        unset_modifier_mask(modifier);
+    }
+
+    // Populate key pressed or released event.
+    event.time = timestamp;
+    event.reserved = 0x00;
+
+    event.type = is_press ? EVENT_KEY_PRESSED : EVENT_KEY_RELEASED;
+    event.mask = get_modifiers();
+
+    event.data.keyboard.keycode = scancode;
+    event.data.keyboard.rawcode = keycode;
+    event.data.keyboard.keychar = CHAR_UNDEFINED;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Key %#X %s. (%#X)\n",
+            __FUNCTION__, __LINE__, event.data.keyboard.keycode,
+            is_press ? "pressed" : "released", event.data.keyboard.rawcode);
+
+    // Fire key pressed or released event.
+    dispatch_event(&event);
+
+    // If the pressed event was not consumed...
+    if (is_press && event.reserved ^ 0x01) {
+        // Translate through a keyboard event carrying our modifiers.
+        UniChar buffer[KEY_BUFFER_SIZE];
+        UniCharCount length = 0;
+
+        CGEventRef key_ref = CGEventCreateKeyboardEvent(NULL, (CGKeyCode) keycode, true);
+        if (key_ref != NULL) {
+            CGEventSetFlags(key_ref, get_event_flags());
+            length = keycode_to_unicode(key_ref, buffer, KEY_BUFFER_SIZE);
+            CFRelease(key_ref);
+        }
+
+        for (unsigned int i = 0; i < length; i++) {
+            // Populate key typed event.
+            event.time = timestamp;
+            event.reserved = 0x00;
+
+            event.type = EVENT_KEY_TYPED;
+            event.mask = get_modifiers();
+
+            event.data.keyboard.keycode = VC_UNDEFINED;
+            event.data.keyboard.rawcode = keycode;
+            event.data.keyboard.keychar = buffer[i];
+
+            logger(LOG_LEVEL_DEBUG, "%s [%u]: Key %#X typed. (%lc)\n",
+                    __FUNCTION__, __LINE__, event.data.keyboard.keycode,
+                    (wint_t) event.data.keyboard.keychar);
+
+            // Fire key typed event.
+            dispatch_event(&event);
+        }
+    }
+}
+
+static void process_button(uint64_t timestamp, uint32_t usage, bool is_press) {
+    // HID button usages start at one for the primary button.
+    uint16_t button = usage <= UINT16_MAX ? (uint16_t) usage : MOUSE_NOBUTTON;
+
+    uint16_t modifier = 0x0000;
+    switch (button) {
+        case MOUSE_BUTTON1: modifier = MASK_BUTTON1; break;
+        case MOUSE_BUTTON2: modifier = MASK_BUTTON2; break;
+        case MOUSE_BUTTON3: modifier = MASK_BUTTON3; break;
+        case MOUSE_BUTTON4: modifier = MASK_BUTTON4; break;
+        case MOUSE_BUTTON5: modifier = MASK_BUTTON5; break;
+    }
+
+    if (is_press) {
+        set_modifier_mask(modifier);
+
+        // Track the number of clicks, the button must match the previous button.
+        if (button == hook->input.mouse.click.button && (long int) (timestamp - hook->input.mouse.click.time) / TIMER_RESOLUTION_MS <= hook_get_multi_click_time()) {
+            if (hook->input.mouse.click.count < USHRT_MAX) {
+                hook->input.mouse.click.count++;
+            } else {
+                logger(LOG_LEVEL_WARN, "%s [%u]: Click count overflow detected!\n",
+                        __FUNCTION__, __LINE__);
+            }
+        } else {
+            // Reset the click count.
+            hook->input.mouse.click.count = 1;
+
+            // Set the previous button.
+            hook->input.mouse.click.button = button;
+        }
+
+        // Save this events time to calculate the click count.
+        hook->input.mouse.click.time = timestamp;
+    } else {
+        unset_modifier_mask(modifier);
+    }
+
+    CGPoint event_point = get_cursor_location();
+
+    // Populate mouse pressed or released event.
+    event.time = timestamp;
+    event.reserved = 0x00;
+
+    event.type = is_press ? EVENT_MOUSE_PRESSED : EVENT_MOUSE_RELEASED;
+    event.mask = get_modifiers();
+
+    event.data.mouse.button = button;
+    event.data.mouse.clicks = hook->input.mouse.click.count;
+    event.data.mouse.x = event_point.x;
+    event.data.mouse.y = event_point.y;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Button %u %s %u time(s). (%u, %u)\n",
+            __FUNCTION__, __LINE__, event.data.mouse.button,
+            is_press ? "pressed" : "released", event.data.mouse.clicks,
+            event.data.mouse.x, event.data.mouse.y);
+
+    // Fire mouse pressed or released event.
+    dispatch_event(&event);
+
+    if (!is_press) {
+        // If the released event was not consumed...
+        if (event.reserved ^ 0x01 && hook->input.mouse.is_dragged != true) {
+            // Populate mouse clicked event.
+            event.time = timestamp;
+            event.reserved = 0x00;
+
+            event.type = EVENT_MOUSE_CLICKED;
+            event.mask = get_modifiers();
+
+            event.data.mouse.button = button;
+            event.data.mouse.clicks = hook->input.mouse.click.count;
+            event.data.mouse.x = event_point.x;
+            event.data.mouse.y = event_point.y;
+
+            logger(LOG_LEVEL_DEBUG, "%s [%u]: Button %u clicked %u time(s). (%u, %u)\n",
+                    __FUNCTION__, __LINE__, event.data.mouse.button, event.data.mouse.clicks,
+                    event.data.mouse.x, event.data.mouse.y);
+
+            // Fire mouse clicked event.
+            dispatch_event(&event);
+        }
+
+        // Reset the number of clicks.
+        if ((long int) (timestamp - hook->input.mouse.click.time) / TIMER_RESOLUTION_MS > hook_get_multi_click_time()) {
+            hook->input.mouse.click.count = 0;
+        }
+
+        hook->input.mouse.is_dragged = false;
+    }
+}
+
+static void process_wheel(uint64_t timestamp, CFIndex value, uint8_t direction) {
+    // Reset the click count and previous button.
+    hook->input.mouse.click.count = 1;
+    hook->input.mouse.click.button = MOUSE_NOBUTTON;
+
+    CGPoint event_point = get_cursor_location();
+
+    // Populate mouse wheel event.
+    event.time = timestamp;
+    event.reserved = 0x00;
+
+    event.type = EVENT_MOUSE_WHEEL;
+    event.mask = get_modifiers();
+
+    event.data.wheel.clicks = hook->input.mouse.click.count;
+    event.data.wheel.x = event_point.x;
+    event.data.wheel.y = event_point.y;
+
+    // HID wheels report detents, the same as line based tap events.
+    event.data.wheel.type = WHEEL_BLOCK_SCROLL;
+    event.data.wheel.amount = 1;
+
+    // A positive wheel value is up and away, a positive pan value is to the right.
+    if (direction == WHEEL_VERTICAL_DIRECTION) {
+        event.data.wheel.rotation = (int16_t) -value;
+    } else {
+        event.data.wheel.rotation = (int16_t) value;
+    }
+    event.data.wheel.direction = direction;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Mouse wheel type %u, rotated %i units in the %u direction at %u, %u.\n",
+            __FUNCTION__, __LINE__, event.data.wheel.type,
+            event.data.wheel.amount * event.data.wheel.rotation,
+            event.data.wheel.direction,
+            event.data.wheel.x, event.data.wheel.y);
+
+    // Fire mouse wheel event.
+    dispatch_event(&event);
+}
+
+static void hid_value_proc(void *context, IOReturn result, void *sender, IOHIDValueRef value) {
+    IOHIDElementRef element = IOHIDValueGetElement(value);
+    uint32_t page = IOHIDElementGetUsagePage(element);
+    uint32_t usage = IOHIDElementGetUsage(element);
+    CFIndex integer_value = IOHIDValueGetIntegerValue(value);
+
+    // The HID timestamp shares the mach_absolute_time() time base.
+    if (event_timebase.denom == 0) {
+        mach_timebase_info(&event_timebase);
+    }
+
+    uint64_t event_ticks = IOHIDValueGetTimeStamp(value);
+    event.capture_time = event_ticks * event_timebase.numer / event_timebase.denom;
+
+    // Click timing divides by TIMER_RESOLUTION_MS, so use nanoseconds rather
+    // than the raw ticks, which are not nanoseconds on Apple silicon.
+    #ifdef USE_EPOCH_TIME
+    uint64_t timestamp = get_unix_timestamp();
+    #else
+    uint64_t timestamp = event.capture_time;
+    #endif
+
+    uint64_t now = get_monotonic_time();
+    if (now >= event.capture_time) {
+        stats_record_lag((now - event.capture_time) / NSEC_PER_USEC);
+    }
+
+    uint32_t event_mask = get_event_mask();
+    if (page == kHIDPage_GenericDesktop && (usage == kHIDUsage_GD_X || usage == kHIDUsage_GD_Y)) {
+        if (integer_value != 0 && (event_mask & EVENT_MASK_MOUSE_MOTION)) {
+            // Collapse all motion up to the next pointer or key event.
+            hook->input.pointer.is_moved = true;
+            hook->input.pointer.time = timestamp;
+            hook->input.pointer.capture_time = event.capture_time;
+        }
+        return;
+    }
+
+    // Keep the motion in order with the event that follows it.
+    uint64_t capture_time = event.capture_time;
+    flush_motion();
+    event.capture_time = capture_time;
+
+    if (page == kHIDPage_KeyboardOrKeypad) {
+        if (event_mask & EVENT_MASK_KEYBOARD) {
+            process_key(timestamp, usage, integer_value != 0);
+        }
+    } else if (page == kHIDPage_Button) {
+        if (event_mask & EVENT_MASK_MOUSE_BUTTON) {
+            process_button(timestamp, usage, integer_value != 0);
+        }
+    } else if (page == kHIDPage_GenericDesktop && usage == kHIDUsage_GD_Wheel) {
+        if (integer_value != 0 && (event_mask & EVENT_MASK_MOUSE_WHEEL)) {
+            process_wheel(timestamp, integer_value, WHEEL_VERTICAL_DIRECTION);
+        }
+    } else if (page == kHIDPage_Consumer && usage == kHIDUsage_Csmr_ACPan) {
+        if (integer_value != 0 && (event_mask & EVENT_MASK_MOUSE_WHEEL)) {
+            process_wheel(timestamp, integer_value, WHEEL_HORIZONTAL_DIRECTION);
+        }
+    }
+}
+
+static void hook_status_proc(CFRunLoopObserverRef observer, CFRunLoopActivity activity, void *info) {
+    #ifdef USE_EPOCH_TIME
+    uint64_t timestamp = get_unix_timestamp();
+    #else
+    uint64_t timestamp = get_monotonic_time();
+    #endif
+
+    switch (activity) {
+        case kCFRunLoopEntry:
+            // Initialize Native Input Functions.
+            load_input_helper();
+
+            // Populate the hook start event.
+            event.time = timestamp;
+            event.capture_time = get_monotonic_time();
+            event.reserved = 0x00;
+
+            event.type = EVENT_HOOK_ENABLED;
+            event.mask = 0x00;
+
+            // Fire the hook start event.
+            dispatch_event(&event);
+            break;
+
+        case kCFRunLoopBeforeWaiting:
+            // Every HID value queued for this pass has been handled.
+            flush_motion();
+
+            // Deliver anything collected for the batch callback.
+            dispatch_flush();
+            break;
+
+        case kCFRunLoopExit:
+            // Populate the hook stop event.
+            event.time = timestamp;
+            event.capture_time = get_monotonic_time();
+            event.reserved = 0x00;
+
+            event.type = EVENT_HOOK_DISABLED;
+            event.mask = 0x00;
+
+            // Fire the hook stop event.
+            dispatch_event(&event);
+            dispatch_flush();
+
+            // Deinitialize native input helper functions.
+            unload_input_helper();
+            break;
+
+        default:
+            logger(LOG_LEVEL_WARN, "%s [%u]: Unhandled RunLoop activity! (%#X)\n",
+                    __FUNCTION__, __LINE__, (unsigned int) activity);
+            break;
+    }
+}
+
+// Create a matching dictionary for a generic desktop usage.
+static CFDictionaryRef create_matching(uint32_t usage) {
+    CFMutableDictionaryRef matching = CFDictionaryCreateMutable(kCFAllocatorDefault, 2,
+            &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+
+    if (matching != NULL) {
+        uint32_t page = kHIDPage_GenericDesktop;
+        CFNumberRef page_ref = CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type, &page);
+        CFNumberRef usage_ref = CFNumberCreate(kCFAllocatorDefault, kCFNumberSInt32Type, &usage);
+
+        CFDictionarySetValue(matching, CFSTR(kIOHIDDeviceUsagePageKey), page_ref);
+        CFDictionarySetValue(matching, CFSTR(kIOHIDDeviceUsageKey), usage_ref);
+
+        CFRelease(page_ref);
+        CFRelease(usage_ref);
+    }
+
+    return matching;
+}
+
+static int create_hid_manager() {
+    hook->manager = IOHIDManagerCreate(kCFAllocatorDefault, kIOHIDOptionsTypeNone);
+    if (hook->manager == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: IOHIDManagerCreate failure!\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_ERROR_OPEN_HID_MANAGER;
+    }
+
+    // Only match the devices for the subscribed event classes.
+    CFMutableArrayRef matching = CFArrayCreateMutable(kCFAllocatorDefault, 3, &kCFTypeArrayCallBacks);
+
+    uint32_t event_mask = get_event_mask();
+    if (event_mask & EVENT_MASK_KEYBOARD) {
+        CFDictionaryRef keyboard = create_matching(kHIDUsage_GD_Keyboard);
+        CFArrayAppendValue(matching, keyboard);
+        CFRelease(keyboard);
+    }
+
+    if (event_mask & EVENT_MASK_MOUSE) {
+        CFDictionaryRef mouse = create_matching(kHIDUsage_GD_Mouse);
+        CFArrayAppendValue(matching, mouse);
+        CFRelease(mouse);
+
+        CFDictionaryRef pointer = create_matching(kHIDUsage_GD_Pointer);
+        CFArrayAppendValue(matching, pointer);
+        CFRelease(pointer);
+    }
+
+    IOHIDManagerSetDeviceMatchingMultiple(hook->manager, matching);
+    CFRelease(matching);
+
+    IOHIDManagerRegisterInputValueCallback(hook->manager, hid_value_proc, NULL);
+    IOHIDManagerScheduleWithRunLoop(hook->manager, event_loop, kCFRunLoopDefaultMode);
+
+    // Input Monitoring access is required, the devices are never seized.
+    IOReturn result = IOHIDManagerOpen(hook->manager, kIOHIDOptionsTypeNone);
+    if (result != kIOReturnSuccess) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: IOHIDManagerOpen failure! (%#X)\n",
+                __FUNCTION__, __LINE__, (unsigned int) result);
+
+        return UIOHOOK_ERROR_OPEN_HID_MANAGER;
+    }
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: IOHIDManagerOpen successful.\n",
+            __FUNCTION__, __LINE__);
+
+    // Create run loop observers.
+    hook->observer = CFRunLoopObserverCreate(
+            kCFAllocatorDefault,
+            kCFRunLoopEntry | kCFRunLoopBeforeWaiting | kCFRunLoopExit,
+            true,
+            0,
+            hook_status_proc,
+            NULL);
+    if (hook->observer == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: CFRunLoopObserverCreate failure!\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_ERROR_CREATE_OBSERVER;
+    }
+
+    CFRunLoopAddObserver(event_loop, hook->observer, kCFRunLoopDefaultMode);
+
+    return UIOHOOK_SUCCESS;
+}
+
+static void destroy_hid_manager() {
+    if (hook->observer != NULL) {
+        if (CFRunLoopContainsObserver(event_loop, hook->observer, kCFRunLoopDefaultMode)) {
+            CFRunLoopRemoveObserver(event_loop, hook->observer, kCFRunLoopDefaultMode);
+        }
+
+        // Invalidate and free hook observer.
+        CFRunLoopObserverInvalidate(hook->observer);
+        CFRelease(hook->observer);
+        hook->observer = NULL;
+    }
+
+    if (hook->manager != NULL) {
+        IOHIDManagerUnscheduleFromRunLoop(hook->manager, event_loop, kCFRunLoopDefaultMode);
+        IOHIDManagerClose(hook->manager, kIOHIDOptionsTypeNone);
+        CFRelease(hook->manager);
+        hook->manager = NULL;
+    }
+}
+
+int run_native_hook() {
+    // Hook data for future cleanup.
+    hook = calloc(1, sizeof(hook_info));
+    if (hook == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for hook structure!\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_ERROR_OUT_OF_MEMORY;
+    }
+
+    hook->input.mouse.click.button = MOUSE_NOBUTTON;
+
+    // Not every setting reports changes, so start each hook with fresh values.
+    invalidate_property_cache();
+
+    memset(hid_keycode_map, kVK_Undefined, sizeof(hid_keycode_map));
+    for (size_t i = 0; i < sizeof(hid_keycode_table) / sizeof(hid_keycode_table[0]); i++) {
+        hid_keycode_map[hid_keycode_table[i].usage] = hid_keycode_table[i].keycode;
+    }
+
+    int status = UIOHOOK_ERROR_GET_RUNLOOP;
+
+    // HID values are delivered on the runloop of the thread that called hook_run().
+    event_loop = CFRunLoopGetCurrent();
+    if (event_loop != NULL) {
+        // Initialize starting modifiers.
+        initialize_modifiers();
+
+        status = create_hid_manager();
+        if (status == UIOHOOK_SUCCESS) {
+            #ifdef USE_APPLICATION_SERVICES
+            // Keep the cached keyboard layout in sync with the selected input source.
+            CFNotificationCenterAddObserver(
+                    CFNotificationCenterGetDistributedCenter(),
+                    (const void *) keyboard_layout_change_proc,
+                    keyboard_layout_change_proc,
+                    kTISNotifySelectedKeyboardInputSourceChanged,
+                    NULL,
+                    CFNotificationSuspensionBehaviorDeliverImmediately);
+
+            // Cache the current keyboard layout before any keys are typed.
+            request_keyboard_layout_refresh();
+            #endif
+
+            // Start the hook thread runloop.
+            CFRunLoopRun();
+
+            #ifdef USE_APPLICATION_SERVICES
+            CFNotificationCenterRemoveObserver(
+                    CFNotificationCenterGetDistributedCenter(),
+                    (const void *) keyboard_layout_change_proc,
+                    kTISNotifySelectedKeyboardInputSourceChanged,
+                    NULL);
+            #endif
+        }
+
+        destroy_hid_manager();
+    } else {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: CFRunLoopGetCurrent failure!\n",
+                __FUNCTION__, __LINE__);
+    }
+
+    event_loop = NULL;
+
+    // Free data associated with this hook.
+    free(hook);
+    hook = NULL;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Something, something, something, complete.\n",
+            __FUNCTION__, __LINE__);
+
+    return status;
+}
+
+int stop_native_hook() {
+    int status = UIOHOOK_FAILURE;
+
+    if (event_loop != NULL) {
+        CFStringRef mode = CFRunLoopCopyCurrentMode(event_loop);
+        if (mode != NULL) {
+            CFRelease(mode);
+
+            // Stop the run loop.
+            CFRunLoopStop(event_loop);
+
+            status = UIOHOOK_SUCCESS;
+        }
+    }
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Status: %#X.\n",
+            __FUNCTION__, __LINE__, status);
+
+    return status;
+}
@@ -0,0 +1,489 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uiohook.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "journal.h"
+#include "logger.h"
+
+/* Journal files are a sequence of segments.  Every segment starts with the
+ * magic, a little-endian format version and two reserved bytes, followed by
+ * variable length records that are delta encoded against the previous record
+ * of the same segment:
+ *
+ *   header   1 byte   event type in the low nibble, JOURNAL_MASK_CHANGED
+ *   mask     varint   only present when JOURNAL_MASK_CHANGED is set
+ *   time     zigzag   milliseconds since the previous record
+ *   payload           depends on the event type, coordinates are zigzag
+ *                     deltas from the previous mouse position
+ *
+ * Opening a writer on an existing journal appends a new segment, so a file is
+ * never rewritten.
+ */
+#define JOURNAL_MAGIC           "UIOJ"
+#define JOURNAL_VERSION         1
+
+#define JOURNAL_TYPE_MASK       0x0F
+#define JOURNAL_MASK_CHANGED    0x10
+
+// Buffer size used for the writer's stdio stream.
+#define JOURNAL_BUFFER_SIZE     (64 * 1024)
+
+struct _journal_writer {
+    FILE *file;
+    char *buffer;
+    journal_state state;
+};
+
+struct _journal_reader {
+    const uint8_t *data;
+    size_t size;
+    size_t offset;
+    journal_state state;
+
+    #ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+    #endif
+};
+
+
+static inline uint64_t zigzag_encode(int64_t value) {
+    return ((uint64_t) value << 1) ^ (uint64_t) (value >> 63);
+}
+
+static inline int64_t zigzag_decode(uint64_t value) {
+    return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+static inline size_t varint_encode(uint8_t *buffer, uint64_t value) {
+    size_t size = 0;
+    while (value >= 0x80) {
+        buffer[size++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    buffer[size++] = (uint8_t) value;
+
+    return size;
+}
+
+static inline bool varint_decode(journal_reader *reader, uint64_t *value) {
+    *value = 0;
+    for (unsigned int shift = 0; shift < 64 && reader->offset < reader->size; shift += 7) {
+        uint8_t byte = reader->data[reader->offset++];
+        *value |= (uint64_t) (byte & 0x7F) << shift;
+
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void journal_reset_state(journal_state *state) {
+    state->time = 0;
+    state->mask = 0x0000;
+    state->x = 0;
+    state->y = 0;
+}
+
+static inline bool is_segment_header(const uint8_t *data) {
+    return memcmp(data, JOURNAL_MAGIC, 4) == 0;
+}
+
+
+size_t journal_encode_segment(uint8_t *buffer) {
+    memcpy(buffer, JOURNAL_MAGIC, 4);
+    buffer[4] = JOURNAL_VERSION & 0xFF;
+    buffer[5] = (JOURNAL_VERSION >> 8) & 0xFF;
+    buffer[6] = 0x00;
+    buffer[7] = 0x00;
+
+    return JOURNAL_SEGMENT_SIZE;
+}
+
+size_t journal_encode_event(journal_state *state, uiohook_event * const event, uint8_t *buffer) {
+    size_t size = 1;
+
+    buffer[0] = (uint8_t) (event->type & JOURNAL_TYPE_MASK);
+    if (event->mask != state->mask) {
+        buffer[0] |= JOURNAL_MASK_CHANGED;
+        size += varint_encode(&buffer[size], event->mask);
+        state->mask = event->mask;
+    }
+
+    size += varint_encode(&buffer[size], zigzag_encode((int64_t) (event->time - state->time)));
+    state->time = event->time;
+
+    switch (event->type) {
+        case EVENT_KEY_TYPED:
+        case EVENT_KEY_PRESSED:
+        case EVENT_KEY_RELEASED:
+            size += varint_encode(&buffer[size], event->data.keyboard.keycode);
+            size += varint_encode(&buffer[size], event->data.keyboard.rawcode);
+            size += varint_encode(&buffer[size], event->data.keyboard.keychar);
+            break;
+
+        case EVENT_MOUSE_CLICKED:
+        case EVENT_MOUSE_PRESSED:
+        case EVENT_MOUSE_RELEASED:
+        case EVENT_MOUSE_MOVED:
+        case EVENT_MOUSE_DRAGGED:
+            size += varint_encode(&buffer[size], event->data.mouse.button);
+            size += varint_encode(&buffer[size], event->data.mouse.clicks);
+            size += varint_encode(&buffer[size], zigzag_encode(event->data.mouse.x - state->x));
+            size += varint_encode(&buffer[size], zigzag_encode(event->data.mouse.y - state->y));
+            state->x = event->data.mouse.x;
+            state->y = event->data.mouse.y;
+            break;
+
+        case EVENT_MOUSE_WHEEL:
+            size += varint_encode(&buffer[size], event->data.wheel.clicks);
+            size += varint_encode(&buffer[size], zigzag_encode(event->data.wheel.x - state->x));
+            size += varint_encode(&buffer[size], zigzag_encode(event->data.wheel.y - state->y));
+            buffer[size++] = event->data.wheel.type;
+            size += varint_encode(&buffer[size], event->data.wheel.amount);
+            size += varint_encode(&buffer[size], zigzag_encode(event->data.wheel.rotation));
+            buffer[size++] = event->data.wheel.direction;
+            state->x = event->data.wheel.x;
+            state->y = event->data.wheel.y;
+            break;
+
+        default:
+            // Hook state events have no payload.
+            break;
+    }
+
+    return size;
+}
+
+static bool decode_event(journal_reader *reader, uiohook_event *event) {
+    journal_state *state = &reader->state;
+    uint64_t value, a, b, c, d;
+
+    uint8_t header = reader->data[reader->offset++];
+    memset(event, 0, sizeof(uiohook_event));
+    event->type = (event_type) (header & JOURNAL_TYPE_MASK);
+
+    if (header & JOURNAL_MASK_CHANGED) {
+        if (!varint_decode(reader, &value)) {
+            return false;
+        }
+        state->mask = (uint16_t) value;
+    }
+    event->mask = state->mask;
+
+    if (!varint_decode(reader, &value)) {
+        return false;
+    }
+    state->time += (uint64_t) zigzag_decode(value);
+    event->time = state->time;
+
+    switch (event->type) {
+        case EVENT_KEY_TYPED:
+        case EVENT_KEY_PRESSED:
+        case EVENT_KEY_RELEASED:
+            if (!varint_decode(reader, &a) || !varint_decode(reader, &b) || !varint_decode(reader, &c)) {
+                return false;
+            }
+            event->data.keyboard.keycode = (uint16_t) a;
+            event->data.keyboard.rawcode = (uint16_t) b;
+            event->data.keyboard.keychar = (uint16_t) c;
+            break;
+
+        case EVENT_MOUSE_CLICKED:
+        case EVENT_MOUSE_PRESSED:
+        case EVENT_MOUSE_RELEASED:
+        case EVENT_MOUSE_MOVED:
+        case EVENT_MOUSE_DRAGGED:
+            if (!varint_decode(reader, &a) || !varint_decode(reader, &b)
+                    || !varint_decode(reader, &c) || !varint_decode(reader, &d)) {
+                return false;
+            }
+            state->x += (int16_t) zigzag_decode(c);
+            state->y += (int16_t) zigzag_decode(d);
+
+            event->data.mouse.button = (uint16_t) a;
+            event->data.mouse.clicks = (uint16_t) b;
+            event->data.mouse.x = state->x;
+            event->data.mouse.y = state->y;
+            break;
+
+        case EVENT_MOUSE_WHEEL:
+            if (!varint_decode(reader, &a) || !varint_decode(reader, &b) || !varint_decode(reader, &c)
+                    || reader->offset >= reader->size) {
+                return false;
+            }
+            state->x += (int16_t) zigzag_decode(b);
+            state->y += (int16_t) zigzag_decode(c);
+
+            event->data.wheel.clicks = (uint16_t) a;
+            event->data.wheel.x = state->x;
+            event->data.wheel.y = state->y;
+            event->data.wheel.type = reader->data[reader->offset++];
+
+            if (!varint_decode(reader, &a) || !varint_decode(reader, &b) || reader->offset >= reader->size) {
+                return false;
+            }
+            event->data.wheel.amount = (uint16_t) a;
+            event->data.wheel.rotation = (int16_t) zigzag_decode(b);
+            event->data.wheel.direction = reader->data[reader->offset++];
+            break;
+
+        case EVENT_HOOK_ENABLED:
+        case EVENT_HOOK_DISABLED:
+            break;
+
+        default:
+            logger(LOG_LEVEL_WARN, "%s [%u]: Unknown journal record type %#X!\n",
+                    __FUNCTION__, __LINE__, event->type);
+            return false;
+    }
+
+    return true;
+}
+
+
+UIOHOOK_API journal_writer * hook_journal_open_writer(const char *path) {
+    journal_writer *writer = calloc(1, sizeof(journal_writer));
+    if (writer == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for journal writer!\n",
+                __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    writer->buffer = malloc(JOURNAL_BUFFER_SIZE);
+    writer->file = fopen(path, "ab");
+    if (writer->buffer == NULL || writer->file == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to open journal '%s' for writing!\n",
+                __FUNCTION__, __LINE__, path);
+
+        if (writer->file != NULL) {
+            fclose(writer->file);
+        }
+        free(writer->buffer);
+        free(writer);
+        return NULL;
+    }
+
+    setvbuf(writer->file, writer->buffer, _IOFBF, JOURNAL_BUFFER_SIZE);
+    journal_reset_state(&writer->state);
+
+    uint8_t segment[JOURNAL_SEGMENT_SIZE];
+    fwrite(segment, journal_encode_segment(segment), 1, writer->file);
+
+    return writer;
+}
+
+UIOHOOK_API int hook_journal_write(journal_writer *writer, uiohook_event * const events, size_t count) {
+    if (writer == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Invalid journal writer!\n",
+                __FUNCTION__, __LINE__);
+        return UIOHOOK_FAILURE;
+    }
+
+    uint8_t record[JOURNAL_RECORD_MAX];
+    for (size_t i = 0; i < count; i++) {
+        size_t size = journal_encode_event(&writer->state, &events[i], record);
+        if (fwrite(record, size, 1, writer->file) != 1) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to write journal record!\n",
+                    __FUNCTION__, __LINE__);
+            return UIOHOOK_FAILURE;
+        }
+    }
+
+    return UIOHOOK_SUCCESS;
+}
+
+UIOHOOK_API int hook_journal_flush(journal_writer *writer) {
+    if (writer == NULL || fflush(writer->file) != 0) {
+        return UIOHOOK_FAILURE;
+    }
+
+    return UIOHOOK_SUCCESS;
+}
+
+UIOHOOK_API void hook_journal_close_writer(journal_writer *writer) {
+    if (writer != NULL) {
+        fclose(writer->file);
+        free(writer->buffer);
+        free(writer);
+    }
+}
+
+UIOHOOK_API void hook_journal_dispatch_proc(uiohook_event * const event, void *user_data) {
+    hook_journal_write((journal_writer *) user_data, event, 1);
+}
+
+UIOHOOK_API void hook_journal_batch_dispatch_proc(uiohook_event * const events, size_t count, void *user_data) {
+    hook_journal_write((journal_writer *) user_data, events, count);
+}
+
+
+UIOHOOK_API journal_reader * hook_journal_open_reader(const char *path) {
+    journal_reader *reader = calloc(1, sizeof(journal_reader));
+    if (reader == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for journal reader!\n",
+                __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    #ifdef _WIN32
+    reader->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER size;
+    if (reader->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(reader->file, &size)) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to open journal '%s'! (%#lX)\n",
+                __FUNCTION__, __LINE__, path, (unsigned long) GetLastError());
+
+        if (reader->file != INVALID_HANDLE_VALUE) {
+            CloseHandle(reader->file);
+        }
+        free(reader);
+        return NULL;
+    }
+
+    reader->size = (size_t) size.QuadPart;
+    if (reader->size > 0) {
+        reader->mapping = CreateFileMapping(reader->file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (reader->mapping != NULL) {
+            reader->data = (const uint8_t *) MapViewOfFile(reader->mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+
+        if (reader->data == NULL) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to map journal '%s'! (%#lX)\n",
+                    __FUNCTION__, __LINE__, path, (unsigned long) GetLastError());
+
+            if (reader->mapping != NULL) {
+                CloseHandle(reader->mapping);
+            }
+            CloseHandle(reader->file);
+            free(reader);
+            return NULL;
+        }
+    }
+    #else
+    int fd = open(path, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to open journal '%s'!\n",
+                __FUNCTION__, __LINE__, path);
+
+        if (fd >= 0) {
+            close(fd);
+        }
+        free(reader);
+        return NULL;
+    }
+
+    reader->size = (size_t) info.st_size;
+    if (reader->size > 0) {
+        void *data = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to map journal '%s'!\n",
+                    __FUNCTION__, __LINE__, path);
+
+            close(fd);
+            free(reader);
+            return NULL;
+        }
+
+        reader->data = (const uint8_t *) data;
+    }
+
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+    #endif
+
+    journal_reset_state(&reader->state);
+
+    return reader;
+}
+
+UIOHOOK_API size_t hook_journal_read(journal_reader *reader, uiohook_event *events, size_t count) {
+    size_t total = 0;
+
+    while (reader != NULL && total < count && reader->offset < reader->size) {
+        if (reader->size - reader->offset >= JOURNAL_SEGMENT_SIZE && is_segment_header(&reader->data[reader->offset])) {
+            uint16_t version = reader->data[reader->offset + 4] | (reader->data[reader->offset + 5] << 8);
+            if (version != JOURNAL_VERSION) {
+                logger(LOG_LEVEL_ERROR, "%s [%u]: Unsupported journal version %u!\n",
+                        __FUNCTION__, __LINE__, version);
+
+                reader->offset = reader->size;
+                break;
+            }
+
+            reader->offset += JOURNAL_SEGMENT_SIZE;
+            journal_reset_state(&reader->state);
+            continue;
+        } else if (reader->offset == 0) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: Missing journal segment header!\n",
+                    __FUNCTION__, __LINE__);
+
+            reader->offset = reader->size;
+            break;
+        }
+
+        if (!decode_event(reader, &events[total])) {
+            logger(LOG_LEVEL_WARN, "%s [%u]: Truncated or corrupt journal record at offset %lu!\n",
+                    __FUNCTION__, __LINE__, (unsigned long) reader->offset);
+
+            reader->offset = reader->size;
+            break;
+        }
+
+        total++;
+    }
+
+    return total;
+}
+
+UIOHOOK_API void hook_journal_close_reader(journal_reader *reader) {
+    if (reader != NULL) {
+        #ifdef _WIN32
+        if (reader->data != NULL) {
+            UnmapViewOfFile(reader->data);
+            CloseHandle(reader->mapping);
+        }
+        CloseHandle(reader->file);
+        #else
+        if (reader->data != NULL) {
+            munmap((void *) reader->data, reader->size);
+        }
+        #endif
+
+        free(reader);
+    }
+}
@@ -0,0 +1,51 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _included_journal
+#define _included_journal
+
+#include <stddef.h>
+#include <stdint.h>
+#include <uiohook.h>
+
+// Size of the header starting every journal segment.
+#define JOURNAL_SEGMENT_SIZE    8
+
+// Largest possible encoded record.
+#define JOURNAL_RECORD_MAX      64
+
+// Delta encoding state shared by the writer and reader.
+typedef struct _journal_state {
+    uint64_t time;
+    uint16_t mask;
+    int16_t x;
+    int16_t y;
+} journal_state;
+
+// Reset the delta encoding state for the start of a new segment.
+extern void journal_reset_state(journal_state *state);
+
+// Write a segment header to buffer, returns JOURNAL_SEGMENT_SIZE.
+extern size_t journal_encode_segment(uint8_t *buffer);
+
+// Encode the event as a record delta encoded against state, which is updated.
+// The buffer must hold at least JOURNAL_RECORD_MAX bytes, returns the size of
+// the record.
+extern size_t journal_encode_event(journal_state *state, uiohook_event * const event, uint8_t *buffer);
+
+#endif
@@ -0,0 +1,202 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <uiohook.h>
+
+#include "atomic_helper.h"
+#include "key_state.h"
+
+#define KEY_STATE_WORDS (KEY_STATE_SIZE / sizeof(uint32_t))
+
+// Held keys, one bit per hook_key_state_index(), and the held MASK_BUTTON*
+// buttons.  The version is odd while the hook thread is updating them, so a
+// reader retries until it copied both without a write in between.
+static volatile uint32_t key_bits[KEY_STATE_WORDS];
+static volatile uint16_t button_bits = 0x0000;
+static volatile uint32_t key_version = 0;
+
+// Modifier masks and the keys they stand for.
+static const struct {
+    uint16_t mask;
+    uint16_t keycode;
+} modifier_keys[] = {
+    { MASK_SHIFT_L, VC_SHIFT_L },
+    { MASK_CTRL_L,  VC_CONTROL_L },
+    { MASK_META_L,  VC_META_L },
+    { MASK_ALT_L,   VC_ALT_L },
+    { MASK_SHIFT_R, VC_SHIFT_R },
+    { MASK_CTRL_R,  VC_CONTROL_R },
+    { MASK_META_R,  VC_META_R },
+    { MASK_ALT_R,   VC_ALT_R }
+};
+
+#define BUTTON_MASK (MASK_BUTTON1 | MASK_BUTTON2 | MASK_BUTTON3 | MASK_BUTTON4 | MASK_BUTTON5)
+
+
+static inline void begin_update() {
+    atomic_store_release(&key_version, key_version + 1);
+    atomic_thread_fence_full();
+}
+
+static inline void end_update() {
+    atomic_store_release(&key_version, key_version + 1);
+}
+
+static inline void write_key_bit(int index, bool pressed) {
+    uint32_t bit = (uint32_t) 1 << (index & 31);
+    uint32_t word = key_bits[index >> 5];
+
+    atomic_store_release(&key_bits[index >> 5], pressed ? word | bit : word & ~bit);
+}
+
+static void write_modifier_keys(uint16_t mask) {
+    for (size_t i = 0; i < sizeof(modifier_keys) / sizeof(modifier_keys[0]); i++) {
+        if (mask & modifier_keys[i].mask) {
+            write_key_bit(hook_key_state_index(modifier_keys[i].keycode), true);
+        }
+    }
+
+    button_bits |= mask & BUTTON_MASK;
+}
+
+void reset_key_state(uint16_t mask) {
+    begin_update();
+    for (size_t i = 0; i < KEY_STATE_WORDS; i++) {
+        atomic_store_release(&key_bits[i], 0);
+    }
+    button_bits = 0x0000;
+
+    write_modifier_keys(mask);
+    end_update();
+}
+
+void seed_key_state(uint16_t mask) {
+    begin_update();
+    write_modifier_keys(mask);
+    end_update();
+}
+
+void set_key_state(uint16_t keycode, bool pressed) {
+    int index = hook_key_state_index(keycode);
+    if (index < 0) {
+        return;
+    }
+
+    begin_update();
+    write_key_bit(index, pressed);
+    end_update();
+}
+
+void update_key_state(uiohook_event *const event) {
+    switch (event->type) {
+        case EVENT_KEY_PRESSED:
+        case EVENT_KEY_RELEASED:
+            set_key_state(event->data.keyboard.keycode, event->type == EVENT_KEY_PRESSED);
+            break;
+
+        case EVENT_MOUSE_PRESSED:
+        case EVENT_MOUSE_RELEASED:
+            if (event->data.mouse.button >= MOUSE_BUTTON1 && event->data.mouse.button <= MOUSE_BUTTON5) {
+                uint16_t button = MASK_BUTTON1 << (event->data.mouse.button - MOUSE_BUTTON1);
+
+                begin_update();
+                if (event->type == EVENT_MOUSE_PRESSED) {
+                    button_bits |= button;
+                } else {
+                    button_bits &= ~button;
+                }
+                end_update();
+            }
+            break;
+
+        case EVENT_HOOK_DISABLED:
+            // Nothing is tracked once the hook stops.
+            reset_key_state(0x0000);
+            break;
+
+        default:
+            break;
+    }
+}
+
+
+UIOHOOK_API int hook_key_state_index(uint16_t keycode) {
+    // Extended keys share the low byte with a base key, but no base keycode
+    // uses the high bit of it, so the extended keys move into the upper half.
+    if (keycode == VC_UNDEFINED || (keycode & 0x80)) {
+        return -1;
+    }
+
+    switch (keycode >> 8) {
+        case 0x00:
+        case 0xEE:
+            // The keypad navigation keys are the keypad keys without num lock.
+            return keycode & 0x7F;
+
+        case 0x0E:
+        case 0xE0:
+        case 0xFF:
+            return 0x80 | (keycode & 0x7F);
+
+        default:
+            return -1;
+    }
+}
+
+UIOHOOK_API bool hook_get_key_state(uint16_t keycode) {
+    int index = hook_key_state_index(keycode);
+    if (index < 0) {
+        return false;
+    }
+
+    // A single word is always consistent, no need to check the version.
+    return (atomic_load_acquire(&key_bits[index >> 5]) >> (index & 31)) & 1;
+}
+
+UIOHOOK_API uint16_t hook_get_button_state() {
+    return atomic_load_acquire(&button_bits);
+}
+
+UIOHOOK_API uint16_t hook_copy_key_state(uint8_t *bitmap) {
+    uint32_t words[KEY_STATE_WORDS];
+    uint16_t buttons;
+
+    uint32_t version;
+    do {
+        version = atomic_load_acquire(&key_version);
+        for (size_t i = 0; i < KEY_STATE_WORDS; i++) {
+            words[i] = atomic_load_acquire(&key_bits[i]);
+        }
+        buttons = atomic_load_acquire(&button_bits);
+
+        atomic_thread_fence_full();
+    } while ((version & 1) || atomic_load_acquire(&key_version) != version);
+
+    if (bitmap != NULL) {
+        // Byte order is independent of the platform, index / 8 holds index % 8.
+        for (size_t i = 0; i < KEY_STATE_SIZE; i++) {
+            bitmap[i] = (uint8_t) (words[i / 4] >> ((i % 4) * 8));
+        }
+    }
+
+    return buttons;
+}
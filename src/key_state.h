@@ -0,0 +1,41 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _included_key_state
+#define _included_key_state
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <uiohook.h>
+
+// The key state is written by the hook thread only and may be read from any
+// thread through hook_get_key_state() and hook_copy_key_state().
+
+// Clear the key state and mark the modifier keys and buttons held in mask as pressed.
+extern void reset_key_state(uint16_t mask);
+
+// Mark the modifier keys and buttons held in mask as pressed, keeping any other keys.
+extern void seed_key_state(uint16_t mask);
+
+// Mark a single key as pressed or released.
+extern void set_key_state(uint16_t keycode, bool pressed);
+
+// Track the key or button pressed or released by the event.
+extern void update_key_state(uiohook_event *const event);
+
+#endif
@@ -0,0 +1,101 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <uiohook.h>
+
+#ifdef USE_XKB_COMMON
+#include <xkbcommon/xkbcommon.h>
+#endif
+
+#include "input_helper.h"
+
+// The forward table covers every 8 bit key code and the inverse table covers
+// every 16 bit scancode, so neither direction needs a bounds check.
+#define SCANCODE_TABLE_SIZE 256
+#define KEYCODE_TABLE_SIZE (UINT16_MAX + 1)
+
+// Keep each lookup table on its own cache lines.
+#define SCANCODE_TABLE_ALIGN __attribute__ ((aligned(64)))
+
+// X11 and xkbcommon key codes are offset from evdev codes by 8.
+#define EVDEV_KEYCODE_OFFSET 8
+
+#include "evdev_scancode_table.h"
+
+static SCANCODE_TABLE_ALIGN uint16_t keycode_table[KEYCODE_TABLE_SIZE];
+
+uint16_t keycode_to_scancode(uint16_t code) {
+    uint16_t scancode = VC_UNDEFINED;
+
+    // The evdev table is indexed by X11 key code, which is the evdev code + 8.
+    if (code + EVDEV_KEYCODE_OFFSET < SCANCODE_TABLE_SIZE) {
+        scancode = evdev_scancode_table[code + EVDEV_KEYCODE_OFFSET];
+    }
+
+    return scancode;
+}
+
+uint16_t evdev_code_to_scancode(uint16_t code) {
+    return keycode_to_scancode(code);
+}
+
+uint16_t scancode_to_keycode(uint16_t scancode) {
+    return keycode_table[scancode];
+}
+
+#ifdef USE_XKB_COMMON
+size_t keycode_to_unicode(struct xkb_state* state, xkb_keycode_t keycode, uint16_t *buffer, size_t length) {
+    size_t count = 0;
+
+    if (state != NULL) {
+        uint32_t unicode = xkb_state_key_get_utf32(state, keycode);
+
+        if (unicode <= 0x10FFFF) {
+            if ((unicode <= 0xD7FF || (unicode >= 0xE000 && unicode <= 0xFFFF)) && length >= 1) {
+                buffer[0] = unicode;
+                count = 1;
+            } else if (unicode >= 0x10000 && length >= 2) {
+                unsigned int code = (unicode - 0x10000);
+                buffer[0] = 0xD800 | (code >> 10);
+                buffer[1] = 0xDC00 | (code & 0x3FF);
+                count = 2;
+            }
+        }
+    }
+
+    return count;
+}
+#endif
+
+// The lowest evdev code wins if a scancode is produced more than once.
+void load_input_helper() {
+    memset(keycode_table, 0x00, sizeof(keycode_table));
+
+    for (unsigned int keycode = EVDEV_KEYCODE_OFFSET; keycode < SCANCODE_TABLE_SIZE; keycode++) {
+        uint16_t scancode = evdev_scancode_table[keycode];
+        if (scancode != VC_UNDEFINED && keycode_table[scancode] == 0) {
+            keycode_table[scancode] = (uint16_t) (keycode - EVDEV_KEYCODE_OFFSET);
+        }
+    }
+}
+
+void unload_input_helper() {
+    memset(keycode_table, 0x00, sizeof(keycode_table));
+}
@@ -0,0 +1,60 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _included_input_helper
+#define _included_input_helper
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef USE_XKB_COMMON
+#include <xkbcommon/xkbcommon.h>
+#endif
+
+/* Converts a Linux input event key code to the appropriate keyboard scan code.
+ */
+extern uint16_t keycode_to_scancode(uint16_t code);
+
+/* Converts a keyboard scan code to the appropriate Linux input event key code.
+ */
+extern uint16_t scancode_to_keycode(uint16_t scancode);
+
+/* Converts a Linux input event key code to the appropriate keyboard scan code.
+ * This is the same lookup as keycode_to_scancode() under the name the evdev
+ * hook uses with the X11 input helper.
+ */
+extern uint16_t evdev_code_to_scancode(uint16_t code);
+
+#ifdef USE_XKB_COMMON
+/* Converts a xkbcommon key code to a Unicode character sequence.  libXKBCommon
+ * support is required for this method.
+ */
+extern size_t keycode_to_unicode(struct xkb_state* state, xkb_keycode_t keycode, uint16_t *buffer, size_t size);
+#endif
+
+/* Build the scancode to key code lookup from the evdev scancode table.  This
+ * method is called by on_library_load().
+ */
+extern void load_input_helper();
+
+/* De-initialize the scancode to key code lookup.  This method is called by
+ * on_library_unload().
+ */
+extern void unload_input_helper();
+
+#endif
@@ -0,0 +1,342 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <uiohook.h>
+#include <unistd.h>
+
+#include "input_helper.h"
+#include "logger.h"
+
+// Virtual device created to post events without an X server.
+#define UINPUT_DEVICE_PATH          "/dev/uinput"
+#define UINPUT_DEVICE_NAME          "libuiohook virtual input"
+
+// Most input events written for a single uiohook event, including the report.
+#define UINPUT_EVENT_SIZE           4
+
+struct _post_context {
+    int fd;
+};
+
+// The device used by hook_post_events() is created on first use.
+// NOTE Events written before the compositor opens a new device are not seen,
+// callers that need the first events delivered should post them after a delay.
+static pthread_mutex_t uinput_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int uinput_fd = -1;
+
+// Report absolute motion over the bounds of every screen, the same way a
+// virtual machine tablet does, so the compositor places the pointer.
+static void setup_abs_axis(int fd, uint16_t code, int32_t minimum, int32_t maximum) {
+    struct uinput_abs_setup abs_setup = {
+        .code = code,
+        .absinfo = {
+            .minimum = minimum,
+            .maximum = maximum
+        }
+    };
+
+    if (ioctl(fd, UI_ABS_SETUP, &abs_setup) < 0) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: UI_ABS_SETUP failure for axis %#X! (%i)\n",
+                __FUNCTION__, __LINE__, code, errno);
+    }
+}
+
+static int create_uinput_device() {
+    int fd = open(UINPUT_DEVICE_PATH, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to open %s! (%i)\n",
+                __FUNCTION__, __LINE__, UINPUT_DEVICE_PATH, errno);
+        return -1;
+    }
+
+    ioctl(fd, UI_SET_EVBIT, EV_SYN);
+
+    // Only keys and mouse buttons, any tool or touch key would turn the device
+    // into a tablet or touchscreen.
+    ioctl(fd, UI_SET_EVBIT, EV_KEY);
+    for (int code = KEY_ESC; code < BTN_MISC; code++) {
+        ioctl(fd, UI_SET_KEYBIT, code);
+    }
+
+    for (int code = BTN_LEFT; code <= BTN_TASK; code++) {
+        ioctl(fd, UI_SET_KEYBIT, code);
+    }
+
+    ioctl(fd, UI_SET_EVBIT, EV_REL);
+    ioctl(fd, UI_SET_RELBIT, REL_WHEEL);
+    ioctl(fd, UI_SET_RELBIT, REL_HWHEEL);
+
+    int32_t min_x = 0, min_y = 0, max_x = INT16_MAX, max_y = INT16_MAX;
+
+    unsigned char count = 0;
+    screen_data *screens = hook_create_screen_info(&count);
+    if (screens != NULL) {
+        if (count > 0) {
+            min_x = INT16_MAX, min_y = INT16_MAX, max_x = INT16_MIN, max_y = INT16_MIN;
+            for (unsigned char i = 0; i < count; i++) {
+                if (screens[i].x < min_x) { min_x = screens[i].x; }
+                if (screens[i].y < min_y) { min_y = screens[i].y; }
+                if (screens[i].x + screens[i].width - 1 > max_x) { max_x = screens[i].x + screens[i].width - 1; }
+                if (screens[i].y + screens[i].height - 1 > max_y) { max_y = screens[i].y + screens[i].height - 1; }
+            }
+        }
+
+        free(screens);
+    }
+
+    ioctl(fd, UI_SET_EVBIT, EV_ABS);
+    ioctl(fd, UI_SET_ABSBIT, ABS_X);
+    ioctl(fd, UI_SET_ABSBIT, ABS_Y);
+    setup_abs_axis(fd, ABS_X, min_x, max_x);
+    setup_abs_axis(fd, ABS_Y, min_y, max_y);
+
+    struct uinput_setup setup = {
+        .id = {
+            .bustype = BUS_VIRTUAL
+        }
+    };
+    snprintf(setup.name, UINPUT_MAX_NAME_SIZE, "%s", UINPUT_DEVICE_NAME);
+
+    if (ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create the uinput device! (%i)\n",
+                __FUNCTION__, __LINE__, errno);
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void destroy_uinput_device(int fd) {
+    if (fd >= 0) {
+        ioctl(fd, UI_DEV_DESTROY);
+        close(fd);
+    }
+}
+
+static inline void set_input_event(struct input_event *ev, uint16_t type, uint16_t code, int32_t value) {
+    memset(ev, 0, sizeof(struct input_event));
+    ev->type = type;
+    ev->code = code;
+    ev->value = value;
+}
+
+static int post_key_event(uiohook_event * const event, struct input_event *events, size_t *count) {
+    uint16_t code = scancode_to_keycode(event->data.keyboard.keycode);
+    if (code == 0x0000) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Unable to lookup scancode: %li\n",
+                __FUNCTION__, __LINE__, event->data.keyboard.keycode);
+        return UIOHOOK_FAILURE;
+    }
+
+    set_input_event(&events[(*count)++], EV_KEY, code, event->type == EVENT_KEY_PRESSED ? 1 : 0);
+
+    return UIOHOOK_SUCCESS;
+}
+
+static int post_mouse_button_event(uiohook_event * const event, struct input_event *events, size_t *count) {
+    uint16_t code;
+    switch (event->data.mouse.button) {
+        case MOUSE_BUTTON1:
+            code = BTN_LEFT;
+            break;
+
+        case MOUSE_BUTTON2:
+            code = BTN_RIGHT;
+            break;
+
+        case MOUSE_BUTTON3:
+            code = BTN_MIDDLE;
+            break;
+
+        case MOUSE_BUTTON4:
+            code = BTN_SIDE;
+            break;
+
+        case MOUSE_BUTTON5:
+            code = BTN_EXTRA;
+            break;
+
+        default:
+            logger(LOG_LEVEL_WARN, "%s [%u]: Invalid button specified for mouse button event! (%u)\n",
+                    __FUNCTION__, __LINE__, event->data.mouse.button);
+            return UIOHOOK_FAILURE;
+    }
+
+    // Move the pointer to the specified position.
+    set_input_event(&events[(*count)++], EV_ABS, ABS_X, event->data.mouse.x);
+    set_input_event(&events[(*count)++], EV_ABS, ABS_Y, event->data.mouse.y);
+    set_input_event(&events[(*count)++], EV_KEY, code, event->type == EVENT_MOUSE_PRESSED ? 1 : 0);
+
+    return UIOHOOK_SUCCESS;
+}
+
+static int post_mouse_wheel_event(uiohook_event * const event, struct input_event *events, size_t *count) {
+    // Positive REL_WHEEL is up and away, positive REL_HWHEEL is to the right.
+    if (event->data.wheel.direction == WHEEL_HORIZONTAL_DIRECTION) {
+        set_input_event(&events[(*count)++], EV_REL, REL_HWHEEL, event->data.wheel.rotation);
+    } else {
+        set_input_event(&events[(*count)++], EV_REL, REL_WHEEL, -event->data.wheel.rotation);
+    }
+
+    return UIOHOOK_SUCCESS;
+}
+
+static int post_mouse_motion_event(uiohook_event * const event, struct input_event *events, size_t *count) {
+    set_input_event(&events[(*count)++], EV_ABS, ABS_X, event->data.mouse.x);
+    set_input_event(&events[(*count)++], EV_ABS, ABS_Y, event->data.mouse.y);
+
+    return UIOHOOK_SUCCESS;
+}
+
+// Write the input events for a single uiohook event followed by its report.
+static int post_event(int fd, uiohook_event * const event) {
+    struct input_event events[UINPUT_EVENT_SIZE];
+    size_t count = 0;
+
+    int status = UIOHOOK_FAILURE;
+    switch (event->type) {
+        case EVENT_KEY_PRESSED:
+        case EVENT_KEY_RELEASED:
+            status = post_key_event(event, events, &count);
+            break;
+
+        case EVENT_MOUSE_PRESSED:
+        case EVENT_MOUSE_RELEASED:
+            status = post_mouse_button_event(event, events, &count);
+            break;
+
+        case EVENT_MOUSE_WHEEL:
+            status = post_mouse_wheel_event(event, events, &count);
+            break;
+
+        case EVENT_MOUSE_MOVED:
+        case EVENT_MOUSE_DRAGGED:
+            status = post_mouse_motion_event(event, events, &count);
+            break;
+
+        case EVENT_KEY_TYPED:
+        case EVENT_MOUSE_CLICKED:
+
+        case EVENT_HOOK_ENABLED:
+        case EVENT_HOOK_DISABLED:
+
+        default:
+            logger(LOG_LEVEL_WARN, "%s [%u]: Ignoring post event type %#X\n",
+                    __FUNCTION__, __LINE__, event->type);
+            status = UIOHOOK_FAILURE;
+    }
+
+    if (status == UIOHOOK_SUCCESS) {
+        set_input_event(&events[count++], EV_SYN, SYN_REPORT, 0);
+
+        ssize_t size = sizeof(struct input_event) * count;
+        if (write(fd, events, size) != size) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to write to the uinput device! (%i)\n",
+                    __FUNCTION__, __LINE__, errno);
+            status = UIOHOOK_FAILURE;
+        }
+    }
+
+    return status;
+}
+
+// Post the events in order up to the first failure.
+static int post_events(int fd, uiohook_event * const events, size_t count) {
+    int status = UIOHOOK_SUCCESS;
+    for (size_t i = 0; i < count && status == UIOHOOK_SUCCESS; i++) {
+        status = post_event(fd, &events[i]);
+    }
+
+    return status;
+}
+
+UIOHOOK_API int hook_post_event(uiohook_event * const event) {
+    return hook_post_events(event, 1);
+}
+
+UIOHOOK_API int hook_post_events(uiohook_event * const events, size_t count) {
+    pthread_mutex_lock(&uinput_mutex);
+
+    if (uinput_fd < 0) {
+        uinput_fd = create_uinput_device();
+    }
+
+    int status = UIOHOOK_ERROR_OPEN_DEVICE;
+    if (uinput_fd >= 0) {
+        status = post_events(uinput_fd, events, count);
+    }
+
+    pthread_mutex_unlock(&uinput_mutex);
+
+    return status;
+}
+
+UIOHOOK_API post_context * hook_post_context_create() {
+    post_context *context = malloc(sizeof(post_context));
+    if (context == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for post context!\n",
+                __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    // A dedicated device keeps posting from contending with the shared device lock.
+    context->fd = create_uinput_device();
+    if (context->fd < 0) {
+        free(context);
+        return NULL;
+    }
+
+    return context;
+}
+
+UIOHOOK_API void hook_post_context_destroy(post_context *context) {
+    if (context != NULL) {
+        destroy_uinput_device(context->fd);
+        free(context);
+    }
+}
+
+UIOHOOK_API int hook_post_context_events(post_context *context, uiohook_event * const events, size_t count) {
+    if (context == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Invalid post context!\n",
+                __FUNCTION__, __LINE__);
+        return UIOHOOK_FAILURE;
+    }
+
+    return post_events(context->fd, events, count);
+}
+
+// Remove the shared device when the library unloads.
+__attribute__ ((destructor))
+static void on_post_event_unload() {
+    pthread_mutex_lock(&uinput_mutex);
+    destroy_uinput_device(uinput_fd);
+    uinput_fd = -1;
+    pthread_mutex_unlock(&uinput_mutex);
+}
@@ -0,0 +1,241 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/input.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <uiohook.h>
+#include <unistd.h>
+
+#ifdef USE_DRM
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#endif
+
+#include "input_helper.h"
+#include "logger.h"
+#include "property_cache.h"
+#include "screen_cache.h"
+
+// Directory containing the kernel event devices.
+#define EVDEV_INPUT_DIR             "/dev/input"
+#define EVDEV_DEVICE_PREFIX         "event"
+
+// Directory containing the DRM devices and the most cards that are checked.
+#define DRM_CARD_PATH               "/dev/dri/card%d"
+#define DRM_CARD_MAX                8
+
+#define test_bit(bit, array)        ((array)[(bit) / (sizeof(unsigned long) * 8)] & (1UL << ((bit) % (sizeof(unsigned long) * 8))))
+#define bits_size(max)              ((max) / (sizeof(unsigned long) * 8) + 1)
+
+// NOTE Without an X server nothing announces screen or setting changes, so the
+// screen and property caches stay untracked and every request queries again.
+
+#ifdef USE_DRM
+// Append every active CRTC of the card to screens, reading the mode state does
+// not require DRM master.
+static screen_data * query_drm_screens(int fd, screen_data *screens, unsigned char *count) {
+    drmModeRes *resources = drmModeGetResources(fd);
+    if (resources == NULL) {
+        return screens;
+    }
+
+    for (int i = 0; i < resources->count_crtcs && *count < UINT8_MAX; i++) {
+        drmModeCrtc *crtc = drmModeGetCrtc(fd, resources->crtcs[i]);
+
+        if (crtc != NULL) {
+            if (crtc->mode_valid && crtc->width > 0 && crtc->height > 0) {
+                screen_data *resized = realloc(screens, sizeof(screen_data) * (*count + 1));
+
+                if (resized != NULL) {
+                    screens = resized;
+                    screens[*count] = (screen_data) {
+                        .number = *count + 1,
+                        .x = crtc->x,
+                        .y = crtc->y,
+                        .width = crtc->width,
+                        .height = crtc->height
+                    };
+                    (*count)++;
+                } else {
+                    logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for screen info!\n",
+                            __FUNCTION__, __LINE__);
+                }
+            }
+
+            drmModeFreeCrtc(crtc);
+        } else {
+            logger(LOG_LEVEL_WARN, "%s [%u]: DRM failed to return crtc information! (%#X)\n",
+                    __FUNCTION__, __LINE__, resources->crtcs[i]);
+        }
+    }
+
+    drmModeFreeResources(resources);
+
+    return screens;
+}
+#endif
+
+screen_data* query_screen_info(unsigned char *count) {
+    *count = 0;
+    screen_data *screens = NULL;
+
+    #ifdef USE_DRM
+    for (int card = 0; card < DRM_CARD_MAX; card++) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), DRM_CARD_PATH, card);
+
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            screens = query_drm_screens(fd, screens, count);
+            close(fd);
+        }
+    }
+
+    if (*count == 0) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: No active DRM crtc found!\n",
+                __FUNCTION__, __LINE__);
+    }
+    #else
+    // The evdev hook falls back to the full 16 bit coordinate space.
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Screen information is unavailable without DRM.\n",
+            __FUNCTION__, __LINE__);
+    #endif
+
+    return screens;
+}
+
+// Read the kernel auto repeat settings of the first keyboard that repeats, the
+// values are in milliseconds the same as XkbGetAutoRepeatRate().
+static bool query_evdev_repeat(unsigned int *delay, unsigned int *period) {
+    bool successful = false;
+
+    DIR *dir = opendir(EVDEV_INPUT_DIR);
+    if (dir == NULL) {
+        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to open %s! (%i)\n",
+                __FUNCTION__, __LINE__, EVDEV_INPUT_DIR, errno);
+        return false;
+    }
+
+    struct dirent *entry;
+    while (!successful && (entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, EVDEV_DEVICE_PREFIX, strlen(EVDEV_DEVICE_PREFIX)) != 0) {
+            continue;
+        }
+
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", EVDEV_INPUT_DIR, entry->d_name);
+
+        int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+
+        unsigned long ev_bits[bits_size(EV_MAX)];
+        memset(ev_bits, 0, sizeof(ev_bits));
+
+        unsigned int rep[REP_CNT];
+        if (ioctl(fd, EVIOCGBIT(0, sizeof(ev_bits)), ev_bits) >= 0 && test_bit(EV_REP, ev_bits)
+                && test_bit(EV_KEY, ev_bits) && ioctl(fd, EVIOCGREP, rep) >= 0) {
+            *delay = rep[REP_DELAY];
+            *period = rep[REP_PERIOD];
+            successful = true;
+
+            logger(LOG_LEVEL_DEBUG, "%s [%u]: EVIOCGREP %s: %u, %u.\n",
+                    __FUNCTION__, __LINE__, path, *delay, *period);
+        }
+
+        close(fd);
+    }
+
+    closedir(dir);
+
+    return successful;
+}
+
+static long int query_auto_repeat_rate() {
+    long int value = -1;
+    unsigned int delay = 0, rate = 0;
+
+    if (query_evdev_repeat(&delay, &rate)) {
+        value = (long int) rate;
+    }
+
+    return value;
+}
+
+static long int query_auto_repeat_delay() {
+    long int value = -1;
+    unsigned int delay = 0, rate = 0;
+
+    if (query_evdev_repeat(&delay, &rate)) {
+        value = (long int) delay;
+    }
+
+    return value;
+}
+
+UIOHOOK_API long int hook_get_auto_repeat_rate() {
+    return get_cached_property(PROPERTY_AUTO_REPEAT_RATE, query_auto_repeat_rate);
+}
+
+UIOHOOK_API long int hook_get_auto_repeat_delay() {
+    return get_cached_property(PROPERTY_AUTO_REPEAT_DELAY, query_auto_repeat_delay);
+}
+
+// The kernel does not accelerate relative motion and the evdev hook integrates
+// it the same way, so report an unaccelerated pointer the way XGetPointerControl()
+// would for acceleration 1/1 with no threshold.
+UIOHOOK_API long int hook_get_pointer_acceleration_multiplier() {
+    return 1;
+}
+
+UIOHOOK_API long int hook_get_pointer_acceleration_threshold() {
+    return 0;
+}
+
+UIOHOOK_API long int hook_get_pointer_sensitivity() {
+    return 1;
+}
+
+// The multi-click time is a setting of the display server, use the same
+// default as the X11 properties when no X default is found.
+UIOHOOK_API long int hook_get_multi_click_time() {
+    return 200;
+}
+
+// Create a shared object constructor.
+__attribute__ ((constructor))
+void on_library_load() {
+    // Events can be posted before the first hook starts.
+    load_input_helper();
+}
+
+// Create a shared object destructor.
+__attribute__ ((destructor))
+void on_library_unload() {
+    // Cleanup.
+    unload_input_helper();
+}
@@ -26,13 +26,26 @@
 
 static logger_t callback = NULL;
 static void *callback_data = NULL;
+static unsigned int callback_level = LOG_LEVEL_DEBUG;
 
-void logger(unsigned int level, const char *format, ...) {
+// Nothing passes the gate until a callback is set.
+volatile unsigned int log_level_gate = LOG_LEVEL_ERROR + 1;
+
+static void update_log_level_gate() {
     if (callback != NULL) {
+        log_level_gate = callback_level;
+    } else {
+        log_level_gate = LOG_LEVEL_ERROR + 1;
+    }
+}
+
+void log_message(unsigned int level, const char *format, ...) {
+    logger_t proc = callback;
+    if (proc != NULL) {
         va_list args;
 
         va_start(args, format);
-        callback(level, callback_data, format, args);
+        proc(level, callback_data, format, args);
         va_end(args);
     }
 }
@@ -40,4 +53,10 @@ void logger(unsigned int level, const char *format, ...) {
 UIOHOOK_API void hook_set_logger_proc(logger_t logger_proc, void *user_data) {
     callback = logger_proc;
     callback_data = user_data;
+    update_log_level_gate();
+}
+
+UIOHOOK_API void hook_set_log_level(log_level level) {
+    callback_level = level;
+    update_log_level_gate();
 }
@@ -26,6 +26,24 @@
 #define __FUNCTION__ __func__
 #endif
 
-extern void logger(unsigned int level, const char *format, ...);
+// Lowest level compiled into the library, configured with UIOHOOK_LOG_LEVEL.
+#ifndef UIOHOOK_MIN_LOG_LEVEL
+#define UIOHOOK_MIN_LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+
+// Lowest level currently delivered, above LOG_LEVEL_ERROR when no callback is set.
+extern volatile unsigned int log_level_gate;
+
+extern void log_message(unsigned int level, const char *format, ...);
+
+/* Both checks happen before any argument is evaluated.  Call sites below the
+ * compile-time threshold fold away entirely, and the runtime gate costs a
+ * single load and compare when the level is filtered. */
+#define logger(level, ...) \
+    do { \
+        if ((level) >= UIOHOOK_MIN_LOG_LEVEL && (level) >= log_level_gate) { \
+            log_message((level), __VA_ARGS__); \
+        } \
+    } while (0)
 
 #endif
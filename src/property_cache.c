@@ -0,0 +1,75 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdbool.h>
+#include <uiohook.h>
+
+#include "atomic_helper.h"
+#include "logger.h"
+#include "property_cache.h"
+
+typedef struct _property_entry {
+    volatile long int value;
+    volatile uint32_t generation;
+} property_entry;
+
+// Generation zero is never current, so every entry starts out invalid.
+static property_entry property_cache[PROPERTY_COUNT];
+static volatile uint32_t property_generation = 1;
+static volatile bool property_tracking = false;
+
+long int get_cached_property(property_id id, property_query_t query) {
+    property_entry *entry = &property_cache[id];
+
+    uint32_t generation = atomic_load_acquire(&property_generation);
+    if (atomic_load_acquire(&entry->generation) == generation && atomic_load_acquire(&property_tracking)) {
+        return entry->value;
+    }
+
+    // The generation was sampled before the query so that an invalidation
+    // arriving while we wait on the native call is not lost.
+    long int value = query();
+    if (value >= 0) {
+        entry->value = value;
+        atomic_store_release(&entry->generation, generation);
+    }
+
+    return value;
+}
+
+void invalidate_property_cache() {
+    uint32_t generation = atomic_load_acquire(&property_generation) + 1;
+    if (generation == 0) {
+        generation = 1;
+    }
+
+    // NOTE Concurrent invalidations may collapse into a single increment,
+    // which is harmless because either one discards the cached values.
+    atomic_store_release(&property_generation, generation);
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: System property cache invalidated.\n",
+            __FUNCTION__, __LINE__);
+}
+
+void track_property_changes(bool enabled) {
+    atomic_store_release(&property_tracking, enabled);
+
+    // Changes may have been missed while nothing was listening.
+    invalidate_property_cache();
+}
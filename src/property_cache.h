@@ -0,0 +1,50 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _included_property_cache
+#define _included_property_cache
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// System properties cached between platform change notifications.
+typedef enum _property_id {
+    PROPERTY_AUTO_REPEAT_RATE,
+    PROPERTY_AUTO_REPEAT_DELAY,
+    PROPERTY_POINTER_ACCELERATION_MULTIPLIER,
+    PROPERTY_POINTER_ACCELERATION_THRESHOLD,
+    PROPERTY_POINTER_SENSITIVITY,
+    PROPERTY_MULTI_CLICK_TIME,
+    PROPERTY_COUNT
+} property_id;
+
+// Native query used to fill a cache entry, negative values are not cached.
+typedef long int (*property_query_t)();
+
+// Return the cached value for the property, calling query on a cache miss.
+extern long int get_cached_property(property_id id, property_query_t query);
+
+// Discard every cached value.  Called when the platform reports a change.
+extern void invalidate_property_cache();
+
+// Declare whether property changes are currently being reported.  While they
+// are not, every request queries the platform to avoid returning stale data.
+extern void track_property_changes(bool enabled);
+
+#endif
@@ -0,0 +1,310 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uiohook.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+#ifdef __APPLE__
+#include <mach/mach_time.h>
+#endif
+#endif
+
+#include "atomic_helper.h"
+#include "event_clock.h"
+#include "logger.h"
+
+#ifdef _WIN32
+// Some versions of MinGW do not define this flag yet.
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#else
+// Longest uninterrupted sleep, bounds how long hook_replay_cancel() may block.
+#define REPLAY_SLEEP_SLICE (10 * NSEC_PER_MSEC)
+#endif
+
+struct _replay_context {
+    uiohook_event *events;
+    size_t count;
+
+    volatile bool cancelled;
+    int status;
+    replay_stats stats;
+
+    #ifdef _WIN32
+    HANDLE thread;
+    HANDLE timer;
+    HANDLE cancel_event;
+    #else
+    pthread_t thread;
+    #endif
+};
+
+#ifdef __APPLE__
+// Converts the monotonic clock back to mach ticks for mach_wait_until().
+static mach_timebase_info_data_t clock_timebase;
+#endif
+
+// Block until the monotonic clock reaches deadline or the replay is cancelled.
+static void replay_sleep_until(replay_context *replay, uint64_t deadline) {
+    uint64_t now = get_monotonic_time();
+
+    #ifdef _WIN32
+    while (now < deadline && !atomic_load_acquire(&replay->cancelled)) {
+        // Relative due time in 100 nanosecond intervals.
+        LARGE_INTEGER due_time;
+        due_time.QuadPart = -(LONGLONG) ((deadline - now) / 100);
+
+        if (due_time.QuadPart == 0 || !SetWaitableTimer(replay->timer, &due_time, 0, NULL, NULL, FALSE)) {
+            break;
+        }
+
+        HANDLE handles[] = { replay->timer, replay->cancel_event };
+        WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+
+        now = get_monotonic_time();
+    }
+    #else
+    while (now < deadline && !atomic_load_acquire(&replay->cancelled)) {
+        uint64_t wake = deadline;
+        if (wake - now > REPLAY_SLEEP_SLICE) {
+            wake = now + REPLAY_SLEEP_SLICE;
+        }
+
+        #ifdef __APPLE__
+        mach_wait_until(wake * clock_timebase.denom / clock_timebase.numer);
+        #else
+        struct timespec ts = {
+            .tv_sec = wake / NSEC_PER_SEC,
+            .tv_nsec = wake % NSEC_PER_SEC
+        };
+
+        // Restart after signals, the deadline is absolute.
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+        #endif
+
+        now = get_monotonic_time();
+    }
+    #endif
+}
+
+#ifdef _WIN32
+static DWORD WINAPI replay_thread_proc(LPVOID arg) {
+#else
+static void *replay_thread_proc(void *arg) {
+#endif
+    replay_context *replay = (replay_context *) arg;
+
+    post_context *context = hook_post_context_create();
+    if (context == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create replay post context!\n",
+                __FUNCTION__, __LINE__);
+
+        replay->stats.failed = replay->count;
+        replay->status = UIOHOOK_FAILURE;
+    } else {
+        uint64_t drift_total = 0;
+
+        // Every deadline is computed from the start so that errors never accumulate.
+        uint64_t start = get_monotonic_time();
+        uint64_t first_time = replay->events[0].time;
+
+        for (size_t i = 0; i < replay->count && !atomic_load_acquire(&replay->cancelled); i++) {
+            uiohook_event *event = &replay->events[i];
+
+            uint64_t offset = 0;
+            if (event->time > first_time) {
+                offset = (event->time - first_time) * NSEC_PER_MSEC;
+            }
+
+            uint64_t deadline = start + offset;
+            replay_sleep_until(replay, deadline);
+            if (atomic_load_acquire(&replay->cancelled)) {
+                break;
+            }
+
+            uint64_t now = get_monotonic_time();
+            uint64_t drift = now > deadline ? now - deadline : 0;
+            drift_total += drift;
+            if (drift > replay->stats.max_drift) {
+                replay->stats.max_drift = drift;
+            }
+
+            int status = hook_post_context_events(context, event, 1);
+            if (status == UIOHOOK_SUCCESS) {
+                replay->stats.posted++;
+            } else {
+                replay->stats.failed++;
+                if (replay->status == UIOHOOK_SUCCESS) {
+                    replay->status = status;
+                }
+            }
+        }
+
+        size_t attempted = replay->stats.posted + replay->stats.failed;
+        if (attempted > 0) {
+            replay->stats.mean_drift = drift_total / attempted;
+        }
+
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Replayed %u events, mean drift %llu ns, max drift %llu ns.\n",
+                __FUNCTION__, __LINE__, (unsigned int) attempted,
+                (unsigned long long) replay->stats.mean_drift, (unsigned long long) replay->stats.max_drift);
+
+        hook_post_context_destroy(context);
+    }
+
+    #ifdef _WIN32
+    return 0;
+    #else
+    return NULL;
+    #endif
+}
+
+static void free_replay_context(replay_context *replay) {
+    #ifdef _WIN32
+    if (replay->timer != NULL) {
+        CloseHandle(replay->timer);
+    }
+
+    if (replay->cancel_event != NULL) {
+        CloseHandle(replay->cancel_event);
+    }
+    #endif
+
+    free(replay->events);
+    free(replay);
+}
+
+UIOHOOK_API replay_context * hook_replay_start(uiohook_event * const events, size_t count) {
+    replay_context *replay = calloc(1, sizeof(replay_context));
+    if (replay == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for replay context!\n",
+                __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    replay->status = UIOHOOK_SUCCESS;
+    replay->count = count;
+
+    // The events are copied so the caller does not need to keep them alive.
+    if (count > 0) {
+        replay->events = malloc(sizeof(uiohook_event) * count);
+        if (replay->events == NULL) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for replay events!\n",
+                    __FUNCTION__, __LINE__);
+            free(replay);
+            return NULL;
+        }
+
+        memcpy(replay->events, events, sizeof(uiohook_event) * count);
+    }
+
+    #ifdef __APPLE__
+    if (clock_timebase.denom == 0) {
+        mach_timebase_info(&clock_timebase);
+    }
+    #endif
+
+    if (count == 0) {
+        // Nothing to schedule, hook_replay_wait() will not join a thread.
+        return replay;
+    }
+
+    #ifdef _WIN32
+    // High resolution timers are only available on Windows 10 1803 and later.
+    replay->timer = CreateWaitableTimerEx(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (replay->timer == NULL) {
+        replay->timer = CreateWaitableTimer(NULL, TRUE, NULL);
+    }
+
+    replay->cancel_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (replay->timer == NULL || replay->cancel_event == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to create replay timer! (%#lX)\n",
+                __FUNCTION__, __LINE__, (unsigned long) GetLastError());
+        free_replay_context(replay);
+        return NULL;
+    }
+
+    replay->thread = CreateThread(NULL, 0, replay_thread_proc, replay, 0, NULL);
+    if (replay->thread == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: CreateThread failure! (%#lX)\n",
+                __FUNCTION__, __LINE__, (unsigned long) GetLastError());
+        free_replay_context(replay);
+        return NULL;
+    }
+    #else
+    if (pthread_create(&replay->thread, NULL, replay_thread_proc, replay) != 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: pthread_create failure!\n",
+                __FUNCTION__, __LINE__);
+        free_replay_context(replay);
+        return NULL;
+    }
+    #endif
+
+    return replay;
+}
+
+UIOHOOK_API void hook_replay_cancel(replay_context *replay) {
+    if (replay != NULL) {
+        atomic_store_release(&replay->cancelled, true);
+
+        #ifdef _WIN32
+        if (replay->cancel_event != NULL) {
+            SetEvent(replay->cancel_event);
+        }
+        #endif
+    }
+}
+
+UIOHOOK_API int hook_replay_wait(replay_context *replay, replay_stats *stats) {
+    if (replay == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Invalid replay context!\n",
+                __FUNCTION__, __LINE__);
+        return UIOHOOK_FAILURE;
+    }
+
+    if (replay->count > 0) {
+        #ifdef _WIN32
+        WaitForSingleObject(replay->thread, INFINITE);
+        CloseHandle(replay->thread);
+        #else
+        pthread_join(replay->thread, NULL);
+        #endif
+    }
+
+    if (stats != NULL) {
+        *stats = replay->stats;
+    }
+
+    int status = replay->status;
+    free_replay_context(replay);
+
+    return status;
+}
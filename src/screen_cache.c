@@ -0,0 +1,284 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <uiohook.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "atomic_helper.h"
+#include "logger.h"
+#include "screen_cache.h"
+
+// Screen bounds sorted by their left edge for hook_screen_at().  The reach is
+// the largest right edge of this span and every span before it, so a lookup can
+// stop walking back as soon as no earlier screen extends past the point.
+typedef struct _screen_span {
+    int32_t left;
+    int32_t top;
+    int32_t right;
+    int32_t bottom;
+    int32_t reach;
+    uint8_t number;
+} screen_span;
+
+// The public snapshot must remain the first member so it can be cast back.
+typedef struct _screen_cache_entry {
+    screen_snapshot snapshot;
+    uint32_t references;
+    uint8_t span_count;
+    screen_span *spans;
+} screen_cache_entry;
+
+// The current snapshot, guarded by snapshot_mutex.  The cache holds one
+// reference until the snapshot is replaced.
+static screen_cache_entry *snapshot_entry = NULL;
+static uint32_t snapshot_generation = 0;
+static uint32_t snapshot_version = 0;
+
+// Generation zero is never current, so the first request builds a snapshot.
+static volatile uint32_t screen_generation = 1;
+static volatile bool screen_tracking = false;
+
+#ifdef _WIN32
+static SRWLOCK snapshot_mutex = SRWLOCK_INIT;
+#else
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+
+static inline void snapshot_lock() {
+    #ifdef _WIN32
+    AcquireSRWLockExclusive(&snapshot_mutex);
+    #else
+    pthread_mutex_lock(&snapshot_mutex);
+    #endif
+}
+
+static inline void snapshot_unlock() {
+    #ifdef _WIN32
+    ReleaseSRWLockExclusive(&snapshot_mutex);
+    #else
+    pthread_mutex_unlock(&snapshot_mutex);
+    #endif
+}
+
+static int compare_spans(const void *a, const void *b) {
+    const screen_span *span_a = (const screen_span *) a;
+    const screen_span *span_b = (const screen_span *) b;
+
+    if (span_a->left != span_b->left) {
+        return span_a->left < span_b->left ? -1 : 1;
+    }
+
+    // Keep the lookup stable for mirrored screens sharing an origin.
+    return (int) span_b->number - (int) span_a->number;
+}
+
+static screen_cache_entry * create_entry() {
+    unsigned char count = 0;
+    screen_data *screens = query_screen_info(&count);
+
+    // A single allocation holds the entry, the screens and the lookup spans.
+    screen_cache_entry *entry = malloc(sizeof(screen_cache_entry)
+            + (sizeof(screen_data) + sizeof(screen_span)) * count);
+    if (entry == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for screen snapshot!\n",
+                __FUNCTION__, __LINE__);
+
+        free(screens);
+        return NULL;
+    }
+
+    screen_span *spans = (screen_span *) (entry + 1);
+    screen_data *data = (screen_data *) (spans + count);
+    if (screens != NULL) {
+        memcpy(data, screens, sizeof(screen_data) * count);
+        free(screens);
+    } else {
+        count = 0;
+    }
+
+    uint8_t span_count = 0;
+    for (uint8_t i = 0; i < count; i++) {
+        // Disabled outputs are reported without a size and never contain a point.
+        if (data[i].width > 0 && data[i].height > 0) {
+            spans[span_count++] = (screen_span) {
+                .left = data[i].x,
+                .top = data[i].y,
+                .right = (int32_t) data[i].x + data[i].width,
+                .bottom = (int32_t) data[i].y + data[i].height,
+                .number = data[i].number
+            };
+        }
+    }
+
+    qsort(spans, span_count, sizeof(screen_span), compare_spans);
+
+    int32_t reach = INT32_MIN;
+    for (uint8_t i = 0; i < span_count; i++) {
+        if (spans[i].right > reach) {
+            reach = spans[i].right;
+        }
+        spans[i].reach = reach;
+    }
+
+    entry->snapshot = (screen_snapshot) {
+        .version = ++snapshot_version,
+        .count = count,
+        .screens = data
+    };
+    entry->references = 1;
+    entry->span_count = span_count;
+    entry->spans = spans;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Created screen snapshot %u with %u screen(s).\n",
+            __FUNCTION__, __LINE__, entry->snapshot.version, count);
+
+    return entry;
+}
+
+// Drop a reference, the caller must hold the snapshot mutex.
+static void release_entry(screen_cache_entry *entry) {
+    if (--entry->references == 0) {
+        free(entry);
+    }
+}
+
+// Return the current snapshot, rebuilding it if it has been invalidated.  The
+// caller must hold the snapshot mutex.
+static screen_cache_entry * current_entry() {
+    // The generation was sampled before the query so that an invalidation
+    // arriving while we wait on the native call is not lost.
+    uint32_t generation = atomic_load_acquire(&screen_generation);
+    if (snapshot_entry != NULL && snapshot_generation == generation && atomic_load_acquire(&screen_tracking)) {
+        return snapshot_entry;
+    }
+
+    screen_cache_entry *entry = create_entry();
+    if (entry != NULL) {
+        if (snapshot_entry != NULL) {
+            release_entry(snapshot_entry);
+        }
+
+        snapshot_entry = entry;
+        snapshot_generation = generation;
+    }
+
+    return snapshot_entry;
+}
+
+void invalidate_screen_cache() {
+    uint32_t generation = atomic_load_acquire(&screen_generation) + 1;
+    if (generation == 0) {
+        generation = 1;
+    }
+
+    // NOTE Concurrent invalidations may collapse into a single increment,
+    // which is harmless because either one discards the snapshot.
+    atomic_store_release(&screen_generation, generation);
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Screen snapshot invalidated.\n",
+            __FUNCTION__, __LINE__);
+}
+
+void track_screen_changes(bool enabled) {
+    atomic_store_release(&screen_tracking, enabled);
+
+    // Changes may have been missed while nothing was listening.
+    invalidate_screen_cache();
+}
+
+UIOHOOK_API const screen_snapshot * hook_acquire_screen_snapshot() {
+    const screen_snapshot *snapshot = NULL;
+
+    snapshot_lock();
+    screen_cache_entry *entry = current_entry();
+    if (entry != NULL) {
+        entry->references++;
+        snapshot = &entry->snapshot;
+    }
+    snapshot_unlock();
+
+    return snapshot;
+}
+
+UIOHOOK_API void hook_release_screen_snapshot(const screen_snapshot *snapshot) {
+    if (snapshot != NULL) {
+        snapshot_lock();
+        release_entry((screen_cache_entry *) snapshot);
+        snapshot_unlock();
+    }
+}
+
+UIOHOOK_API uint8_t hook_screen_at(int16_t x, int16_t y) {
+    uint8_t number = 0;
+
+    snapshot_lock();
+    screen_cache_entry *entry = current_entry();
+    if (entry != NULL && entry->span_count > 0) {
+        // Find the last span starting at or before x.
+        size_t low = 0, high = entry->span_count;
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            if (entry->spans[mid].left <= x) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+
+        // Walk back while an earlier span could still reach past x.
+        for (size_t i = low; i > 0 && entry->spans[i - 1].reach > x; i--) {
+            screen_span *span = &entry->spans[i - 1];
+            if (x < span->right && y >= span->top && y < span->bottom) {
+                number = span->number;
+                break;
+            }
+        }
+    }
+    snapshot_unlock();
+
+    return number;
+}
+
+UIOHOOK_API screen_data* hook_create_screen_info(unsigned char *count) {
+    screen_data *screens = NULL;
+    *count = 0;
+
+    snapshot_lock();
+    screen_cache_entry *entry = current_entry();
+    if (entry != NULL && entry->snapshot.count > 0) {
+        // Callers own and free the returned copy.
+        screens = malloc(sizeof(screen_data) * entry->snapshot.count);
+        if (screens != NULL) {
+            memcpy(screens, entry->snapshot.screens, sizeof(screen_data) * entry->snapshot.count);
+            *count = entry->snapshot.count;
+        }
+    }
+    snapshot_unlock();
+
+    return screens;
+}
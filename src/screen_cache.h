@@ -0,0 +1,37 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _included_screen_cache
+#define _included_screen_cache
+
+#include <stdbool.h>
+#include <uiohook.h>
+
+// Native query used to build a snapshot, implemented by each platform's
+// system_properties.c.  Returns a malloc'd array the same as the old
+// hook_create_screen_info().
+extern screen_data* query_screen_info(unsigned char *count);
+
+// Discard the current snapshot.  Called when the platform reports a change.
+extern void invalidate_screen_cache();
+
+// Declare whether screen changes are currently being reported.  While they
+// are not, every request rebuilds the snapshot to avoid returning stale data.
+extern void track_screen_changes(bool enabled);
+
+#endif
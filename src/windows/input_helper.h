@@ -45,6 +45,7 @@
 #define _included_input_helper
 
 #include <limits.h>
+#include <stdbool.h>
 #include <windows.h>
 
 #ifndef LPFN_ISWOW64PROCESS
@@ -126,7 +127,11 @@ typedef struct tagKbdLayer {
 } KBDTABLES, *PKBDTABLES;               // __ptr64
 
 
-extern SIZE_T keycode_to_unicode(DWORD keycode, PWCHAR buffer, SIZE_T size);
+// Translate a virtual key with the given modifier mask and caps lock toggle state using the active locale.
+extern SIZE_T keycode_to_unicode(DWORD keycode, unsigned short int modifiers, bool is_caps_locked, PWCHAR buffer, SIZE_T size);
+
+// Flag the active locale for lookup after a focus or layout change.
+extern void invalidate_keyboard_locale();
 
 //extern DWORD unicode_to_keycode(wchar_t unicode);
 
@@ -20,14 +20,22 @@
 #include <uiohook.h>
 #include <windows.h>
 
+#include "dispatch_event.h"
+#include "event_clock.h"
+#include "hook_context.h"
+#include "hook_stats.h"
 #include "input_helper.h"
+#include "key_state.h"
 #include "logger.h"
 #include "monitor_helper.h"
+#include "property_cache.h"
+#include "screen_cache.h"
 
 // Thread and hook handles.
 static DWORD hook_thread_id = 0;
 static HHOOK keyboard_event_hhook = NULL, mouse_event_hhook = NULL;
 static HWINEVENTHOOK win_event_hhook = NULL;
+static HWINEVENTHOOK win_foreground_hhook = NULL;
 static HWND invisible_win_hwnd = NULL;
 
 // The handle to the DLL module pulled in DllMain on DLL_PROCESS_ATTACH.
@@ -36,6 +44,9 @@ extern HINSTANCE hInst;
 // Modifiers for tracking key masks.
 static unsigned short int current_modifiers = 0x0000;
 
+// Toggle state of caps lock, the mask above only records the key being held.
+static bool is_caps_locked = false;
+
 #ifdef USE_EPOCH_TIME
 // Structure for the current Unix epoch in milliseconds.
 static FILETIME system_time;
@@ -50,32 +61,6 @@ static POINT last_click;
 // Static event memory.
 static uiohook_event event;
 
-// Event dispatch callback.
-static dispatcher_t dispatch = NULL;
-static void *dispatch_data = NULL;
-
-UIOHOOK_API void hook_set_dispatch_proc(dispatcher_t dispatch_proc, void *user_data) {
-    logger(LOG_LEVEL_DEBUG, "%s [%u]: Setting new dispatch callback to %#p.\n",
-            __FUNCTION__, __LINE__, dispatch_proc);
-
-    dispatch = dispatch_proc;
-    dispatch_data = user_data;
-}
-
-// Send out an event if a dispatcher was set.
-static void dispatch_event(uiohook_event *const event) {
-    if (dispatch != NULL) {
-        logger(LOG_LEVEL_DEBUG, "%s [%u]: Dispatching event type %u.\n",
-                __FUNCTION__, __LINE__, event->type);
-
-        dispatch(event, dispatch_data);
-    } else {
-        logger(LOG_LEVEL_WARN, "%s [%u]: No dispatch callback set!\n",
-                __FUNCTION__, __LINE__);
-    }
-}
-
-
 // Set the native modifier mask for future events.
 static inline void set_modifier_mask(unsigned short int mask) {
     current_modifiers |= mask;
@@ -114,6 +99,11 @@ static void initialize_modifiers() {
     if (GetKeyState(VK_NUMLOCK)  < 0) { set_modifier_mask(MASK_NUM_LOCK);    }
     if (GetKeyState(VK_CAPITAL)  < 0) { set_modifier_mask(MASK_CAPS_LOCK);   }
     if (GetKeyState(VK_SCROLL)   < 0) { set_modifier_mask(MASK_SCROLL_LOCK); }
+
+    // NOTE The low order bit is the toggle state of the lock key.
+    is_caps_locked = (GetKeyState(VK_CAPITAL) & 0x01) != 0;
+
+    reset_key_state(get_modifiers());
 }
 
 
@@ -167,13 +157,62 @@ static inline uint64_t get_unix_timestamp() {
 }
 #endif
 
+UIOHOOK_API uint64_t hook_capture_time_to_event_time(uint64_t capture_time) {
+    #ifdef USE_EPOCH_TIME
+    return (uint64_t) ((int64_t) capture_time + get_realtime_offset()) / NSEC_PER_MSEC;
+    #else
+    // The event time is GetTickCount() in milliseconds, count back from now.
+    DWORD elapsed = (DWORD) ((get_monotonic_time() - capture_time) / NSEC_PER_MSEC);
+
+    return (uint64_t) (DWORD) (GetTickCount() - elapsed);
+    #endif
+}
+
+#ifdef USE_RAW_INPUT_HOOK
+// Register or remove the raw input devices for the subscribed event classes.
+static bool set_raw_input_devices(DWORD flags, HWND target) {
+    RAWINPUTDEVICE devices[2];
+    UINT count = 0;
+
+    // Mouse events carry the modifier mask, which only keyboard input can track.
+    uint32_t event_mask = get_event_mask();
+    if (event_mask & (EVENT_MASK_KEYBOARD | EVENT_MASK_MOUSE)) {
+        devices[count].usUsagePage = 0x01; // HID_USAGE_PAGE_GENERIC
+        devices[count].usUsage = 0x06;     // HID_USAGE_GENERIC_KEYBOARD
+        devices[count].dwFlags = flags;
+        devices[count].hwndTarget = target;
+        count++;
+    }
+
+    if (event_mask & EVENT_MASK_MOUSE) {
+        devices[count].usUsagePage = 0x01; // HID_USAGE_PAGE_GENERIC
+        devices[count].usUsage = 0x02;     // HID_USAGE_GENERIC_MOUSE
+        devices[count].dwFlags = flags;
+        devices[count].hwndTarget = target;
+        count++;
+    }
+
+    return count == 0 || RegisterRawInputDevices(devices, count, sizeof(RAWINPUTDEVICE));
+}
+#endif
+
 void unregister_running_hooks() {
+    #ifdef USE_RAW_INPUT_HOOK
+    // Stop the raw input delivery to the invisible window.
+    set_raw_input_devices(RIDEV_REMOVE, NULL);
+    #endif
+
     // Stop the event hook and any timer still running.
     if (win_event_hhook != NULL) {
         UnhookWinEvent(win_event_hhook);
         win_event_hhook = NULL;
     }
 
+    if (win_foreground_hhook != NULL) {
+        UnhookWinEvent(win_foreground_hhook);
+        win_foreground_hhook = NULL;
+    }
+
     // Destroy the native hooks.
     if (keyboard_event_hhook != NULL) {
         UnhookWindowsHookEx(keyboard_event_hhook);
@@ -199,6 +238,7 @@ void hook_start_proc() {
 
     // Populate the hook start event.
     event.time = timestamp;
+    event.capture_time = get_monotonic_time();
     event.reserved = 0x00;
 
     event.type = EVENT_HOOK_ENABLED;
@@ -218,6 +258,7 @@ void hook_stop_proc() {
 
     // Populate the hook stop event.
     event.time = timestamp;
+    event.capture_time = get_monotonic_time();
     event.reserved = 0x00;
 
     event.type = EVENT_HOOK_DISABLED;
@@ -237,6 +278,9 @@ static void process_key_pressed(KBDLLHOOKSTRUCT *kbhook) {
     uint64_t timestamp = kbhook->time;
     #endif
 
+    // Auto repeat presses of a held caps lock key do not toggle the lock.
+    bool is_caps_toggled = kbhook->vkCode == VK_CAPITAL && !(get_modifiers() & MASK_CAPS_LOCK);
+
     // Check and setup modifiers.
     if      (kbhook->vkCode == VK_LSHIFT)   { set_modifier_mask(MASK_SHIFT_L);     }
     else if (kbhook->vkCode == VK_RSHIFT)   { set_modifier_mask(MASK_SHIFT_R);     }
@@ -269,11 +313,16 @@ static void process_key_pressed(KBDLLHOOKSTRUCT *kbhook) {
 
     // If the pressed event was not consumed...
     if (event.reserved ^ 0x01) {
+        // Windows only toggles the lock for a press that reaches the system.
+        if (is_caps_toggled) {
+            is_caps_locked = !is_caps_locked;
+        }
+
         // Buffer for unicode typed chars. No more than 2 needed.
         WCHAR buffer[2]; // = { WCH_NONE };
 
         // If the pressed event was not consumed and a unicode char exists...
-        SIZE_T count = keycode_to_unicode(kbhook->vkCode, buffer, sizeof(buffer));
+        SIZE_T count = keycode_to_unicode(kbhook->vkCode, get_modifiers(), is_caps_locked, buffer, sizeof(buffer) / sizeof(buffer[0]));
         for (unsigned int i = 0; i < count; i++) {
             // Populate key typed event.
             event.time = timestamp;
@@ -315,6 +364,20 @@ static void process_key_released(KBDLLHOOKSTRUCT *kbhook) {
     else if (kbhook->vkCode == VK_CAPITAL)  { unset_modifier_mask(MASK_CAPS_LOCK);   }
     else if (kbhook->vkCode == VK_SCROLL)   { unset_modifier_mask(MASK_SCROLL_LOCK); }
 
+    // Layout switching hotkeys complete on a modifier release.
+    switch (kbhook->vkCode) {
+        case VK_LSHIFT:
+        case VK_RSHIFT:
+        case VK_LCONTROL:
+        case VK_RCONTROL:
+        case VK_LMENU:
+        case VK_RMENU:
+        case VK_LWIN:
+        case VK_RWIN:
+            invalidate_keyboard_locale();
+            break;
+    }
+
     // Populate key pressed event.
     event.time = timestamp;
     event.reserved = 0x00;
@@ -333,8 +396,7 @@ static void process_key_released(KBDLLHOOKSTRUCT *kbhook) {
     dispatch_event(&event);
 }
 
-LRESULT CALLBACK keyboard_hook_event_proc(int nCode, WPARAM wParam, LPARAM lParam) {
-    KBDLLHOOKSTRUCT *kbhook = (KBDLLHOOKSTRUCT *) lParam;
+static void process_keyboard_message(WPARAM wParam, KBDLLHOOKSTRUCT *kbhook) {
     switch (wParam) {
         case WM_KEYDOWN:
         case WM_SYSKEYDOWN:
@@ -352,6 +414,23 @@ LRESULT CALLBACK keyboard_hook_event_proc(int nCode, WPARAM wParam, LPARAM lPara
                     __FUNCTION__, __LINE__, (unsigned int) wParam);
             break;
     }
+}
+
+#ifndef USE_RAW_INPUT_HOOK
+LRESULT CALLBACK keyboard_hook_event_proc(int nCode, WPARAM wParam, LPARAM lParam) {
+    KBDLLHOOKSTRUCT *kbhook = (KBDLLHOOKSTRUCT *) lParam;
+
+    // The hook time is GetTickCount() in milliseconds, so the capture time is
+    // taken from QueryPerformanceCounter when the hook is called.
+    event.capture_time = get_monotonic_time();
+    stats_record_lag((uint64_t) (DWORD) (GetTickCount() - kbhook->time) * 1000);
+
+    process_keyboard_message(wParam, kbhook);
+
+    // Deliver anything collected for the batch callback.
+    // NOTE Low level hooks are called once per event, so these batches hold a
+    // single event.  The raw input hook batches everything behind a WM_INPUT.
+    dispatch_flush();
 
     LRESULT hook_result = -1;
     if (nCode < 0 || event.reserved ^ 0x01) {
@@ -363,6 +442,7 @@ LRESULT CALLBACK keyboard_hook_event_proc(int nCode, WPARAM wParam, LPARAM lPara
 
     return hook_result;
 }
+#endif
 
 
 static void process_button_pressed(MSLLHOOKSTRUCT *mshook, uint16_t button) {
@@ -569,8 +649,7 @@ static void process_mouse_wheel(MSLLHOOKSTRUCT *mshook, uint8_t direction) {
     dispatch_event(&event);
 }
 
-LRESULT CALLBACK mouse_hook_event_proc(int nCode, WPARAM wParam, LPARAM lParam) {
-    MSLLHOOKSTRUCT *mshook = (MSLLHOOKSTRUCT *) lParam;
+static void process_mouse_message(WPARAM wParam, MSLLHOOKSTRUCT *mshook) {
     switch (wParam) {
         case WM_LBUTTONDOWN:
             set_modifier_mask(MASK_BUTTON1);
@@ -671,6 +750,22 @@ LRESULT CALLBACK mouse_hook_event_proc(int nCode, WPARAM wParam, LPARAM lParam)
                     __FUNCTION__, __LINE__, (unsigned int) wParam);
             break;
     }
+}
+
+#ifndef USE_RAW_INPUT_HOOK
+LRESULT CALLBACK mouse_hook_event_proc(int nCode, WPARAM wParam, LPARAM lParam) {
+    MSLLHOOKSTRUCT *mshook = (MSLLHOOKSTRUCT *) lParam;
+
+    // The hook time is GetTickCount() in milliseconds, so the capture time is
+    // taken from QueryPerformanceCounter when the hook is called.
+    event.capture_time = get_monotonic_time();
+    stats_record_lag((uint64_t) (DWORD) (GetTickCount() - mshook->time) * 1000);
+
+    process_mouse_message(wParam, mshook);
+
+    // Deliver anything collected for the batch callback.
+    // NOTE Like the keyboard hook this is called once per event.
+    dispatch_flush();
 
     LRESULT hook_result = -1;
     if (nCode < 0 || event.reserved ^ 0x01) {
@@ -682,7 +777,227 @@ LRESULT CALLBACK mouse_hook_event_proc(int nCode, WPARAM wParam, LPARAM lParam)
 
     return hook_result;
 }
+#endif
+
+
+#ifdef USE_RAW_INPUT_HOOK
+// Number of raw input records read by each GetRawInputBuffer() call.
+#define RAW_INPUT_BUFFER_SIZE 64
+
+// RAWINPUT is the largest record type, so the array keeps every record aligned.
+static RAWINPUT raw_input_buffer[RAW_INPUT_BUFFER_SIZE];
+
+// Cursor position for the current batch, raw mouse input only carries deltas.
+static POINT raw_cursor;
+
+// Raw motion is collapsed into a single event for each batch.
+static bool is_raw_moved = false;
+
+// Mouse button transitions reported by raw input and their hook messages.
+static const struct {
+    USHORT flag;
+    WPARAM message;
+    WORD data;
+} raw_button_messages[] = {
+    { RI_MOUSE_LEFT_BUTTON_DOWN,   WM_LBUTTONDOWN, 0        },
+    { RI_MOUSE_LEFT_BUTTON_UP,     WM_LBUTTONUP,   0        },
+    { RI_MOUSE_RIGHT_BUTTON_DOWN,  WM_RBUTTONDOWN, 0        },
+    { RI_MOUSE_RIGHT_BUTTON_UP,    WM_RBUTTONUP,   0        },
+    { RI_MOUSE_MIDDLE_BUTTON_DOWN, WM_MBUTTONDOWN, 0        },
+    { RI_MOUSE_MIDDLE_BUTTON_UP,   WM_MBUTTONUP,   0        },
+    { RI_MOUSE_BUTTON_4_DOWN,      WM_XBUTTONDOWN, XBUTTON1 },
+    { RI_MOUSE_BUTTON_4_UP,        WM_XBUTTONUP,   XBUTTON1 },
+    { RI_MOUSE_BUTTON_5_DOWN,      WM_XBUTTONDOWN, XBUTTON2 },
+    { RI_MOUSE_BUTTON_5_UP,        WM_XBUTTONUP,   XBUTTON2 }
+};
+
+// Deliver the motion collected since the last key or button record, if any.
+static void flush_raw_motion(DWORD time) {
+    if (is_raw_moved) {
+        is_raw_moved = false;
+
+        MSLLHOOKSTRUCT mshook = { 0 };
+        mshook.pt = raw_cursor;
+        mshook.time = time;
+
+        process_mouse_message(WM_MOUSEMOVE, &mshook);
+    }
+}
+
+static void process_raw_keyboard(RAWKEYBOARD *keyboard, DWORD time) {
+    // Skip the fake keys sent as part of the Pause and Print Screen sequences.
+    if (keyboard->VKey == 0xFF) {
+        return;
+    }
+
+    KBDLLHOOKSTRUCT kbhook = { 0 };
+    kbhook.vkCode = keyboard->VKey;
+    kbhook.scanCode = keyboard->MakeCode;
+    kbhook.time = time;
+
+    if (keyboard->Flags & RI_KEY_E0) {
+        kbhook.flags |= LLKHF_EXTENDED;
+    }
+
+    if (keyboard->Flags & RI_KEY_BREAK) {
+        kbhook.flags |= LLKHF_UP;
+    }
+
+    // Raw input reports the generic modifier keys, resolve the left and right keys.
+    switch (keyboard->VKey) {
+        case VK_SHIFT:
+            kbhook.vkCode = MapVirtualKey(keyboard->MakeCode, MAPVK_VSC_TO_VK_EX);
+            break;
+
+        case VK_CONTROL:
+            kbhook.vkCode = (keyboard->Flags & RI_KEY_E0) ? VK_RCONTROL : VK_LCONTROL;
+            break;
+
+        case VK_MENU:
+            kbhook.vkCode = (keyboard->Flags & RI_KEY_E0) ? VK_RMENU : VK_LMENU;
+            break;
+    }
+
+    process_keyboard_message(keyboard->Message, &kbhook);
+}
+
+static void process_raw_mouse(RAWMOUSE *mouse, DWORD time) {
+    if (mouse->lLastX != 0 || mouse->lLastY != 0 || (mouse->usFlags & MOUSE_MOVE_ABSOLUTE)) {
+        is_raw_moved = true;
+    }
+
+    USHORT button_flags = mouse->usButtonFlags;
+    if (button_flags == 0) {
+        return;
+    }
+
+    // Keep the motion in order with the buttons that follow it.
+    flush_raw_motion(time);
+
+    MSLLHOOKSTRUCT mshook = { 0 };
+    mshook.pt = raw_cursor;
+    mshook.time = time;
 
+    // Raw input reports the physical buttons, the hooks report the logical ones.
+    bool is_swapped = GetSystemMetrics(SM_SWAPBUTTON) != 0;
+
+    for (size_t i = 0; i < sizeof(raw_button_messages) / sizeof(raw_button_messages[0]); i++) {
+        if (button_flags & raw_button_messages[i].flag) {
+            WPARAM message = raw_button_messages[i].message;
+            if (is_swapped) {
+                if      (message == WM_LBUTTONDOWN) { message = WM_RBUTTONDOWN; }
+                else if (message == WM_LBUTTONUP)   { message = WM_RBUTTONUP;   }
+                else if (message == WM_RBUTTONDOWN) { message = WM_LBUTTONDOWN; }
+                else if (message == WM_RBUTTONUP)   { message = WM_LBUTTONUP;   }
+            }
+
+            mshook.mouseData = MAKELONG(0, raw_button_messages[i].data);
+            process_mouse_message(message, &mshook);
+        }
+    }
+
+    if (button_flags & RI_MOUSE_WHEEL) {
+        mshook.mouseData = MAKELONG(0, mouse->usButtonData);
+        process_mouse_message(WM_MOUSEWHEEL, &mshook);
+    }
+
+    if (button_flags & RI_MOUSE_HWHEEL) {
+        mshook.mouseData = MAKELONG(0, mouse->usButtonData);
+        process_mouse_message(WM_MOUSEHWHEEL, &mshook);
+    }
+}
+
+static void process_raw_input(DWORD type, void *data, DWORD time) {
+    if (type == RIM_TYPEKEYBOARD) {
+        // Keep the motion in order with the key that follows it.
+        flush_raw_motion(time);
+        process_raw_keyboard((RAWKEYBOARD *) data, time);
+    } else if (type == RIM_TYPEMOUSE) {
+        process_raw_mouse((RAWMOUSE *) data, time);
+    }
+}
+
+// Process the WM_INPUT record and everything queued behind it as one batch.
+static void process_raw_input_message(HRAWINPUT handle) {
+    // Raw input is not time stamped, every record in the batch uses the
+    // GetTickCount() time of the WM_INPUT message.
+    DWORD time = GetMessageTime();
+
+    event.capture_time = get_monotonic_time();
+    stats_record_lag((uint64_t) (DWORD) (GetTickCount() - time) * 1000);
+
+    GetCursorPos(&raw_cursor);
+
+    // The record for this message has already been removed from the buffer.
+    UINT size = sizeof(raw_input_buffer);
+    if (GetRawInputData(handle, RID_INPUT, raw_input_buffer, &size, sizeof(RAWINPUTHEADER)) != (UINT) -1) {
+        process_raw_input(raw_input_buffer[0].header.dwType, &raw_input_buffer[0].data, time);
+    }
+
+    #ifndef _WIN64
+    // The buffered records of a 32-bit process on a 64-bit system use 64-bit headers.
+    BOOL is_wow64 = FALSE;
+    IsWow64Process(GetCurrentProcess(), &is_wow64);
+    size_t data_offset = is_wow64 ? 8 : 0;
+    #else
+    size_t data_offset = 0;
+    #endif
+
+    UINT count;
+    do {
+        size = sizeof(raw_input_buffer);
+        count = GetRawInputBuffer(raw_input_buffer, &size, sizeof(RAWINPUTHEADER));
+        if (count == (UINT) -1) {
+            logger(LOG_LEVEL_WARN, "%s [%u]: GetRawInputBuffer() failed! (%#lX)\n",
+                    __FUNCTION__, __LINE__, (unsigned long) GetLastError());
+            break;
+        }
+
+        RAWINPUT *input = raw_input_buffer;
+        for (UINT i = 0; i < count; i++) {
+            process_raw_input(input->header.dwType, (BYTE *) &input->data + data_offset, time);
+            input = NEXTRAWINPUTBLOCK(input);
+        }
+    } while (count > 0);
+
+    flush_raw_motion(time);
+
+    // Deliver anything collected for the batch callback.
+    dispatch_flush();
+}
+#endif
+
+#ifdef USE_RAW_INPUT_HOOK
+// Register the raw input devices for the subscribed event classes, returns false if it failed.
+static bool set_windows_hooks() {
+    // RIDEV_INPUTSINK delivers input to the invisible window even when it is not
+    // in the foreground, without delaying the input of other applications.
+    return set_raw_input_devices(RIDEV_INPUTSINK, invisible_win_hwnd);
+}
+#else
+// Install the low level hooks for the subscribed event classes, returns false if any failed.
+static bool set_windows_hooks() {
+    uint32_t event_mask = get_event_mask();
+
+    // Mouse events carry the modifier mask, which only the keyboard hook can
+    // track.  Unwanted key events are dropped by dispatch_event().
+    if (event_mask & (EVENT_MASK_KEYBOARD | EVENT_MASK_MOUSE)) {
+        keyboard_event_hhook = SetWindowsHookEx(WH_KEYBOARD_LL, keyboard_hook_event_proc, hInst, 0);
+        if (keyboard_event_hhook == NULL) {
+            return false;
+        }
+    }
+
+    if (event_mask & EVENT_MASK_MOUSE) {
+        mouse_event_hhook = SetWindowsHookEx(WH_MOUSE_LL, mouse_hook_event_proc, hInst, 0);
+        if (mouse_event_hhook == NULL) {
+            return false;
+        }
+    }
+
+    return true;
+}
+#endif
 
 // Callback function that handles events.
 void CALLBACK win_hook_event_proc(HWINEVENTHOOK hook, DWORD event, HWND hWnd, LONG idObject, LONG idChild, DWORD dwEventThread, DWORD dwmsEventTime) {
@@ -694,15 +1009,17 @@ void CALLBACK win_hook_event_proc(HWINEVENTHOOK hook, DWORD event, HWND hWnd, LO
             // Remove any keyboard or mouse hooks that are still running.
             if (keyboard_event_hhook != NULL) {
                 UnhookWindowsHookEx(keyboard_event_hhook);
+                keyboard_event_hhook = NULL;
             }
 
             if (mouse_event_hhook != NULL) {
                 UnhookWindowsHookEx(mouse_event_hhook);
+                mouse_event_hhook = NULL;
             }
 
             // Restart the event hooks.
-            keyboard_event_hhook = SetWindowsHookEx(WH_KEYBOARD_LL, keyboard_hook_event_proc, hInst, 0);
-            mouse_event_hhook = SetWindowsHookEx(WH_MOUSE_LL, mouse_hook_event_proc, hInst, 0);
+            bool is_hooked = set_windows_hooks();
+            stats_record_hook_restart();
 
             // Re-initialize modifier masks.
             initialize_modifiers();
@@ -711,12 +1028,17 @@ void CALLBACK win_hook_event_proc(HWINEVENTHOOK hook, DWORD event, HWND hWnd, LO
             // to determine if we should synthesize missing events.
 
             // Check for event hook error.
-            if (keyboard_event_hhook == NULL || mouse_event_hhook == NULL) {
+            if (!is_hooked) {
                 logger(LOG_LEVEL_ERROR, "%s [%u]: SetWindowsHookEx() failed! (%#lX)\n",
                         __FUNCTION__, __LINE__, (unsigned long) GetLastError());
             }
             break;
 
+        case EVENT_SYSTEM_FOREGROUND:
+            // The new foreground thread may be using a different keyboard layout.
+            invalidate_keyboard_locale();
+            break;
+
         default:
             logger(LOG_LEVEL_DEBUG, "%s [%u]: Unhandled Windows window event: %#X.\n",
                     __FUNCTION__, __LINE__, event);
@@ -731,11 +1053,25 @@ static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM l
             DestroyWindow(hwnd);
             break;
         case WM_DESTROY:
+            // Display and setting changes are no longer reported without the window.
+            track_screen_changes(false);
+            track_property_changes(false);
             PostQuitMessage(0);
             break;
         case WM_DISPLAYCHANGE:
-            enumerate_displays();
+            invalidate_screen_cache();
             break;
+        case WM_SETTINGCHANGE:
+            // Keyboard, mouse and double-click settings are all announced here.
+            invalidate_property_cache();
+            break;
+        #ifdef USE_RAW_INPUT_HOOK
+        case WM_INPUT:
+            process_raw_input_message((HRAWINPUT) lParam);
+
+            // Let the system release the raw input data.
+            return DefWindowProc(hwnd, message, wParam, lParam);
+        #endif
         default:
             return DefWindowProc(hwnd, message, wParam, lParam);
     }
@@ -785,7 +1121,7 @@ static int create_invisible_window()
     return 1;
 }
 
-UIOHOOK_API int hook_run() {
+int run_native_hook() {
     int status = UIOHOOK_FAILURE;
 
     // Set the thread id we want to signal later.
@@ -816,23 +1152,48 @@ UIOHOOK_API int hook_run() {
                __FUNCTION__, __LINE__, (unsigned long) GetLastError());
 
         status = UIOHOOK_ERROR_CREATE_INVISIBLE_WINDOW;
+    } else {
+        track_screen_changes(true);
+        track_property_changes(true);
     }
 
-    // Create the native hooks.
-    keyboard_event_hhook = SetWindowsHookEx(WH_KEYBOARD_LL, keyboard_hook_event_proc, hInst, 0);
-    mouse_event_hhook = SetWindowsHookEx(WH_MOUSE_LL, mouse_hook_event_proc, hInst, 0);
+    // Without a subscribed input class nothing is hooked and the message loop
+    // would block without ever delivering an event.
+    bool has_input = (get_event_mask() & (EVENT_MASK_KEYBOARD | EVENT_MASK_MOUSE)) != 0;
+    if (!has_input) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: No keyboard or mouse events are subscribed!\n",
+                __FUNCTION__, __LINE__);
+    }
 
+    // Create the native hooks, skipping any that would only deliver unwanted events.
+    bool is_hooked = has_input && set_windows_hooks();
+
+    #ifndef USE_RAW_INPUT_HOOK
     // Create a window event hook to listen for capture change.
+    // NOTE Raw input is never removed by the system, so it does not need to restart.
     win_event_hhook = SetWinEventHook(
             EVENT_OBJECT_NAMECHANGE, EVENT_OBJECT_NAMECHANGE,
             NULL,
             win_hook_event_proc,
             0, 0,
             WINEVENT_OUTOFCONTEXT | WINEVENT_SKIPOWNPROCESS);
+    #endif
+
+    // Create a window event hook to track the keyboard layout of the foreground window.
+    win_foreground_hhook = SetWinEventHook(
+            EVENT_SYSTEM_FOREGROUND, EVENT_SYSTEM_FOREGROUND,
+            NULL,
+            win_hook_event_proc,
+            0, 0,
+            WINEVENT_OUTOFCONTEXT);
 
     // If we did not encounter a problem, start processing events.
-    if (keyboard_event_hhook != NULL && mouse_event_hhook != NULL) {
-        if (win_event_hhook == NULL) {
+    if (is_hooked) {
+        #ifdef USE_RAW_INPUT_HOOK
+        if (win_foreground_hhook == NULL) {
+        #else
+        if (win_event_hhook == NULL || win_foreground_hhook == NULL) {
+        #endif
             logger(LOG_LEVEL_WARN, "%s [%u]: SetWinEventHook() failed!\n",
                     __FUNCTION__, __LINE__);
         }
@@ -856,6 +1217,8 @@ UIOHOOK_API int hook_run() {
             TranslateMessage(&message);
             DispatchMessage(&message);
         }
+    } else if (!has_input) {
+        status = UIOHOOK_FAILURE;
     } else {
         logger(LOG_LEVEL_ERROR, "%s [%u]: SetWindowsHookEx() failed! (%#lX)\n",
                 __FUNCTION__, __LINE__, (unsigned long) GetLastError());
@@ -874,7 +1237,7 @@ UIOHOOK_API int hook_run() {
     return status;
 }
 
-UIOHOOK_API int hook_stop() {
+int stop_native_hook() {
     int status = UIOHOOK_FAILURE;
 
     // Destroy the invisible window
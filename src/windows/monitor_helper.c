@@ -1,37 +1,28 @@
-#include "monitor_helper.h"
-
-static LONG left = 0;
-static LONG top = 0;
-
-static BOOL CALLBACK enum_monitor_proc(HMONITOR h_monitor, HDC hdc, LPRECT lp_rect, LPARAM dwData) {
-    MONITORINFO MonitorInfo = {0};
-    MonitorInfo.cbSize = sizeof(MonitorInfo);
-    if (GetMonitorInfo(h_monitor, &MonitorInfo)) {
-        if (MonitorInfo.rcMonitor.left < left) {
-            left = MonitorInfo.rcMonitor.left;
-        }
-        if (MonitorInfo.rcMonitor.top < top) {
-            top = MonitorInfo.rcMonitor.top;
-        }
-    }
-    return TRUE;
-}
-
-void enumerate_displays()
-{
-    // Reset coordinates because if a negative monitor moves to positive space,
-    // it will still look like there is some monitor in negative space.
-    left = 0;
-    top = 0;
+#include <uiohook.h>
 
-    EnumDisplayMonitors(NULL, NULL, enum_monitor_proc, 0);
-}
+#include "monitor_helper.h"
 
 LARGESTNEGATIVECOORDINATES get_largest_negative_coordinates()
 {
     LARGESTNEGATIVECOORDINATES lnc = {
-            .left = left,
-            .top = top
+            .left = 0,
+            .top = 0
     };
+
+    // The snapshot is only rebuilt after WM_DISPLAYCHANGE.
+    const screen_snapshot *snapshot = hook_acquire_screen_snapshot();
+    if (snapshot != NULL) {
+        for (uint8_t i = 0; i < snapshot->count; i++) {
+            if (snapshot->screens[i].x < lnc.left) {
+                lnc.left = snapshot->screens[i].x;
+            }
+            if (snapshot->screens[i].y < lnc.top) {
+                lnc.top = snapshot->screens[i].y;
+            }
+        }
+
+        hook_release_screen_snapshot(snapshot);
+    }
+
     return lnc;
-}
\ No newline at end of file
+}
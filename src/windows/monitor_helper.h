@@ -5,6 +5,4 @@ typedef struct {
     LONG top;
 } LARGESTNEGATIVECOORDINATES;
 
-extern void enumerate_displays();
-
 extern LARGESTNEGATIVECOORDINATES get_largest_negative_coordinates();
@@ -16,6 +16,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <limits.h>
 #include <stdio.h>
 #include <uiohook.h>
 #include <windows.h>
@@ -50,6 +51,9 @@
 
 #define MAX_WINDOWS_COORD_VALUE (1 << 16)
 
+// A mouse button event may need a motion input to move the cursor first.
+#define MAX_EVENT_INPUTS 2
+
 // TODO I doubt this table is complete.
 // http://letcoderock.blogspot.fr/2011/10/sendinput-with-shift-key-not-work.html
 static const uint16_t extend_key_table[10] = {
@@ -176,14 +180,6 @@ static int map_mouse_event(uiohook_event * const event, INPUT * const input, boo
                 }
             }
 
-            if (move_mouse) {
-                // We need to move the mouse to the correct location prior to clicking.
-                event->type = EVENT_MOUSE_MOVED;
-                // TODO Remember to check the status here.
-                hook_post_event(event);
-                event->type = EVENT_MOUSE_PRESSED;
-            }
-
             break;
 
         case EVENT_MOUSE_RELEASED:
@@ -208,14 +204,6 @@ static int map_mouse_event(uiohook_event * const event, INPUT * const input, boo
                 }
             }
 
-            if (move_mouse) {
-                // We need to move the mouse to the correct location prior to clicking.
-                event->type = EVENT_MOUSE_MOVED;
-                // TODO Remember to check the status here.
-                hook_post_event(event);
-                event->type = EVENT_MOUSE_PRESSED;
-            }
-
             break;
 
         case EVENT_MOUSE_WHEEL:
@@ -239,27 +227,49 @@ static int map_mouse_event(uiohook_event * const event, INPUT * const input, boo
     return UIOHOOK_SUCCESS;
 }
 
-static int do_hook_post_event(uiohook_event * const event, bool move_mouse) {
-    INPUT *input = (INPUT *) calloc(1, sizeof(INPUT));
-    if (input == NULL) {
-        logger(LOG_LEVEL_ERROR, "%s [%u]: failed to allocate memory: calloc!\n",
-               __FUNCTION__, __LINE__);
-        return UIOHOOK_ERROR_OUT_OF_MEMORY;
-    }
+struct _post_context {
+    CRITICAL_SECTION lock;
+    INPUT *inputs;
+    size_t capacity;
+};
+
+// Number of events the scratch buffer of a new post context can hold.
+#define POST_CONTEXT_EVENTS 64
+
+// Map a single event, inputs must have room for MAX_EVENT_INPUTS past count.
+static int map_event(uiohook_event * const event, INPUT * const inputs, UINT *count, bool move_mouse) {
+    UINT start = *count;
+
+    // The buffers are reused, so clear anything left over from a previous event.
+    ZeroMemory(&inputs[start], sizeof(INPUT) * MAX_EVENT_INPUTS);
 
     int status = UIOHOOK_FAILURE;
     switch (event->type) {
         case EVENT_KEY_PRESSED:
         case EVENT_KEY_RELEASED:
-            status = map_keyboard_event(event, input);
+            status = map_keyboard_event(event, &inputs[(*count)++]);
             break;
 
         case EVENT_MOUSE_PRESSED:
         case EVENT_MOUSE_RELEASED:
+            if (move_mouse) {
+                // We need to move the mouse to the correct location prior to clicking.
+                uiohook_event move_event = *event;
+                move_event.type = EVENT_MOUSE_MOVED;
+
+                status = map_mouse_event(&move_event, &inputs[(*count)++], move_mouse);
+                if (status != UIOHOOK_SUCCESS) {
+                    break;
+                }
+            }
+
+            status = map_mouse_event(event, &inputs[(*count)++], move_mouse);
+            break;
+
         case EVENT_MOUSE_WHEEL:
         case EVENT_MOUSE_MOVED:
         case EVENT_MOUSE_DRAGGED:
-            status = map_mouse_event(event, input, move_mouse);
+            status = map_mouse_event(event, &inputs[(*count)++], move_mouse);
             break;
 
         case EVENT_KEY_TYPED:
@@ -274,17 +284,52 @@ static int do_hook_post_event(uiohook_event * const event, bool move_mouse) {
             status = UIOHOOK_FAILURE;
     }
 
-    if (status == UIOHOOK_SUCCESS && !SendInput(1, input, sizeof(INPUT))) {
-        logger(LOG_LEVEL_ERROR, "%s [%u]: SendInput() failed! (%#lX)\n",
-               __FUNCTION__, __LINE__, (unsigned long) GetLastError());
+    if (status != UIOHOOK_SUCCESS) {
+        // Drop any partially mapped input for this event.
+        *count = start;
+    }
+
+    return status;
+}
+
+static int send_inputs(INPUT * const inputs, UINT count) {
+    int status = UIOHOOK_SUCCESS;
+
+    UINT sent = SendInput(count, inputs, sizeof(INPUT));
+    if (sent != count) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: SendInput() failed! (%u of %u) (%#lX)\n",
+               __FUNCTION__, __LINE__, sent, count, (unsigned long) GetLastError());
         status = UIOHOOK_FAILURE;
     }
 
-    free(input);
+    return status;
+}
+
+static int map_and_send_events(uiohook_event * const events, size_t count, INPUT * const inputs, bool move_mouse) {
+    // Map every event up to the first failure, then hand the whole batch to
+    // the system with a single SendInput call.
+    UINT input_count = 0;
+    int status = UIOHOOK_SUCCESS;
+    for (size_t i = 0; i < count && status == UIOHOOK_SUCCESS; i++) {
+        status = map_event(&events[i], inputs, &input_count, move_mouse);
+    }
+
+    if (input_count > 0) {
+        int send_status = send_inputs(inputs, input_count);
+        if (status == UIOHOOK_SUCCESS) {
+            status = send_status;
+        }
+    }
 
     return status;
 }
 
+static int do_hook_post_event(uiohook_event * const event, bool move_mouse) {
+    INPUT inputs[MAX_EVENT_INPUTS];
+
+    return map_and_send_events(event, 1, inputs, move_mouse);
+}
+
 UIOHOOK_API int hook_post_event(uiohook_event * const event) {
     return do_hook_post_event(event, true);
 }
@@ -292,3 +337,94 @@ UIOHOOK_API int hook_post_event(uiohook_event * const event) {
 UIOHOOK_API int hook_post_event_dont_move_mouse(uiohook_event * const event) {
     return do_hook_post_event(event, false);
 }
+
+UIOHOOK_API int hook_post_events(uiohook_event * const events, size_t count) {
+    if (count == 0) {
+        return UIOHOOK_SUCCESS;
+    } else if (count > UINT_MAX / MAX_EVENT_INPUTS) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Too many events to post! (%lu)\n",
+               __FUNCTION__, __LINE__, (unsigned long) count);
+        return UIOHOOK_FAILURE;
+    }
+
+    INPUT *inputs = (INPUT *) malloc(sizeof(INPUT) * count * MAX_EVENT_INPUTS);
+    if (inputs == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: failed to allocate memory: malloc!\n",
+               __FUNCTION__, __LINE__);
+        return UIOHOOK_ERROR_OUT_OF_MEMORY;
+    }
+
+    int status = map_and_send_events(events, count, inputs, true);
+
+    free(inputs);
+
+    return status;
+}
+
+UIOHOOK_API post_context * hook_post_context_create() {
+    post_context *context = (post_context *) malloc(sizeof(post_context));
+    if (context == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: failed to allocate memory: malloc!\n",
+               __FUNCTION__, __LINE__);
+        return NULL;
+    }
+
+    context->capacity = POST_CONTEXT_EVENTS * MAX_EVENT_INPUTS;
+    context->inputs = (INPUT *) malloc(sizeof(INPUT) * context->capacity);
+    if (context->inputs == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: failed to allocate memory: malloc!\n",
+               __FUNCTION__, __LINE__);
+        free(context);
+        return NULL;
+    }
+
+    InitializeCriticalSection(&context->lock);
+
+    return context;
+}
+
+UIOHOOK_API void hook_post_context_destroy(post_context *context) {
+    if (context != NULL) {
+        DeleteCriticalSection(&context->lock);
+        free(context->inputs);
+        free(context);
+    }
+}
+
+UIOHOOK_API int hook_post_context_events(post_context *context, uiohook_event * const events, size_t count) {
+    if (context == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Invalid post context!\n",
+               __FUNCTION__, __LINE__);
+        return UIOHOOK_FAILURE;
+    } else if (count == 0) {
+        return UIOHOOK_SUCCESS;
+    } else if (count > UINT_MAX / MAX_EVENT_INPUTS) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Too many events to post! (%lu)\n",
+               __FUNCTION__, __LINE__, (unsigned long) count);
+        return UIOHOOK_FAILURE;
+    }
+
+    EnterCriticalSection(&context->lock);
+
+    int status = UIOHOOK_SUCCESS;
+    if (count * MAX_EVENT_INPUTS > context->capacity) {
+        // The scratch buffer only grows, so steady state posting does not allocate.
+        INPUT *inputs = (INPUT *) realloc(context->inputs, sizeof(INPUT) * count * MAX_EVENT_INPUTS);
+        if (inputs != NULL) {
+            context->inputs = inputs;
+            context->capacity = count * MAX_EVENT_INPUTS;
+        } else {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: failed to allocate memory: realloc!\n",
+                   __FUNCTION__, __LINE__);
+            status = UIOHOOK_ERROR_OUT_OF_MEMORY;
+        }
+    }
+
+    if (status == UIOHOOK_SUCCESS) {
+        status = map_and_send_events(events, count, context->inputs, true);
+    }
+
+    LeaveCriticalSection(&context->lock);
+
+    return status;
+}
@@ -20,6 +20,8 @@
 #include <windows.h>
 
 #include "logger.h"
+#include "property_cache.h"
+#include "screen_cache.h"
 #include "input_helper.h"
 
 // The handle to the DLL module pulled in DllMain on DLL_PROCESS_ATTACH.
@@ -56,7 +58,7 @@ static BOOL CALLBACK monitor_enum_proc(HMONITOR hMonitor, HDC hdcMonitor, LPRECT
         if (screens->data == NULL) {
             screens->data = (screen_data *) malloc(sizeof(screen_data));
         } else {
-            screens->data = (screen_data *) realloc(screens->data, sizeof(screen_data) * screens->count);
+            screens->data = (screen_data *) realloc(screens->data, sizeof(screen_data) * (screens->count + 1));
         }
 
         screens->data[screens->count++] = (screen_data) {
@@ -78,7 +80,7 @@ static BOOL CALLBACK monitor_enum_proc(HMONITOR hMonitor, HDC hdcMonitor, LPRECT
 /* The following function was contributed by Anthony Liguori Jan 14, 2015.
  * https://github.com/kwhat/libuiohook/pull/17
  */
-UIOHOOK_API screen_data* hook_create_screen_info(unsigned char *count) {
+screen_data* query_screen_info(unsigned char *count) {
     // Initialize count to zero.
     *count = 0;
 
@@ -120,7 +122,7 @@ UIOHOOK_API screen_data* hook_create_screen_info(unsigned char *count) {
     return screens.data;
 }
 
-UIOHOOK_API long int hook_get_auto_repeat_rate() {
+static long int query_auto_repeat_rate() {
     long int value = -1;
     long int rate;
 
@@ -134,7 +136,7 @@ UIOHOOK_API long int hook_get_auto_repeat_rate() {
     return value;
 }
 
-UIOHOOK_API long int hook_get_auto_repeat_delay() {
+static long int query_auto_repeat_delay() {
     long int value = -1;
     long int delay;
 
@@ -148,7 +150,7 @@ UIOHOOK_API long int hook_get_auto_repeat_delay() {
     return value;
 }
 
-UIOHOOK_API long int hook_get_pointer_acceleration_multiplier() {
+static long int query_pointer_acceleration_multiplier() {
     long int value = -1;
     int mouse[3]; // 0-Threshold X, 1-Threshold Y and 2-Speed.
 
@@ -162,7 +164,7 @@ UIOHOOK_API long int hook_get_pointer_acceleration_multiplier() {
     return value;
 }
 
-UIOHOOK_API long int hook_get_pointer_acceleration_threshold() {
+static long int query_pointer_acceleration_threshold() {
     long int value = -1;
     int mouse[3]; // 0-Threshold X, 1-Threshold Y and 2-Speed.
 
@@ -179,7 +181,7 @@ UIOHOOK_API long int hook_get_pointer_acceleration_threshold() {
     return value;
 }
 
-UIOHOOK_API long int hook_get_pointer_sensitivity() {
+static long int query_pointer_sensitivity() {
     long int value = -1;
     int sensitivity;
 
@@ -193,7 +195,7 @@ UIOHOOK_API long int hook_get_pointer_sensitivity() {
     return value;
 }
 
-UIOHOOK_API long int hook_get_multi_click_time() {
+static long int query_multi_click_time() {
     long int value = -1;
     UINT clicktime;
 
@@ -206,6 +208,31 @@ UIOHOOK_API long int hook_get_multi_click_time() {
     return value;
 }
 
+// Property values are cached until the platform reports a settings change.
+UIOHOOK_API long int hook_get_auto_repeat_rate() {
+    return get_cached_property(PROPERTY_AUTO_REPEAT_RATE, query_auto_repeat_rate);
+}
+
+UIOHOOK_API long int hook_get_auto_repeat_delay() {
+    return get_cached_property(PROPERTY_AUTO_REPEAT_DELAY, query_auto_repeat_delay);
+}
+
+UIOHOOK_API long int hook_get_pointer_acceleration_multiplier() {
+    return get_cached_property(PROPERTY_POINTER_ACCELERATION_MULTIPLIER, query_pointer_acceleration_multiplier);
+}
+
+UIOHOOK_API long int hook_get_pointer_acceleration_threshold() {
+    return get_cached_property(PROPERTY_POINTER_ACCELERATION_THRESHOLD, query_pointer_acceleration_threshold);
+}
+
+UIOHOOK_API long int hook_get_pointer_sensitivity() {
+    return get_cached_property(PROPERTY_POINTER_SENSITIVITY, query_pointer_sensitivity);
+}
+
+UIOHOOK_API long int hook_get_multi_click_time() {
+    return get_cached_property(PROPERTY_MULTI_CLICK_TIME, query_multi_click_time);
+}
+
 // DLL Entry point.
 BOOL WINAPI DllMain(HINSTANCE hInstDLL, DWORD fdwReason, LPVOID lpReserved) {
     switch (fdwReason) {
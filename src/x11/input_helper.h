@@ -19,6 +19,7 @@
 #ifndef _included_input_helper
 #define _included_input_helper
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <X11/Xlib.h>
 
@@ -61,6 +62,13 @@ extern uint16_t keycode_to_scancode(KeyCode keycode);
  */
 extern KeyCode scancode_to_keycode(uint16_t scancode);
 
+#ifdef USE_EVDEV
+/* Converts a Linux input event key code to the appropriate keyboard scan code.
+ * Unlike keycode_to_scancode() this does not depend on the X server keycodes.
+ */
+extern uint16_t evdev_code_to_scancode(uint16_t code);
+#endif
+
 
 #ifdef USE_XKB_COMMON
 
@@ -87,10 +95,50 @@ extern KeySym keycode_to_keysym(KeyCode keycode, unsigned int modifier_mask);
 
 #endif
 
+/* Converts a X11 key code to its key symbol and Unicode character sequence for
+ * the current modifier state.  Results are cached per modifier state until the
+ * keyboard mapping changes.
+ */
+#ifdef USE_XKB_COMMON
+extern size_t keycode_to_keysym_unicode(struct xkb_state *state, KeyCode keycode, KeySym *keysym, uint16_t *buffer, size_t size);
+#else
+extern size_t keycode_to_keysym_unicode(KeyCode keycode, unsigned int modifier_mask, KeySym *keysym, uint16_t *buffer, size_t size);
+#endif
+
+/* Returns the generation of the keyboard mapping, which changes every time
+ * invalidate_keysym_cache() is called.
+ */
+extern uint32_t get_keymap_generation();
+
+/* Discard the cached key symbols after a keyboard mapping change.  This function
+ * is safe to call from any thread.
+ */
+extern void invalidate_keysym_cache();
+
+/* Query the modifier and button masks currently held down on the display.  The
+ * lock masks are not included.
+ */
+extern uint16_t query_modifier_mask(Display *display);
+
 /* Lookup a X11 buttons possible remapping and return that value.
  */
 extern unsigned int button_map_lookup(unsigned int button);
 
+/* Rebuild the scancode to key code lookup from the selected scancode table.
+ * This function is called when the library loads and by load_input_helper().
+ */
+extern void load_keycode_table();
+
+/* Discard the cached pointer mapping after a MappingNotify for the pointer.
+ * This function is safe to call from any thread.
+ */
+extern void invalidate_button_map();
+
+/* Declare whether pointer mapping changes are currently being reported.  While
+ * they are not, every lookup fetches the pointer mapping from the server.
+ */
+extern void track_button_map_changes(bool enabled);
+
 /* Initialize items required for KeyCodeToKeySym() and KeySymToUnicode()
  * functionality.  This method is called by OnLibraryLoad() and may need to be
  * called in combination with UnloadInputHelper() if the native keyboard layout
@@ -20,7 +20,10 @@
 #include <limits.h>
 
 #ifdef USE_XRECORD_ASYNC
-#include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
 #endif
 
 #include <stdint.h>
@@ -48,15 +51,18 @@
 #pragma message("... Assuming single-head display.")
 #endif
 
+#include "dispatch_event.h"
+#include "event_clock.h"
+#include "hook_context.h"
+#include "hook_stats.h"
 #include "logger.h"
 #include "input_helper.h"
+#include "key_state.h"
+#include "property_cache.h"
 
-// Thread and hook handles.
 #ifdef USE_XRECORD_ASYNC
-static bool running;
-
-static pthread_cond_t hook_xrecord_cond = PTHREAD_COND_INITIALIZER;
-static pthread_mutex_t hook_xrecord_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Time in MS to wait for the end of data once hook_stop() has been called.
+#define XRECORD_STOP_TIMEOUT 100
 #endif
 
 typedef struct _hook_info {
@@ -67,11 +73,18 @@ typedef struct _hook_info {
     struct _ctrl {
         Display *display;
         XRecordContext context;
+        #ifdef USE_XRECORD_ASYNC
+        // Pipe written by hook_stop() to wake the async loop.
+        int stop_fd[2];
+        bool enabled;
+        #endif
     } ctrl;
     struct _input {
         #ifdef USE_XKB_COMMON
         xcb_connection_t *connection;
         struct xkb_context *context;
+        #else
+        int xkb_event_base;
         #endif
         uint16_t mask;
         struct _mouse {
@@ -98,6 +111,9 @@ typedef union {
 
 #if defined(USE_XKB_COMMON)
 static struct xkb_state *state = NULL;
+
+// Keyboard mapping generation the xkb state was created for.
+static uint32_t state_generation = 0;
 #endif
 
 #ifdef USE_EPOCH_TIME
@@ -108,31 +124,6 @@ static struct timeval system_time;
 // Virtual event pointer.
 static uiohook_event event;
 
-// Event dispatch callback.
-static dispatcher_t dispatch = NULL;
-static void *dispatch_data = NULL;
-
-UIOHOOK_API void hook_set_dispatch_proc(dispatcher_t dispatch_proc, void *user_data) {
-    logger(LOG_LEVEL_DEBUG, "%s [%u]: Setting new dispatch callback to %#p.\n",
-            __FUNCTION__, __LINE__, dispatch_proc);
-
-    dispatch = dispatch_proc;
-    dispatch_data = user_data;
-}
-
-// Send out an event if a dispatcher was set.
-static void dispatch_event(uiohook_event *const event) {
-    if (dispatch != NULL) {
-        logger(LOG_LEVEL_DEBUG, "%s [%u]: Dispatching event type %u.\n",
-                __FUNCTION__, __LINE__, event->type);
-
-        dispatch(event, dispatch_data);
-    } else {
-        logger(LOG_LEVEL_WARN, "%s [%u]: No dispatch callback set!\n",
-                __FUNCTION__, __LINE__);
-    }
-}
-
 // Set the native modifier mask for future events.
 static inline void set_modifier_mask(uint16_t mask) {
     hook->input.mask |= mask;
@@ -148,6 +139,29 @@ static inline uint16_t get_modifiers() {
     return hook->input.mask;
 }
 
+#ifndef USE_XKB_COMMON
+// Set the modifier lock masks from a XKB indicator mask.
+static void set_lock_mask(unsigned int led_mask) {
+    if (led_mask & 0x01) {
+        set_modifier_mask(MASK_CAPS_LOCK);
+    } else {
+        unset_modifier_mask(MASK_CAPS_LOCK);
+    }
+
+    if (led_mask & 0x02) {
+        set_modifier_mask(MASK_NUM_LOCK);
+    } else {
+        unset_modifier_mask(MASK_NUM_LOCK);
+    }
+
+    if (led_mask & 0x04) {
+        set_modifier_mask(MASK_SCROLL_LOCK);
+    } else {
+        unset_modifier_mask(MASK_SCROLL_LOCK);
+    }
+}
+#endif
+
 // Initialize the modifier lock masks.
 static void initialize_locks() {
     #ifdef USE_XKB_COMMON
@@ -171,23 +185,7 @@ static void initialize_locks() {
     #else
     unsigned int led_mask = 0x00;
     if (XkbGetIndicatorState(hook->ctrl.display, XkbUseCoreKbd, &led_mask) == Success) {
-        if (led_mask & 0x01) {
-            set_modifier_mask(MASK_CAPS_LOCK);
-        } else {
-            unset_modifier_mask(MASK_CAPS_LOCK);
-        }
-
-        if (led_mask & 0x02) {
-            set_modifier_mask(MASK_NUM_LOCK);
-        } else {
-            unset_modifier_mask(MASK_NUM_LOCK);
-        }
-
-        if (led_mask & 0x04) {
-            set_modifier_mask(MASK_SCROLL_LOCK);
-        } else {
-            unset_modifier_mask(MASK_SCROLL_LOCK);
-        }
+        set_lock_mask(led_mask);
     } else {
         logger(LOG_LEVEL_WARN, "%s [%u]: XkbGetIndicatorState failed to get current led mask!\n",
                 __FUNCTION__, __LINE__);
@@ -195,69 +193,37 @@ static void initialize_locks() {
     #endif
 }
 
-// Initialize the modifier mask to the current modifiers.
-static void initialize_modifiers() {
-    hook->input.mask = 0x0000;
-
-    KeyCode keycode;
-    char keymap[32];
-    XQueryKeymap(hook->ctrl.display, keymap);
-
-    Window unused_win;
-    int unused_int;
-    unsigned int mask;
-    if (XQueryPointer(hook->ctrl.display, DefaultRootWindow(hook->ctrl.display), &unused_win, &unused_win, &unused_int, &unused_int, &unused_int, &unused_int, &mask)) {
-        if (mask & ShiftMask) {
-            keycode = XKeysymToKeycode(hook->ctrl.display, XK_Shift_L);
-            if (keymap[keycode / 8] & (1 << (keycode % 8))) { set_modifier_mask(MASK_SHIFT_L); }
-            keycode = XKeysymToKeycode(hook->ctrl.display, XK_Shift_R);
-            if (keymap[keycode / 8] & (1 << (keycode % 8))) { set_modifier_mask(MASK_SHIFT_R); }
-        }
-        if (mask & ControlMask) {
-            keycode = XKeysymToKeycode(hook->ctrl.display, XK_Control_L);
-            if (keymap[keycode / 8] & (1 << (keycode % 8))) { set_modifier_mask(MASK_CTRL_L);  }
-            keycode = XKeysymToKeycode(hook->ctrl.display, XK_Control_R);
-            if (keymap[keycode / 8] & (1 << (keycode % 8))) { set_modifier_mask(MASK_CTRL_R);  }
-        }
-        if (mask & Mod1Mask) {
-            keycode = XKeysymToKeycode(hook->ctrl.display, XK_Alt_L);
-            if (keymap[keycode / 8] & (1 << (keycode % 8))) { set_modifier_mask(MASK_ALT_L);   }
-            keycode = XKeysymToKeycode(hook->ctrl.display, XK_Alt_R);
-            if (keymap[keycode / 8] & (1 << (keycode % 8))) { set_modifier_mask(MASK_ALT_R);   }
-        }
-        if (mask & Mod4Mask) {
-            keycode = XKeysymToKeycode(hook->ctrl.display, XK_Super_L);
-            if (keymap[keycode / 8] & (1 << (keycode % 8))) { set_modifier_mask(MASK_META_L);  }
-            keycode = XKeysymToKeycode(hook->ctrl.display, XK_Super_R);
-            if (keymap[keycode / 8] & (1 << (keycode % 8))) { set_modifier_mask(MASK_META_R);  }
+// Update the cached lock masks after a key event.
+static void update_locks(uint16_t scancode, bool is_press) {
+    #ifdef USE_XKB_COMMON
+    // The xkb state is maintained locally, so this does not hit the server.
+    (void) scancode;
+    (void) is_press;
+    initialize_locks();
+    #else
+    if (is_press && (scancode == VC_CAPS_LOCK || scancode == VC_NUM_LOCK || scancode == VC_SCROLL_LOCK)) {
+        // Only lock keys change the indicators, resync when one is pressed.
+        initialize_locks();
+    } else if (hook->input.xkb_event_base >= 0) {
+        // Apply indicator changes made by other clients.  This only reads
+        // what the server already sent us and never waits on a reply.
+        while (XEventsQueued(hook->ctrl.display, QueuedAfterReading) > 0) {
+            XEvent notify;
+            XNextEvent(hook->ctrl.display, &notify);
+
+            if (notify.type == hook->input.xkb_event_base
+                    && ((XkbAnyEvent *) &notify)->xkb_type == XkbIndicatorStateNotify) {
+                set_lock_mask(((XkbIndicatorNotifyEvent *) &notify)->state);
+            }
         }
-
-        if (mask & Button1Mask) { set_modifier_mask(MASK_BUTTON1); }
-        if (mask & Button2Mask) { set_modifier_mask(MASK_BUTTON2); }
-        if (mask & Button3Mask) { set_modifier_mask(MASK_BUTTON3); }
-        if (mask & Button4Mask) { set_modifier_mask(MASK_BUTTON4); }
-        if (mask & Button5Mask) { set_modifier_mask(MASK_BUTTON5); }
-    } else {
-        logger(LOG_LEVEL_WARN, "%s [%u]: XQueryPointer failed to get current modifiers!\n",
-                __FUNCTION__, __LINE__);
-
-        keycode = XKeysymToKeycode(hook->ctrl.display, XK_Shift_L);
-        if (keymap[keycode / 8] & (1 << (keycode % 8))) { set_modifier_mask(MASK_SHIFT_L); }
-        keycode = XKeysymToKeycode(hook->ctrl.display, XK_Shift_R);
-        if (keymap[keycode / 8] & (1 << (keycode % 8))) { set_modifier_mask(MASK_SHIFT_R); }
-        keycode = XKeysymToKeycode(hook->ctrl.display, XK_Control_L);
-        if (keymap[keycode / 8] & (1 << (keycode % 8))) { set_modifier_mask(MASK_CTRL_L);  }
-        keycode = XKeysymToKeycode(hook->ctrl.display, XK_Control_R);
-        if (keymap[keycode / 8] & (1 << (keycode % 8))) { set_modifier_mask(MASK_CTRL_R);  }
-        keycode = XKeysymToKeycode(hook->ctrl.display, XK_Alt_L);
-        if (keymap[keycode / 8] & (1 << (keycode % 8))) { set_modifier_mask(MASK_ALT_L);   }
-        keycode = XKeysymToKeycode(hook->ctrl.display, XK_Alt_R);
-        if (keymap[keycode / 8] & (1 << (keycode % 8))) { set_modifier_mask(MASK_ALT_R);   }
-        keycode = XKeysymToKeycode(hook->ctrl.display, XK_Super_L);
-        if (keymap[keycode / 8] & (1 << (keycode % 8))) { set_modifier_mask(MASK_META_L);  }
-        keycode = XKeysymToKeycode(hook->ctrl.display, XK_Super_R);
-        if (keymap[keycode / 8] & (1 << (keycode % 8))) { set_modifier_mask(MASK_META_R);  }
     }
+    #endif
+}
+
+// Initialize the modifier mask to the current modifiers.
+static void initialize_modifiers() {
+    hook->input.mask = query_modifier_mask(hook->ctrl.display);
+    reset_key_state(hook->input.mask);
 
     initialize_locks();
 }
@@ -274,6 +240,16 @@ static inline uint64_t get_unix_timestamp() {
 }
 #endif
 
+UIOHOOK_API uint64_t hook_capture_time_to_event_time(uint64_t capture_time) {
+    #ifdef USE_EPOCH_TIME
+    return (uint64_t) ((int64_t) capture_time + get_realtime_offset()) / NSEC_PER_MSEC;
+    #else
+    // NOTE Xorg derives the server time from CLOCK_MONOTONIC, so this only holds
+    // when the server runs on this machine.
+    return (uint64_t) (uint32_t) (capture_time / NSEC_PER_MSEC);
+    #endif
+}
+
 void hook_event_proc(XPointer closeure, XRecordInterceptData *recorded_data) {
     #ifdef USE_EPOCH_TIME
 	uint64_t timestamp = get_unix_timestamp();
@@ -281,6 +257,10 @@ void hook_event_proc(XPointer closeure, XRecordInterceptData *recorded_data) {
     uint64_t timestamp = (uint64_t) recorded_data->server_time;
     #endif
 
+    // XRecord only carries the millisecond server time, so events are captured
+    // with the time the client received them.
+    event.capture_time = get_monotonic_time();
+
     if (recorded_data->category == XRecordStartOfData) {
         // Initialize native input helper functions.
         load_input_helper();
@@ -307,31 +287,46 @@ void hook_event_proc(XPointer closeure, XRecordInterceptData *recorded_data) {
 
         // Deinitialize native input helper functions.
         unload_input_helper();
+
+        #ifdef USE_XRECORD_ASYNC
+        // Let the async loop return now that the context has been disabled.
+        hook->ctrl.enabled = false;
+        #endif
     } else if (recorded_data->category == XRecordFromServer || recorded_data->category == XRecordFromClient) {
         // Get XRecord data.
         XRecordDatum *data = (XRecordDatum *) recorded_data->data;
 
+        // NOTE Xorg stamps events with CLOCK_MONOTONIC milliseconds, so the lag
+        // is only meaningful when the server runs on this machine.
+        uint32_t server_now = (uint32_t) (event.capture_time / NSEC_PER_MSEC);
+        stats_record_lag((uint64_t) (uint32_t) (server_now - recorded_data->server_time) * 1000);
+
+        #ifdef USE_XKB_COMMON
+        if (data->type == KeyPress || data->type == KeyRelease) {
+            // Recreate the xkb state if the keyboard mapping has changed.
+            uint32_t generation = get_keymap_generation();
+            if (state_generation != generation) {
+                if (state != NULL) {
+                    destroy_xkb_state(state);
+                }
+
+                state = create_xkb_state(hook->input.context, hook->input.connection);
+                state_generation = generation;
+            }
+        }
+        #endif
+
         if (data->type == KeyPress) {
             // The X11 KeyCode associated with this event.
             KeyCode keycode = (KeyCode) data->event.u.u.detail;
             KeySym keysym = 0x00;
-            #if defined(USE_XKB_COMMON)
-            if (state != NULL) {
-                keysym = xkb_state_key_get_one_sym(state, keycode);
-            }
-            #else
-            keysym = keycode_to_keysym(keycode, data->event.u.keyButtonPointer.state);
-            #endif
 
             // Check to make sure the key is printable.
             uint16_t buffer[2];
-            size_t count =  0;
-            #ifdef USE_XKB_COMMON
-            if (state != NULL) {
-                count = keycode_to_unicode(state, keycode, buffer, sizeof(buffer) / sizeof(uint16_t));
-            }
+            #if defined(USE_XKB_COMMON)
+            size_t count = keycode_to_keysym_unicode(state, keycode, &keysym, buffer, sizeof(buffer) / sizeof(uint16_t));
             #else
-            count = keysym_to_unicode(keysym, buffer, sizeof(buffer) / sizeof(uint16_t));
+            size_t count = keycode_to_keysym_unicode(keycode, data->event.u.keyButtonPointer.state, &keysym, buffer, sizeof(buffer) / sizeof(uint16_t));
             #endif
 
 
@@ -349,7 +344,7 @@ void hook_event_proc(XPointer closeure, XRecordInterceptData *recorded_data) {
             #ifdef USE_XKB_COMMON
             xkb_state_update_key(state, keycode, XKB_KEY_DOWN);
             #endif
-            initialize_locks();
+            update_locks(scancode, true);
 
 
             if ((get_modifiers() & MASK_NUM_LOCK) == 0) {
@@ -412,22 +407,13 @@ void hook_event_proc(XPointer closeure, XRecordInterceptData *recorded_data) {
             // The X11 KeyCode associated with this event.
             KeyCode keycode = (KeyCode) data->event.u.u.detail;
             KeySym keysym = 0x00;
-            #ifdef USE_XKB_COMMON
-            if (state != NULL) {
-                keysym = xkb_state_key_get_one_sym(state, keycode);
-            }
-            #else
-            keysym = keycode_to_keysym(keycode, data->event.u.keyButtonPointer.state);
-            #endif
 
             // Check to make sure the key is printable.
             uint16_t buffer[2];
-            #ifdef USE_XKB_COMMON
-            if (state != NULL) {
-                keycode_to_unicode(state, keycode, buffer, sizeof(buffer) / sizeof(uint16_t));
-            }
+            #if defined(USE_XKB_COMMON)
+            keycode_to_keysym_unicode(state, keycode, &keysym, buffer, sizeof(buffer) / sizeof(uint16_t));
             #else
-            keysym_to_unicode(keysym, buffer, sizeof(buffer) / sizeof(uint16_t));
+            keycode_to_keysym_unicode(keycode, data->event.u.keyButtonPointer.state, &keysym, buffer, sizeof(buffer) / sizeof(uint16_t));
             #endif
 
             unsigned short int scancode = keycode_to_scancode(keycode);
@@ -444,7 +430,7 @@ void hook_event_proc(XPointer closeure, XRecordInterceptData *recorded_data) {
             #ifdef USE_XKB_COMMON
             xkb_state_update_key(state, keycode, XKB_KEY_UP);
             #endif
-            initialize_locks();
+            update_locks(scancode, false);
 
             if ((get_modifiers() & MASK_NUM_LOCK) == 0) {
                 switch (scancode) {
@@ -510,15 +496,14 @@ void hook_event_proc(XPointer closeure, XRecordInterceptData *recorded_data) {
                 event.data.wheel.y = data->event.u.keyButtonPointer.rootY;
 
                 #if defined(USE_XINERAMA) || defined(USE_XRANDR)
-                uint8_t count;
-                screen_data *screens = hook_create_screen_info(&count);
-                if (count > 1) {
-                    event.data.wheel.x -= screens[0].x;
-                    event.data.wheel.y -= screens[0].y;
-                }
+                const screen_snapshot *snapshot = hook_acquire_screen_snapshot();
+                if (snapshot != NULL) {
+                    if (snapshot->count > 1) {
+                        event.data.wheel.x -= snapshot->screens[0].x;
+                        event.data.wheel.y -= snapshot->screens[0].y;
+                    }
 
-                if (screens != NULL) {
-                    free(screens);
+                    hook_release_screen_snapshot(snapshot);
                 }
                 #endif
 
@@ -630,15 +615,14 @@ void hook_event_proc(XPointer closeure, XRecordInterceptData *recorded_data) {
                 event.data.mouse.y = data->event.u.keyButtonPointer.rootY;
 
                 #if defined(USE_XINERAMA) || defined(USE_XRANDR)
-                uint8_t count;
-                screen_data *screens = hook_create_screen_info(&count);
-                if (count > 1) {
-                    event.data.mouse.x -= screens[0].x;
-                    event.data.mouse.y -= screens[0].y;
-                }
+                const screen_snapshot *snapshot = hook_acquire_screen_snapshot();
+                if (snapshot != NULL) {
+                    if (snapshot->count > 1) {
+                        event.data.mouse.x -= snapshot->screens[0].x;
+                        event.data.mouse.y -= snapshot->screens[0].y;
+                    }
 
-                if (screens != NULL) {
-                    free(screens);
+                    hook_release_screen_snapshot(snapshot);
                 }
                 #endif
 
@@ -705,15 +689,14 @@ void hook_event_proc(XPointer closeure, XRecordInterceptData *recorded_data) {
                 event.data.mouse.y = data->event.u.keyButtonPointer.rootY;
 
                 #if defined(USE_XINERAMA) || defined(USE_XRANDR)
-                uint8_t count;
-                screen_data *screens = hook_create_screen_info(&count);
-                if (count > 1) {
-                    event.data.mouse.x -= screens[0].x;
-                    event.data.mouse.y -= screens[0].y;
-                }
+                const screen_snapshot *snapshot = hook_acquire_screen_snapshot();
+                if (snapshot != NULL) {
+                    if (snapshot->count > 1) {
+                        event.data.mouse.x -= snapshot->screens[0].x;
+                        event.data.mouse.y -= snapshot->screens[0].y;
+                    }
 
-                if (screens != NULL) {
-                    free(screens);
+                    hook_release_screen_snapshot(snapshot);
                 }
                 #endif
 
@@ -740,15 +723,14 @@ void hook_event_proc(XPointer closeure, XRecordInterceptData *recorded_data) {
                     event.data.mouse.y = data->event.u.keyButtonPointer.rootY;
 
                     #if defined(USE_XINERAMA) || defined(USE_XRANDR)
-                    uint8_t count;
-                    screen_data *screens = hook_create_screen_info(&count);
-                    if (count > 1) {
-                        event.data.mouse.x -= screens[0].x;
-                        event.data.mouse.y -= screens[0].y;
-                    }
-
-                    if (screens != NULL) {
-                        free(screens);
+                    const screen_snapshot *snapshot = hook_acquire_screen_snapshot();
+                    if (snapshot != NULL) {
+                        if (snapshot->count > 1) {
+                            event.data.mouse.x -= snapshot->screens[0].x;
+                            event.data.mouse.y -= snapshot->screens[0].y;
+                        }
+
+                        hook_release_screen_snapshot(snapshot);
                     }
                     #endif
 
@@ -796,15 +778,14 @@ void hook_event_proc(XPointer closeure, XRecordInterceptData *recorded_data) {
             event.data.mouse.y = data->event.u.keyButtonPointer.rootY;
 
             #if defined(USE_XINERAMA) || defined(USE_XRANDR)
-            uint8_t count;
-            screen_data *screens = hook_create_screen_info(&count);
-            if (count > 1) {
-                event.data.mouse.x -= screens[0].x;
-                event.data.mouse.y -= screens[0].y;
-            }
+            const screen_snapshot *snapshot = hook_acquire_screen_snapshot();
+            if (snapshot != NULL) {
+                if (snapshot->count > 1) {
+                    event.data.mouse.x -= snapshot->screens[0].x;
+                    event.data.mouse.y -= snapshot->screens[0].y;
+                }
 
-            if (screens != NULL) {
-                free(screens);
+                hook_release_screen_snapshot(snapshot);
             }
             #endif
 
@@ -826,6 +807,14 @@ void hook_event_proc(XPointer closeure, XRecordInterceptData *recorded_data) {
 
     // TODO There is no way to consume the XRecord event.
 
+    #ifndef USE_XRECORD_ASYNC
+    // Deliver anything collected for the batch callback.
+    // NOTE XRecordEnableContext() calls back once per event and never returns
+    // between them, so these batches hold a single event.  The async loop
+    // flushes once per XRecordProcessReplies() instead.
+    dispatch_flush();
+    #endif
+
     XRecordFreeData(recorded_data);
 }
 
@@ -851,39 +840,58 @@ static inline int xrecord_block() {
 
     #ifdef USE_XRECORD_ASYNC
     // Async requires that we loop so that our thread does not return.
-    if (XRecordEnableContextAsync(hook->data.display, context, hook_event_proc, closeure) != 0) {
-        // Time in MS to sleep the runloop.
-        int timesleep = 100;
+    if (XRecordEnableContextAsync(hook->data.display, hook->ctrl.context, hook_event_proc, closeure) != 0) {
+        struct pollfd fds[2] = {
+            { .fd = ConnectionNumber(hook->data.display), .events = POLLIN },
+            { .fd = hook->ctrl.stop_fd[0], .events = POLLIN }
+        };
 
-        // Allow the thread loop to block.
-        pthread_mutex_lock(&hook_xrecord_mutex);
-        running = true;
+        // The loop sleeps until the server sends data or hook_stop() writes to
+        // the pipe, after that it only waits a short time for the end of data.
+        int timeout = -1;
 
-        do {
-            // Unlock the mutex from the previous iteration.
-            pthread_mutex_unlock(&hook_xrecord_mutex);
+        hook->ctrl.enabled = true;
+        status = UIOHOOK_SUCCESS;
 
+        while (hook->ctrl.enabled) {
+            // Process everything Xlib has read so a partial reply still in its
+            // buffer does not wait for the next wakeup.
             XRecordProcessReplies(hook->data.display);
+            dispatch_flush();
 
-            // Prevent 100% CPU utilization.
-            struct timeval tv;
-            gettimeofday(&tv, NULL);
+            if (!hook->ctrl.enabled) {
+                break;
+            }
 
-            struct timespec ts;
-            ts.tv_sec = time(NULL) + timesleep / 1000;
-            ts.tv_nsec = tv.tv_usec * 1000 + 1000 * 1000 * (timesleep % 1000);
-            ts.tv_sec += ts.tv_nsec / (1000 * 1000 * 1000);
-            ts.tv_nsec %= (1000 * 1000 * 1000);
+            int ready = poll(fds, timeout < 0 ? 2 : 1, timeout);
+            if (ready < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
 
-            pthread_mutex_lock(&hook_xrecord_mutex);
-            pthread_cond_timedwait(&hook_xrecord_cond, &hook_xrecord_mutex, &ts);
-        } while (running);
+                logger(LOG_LEVEL_ERROR, "%s [%u]: poll failure! (%i)\n",
+                        __FUNCTION__, __LINE__, errno);
 
-        // Unlock after loop exit.
-        pthread_mutex_unlock(&hook_xrecord_mutex);
+                status = UIOHOOK_FAILURE;
+                break;
+            } else if (ready == 0) {
+                logger(LOG_LEVEL_WARN, "%s [%u]: XRecord end of data did not arrive after stop!\n",
+                        __FUNCTION__, __LINE__);
+                break;
+            }
 
-        // Set the exit status.
-        status = NULL;
+            if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                logger(LOG_LEVEL_ERROR, "%s [%u]: Lost connection to the X server!\n",
+                        __FUNCTION__, __LINE__);
+
+                status = UIOHOOK_FAILURE;
+                break;
+            }
+
+            if (timeout < 0 && (fds[1].revents & POLLIN)) {
+                timeout = XRECORD_STOP_TIMEOUT;
+            }
+        }
     }
     #else
     // Sync blocks until XRecordDisableContext() is called.
@@ -895,13 +903,6 @@ static inline int xrecord_block() {
         logger(LOG_LEVEL_ERROR, "%s [%u]: XRecordEnableContext failure!\n",
                 __FUNCTION__, __LINE__);
 
-        #ifdef USE_XRECORD_ASYNC
-        // Reset the running state.
-        pthread_mutex_lock(&hook_xrecord_mutex);
-        running = false;
-        pthread_mutex_unlock(&hook_xrecord_mutex);
-        #endif
-
         // Set the exit status.
         status = UIOHOOK_ERROR_X_RECORD_ENABLE_CONTEXT;
     }
@@ -925,8 +926,24 @@ static int xrecord_alloc() {
         logger(LOG_LEVEL_DEBUG, "%s [%u]: XRecordAllocRange successful.\n",
                 __FUNCTION__, __LINE__);
 
-        hook->data.range->device_events.first = KeyPress;
-        hook->data.range->device_events.last = MotionNotify;
+        // Only record the contiguous range of core events that covers the
+        // subscribed classes.  Mouse wheel events are button events on X11.
+        uint32_t event_mask = get_event_mask();
+        if (event_mask & EVENT_MASK_KEYBOARD) {
+            hook->data.range->device_events.first = KeyPress;
+        } else if (event_mask & (EVENT_MASK_MOUSE_BUTTON | EVENT_MASK_MOUSE_WHEEL)) {
+            hook->data.range->device_events.first = ButtonPress;
+        } else if (event_mask & EVENT_MASK_MOUSE_MOTION) {
+            hook->data.range->device_events.first = MotionNotify;
+        }
+
+        if (event_mask & EVENT_MASK_MOUSE_MOTION) {
+            hook->data.range->device_events.last = MotionNotify;
+        } else if (event_mask & (EVENT_MASK_MOUSE_BUTTON | EVENT_MASK_MOUSE_WHEEL)) {
+            hook->data.range->device_events.last = ButtonRelease;
+        } else if (event_mask & EVENT_MASK_KEYBOARD) {
+            hook->data.range->device_events.last = KeyRelease;
+        }
 
         // Note that the documentation for this function is incorrect,
         // hook->data.display should be used!
@@ -1026,6 +1043,20 @@ static int xrecord_start() {
 
         #ifdef USE_XKB_COMMON
         state = create_xkb_state(hook->input.context, hook->input.connection);
+        state_generation = get_keymap_generation();
+        #else
+        // Subscribe to indicator changes so the lock masks can be cached.
+        hook->input.xkb_event_base = -1;
+
+        int xkb_opcode, xkb_event_base, xkb_error_base;
+        int xkb_major = XkbMajorVersion, xkb_minor = XkbMinorVersion;
+        if (XkbQueryExtension(hook->ctrl.display, &xkb_opcode, &xkb_event_base, &xkb_error_base, &xkb_major, &xkb_minor)
+                && XkbSelectEvents(hook->ctrl.display, XkbUseCoreKbd, XkbIndicatorStateNotifyMask, XkbIndicatorStateNotifyMask)) {
+            hook->input.xkb_event_base = xkb_event_base;
+        } else {
+            logger(LOG_LEVEL_WARN, "%s [%u]: Could not select XkbIndicatorStateNotify events!\n",
+                    __FUNCTION__, __LINE__);
+        }
         #endif
 
         // Initialize starting modifiers.
@@ -1036,6 +1067,7 @@ static int xrecord_start() {
         #ifdef USE_XKB_COMMON
         if (state != NULL) {
             destroy_xkb_state(state);
+            state = NULL;
         }
 
         if (hook->input.context != NULL) {
@@ -1065,7 +1097,7 @@ static int xrecord_start() {
     return status;
 }
 
-UIOHOOK_API int hook_run() {
+int run_native_hook() {
     // Hook data for future cleanup.
     hook = malloc(sizeof(hook_info));
     if (hook == NULL) {
@@ -1081,8 +1113,34 @@ UIOHOOK_API int hook_run() {
     hook->input.mouse.click.time = 0;
     hook->input.mouse.click.button = MOUSE_NOBUTTON;
 
+    // Pointer control changes are not announced, so start with fresh values.
+    invalidate_property_cache();
+
+    #ifdef USE_XRECORD_ASYNC
+    if (pipe(hook->ctrl.stop_fd) != 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: pipe failure! (%i)\n",
+                __FUNCTION__, __LINE__, errno);
+
+        free(hook);
+        hook = NULL;
+
+        return UIOHOOK_FAILURE;
+    }
+
+    // Non-blocking so hook_stop() never waits on a full pipe.
+    for (int i = 0; i < 2; i++) {
+        fcntl(hook->ctrl.stop_fd[i], F_SETFL, fcntl(hook->ctrl.stop_fd[i], F_GETFL) | O_NONBLOCK);
+        fcntl(hook->ctrl.stop_fd[i], F_SETFD, FD_CLOEXEC);
+    }
+    #endif
+
     int status = xrecord_start();
 
+    #ifdef USE_XRECORD_ASYNC
+    close(hook->ctrl.stop_fd[0]);
+    close(hook->ctrl.stop_fd[1]);
+    #endif
+
     // Free data associated with this hook.
     free(hook);
     hook = NULL;
@@ -1093,7 +1151,7 @@ UIOHOOK_API int hook_run() {
     return status;
 }
 
-UIOHOOK_API int hook_stop() {
+int stop_native_hook() {
     int status = UIOHOOK_FAILURE;
 
     if (hook != NULL && hook->ctrl.display != NULL && hook->ctrl.context != 0) {
@@ -1103,18 +1161,20 @@ UIOHOOK_API int hook_stop() {
             if (XRecordGetContext(hook->ctrl.display, hook->ctrl.context, &state) != 0) {
                 // Try to exit the thread naturally.
                 if (state->enabled && XRecordDisableContext(hook->ctrl.display, hook->ctrl.context) != 0) {
-                    #ifdef USE_XRECORD_ASYNC
-                    pthread_mutex_lock(&hook_xrecord_mutex);
-                    running = false;
-                    pthread_cond_signal(&hook_xrecord_cond);
-                    pthread_mutex_unlock(&hook_xrecord_mutex);
-                    #endif
-
                     // See Bug 42356 for more information.
                     // https://bugs.freedesktop.org/show_bug.cgi?id=42356#c4
                     //XFlush(hook->ctrl.display);
                     XSync(hook->ctrl.display, False);
 
+                    #ifdef USE_XRECORD_ASYNC
+                    // Wake the async loop so it collects the end of data and returns.
+                    char stop = 1;
+                    if (write(hook->ctrl.stop_fd[1], &stop, sizeof(stop)) < 0 && errno != EAGAIN) {
+                        logger(LOG_LEVEL_WARN, "%s [%u]: Failed to wake the XRecord loop! (%i)\n",
+                                __FUNCTION__, __LINE__, errno);
+                    }
+                    #endif
+
                     status = UIOHOOK_SUCCESS;
                 }
             } else {
@@ -27,8 +27,11 @@
 #include "input_helper.h"
 #include "logger.h"
 
+struct _post_context {
+    Display *display;
+};
 
-static int post_key_event(uiohook_event * const event) {
+static int post_key_event(Display *display, uiohook_event * const event) {
     KeyCode keycode = scancode_to_keycode(event->data.keyboard.keycode);
     if (keycode == 0x0000) {
         logger(LOG_LEVEL_WARN, "%s [%u]: Unable to lookup scancode: %li\n",
@@ -47,7 +50,8 @@ static int post_key_event(uiohook_event * const event) {
         return UIOHOOK_FAILURE;
     }
 
-    if (XTestFakeKeyEvent(helper_disp, keycode, is_pressed, 0) != Success) {
+    // NOTE XTestFakeKeyEvent() returns zero on failure, not an X error code.
+    if (XTestFakeKeyEvent(display, keycode, is_pressed, 0) == 0) {
         logger(LOG_LEVEL_ERROR, "%s [%u]: XTestFakeKeyEvent() failed!\n",
                 __FUNCTION__, __LINE__, event->type);
         return UIOHOOK_FAILURE;
@@ -56,15 +60,15 @@ static int post_key_event(uiohook_event * const event) {
     return UIOHOOK_SUCCESS;
 }
 
-static int post_mouse_button_event(uiohook_event * const event, bool move_mouse) {
+static int post_mouse_button_event(Display *display, uiohook_event * const event, bool move_mouse) {
     XButtonEvent btn_event = {
         .serial = 0,
         .send_event = False,
-        .display = helper_disp,
+        .display = display,
 
         .window = None,                                /* “event” window it is reported relative to */
         .root = None,                                  /* root window that the event occurred on */
-        .subwindow = XDefaultRootWindow(helper_disp),  /* child window */
+        .subwindow = XDefaultRootWindow(display),  /* child window */
 
         .time = CurrentTime,
 
@@ -92,7 +96,7 @@ static int post_mouse_button_event(uiohook_event * const event, bool move_mouse)
                 return UIOHOOK_FAILURE;
             }
 
-            if (XTestFakeButtonEvent(helper_disp, event->data.mouse.button, True, 0) != 0) {
+            if (XTestFakeButtonEvent(display, event->data.mouse.button, True, 0) != 0) {
                 status = UIOHOOK_SUCCESS;
             }
             break;
@@ -104,7 +108,7 @@ static int post_mouse_button_event(uiohook_event * const event, bool move_mouse)
                 return UIOHOOK_FAILURE;
             }
 
-            if (XTestFakeButtonEvent(helper_disp, event->data.mouse.button, False, 0) != 0) {
+            if (XTestFakeButtonEvent(display, event->data.mouse.button, False, 0) != 0) {
                 status = UIOHOOK_SUCCESS;
             }
             break;
@@ -118,25 +122,17 @@ static int post_mouse_button_event(uiohook_event * const event, bool move_mouse)
     return status;
 }
 
-static int post_mouse_button_event_move_mouse(uiohook_event * const event) {
-    return post_mouse_button_event(event, true);
-}
-
-static int post_mouse_button_event_dont_move_mouse(uiohook_event * const event) {
-    return post_mouse_button_event(event, false);
-}
-
-static int post_mouse_wheel_event(uiohook_event * const event) {
+static int post_mouse_wheel_event(Display *display, uiohook_event * const event) {
     int status = UIOHOOK_FAILURE;
 
     XButtonEvent btn_event = {
         .serial = 0,
         .send_event = False,
-        .display = helper_disp,
+        .display = display,
 
         .window = None,                                /* “event” window it is reported relative to */
         .root = None,                                  /* root window that the event occurred on */
-        .subwindow = XDefaultRootWindow(helper_disp),  /* child window */
+        .subwindow = XDefaultRootWindow(display),  /* child window */
 
         .time = CurrentTime,
 
@@ -154,56 +150,48 @@ static int post_mouse_wheel_event(uiohook_event * const event) {
     // type, amount and rotation
     unsigned int button = button_map_lookup(event->data.wheel.rotation < 0 ? WheelUp : WheelDown);
 
-    if (XTestFakeButtonEvent(helper_disp, button, True, 0) != 0) {
+    if (XTestFakeButtonEvent(display, button, True, 0) != 0) {
         status = UIOHOOK_SUCCESS;
     }
 
-    if (status == UIOHOOK_SUCCESS && XTestFakeButtonEvent(helper_disp, button, False, 0) == 0) {
+    if (status == UIOHOOK_SUCCESS && XTestFakeButtonEvent(display, button, False, 0) == 0) {
         status = UIOHOOK_FAILURE;
     }
 
     return UIOHOOK_SUCCESS;
 }
 
-static int post_mouse_motion_event(uiohook_event * const event) {
+static int post_mouse_motion_event(Display *display, uiohook_event * const event) {
     int status = UIOHOOK_FAILURE;
 
-    if (XTestFakeMotionEvent(helper_disp, -1, event->data.mouse.x, event->data.mouse.y, 0) != 0) {
+    if (XTestFakeMotionEvent(display, -1, event->data.mouse.x, event->data.mouse.y, 0) != 0) {
         status = UIOHOOK_SUCCESS;
     }
 
     return status;
 }
 
-// TODO This should return a status code, UIOHOOK_SUCCESS or otherwise.
-UIOHOOK_API int hook_post_event(uiohook_event * const event) {
-    if (helper_disp == NULL) {
-        logger(LOG_LEVEL_ERROR, "%s [%u]: XDisplay helper_disp is unavailable!\n",
-                __FUNCTION__, __LINE__);
-        return UIOHOOK_ERROR_X_OPEN_DISPLAY;
-    }
-
-    XLockDisplay(helper_disp);
-
+// Queue the XTest requests for a single event, the caller must hold the display lock.
+static int post_event(Display *display, uiohook_event * const event, bool move_mouse) {
     int status = UIOHOOK_FAILURE;
     switch (event->type) {
         case EVENT_KEY_PRESSED:
         case EVENT_KEY_RELEASED:
-            status = post_key_event(event);
+            status = post_key_event(display, event);
             break;
 
         case EVENT_MOUSE_PRESSED:
         case EVENT_MOUSE_RELEASED:
-            status = post_mouse_button_event_move_mouse(event);
+            status = post_mouse_button_event(display, event, move_mouse);
             break;
 
         case EVENT_MOUSE_WHEEL:
-            status = post_mouse_wheel_event(event);
+            status = post_mouse_wheel_event(display, event);
             break;
 
         case EVENT_MOUSE_MOVED:
         case EVENT_MOUSE_DRAGGED:
-            status = post_mouse_motion_event(event);
+            status = post_mouse_motion_event(display, event);
             break;
 
         case EVENT_KEY_TYPED:
@@ -218,13 +206,31 @@ UIOHOOK_API int hook_post_event(uiohook_event * const event) {
             status = UIOHOOK_FAILURE;
     }
 
+    return status;
+}
+
+// Post the events in order up to the first failure with a single flush.
+static int post_events(Display *display, uiohook_event * const events, size_t count, bool move_mouse) {
+    XLockDisplay(display);
+
+    // The XTest requests are buffered by Xlib until the sync below, so the
+    // whole batch reaches the server in a single round trip.
+    int status = UIOHOOK_SUCCESS;
+    for (size_t i = 0; i < count && status == UIOHOOK_SUCCESS; i++) {
+        status = post_event(display, &events[i], move_mouse);
+    }
+
     // Don't forget to flush!
-    XSync(helper_disp, True);
-    XUnlockDisplay(helper_disp);
+    XSync(display, True);
+    XUnlockDisplay(display);
 
     return status;
 }
 
+UIOHOOK_API int hook_post_event(uiohook_event * const event) {
+    return hook_post_events(event, 1);
+}
+
 UIOHOOK_API int hook_post_event_dont_move_mouse(uiohook_event * const event) {
     if (helper_disp == NULL) {
         logger(LOG_LEVEL_ERROR, "%s [%u]: XDisplay helper_disp is unavailable!\n",
@@ -232,44 +238,52 @@ UIOHOOK_API int hook_post_event_dont_move_mouse(uiohook_event * const event) {
         return UIOHOOK_ERROR_X_OPEN_DISPLAY;
     }
 
-    XLockDisplay(helper_disp);
-
-    int status = UIOHOOK_FAILURE;
-    switch (event->type) {
-        case EVENT_KEY_PRESSED:
-        case EVENT_KEY_RELEASED:
-            status = post_key_event(event);
-            break;
+    return post_events(helper_disp, event, 1, false);
+}
 
-        case EVENT_MOUSE_PRESSED:
-        case EVENT_MOUSE_RELEASED:
-            status = post_mouse_button_event_dont_move_mouse(event);
-            break;
+UIOHOOK_API int hook_post_events(uiohook_event * const events, size_t count) {
+    if (helper_disp == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: XDisplay helper_disp is unavailable!\n",
+                __FUNCTION__, __LINE__);
+        return UIOHOOK_ERROR_X_OPEN_DISPLAY;
+    }
 
-        case EVENT_MOUSE_WHEEL:
-            status = post_mouse_wheel_event(event);
-            break;
+    return post_events(helper_disp, events, count, true);
+}
 
-        case EVENT_MOUSE_MOVED:
-        case EVENT_MOUSE_DRAGGED:
-            status = post_mouse_motion_event(event);
-            break;
+UIOHOOK_API post_context * hook_post_context_create() {
+    post_context *context = malloc(sizeof(post_context));
+    if (context == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for post context!\n",
+                __FUNCTION__, __LINE__);
+        return NULL;
+    }
 
-        case EVENT_KEY_TYPED:
-        case EVENT_MOUSE_CLICKED:
+    // A dedicated connection keeps posting from contending with the helper display lock.
+    context->display = XOpenDisplay(XDisplayName(NULL));
+    if (context->display == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: XOpenDisplay failure!\n",
+                __FUNCTION__, __LINE__);
+        free(context);
+        return NULL;
+    }
 
-        case EVENT_HOOK_ENABLED:
-        case EVENT_HOOK_DISABLED:
+    return context;
+}
 
-        default:
-            logger(LOG_LEVEL_WARN, "%s [%u]: Ignoring post event type %#X\n",
-                   __FUNCTION__, __LINE__, event->type);
-            status = UIOHOOK_FAILURE;
+UIOHOOK_API void hook_post_context_destroy(post_context *context) {
+    if (context != NULL) {
+        XCloseDisplay(context->display);
+        free(context);
     }
+}
 
-    // Don't forget to flush!
-    XSync(helper_disp, True);
-    XUnlockDisplay(helper_disp);
+UIOHOOK_API int hook_post_context_events(post_context *context, uiohook_event * const events, size_t count) {
+    if (context == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Invalid post context!\n",
+                __FUNCTION__, __LINE__);
+        return UIOHOOK_FAILURE;
+    }
 
-    return status;
+    return post_events(context->display, events, count, true);
 }
@@ -28,10 +28,11 @@
 #include <X11/extensions/xf86mscstr.h>
 #endif
 
+#include <pthread.h>
+
 #if defined(USE_XINERAMA) && !defined(USE_XRANDR)
 #include <X11/extensions/Xinerama.h>
 #elif defined(USE_XRANDR)
-#include <pthread.h>
 #include <X11/extensions/Xrandr.h>
 #endif
 
@@ -44,65 +45,168 @@ static Display *xt_disp;
 
 #include "input_helper.h"
 #include "logger.h"
+#include "property_cache.h"
+#include "screen_cache.h"
 
 #ifdef USE_XRANDR
 static pthread_mutex_t xrandr_mutex = PTHREAD_MUTEX_INITIALIZER;
 static XRRScreenResources *xrandr_resources = NULL;
+#endif
 
 static void settings_cleanup_proc(void *arg) {
+    // Nothing is listening for screen or setting changes once this thread exits.
+    track_screen_changes(false);
+    track_property_changes(false);
+    track_button_map_changes(false);
+
+    #ifdef USE_XRANDR
     if (pthread_mutex_trylock(&xrandr_mutex) == 0) {
         if (xrandr_resources != NULL) {
             XRRFreeScreenResources(xrandr_resources);
             xrandr_resources = NULL;
         }
 
-        if (arg != NULL) {
-            XCloseDisplay((Display *) arg);
-            arg = NULL;
-        }
-
         pthread_mutex_unlock(&xrandr_mutex);
     }
+    #endif
+
+    if (arg != NULL) {
+        XCloseDisplay((Display *) arg);
+        arg = NULL;
+    }
+}
+
+// Locate the current XSETTINGS manager window and listen for changes to it.
+static Window select_xsettings_owner(Display *display, Atom selection) {
+    XGrabServer(display);
+
+    Window owner = XGetSelectionOwner(display, selection);
+    if (owner != None) {
+        XSelectInput(display, owner, PropertyChangeMask | StructureNotifyMask);
+    }
+
+    XUngrabServer(display);
+    XFlush(display);
+
+    return owner;
 }
 
 static void *settings_thread_proc(void *arg) {
-    Display *settings_disp = XOpenDisplay(XDisplayName(NULL));;
+    (void) arg;
+
+    Display *settings_disp = XOpenDisplay(XDisplayName(NULL));
     if (settings_disp != NULL) {
         logger(LOG_LEVEL_DEBUG, "%s [%u]: %s\n",
                 __FUNCTION__, __LINE__, "XOpenDisplay success.");
 
         pthread_cleanup_push(settings_cleanup_proc, settings_disp);
 
-        int event_base = 0;
-        int error_base = 0;
-        if (XRRQueryExtension(settings_disp, &event_base, &error_base)) {
-            Window root = XDefaultRootWindow(settings_disp);
-            unsigned long event_mask = RRScreenChangeNotifyMask;
-            XRRSelectInput(settings_disp, root, event_mask);
+        Window root = XDefaultRootWindow(settings_disp);
+
+        // Changes to the resource database and XSETTINGS manager handoffs are
+        // both announced on the root window.
+        XSelectInput(settings_disp, root, PropertyChangeMask | StructureNotifyMask);
+
+        Atom resource_manager = XInternAtom(settings_disp, "RESOURCE_MANAGER", False);
+        Atom manager = XInternAtom(settings_disp, "MANAGER", False);
+        Atom xsettings = XInternAtom(settings_disp, "_XSETTINGS_SETTINGS", False);
+
+        char selection_name[32];
+        snprintf(selection_name, sizeof(selection_name), "_XSETTINGS_S%d", DefaultScreen(settings_disp));
+        Atom xsettings_selection = XInternAtom(settings_disp, selection_name, False);
+        Window xsettings_owner = select_xsettings_owner(settings_disp, xsettings_selection);
+
+        // Auto-repeat rate and delay changes are reported as XKB controls notifications.
+        int xkb_opcode, xkb_event_base = -1, xkb_error_base;
+        int xkb_major = XkbMajorVersion, xkb_minor = XkbMinorVersion;
+        if (!XkbQueryExtension(settings_disp, &xkb_opcode, &xkb_event_base, &xkb_error_base, &xkb_major, &xkb_minor)
+                || !XkbSelectEventDetails(settings_disp, XkbUseCoreKbd, XkbControlsNotify, XkbRepeatKeysMask, XkbRepeatKeysMask)) {
+            logger(LOG_LEVEL_WARN, "%s [%u]: Could not select XkbControlsNotify events!\n",
+                    __FUNCTION__, __LINE__);
+
+            xkb_event_base = -1;
+        } else if (!XkbSelectEvents(settings_disp, XkbUseCoreKbd,
+                XkbMapNotifyMask | XkbNewKeyboardNotifyMask, XkbMapNotifyMask | XkbNewKeyboardNotifyMask)) {
+            // Keyboard mapping changes are still reported as core MappingNotify events.
+            logger(LOG_LEVEL_WARN, "%s [%u]: Could not select XkbMapNotify events!\n",
+                    __FUNCTION__, __LINE__);
+        }
+
+        #ifdef USE_XRANDR
+        int xrandr_event_base = -1, xrandr_error_base;
+        if (XRRQueryExtension(settings_disp, &xrandr_event_base, &xrandr_error_base)) {
+            XRRSelectInput(settings_disp, root, RRScreenChangeNotifyMask);
+        } else {
+            logger(LOG_LEVEL_WARN, "%s [%u]: XRandR is not currently available!\n",
+                    __FUNCTION__, __LINE__);
+
+            xrandr_event_base = -1;
+        }
+        #endif
+
+        // Resizing the root window is reported without XRandR as well.
+        track_screen_changes(true);
+        track_property_changes(true);
+        track_button_map_changes(true);
 
-            XEvent ev;
+        XEvent ev;
 
-            while(settings_disp != NULL) {
-                XNextEvent(settings_disp, &ev);
+        while(settings_disp != NULL) {
+            XNextEvent(settings_disp, &ev);
 
-                if (ev.type == event_base + RRScreenChangeNotifyMask) {
-                    logger(LOG_LEVEL_DEBUG, "%s [%u]: Received XRRScreenChangeNotifyEvent.\n",
+            #ifdef USE_XRANDR
+            if (xrandr_event_base >= 0 && ev.type == xrandr_event_base + RRScreenChangeNotify) {
+                logger(LOG_LEVEL_DEBUG, "%s [%u]: Received XRRScreenChangeNotifyEvent.\n",
+                        __FUNCTION__, __LINE__);
+
+                pthread_mutex_lock(&xrandr_mutex);
+                if (xrandr_resources != NULL) {
+                    XRRFreeScreenResources(xrandr_resources);
+                }
+
+                xrandr_resources = XRRGetScreenResources(settings_disp, root);
+                if (xrandr_resources == NULL) {
+                    logger(LOG_LEVEL_WARN, "%s [%u]: XRandR could not get screen resources!\n",
                             __FUNCTION__, __LINE__);
+                }
+                pthread_mutex_unlock(&xrandr_mutex);
 
-                    pthread_mutex_lock(&xrandr_mutex);
-                    if (xrandr_resources != NULL) {
-                        XRRFreeScreenResources(xrandr_resources);
-                    }
+                invalidate_screen_cache();
+                continue;
+            }
+            #endif
 
-                    xrandr_resources = XRRGetScreenResources(settings_disp, root);
-                    if (xrandr_resources == NULL) {
-                        logger(LOG_LEVEL_WARN, "%s [%u]: XRandR could not get screen resources!\n",
-                                __FUNCTION__, __LINE__);
-                    }
-                    pthread_mutex_unlock(&xrandr_mutex);
+            if (ev.type == PropertyNotify) {
+                if ((ev.xproperty.window == root && ev.xproperty.atom == resource_manager)
+                        || (ev.xproperty.window == xsettings_owner && ev.xproperty.atom == xsettings)) {
+                    invalidate_property_cache();
+                }
+            } else if (ev.type == ClientMessage && ev.xclient.message_type == manager
+                    && (Atom) ev.xclient.data.l[1] == xsettings_selection) {
+                // A new XSETTINGS manager has taken ownership of the selection.
+                xsettings_owner = select_xsettings_owner(settings_disp, xsettings_selection);
+                invalidate_property_cache();
+            } else if (ev.type == DestroyNotify && ev.xdestroywindow.window == xsettings_owner) {
+                xsettings_owner = None;
+            } else if (ev.type == ConfigureNotify && ev.xconfigure.window == root) {
+                invalidate_screen_cache();
+            } else if (ev.type == MappingNotify) {
+                if (ev.xmapping.request == MappingPointer) {
+                    invalidate_button_map();
                 } else {
-                    logger(LOG_LEVEL_WARN, "%s [%u]: XRandR is not currently available!\n",
-                            __FUNCTION__, __LINE__);
+                    XRefreshKeyboardMapping(&ev.xmapping);
+                    invalidate_keysym_cache();
+                }
+            } else if (xkb_event_base >= 0 && ev.type == xkb_event_base) {
+                switch (((XkbEvent *) &ev)->any.xkb_type) {
+                    case XkbControlsNotify:
+                        invalidate_property_cache();
+                        break;
+
+                    case XkbMapNotify:
+                    case XkbNewKeyboardNotify:
+                        invalidate_keysym_cache();
+                        break;
                 }
             }
         }
@@ -117,9 +221,8 @@ static void *settings_thread_proc(void *arg) {
 
     return NULL;
 }
-#endif
 
-UIOHOOK_API screen_data* hook_create_screen_info(unsigned char *count) {
+screen_data* query_screen_info(unsigned char *count) {
     *count = 0;
     screen_data *screens = NULL;
 
@@ -220,7 +323,7 @@ UIOHOOK_API screen_data* hook_create_screen_info(unsigned char *count) {
     return screens;
 }
 
-UIOHOOK_API long int hook_get_auto_repeat_rate() {
+static long int query_auto_repeat_rate() {
     bool successful = false;
     long int value = -1;
     unsigned int delay = 0, rate = 0;
@@ -263,7 +366,7 @@ UIOHOOK_API long int hook_get_auto_repeat_rate() {
     return value;
 }
 
-UIOHOOK_API long int hook_get_auto_repeat_delay() {
+static long int query_auto_repeat_delay() {
     bool successful = false;
     long int value = -1;
     unsigned int delay = 0, rate = 0;
@@ -306,7 +409,7 @@ UIOHOOK_API long int hook_get_auto_repeat_delay() {
     return value;
 }
 
-UIOHOOK_API long int hook_get_pointer_acceleration_multiplier() {
+static long int query_pointer_acceleration_multiplier() {
     long int value = -1;
     int accel_numerator, accel_denominator, threshold;
 
@@ -327,7 +430,7 @@ UIOHOOK_API long int hook_get_pointer_acceleration_multiplier() {
     return value;
 }
 
-UIOHOOK_API long int hook_get_pointer_acceleration_threshold() {
+static long int query_pointer_acceleration_threshold() {
     long int value = -1;
     int accel_numerator, accel_denominator, threshold;
 
@@ -348,7 +451,7 @@ UIOHOOK_API long int hook_get_pointer_acceleration_threshold() {
     return value;
 }
 
-UIOHOOK_API long int hook_get_pointer_sensitivity() {
+static long int query_pointer_sensitivity() {
     long int value = -1;
     int accel_numerator, accel_denominator, threshold;
 
@@ -369,7 +472,7 @@ UIOHOOK_API long int hook_get_pointer_sensitivity() {
     return value;
 }
 
-UIOHOOK_API long int hook_get_multi_click_time() {
+static long int query_multi_click_time() {
     long int value = 200;
     int click_time;
     bool successful = false;
@@ -428,12 +531,42 @@ UIOHOOK_API long int hook_get_multi_click_time() {
     return value;
 }
 
+// Property values are cached until the platform reports a settings change.
+UIOHOOK_API long int hook_get_auto_repeat_rate() {
+    return get_cached_property(PROPERTY_AUTO_REPEAT_RATE, query_auto_repeat_rate);
+}
+
+UIOHOOK_API long int hook_get_auto_repeat_delay() {
+    return get_cached_property(PROPERTY_AUTO_REPEAT_DELAY, query_auto_repeat_delay);
+}
+
+// XChangePointerControl() is not announced to other clients, so the pointer
+// control values are always queried from the server.
+UIOHOOK_API long int hook_get_pointer_acceleration_multiplier() {
+    return query_pointer_acceleration_multiplier();
+}
+
+UIOHOOK_API long int hook_get_pointer_acceleration_threshold() {
+    return query_pointer_acceleration_threshold();
+}
+
+UIOHOOK_API long int hook_get_pointer_sensitivity() {
+    return query_pointer_sensitivity();
+}
+
+UIOHOOK_API long int hook_get_multi_click_time() {
+    return get_cached_property(PROPERTY_MULTI_CLICK_TIME, query_multi_click_time);
+}
+
 // Create a shared object constructor.
 __attribute__ ((constructor))
 void on_library_load() {
     // Make sure we are initialized for threading.
     XInitThreads();
 
+    // Events can be posted before the first hook selects a scancode table.
+    load_keycode_table();
+
     // Open local display.
     helper_disp = XOpenDisplay(XDisplayName(NULL));
     if (helper_disp == NULL) {
@@ -444,7 +577,6 @@ void on_library_load() {
                 __FUNCTION__, __LINE__, "XOpenDisplay success.");
     }
 
-    #ifdef USE_XRANDR
     // Create the thread attribute.
     pthread_attr_t settings_thread_attr;
     pthread_attr_init(&settings_thread_attr);
@@ -460,7 +592,6 @@ void on_library_load() {
 
     // Make sure the thread attribute is removed.
     pthread_attr_destroy(&settings_thread_attr);
-    #endif
 
     #ifdef USE_XT
     XtToolkitInitialize();
@@ -0,0 +1,1097 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <uiohook.h>
+#include <unistd.h>
+
+#ifdef USE_EPOCH_TIME
+#include <sys/time.h>
+#endif
+
+#include <xcb/xkb.h>
+#include <X11/XKBlib.h>
+
+#include <X11/keysym.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/XInput2.h>
+
+#if defined(USE_XINERAMA) && !defined(USE_XRANDR)
+#include <X11/extensions/Xinerama.h>
+#elif defined(USE_XRANDR)
+#include <X11/extensions/Xrandr.h>
+#endif
+
+#include "dispatch_event.h"
+#include "event_clock.h"
+#include "hook_context.h"
+#include "hook_stats.h"
+#include "logger.h"
+#include "input_helper.h"
+#include "key_state.h"
+#include "property_cache.h"
+
+// Maximum number of source devices whose valuator modes are remembered.
+#define XINPUT_MAX_SOURCES 16
+
+// How the X and Y valuators of a slave device report motion.
+typedef struct _source_device {
+    int deviceid;
+    bool is_absolute;
+    double min_x, max_x;
+    double min_y, max_y;
+} source_device;
+
+typedef struct _hook_info {
+    Display *display;
+    int xi_opcode;
+    // Pipe written by hook_stop() to wake the event loop.
+    int stop_fd[2];
+    struct _input {
+        #ifdef USE_XKB_COMMON
+        xcb_connection_t *connection;
+        struct xkb_context *context;
+        #else
+        int xkb_event_base;
+        #endif
+        uint16_t mask;
+        struct _pointer {
+            int deviceid;
+            int16_t x;
+            int16_t y;
+            // The root position is followed from the raw motion valuators at
+            // full precision and only rounded for the delivered events.
+            double root_x;
+            double root_y;
+            bool is_moved;
+            uint64_t time;
+            uint64_t capture_time;
+        } pointer;
+        source_device sources[XINPUT_MAX_SOURCES];
+        size_t source_count;
+        struct _mouse {
+            bool is_dragged;
+            struct _click {
+                unsigned short int count;
+                long int time;
+                unsigned short int button;
+            } click;
+        } mouse;
+    } input;
+} hook_info;
+static hook_info *hook;
+
+#if defined(USE_XKB_COMMON)
+static struct xkb_state *state = NULL;
+
+// Keyboard mapping generation the xkb state was created for.
+static uint32_t state_generation = 0;
+#endif
+
+// Virtual event pointer.
+static uiohook_event event;
+
+// Set the native modifier mask for future events.
+static inline void set_modifier_mask(uint16_t mask) {
+    hook->input.mask |= mask;
+}
+
+// Unset the native modifier mask for future events.
+static inline void unset_modifier_mask(uint16_t mask) {
+    hook->input.mask &= ~mask;
+}
+
+// Get the current native modifier mask state.
+static inline uint16_t get_modifiers() {
+    return hook->input.mask;
+}
+
+#ifndef USE_XKB_COMMON
+// Raw events do not carry the core modifier state, rebuild it from our own mask.
+static unsigned int get_modifier_state() {
+    unsigned int modifier_state = 0x00;
+    uint16_t mask = get_modifiers();
+
+    if (mask & (MASK_SHIFT_L | MASK_SHIFT_R)) { modifier_state |= ShiftMask;   }
+    if (mask & (MASK_CTRL_L  | MASK_CTRL_R))  { modifier_state |= ControlMask; }
+    if (mask & (MASK_ALT_L   | MASK_ALT_R))   { modifier_state |= Mod1Mask;    }
+    if (mask & (MASK_META_L  | MASK_META_R))  { modifier_state |= Mod4Mask;    }
+    if (mask & MASK_CAPS_LOCK)                { modifier_state |= LockMask;    }
+    if (mask & MASK_NUM_LOCK)                 { modifier_state |= Mod2Mask;    }
+
+    return modifier_state;
+}
+
+// Set the modifier lock masks from a XKB indicator mask.
+static void set_lock_mask(unsigned int led_mask) {
+    if (led_mask & 0x01) {
+        set_modifier_mask(MASK_CAPS_LOCK);
+    } else {
+        unset_modifier_mask(MASK_CAPS_LOCK);
+    }
+
+    if (led_mask & 0x02) {
+        set_modifier_mask(MASK_NUM_LOCK);
+    } else {
+        unset_modifier_mask(MASK_NUM_LOCK);
+    }
+
+    if (led_mask & 0x04) {
+        set_modifier_mask(MASK_SCROLL_LOCK);
+    } else {
+        unset_modifier_mask(MASK_SCROLL_LOCK);
+    }
+}
+#endif
+
+// Initialize the modifier lock masks.
+static void initialize_locks() {
+    #ifdef USE_XKB_COMMON
+    if (xkb_state_led_name_is_active(state, XKB_LED_NAME_CAPS) > 0) {
+        set_modifier_mask(MASK_CAPS_LOCK);
+    } else {
+        unset_modifier_mask(MASK_CAPS_LOCK);
+    }
+
+    if (xkb_state_led_name_is_active(state, XKB_LED_NAME_NUM) > 0) {
+        set_modifier_mask(MASK_NUM_LOCK);
+    } else {
+        unset_modifier_mask(MASK_NUM_LOCK);
+    }
+
+    if (xkb_state_led_name_is_active(state, XKB_LED_NAME_SCROLL) > 0) {
+        set_modifier_mask(MASK_SCROLL_LOCK);
+    } else {
+        unset_modifier_mask(MASK_SCROLL_LOCK);
+    }
+    #else
+    unsigned int led_mask = 0x00;
+    if (XkbGetIndicatorState(hook->display, XkbUseCoreKbd, &led_mask) == Success) {
+        set_lock_mask(led_mask);
+    } else {
+        logger(LOG_LEVEL_WARN, "%s [%u]: XkbGetIndicatorState failed to get current led mask!\n",
+                __FUNCTION__, __LINE__);
+    }
+    #endif
+}
+
+// Initialize the modifier mask to the current modifiers.
+static void initialize_modifiers() {
+    hook->input.mask = query_modifier_mask(hook->display);
+    reset_key_state(hook->input.mask);
+
+    initialize_locks();
+}
+
+#ifdef USE_EPOCH_TIME
+static inline uint64_t get_unix_timestamp() {
+    struct timeval system_time;
+
+    // Get the local system time in UTC.
+    gettimeofday(&system_time, NULL);
+
+    // Convert the local system time to a Unix epoch in MS.
+    return (system_time.tv_sec * 1000) + (system_time.tv_usec / 1000);
+}
+#endif
+
+UIOHOOK_API uint64_t hook_capture_time_to_event_time(uint64_t capture_time) {
+    #ifdef USE_EPOCH_TIME
+    return (uint64_t) ((int64_t) capture_time + get_realtime_offset()) / NSEC_PER_MSEC;
+    #else
+    // NOTE Xorg derives the server time from CLOCK_MONOTONIC, so this only holds
+    // when the server runs on this machine.
+    return (uint64_t) (uint32_t) (capture_time / NSEC_PER_MSEC);
+    #endif
+}
+
+// Round a root window coordinate to the nearest pixel and apply the screen offset.
+static inline int16_t to_event_coordinate(double value, int16_t offset) {
+    long int rounded = (long int) (value < 0 ? value - 0.5 : value + 0.5) - offset;
+
+    if (rounded > INT16_MAX) {
+        rounded = INT16_MAX;
+    } else if (rounded < INT16_MIN) {
+        rounded = INT16_MIN;
+    }
+
+    return (int16_t) rounded;
+}
+
+// Round the root position to the event coordinates.
+static void update_pointer() {
+    int16_t offset_x = 0, offset_y = 0;
+
+    #if defined(USE_XINERAMA) || defined(USE_XRANDR)
+    const screen_snapshot *snapshot = hook_acquire_screen_snapshot();
+    if (snapshot != NULL) {
+        if (snapshot->count > 1) {
+            offset_x = snapshot->screens[0].x;
+            offset_y = snapshot->screens[0].y;
+        }
+
+        hook_release_screen_snapshot(snapshot);
+    }
+    #endif
+
+    hook->input.pointer.x = to_event_coordinate(hook->input.pointer.root_x, offset_x);
+    hook->input.pointer.y = to_event_coordinate(hook->input.pointer.root_y, offset_y);
+}
+
+// Refresh the root position from the server.  This is a round trip, so it is
+// only used where raw motion can not tell where the pointer is.
+static void query_pointer() {
+    Window root, child;
+    double root_x, root_y, win_x, win_y;
+    XIButtonState buttons;
+    XIModifierState modifiers;
+    XIGroupState group;
+
+    if (XIQueryPointer(hook->display, hook->input.pointer.deviceid, DefaultRootWindow(hook->display),
+            &root, &child, &root_x, &root_y, &win_x, &win_y, &buttons, &modifiers, &group)) {
+        hook->input.pointer.root_x = root_x;
+        hook->input.pointer.root_y = root_y;
+        update_pointer();
+
+        if (buttons.mask != NULL) {
+            XFree(buttons.mask);
+        }
+    } else {
+        logger(LOG_LEVEL_WARN, "%s [%u]: XIQueryPointer failed for device %i!\n",
+                __FUNCTION__, __LINE__, hook->input.pointer.deviceid);
+    }
+}
+
+// Look up how the valuators of a source device report motion, the device is
+// only queried the first time it moves the pointer.
+static source_device * get_source_device(int deviceid) {
+    for (size_t i = 0; i < hook->input.source_count && i < XINPUT_MAX_SOURCES; i++) {
+        if (hook->input.sources[i].deviceid == deviceid) {
+            return &hook->input.sources[i];
+        }
+    }
+
+    // Replace the oldest device once the table is full.
+    source_device *source = &hook->input.sources[hook->input.source_count++ % XINPUT_MAX_SOURCES];
+    source->deviceid = deviceid;
+    source->is_absolute = false;
+
+    int count = 0;
+    XIDeviceInfo *info = XIQueryDevice(hook->display, deviceid, &count);
+    if (info != NULL) {
+        for (int i = 0; i < info->num_classes; i++) {
+            XIValuatorClassInfo *valuator = (XIValuatorClassInfo *) info->classes[i];
+            if (valuator->type == XIValuatorClass && valuator->mode == XIModeAbsolute
+                    && valuator->max > valuator->min) {
+                if (valuator->number == 0) {
+                    source->min_x = valuator->min;
+                    source->max_x = valuator->max;
+                    source->is_absolute = true;
+                } else if (valuator->number == 1) {
+                    source->min_y = valuator->min;
+                    source->max_y = valuator->max;
+                }
+            }
+        }
+
+        XIFreeDeviceInfo(info);
+    } else {
+        logger(LOG_LEVEL_WARN, "%s [%u]: XIQueryDevice failed for device %i!\n",
+                __FUNCTION__, __LINE__, deviceid);
+    }
+
+    // Both axes must be absolute to map the device onto the screen.
+    if (source->is_absolute && !(source->max_y > source->min_y)) {
+        source->is_absolute = false;
+    }
+
+    return source;
+}
+
+// Returns the value of a valuator, the values only hold the valuators set in the mask.
+static bool get_valuator(XIValuatorState *valuators, int number, double *value) {
+    if (number >= valuators->mask_len * 8 || !XIMaskIsSet(valuators->mask, number)) {
+        return false;
+    }
+
+    const double *values = valuators->values;
+    for (int i = 0; i < number; i++) {
+        if (XIMaskIsSet(valuators->mask, i)) {
+            values++;
+        }
+    }
+
+    *value = *values;
+
+    return true;
+}
+
+static inline double clamp_root(double value, int size) {
+    if (value < 0) {
+        value = 0;
+    } else if (value > size - 1) {
+        value = size - 1;
+    }
+
+    return value;
+}
+
+// Follow the pointer from the raw motion without asking the server.  The
+// valuators of a relative device hold the accelerated delta, those of an
+// absolute device the position within its range.
+// NOTE Pointer warps by other clients are not reported as raw motion.
+static void move_pointer(XIRawEvent *raw) {
+    source_device *source = get_source_device(raw->sourceid);
+    int width = DisplayWidth(hook->display, DefaultScreen(hook->display));
+    int height = DisplayHeight(hook->display, DefaultScreen(hook->display));
+
+    double value;
+    if (get_valuator(&raw->valuators, 0, &value)) {
+        if (source->is_absolute) {
+            hook->input.pointer.root_x = (value - source->min_x) * (width - 1) / (source->max_x - source->min_x);
+        } else {
+            hook->input.pointer.root_x += value;
+        }
+        hook->input.pointer.root_x = clamp_root(hook->input.pointer.root_x, width);
+    }
+
+    if (get_valuator(&raw->valuators, 1, &value)) {
+        if (source->is_absolute) {
+            hook->input.pointer.root_y = (value - source->min_y) * (height - 1) / (source->max_y - source->min_y);
+        } else {
+            hook->input.pointer.root_y += value;
+        }
+        hook->input.pointer.root_y = clamp_root(hook->input.pointer.root_y, height);
+    }
+}
+
+// Deliver the motion collected since the last pointer event, if any.
+static void flush_motion() {
+    if (!hook->input.pointer.is_moved) {
+        return;
+    }
+
+    hook->input.pointer.is_moved = false;
+    update_pointer();
+
+    uint64_t timestamp = hook->input.pointer.time;
+
+    // Reset the click count.
+    if (hook->input.mouse.click.count != 0 && (long int) (timestamp - hook->input.mouse.click.time) > hook_get_multi_click_time()) {
+        hook->input.mouse.click.count = 0;
+    }
+
+    // Populate mouse move event.
+    event.time = timestamp;
+    event.capture_time = hook->input.pointer.capture_time;
+    event.reserved = 0x00;
+
+    event.mask = get_modifiers();
+
+    // Check the upper half of virtual modifiers for non-zero values and set the mouse
+    // dragged flag.  The last 3 bits are reserved for lock masks.
+    hook->input.mouse.is_dragged = ((event.mask & 0x1F00) > 0);
+    if (hook->input.mouse.is_dragged) {
+        // Create Mouse Dragged event.
+        event.type = EVENT_MOUSE_DRAGGED;
+    } else {
+        // Create a Mouse Moved event.
+        event.type = EVENT_MOUSE_MOVED;
+    }
+
+    event.data.mouse.button = MOUSE_NOBUTTON;
+    event.data.mouse.clicks = hook->input.mouse.click.count;
+    event.data.mouse.x = hook->input.pointer.x;
+    event.data.mouse.y = hook->input.pointer.y;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Mouse %s to %i, %i. (%#X)\n",
+            __FUNCTION__, __LINE__, hook->input.mouse.is_dragged ? "dragged" : "moved",
+            event.data.mouse.x, event.data.mouse.y, event.mask);
+
+    // Fire mouse move event.
+    dispatch_event(&event);
+}
+
+static void process_key(XIRawEvent *raw, uint64_t timestamp) {
+    bool is_press = raw->evtype == XI_RawKeyPress;
+
+    #ifdef USE_XKB_COMMON
+    // Recreate the xkb state if the keyboard mapping has changed.
+    uint32_t generation = get_keymap_generation();
+    if (state_generation != generation) {
+        if (state != NULL) {
+            destroy_xkb_state(state);
+        }
+
+        state = create_xkb_state(hook->input.context, hook->input.connection);
+        state_generation = generation;
+    }
+    #endif
+
+    // The X11 KeyCode associated with this event.
+    KeyCode keycode = (KeyCode) raw->detail;
+    KeySym keysym = 0x00;
+
+    // Check to make sure the key is printable.
+    uint16_t buffer[2];
+    #if defined(USE_XKB_COMMON)
+    size_t count = keycode_to_keysym_unicode(state, keycode, &keysym, buffer, sizeof(buffer) / sizeof(uint16_t));
+    #else
+    size_t count = keycode_to_keysym_unicode(keycode, get_modifier_state(), &keysym, buffer, sizeof(buffer) / sizeof(uint16_t));
+    #endif
+
+    unsigned short int scancode = keycode_to_scancode(keycode);
+
+    uint16_t modifier = 0x0000;
+    if      (scancode == VC_SHIFT_L)   { modifier = MASK_SHIFT_L; }
+    else if (scancode == VC_SHIFT_R)   { modifier = MASK_SHIFT_R; }
+    else if (scancode == VC_CONTROL_L) { modifier = MASK_CTRL_L;  }
+    else if (scancode == VC_CONTROL_R) { modifier = MASK_CTRL_R;  }
+    else if (scancode == VC_ALT_L)     { modifier = MASK_ALT_L;   }
+    else if (scancode == VC_ALT_R)     { modifier = MASK_ALT_R;   }
+    else if (scancode == VC_META_L)    { modifier = MASK_META_L;  }
+    else if (scancode == VC_META_R)    { modifier = MASK_META_R;  }
+
+    if (is_press) {
+        set_modifier_mask(modifier);
+    } else {
+        unset_modifier_mask(modifier);
+    }
+
+    #ifdef USE_XKB_COMMON
+    // The xkb state is maintained locally, so this does not hit the server.
+    xkb_state_update_key(state, keycode, is_press ? XKB_KEY_DOWN : XKB_KEY_UP);
+    initialize_locks();
+    #else
+    // Indicator changes made by other clients arrive as XkbIndicatorStateNotify,
+    // only our own lock key presses need to be resynchronized here.
+    if (is_press && (scancode == VC_CAPS_LOCK || scancode == VC_NUM_LOCK || scancode == VC_SCROLL_LOCK)) {
+        initialize_locks();
+    }
+    #endif
+
+    if ((get_modifiers() & MASK_NUM_LOCK) == 0) {
+        switch (scancode) {
+            case VC_KP_SEPARATOR:
+            case VC_KP_1:
+            case VC_KP_2:
+            case VC_KP_3:
+            case VC_KP_4:
+            case VC_KP_5:
+            case VC_KP_6:
+            case VC_KP_7:
+            case VC_KP_8:
+            case VC_KP_0:
+            case VC_KP_9:
+                scancode |= 0xEE00;
+                break;
+        }
+    }
+
+    // Populate key pressed or released event.
+    event.time = timestamp;
+    event.reserved = 0x00;
+
+    event.type = is_press ? EVENT_KEY_PRESSED : EVENT_KEY_RELEASED;
+    event.mask = get_modifiers();
+
+    event.data.keyboard.keycode = scancode;
+    event.data.keyboard.rawcode = keysym;
+    event.data.keyboard.keychar = CHAR_UNDEFINED;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Key %#X %s. (%#X)\n",
+            __FUNCTION__, __LINE__, event.data.keyboard.keycode,
+            is_press ? "pressed" : "released", event.data.keyboard.rawcode);
+
+    // Fire key pressed or released event.
+    dispatch_event(&event);
+
+    // If the pressed event was not consumed...
+    if (is_press && event.reserved ^ 0x01) {
+        for (unsigned int i = 0; i < count; i++) {
+            // Populate key typed event.
+            event.time = timestamp;
+            event.reserved = 0x00;
+
+            event.type = EVENT_KEY_TYPED;
+            event.mask = get_modifiers();
+
+            event.data.keyboard.keycode = VC_UNDEFINED;
+            event.data.keyboard.rawcode = keysym;
+            event.data.keyboard.keychar = buffer[i];
+
+            logger(LOG_LEVEL_DEBUG, "%s [%u]: Key %#X typed. (%lc)\n",
+                    __FUNCTION__, __LINE__, event.data.keyboard.keycode, (uint16_t) event.data.keyboard.keychar);
+
+            // Fire key typed event.
+            dispatch_event(&event);
+        }
+    }
+}
+
+static void process_wheel(unsigned int map_button, uint64_t timestamp) {
+    // Reset the click count and previous button.
+    hook->input.mouse.click.count = 1;
+    hook->input.mouse.click.button = MOUSE_NOBUTTON;
+
+    // Populate mouse wheel event.
+    event.time = timestamp;
+    event.reserved = 0x00;
+
+    event.type = EVENT_MOUSE_WHEEL;
+    event.mask = get_modifiers();
+
+    event.data.wheel.clicks = hook->input.mouse.click.count;
+    event.data.wheel.x = hook->input.pointer.x;
+    event.data.wheel.y = hook->input.pointer.y;
+
+    // Raw button events only report the emulated wheel buttons, use the same
+    // unit scroll defaults as the XRecord hook.
+    event.data.wheel.type = WHEEL_UNIT_SCROLL;
+    event.data.wheel.amount = 3;
+
+    if (map_button == WheelUp || map_button == WheelLeft) {
+        // Wheel Rotated Up and Away.
+        event.data.wheel.rotation = -1;
+    } else { // map_button == WheelDown || map_button == WheelRight
+        // Wheel Rotated Down and Towards.
+        event.data.wheel.rotation = 1;
+    }
+
+    if (map_button == WheelUp || map_button == WheelDown) {
+        // Wheel Rotated Up or Down.
+        event.data.wheel.direction = WHEEL_VERTICAL_DIRECTION;
+    } else { // map_button == WheelLeft || map_button == WheelRight
+        // Wheel Rotated Left or Right.
+        event.data.wheel.direction = WHEEL_HORIZONTAL_DIRECTION;
+    }
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Mouse wheel type %u, rotated %i units in the %u direction at %u, %u.\n",
+            __FUNCTION__, __LINE__, event.data.wheel.type,
+            event.data.wheel.amount * event.data.wheel.rotation,
+            event.data.wheel.direction,
+            event.data.wheel.x, event.data.wheel.y);
+
+    // Fire mouse wheel event.
+    dispatch_event(&event);
+}
+
+static void process_button(XIRawEvent *raw, uint64_t timestamp) {
+    bool is_press = raw->evtype == XI_RawButtonPress;
+    unsigned int map_button = button_map_lookup(raw->detail);
+
+    // X11 handles wheel events as button events.
+    if (map_button == WheelUp || map_button == WheelDown
+            || map_button == WheelLeft || map_button == WheelRight) {
+        if (is_press) {
+            process_wheel(map_button, timestamp);
+        }
+
+        return;
+    }
+
+    /* This information is all static for X11, its up to the WM to
+     * decide how to interpret the wheel events.
+     */
+    uint16_t button = MOUSE_NOBUTTON;
+    uint16_t modifier = 0x0000;
+    switch (map_button) {
+        case Button1:
+            button = MOUSE_BUTTON1;
+            modifier = MASK_BUTTON1;
+            break;
+
+        case Button2:
+            button = MOUSE_BUTTON2;
+            modifier = MASK_BUTTON2;
+            break;
+
+        case Button3:
+            button = MOUSE_BUTTON3;
+            modifier = MASK_BUTTON3;
+            break;
+
+        case XButton1:
+            button = MOUSE_BUTTON4;
+            modifier = MASK_BUTTON5;
+            break;
+
+        case XButton2:
+            button = MOUSE_BUTTON5;
+            modifier = MASK_BUTTON5;
+            break;
+
+        default:
+            // Do not set modifier masks past button MASK_BUTTON5.
+            break;
+    }
+
+    if (is_press) {
+        set_modifier_mask(modifier);
+
+        // Track the number of clicks, the button must match the previous button.
+        if (button == hook->input.mouse.click.button && (long int) (timestamp - hook->input.mouse.click.time) <= hook_get_multi_click_time()) {
+            if (hook->input.mouse.click.count < USHRT_MAX) {
+                hook->input.mouse.click.count++;
+            } else {
+                logger(LOG_LEVEL_WARN, "%s [%u]: Click count overflow detected!\n",
+                        __FUNCTION__, __LINE__);
+            }
+        } else {
+            // Reset the click count.
+            hook->input.mouse.click.count = 1;
+
+            // Set the previous button.
+            hook->input.mouse.click.button = button;
+        }
+
+        // Save this events time to calculate the hook->input.mouse.click.count.
+        hook->input.mouse.click.time = timestamp;
+    } else {
+        unset_modifier_mask(modifier);
+    }
+
+    // Populate mouse pressed or released event.
+    event.time = timestamp;
+    event.reserved = 0x00;
+
+    event.type = is_press ? EVENT_MOUSE_PRESSED : EVENT_MOUSE_RELEASED;
+    event.mask = get_modifiers();
+
+    event.data.mouse.button = button;
+    event.data.mouse.clicks = hook->input.mouse.click.count;
+    event.data.mouse.x = hook->input.pointer.x;
+    event.data.mouse.y = hook->input.pointer.y;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Button %u %s %u time(s). (%u, %u)\n",
+            __FUNCTION__, __LINE__, event.data.mouse.button,
+            is_press ? "pressed" : "released", event.data.mouse.clicks,
+            event.data.mouse.x, event.data.mouse.y);
+
+    // Fire mouse pressed or released event.
+    dispatch_event(&event);
+
+    if (!is_press) {
+        // If the released event was not consumed...
+        if (event.reserved ^ 0x01 && hook->input.mouse.is_dragged != true) {
+            // Populate mouse clicked event.
+            event.time = timestamp;
+            event.reserved = 0x00;
+
+            event.type = EVENT_MOUSE_CLICKED;
+            event.mask = get_modifiers();
+
+            event.data.mouse.button = button;
+            event.data.mouse.clicks = hook->input.mouse.click.count;
+            event.data.mouse.x = hook->input.pointer.x;
+            event.data.mouse.y = hook->input.pointer.y;
+
+            logger(LOG_LEVEL_DEBUG, "%s [%u]: Button %u clicked %u time(s). (%u, %u)\n",
+                    __FUNCTION__, __LINE__, event.data.mouse.button,
+                    event.data.mouse.clicks,
+                    event.data.mouse.x, event.data.mouse.y);
+
+            // Fire mouse clicked event.
+            dispatch_event(&event);
+        }
+
+        // Reset the number of clicks.
+        if (button == hook->input.mouse.click.button && (long int) (event.time - hook->input.mouse.click.time) > hook_get_multi_click_time()) {
+            // Reset the click count.
+            hook->input.mouse.click.count = 0;
+        }
+    }
+}
+
+static void process_raw_event(XIRawEvent *raw) {
+    #ifdef USE_EPOCH_TIME
+    uint64_t timestamp = get_unix_timestamp();
+    #else
+    uint64_t timestamp = (uint64_t) raw->time;
+    #endif
+
+    // The raw event only carries the millisecond server time, so events are
+    // captured with the time the client received them.
+    event.capture_time = get_monotonic_time();
+
+    // NOTE Xorg stamps events with CLOCK_MONOTONIC milliseconds, so the lag
+    // is only meaningful when the server runs on this machine.
+    uint32_t server_now = (uint32_t) (event.capture_time / NSEC_PER_MSEC);
+    stats_record_lag((uint64_t) (uint32_t) (server_now - (uint32_t) raw->time) * 1000);
+
+    if (raw->evtype == XI_RawMotion) {
+        // Collapse all motion up to the next pointer or key event.
+        hook->input.pointer.deviceid = raw->deviceid;
+        move_pointer(raw);
+        hook->input.pointer.is_moved = true;
+        hook->input.pointer.time = timestamp;
+        hook->input.pointer.capture_time = event.capture_time;
+        return;
+    }
+
+    // Keep the motion in order with the event that follows it.
+    uint64_t capture_time = event.capture_time;
+    flush_motion();
+    event.capture_time = capture_time;
+
+    if (raw->evtype == XI_RawKeyPress || raw->evtype == XI_RawKeyRelease) {
+        process_key(raw, timestamp);
+    } else if (raw->evtype == XI_RawButtonPress || raw->evtype == XI_RawButtonRelease) {
+        // Without motion events the position is never followed, and a press
+        // picks up any warp by another client.
+        if (!(get_event_mask() & EVENT_MASK_MOUSE_MOTION) || raw->evtype == XI_RawButtonPress) {
+            hook->input.pointer.deviceid = raw->deviceid;
+            query_pointer();
+        }
+
+        process_button(raw, timestamp);
+    } else {
+        // In theory this *should* never execute.
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: Unhandled XInput2 event: %#X.\n",
+                __FUNCTION__, __LINE__, (unsigned int) raw->evtype);
+    }
+}
+
+static void process_events() {
+    // XPending() only reads from the socket when the queue is empty, so all
+    // events the server has already sent are handled in one batch.
+    while (XPending(hook->display) > 0) {
+        XEvent ev;
+        XNextEvent(hook->display, &ev);
+
+        if (ev.type == GenericEvent && ev.xcookie.extension == hook->xi_opcode) {
+            if (XGetEventData(hook->display, &ev.xcookie)) {
+                process_raw_event((XIRawEvent *) ev.xcookie.data);
+                XFreeEventData(hook->display, &ev.xcookie);
+            }
+        }
+        #ifndef USE_XKB_COMMON
+        else if (ev.type == hook->input.xkb_event_base
+                && ((XkbAnyEvent *) &ev)->xkb_type == XkbIndicatorStateNotify) {
+            // Apply indicator changes made by other clients.
+            set_lock_mask(((XkbIndicatorNotifyEvent *) &ev)->state);
+        }
+        #endif
+    }
+}
+
+static int xinput_block() {
+    int status = UIOHOOK_SUCCESS;
+
+    struct pollfd fds[2] = {
+        { .fd = ConnectionNumber(hook->display), .events = POLLIN },
+        { .fd = hook->stop_fd[0], .events = POLLIN }
+    };
+
+    while (true) {
+        do {
+            process_events();
+
+            // Device and pointer queries may read more events into the queue.
+            flush_motion();
+        } while (XEventsQueued(hook->display, QueuedAlready) > 0);
+
+        // Deliver anything collected for the batch callback.
+        dispatch_flush();
+
+        int ready = poll(fds, 2, -1);
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            logger(LOG_LEVEL_ERROR, "%s [%u]: poll failure! (%i)\n",
+                    __FUNCTION__, __LINE__, errno);
+
+            status = UIOHOOK_FAILURE;
+            break;
+        }
+
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+
+        if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: Lost connection to the X server!\n",
+                    __FUNCTION__, __LINE__);
+
+            status = UIOHOOK_FAILURE;
+            break;
+        }
+    }
+
+    return status;
+}
+
+static int xinput_select() {
+    int status = UIOHOOK_FAILURE;
+
+    // Only select the raw events for the subscribed classes.  Mouse wheel
+    // events are button events on X11.
+    unsigned char mask[XIMaskLen(XI_RawMotion)] = { 0 };
+
+    uint32_t event_mask = get_event_mask();
+    if (event_mask & EVENT_MASK_KEYBOARD) {
+        XISetMask(mask, XI_RawKeyPress);
+        XISetMask(mask, XI_RawKeyRelease);
+    }
+
+    if (event_mask & (EVENT_MASK_MOUSE_BUTTON | EVENT_MASK_MOUSE_WHEEL)) {
+        XISetMask(mask, XI_RawButtonPress);
+        XISetMask(mask, XI_RawButtonRelease);
+    }
+
+    if (event_mask & EVENT_MASK_MOUSE_MOTION) {
+        XISetMask(mask, XI_RawMotion);
+    }
+
+    XIEventMask selection = {
+        .deviceid = XIAllMasterDevices,
+        .mask_len = sizeof(mask),
+        .mask = mask
+    };
+
+    if (XISelectEvents(hook->display, DefaultRootWindow(hook->display), &selection, 1) == Success) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: XISelectEvents successful.\n",
+                __FUNCTION__, __LINE__);
+
+        // Initialize native input helper functions.
+        load_input_helper();
+
+        // Start with the current pointer position for button events.
+        if (!XIGetClientPointer(hook->display, None, &hook->input.pointer.deviceid)) {
+            logger(LOG_LEVEL_WARN, "%s [%u]: XIGetClientPointer failure!\n",
+                    __FUNCTION__, __LINE__);
+        }
+        query_pointer();
+
+        // Make sure the selection is active before reporting the hook as enabled.
+        XSync(hook->display, False);
+
+        // Populate the hook start event.
+        #ifdef USE_EPOCH_TIME
+        event.time = get_unix_timestamp();
+        #else
+        event.time = hook_capture_time_to_event_time(get_monotonic_time());
+        #endif
+        event.capture_time = get_monotonic_time();
+        event.reserved = 0x00;
+
+        event.type = EVENT_HOOK_ENABLED;
+        event.mask = 0x00;
+
+        // Fire the hook start event.
+        dispatch_event(&event);
+
+        // Block until hook_stop() is called.
+        status = xinput_block();
+
+        // Populate the hook stop event.
+        #ifdef USE_EPOCH_TIME
+        event.time = get_unix_timestamp();
+        #else
+        event.time = hook_capture_time_to_event_time(get_monotonic_time());
+        #endif
+        event.capture_time = get_monotonic_time();
+        event.reserved = 0x00;
+
+        event.type = EVENT_HOOK_DISABLED;
+        event.mask = 0x00;
+
+        // Fire the hook stop event.
+        dispatch_event(&event);
+        dispatch_flush();
+
+        // Deinitialize native input helper functions.
+        unload_input_helper();
+    } else {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: XISelectEvents failure!\n",
+                __FUNCTION__, __LINE__);
+
+        status = UIOHOOK_ERROR_X_INPUT_SELECT_EVENTS;
+    }
+
+    return status;
+}
+
+static int xinput_query() {
+    int status = UIOHOOK_FAILURE;
+
+    // Check to make sure XInput 2.0 is installed and enabled.
+    int event_base, error_base;
+    int major = 2, minor = 0;
+    if (XQueryExtension(hook->display, "XInputExtension", &hook->xi_opcode, &event_base, &error_base)
+            && XIQueryVersion(hook->display, &major, &minor) == Success) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: XInput version: %i.%i.\n",
+                __FUNCTION__, __LINE__, major, minor);
+
+        status = xinput_select();
+    } else {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: XInput 2.0 is not currently available!\n",
+                __FUNCTION__, __LINE__);
+
+        status = UIOHOOK_ERROR_X_INPUT_NOT_FOUND;
+    }
+
+    return status;
+}
+
+static int xinput_start() {
+    int status = UIOHOOK_FAILURE;
+
+    // Open the display for XInput.  Unlike XRecord this connection is never
+    // synchronized, events are read in batches as the server sends them.
+    hook->display = XOpenDisplay(NULL);
+    if (hook->display != NULL) {
+        logger(LOG_LEVEL_DEBUG, "%s [%u]: XOpenDisplay successful.\n",
+                __FUNCTION__, __LINE__);
+
+        #if defined(USE_XKB_COMMON)
+        // Open XCB Connection
+        hook->input.connection = XGetXCBConnection(hook->display);
+        int xcb_status = xcb_connection_has_error(hook->input.connection);
+        if (xcb_status <= 0) {
+            // Initialize xkbcommon context.
+            hook->input.context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
+            if (hook->input.context == NULL) {
+                logger(LOG_LEVEL_ERROR, "%s [%u]: xkb_context_new failure!\n",
+                        __FUNCTION__, __LINE__);
+            }
+        } else {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: xcb_connect failure! (%d)\n",
+                    __FUNCTION__, __LINE__, xcb_status);
+        }
+
+        state = create_xkb_state(hook->input.context, hook->input.connection);
+        state_generation = get_keymap_generation();
+        #else
+        // Subscribe to indicator changes so the lock masks can be cached.
+        hook->input.xkb_event_base = -1;
+
+        int xkb_opcode, xkb_event_base, xkb_error_base;
+        int xkb_major = XkbMajorVersion, xkb_minor = XkbMinorVersion;
+        if (XkbQueryExtension(hook->display, &xkb_opcode, &xkb_event_base, &xkb_error_base, &xkb_major, &xkb_minor)
+                && XkbSelectEvents(hook->display, XkbUseCoreKbd, XkbIndicatorStateNotifyMask, XkbIndicatorStateNotifyMask)) {
+            hook->input.xkb_event_base = xkb_event_base;
+        } else {
+            logger(LOG_LEVEL_WARN, "%s [%u]: Could not select XkbIndicatorStateNotify events!\n",
+                    __FUNCTION__, __LINE__);
+        }
+        #endif
+
+        // Initialize starting modifiers.
+        initialize_modifiers();
+
+        status = xinput_query();
+
+        #ifdef USE_XKB_COMMON
+        if (state != NULL) {
+            destroy_xkb_state(state);
+            state = NULL;
+        }
+
+        if (hook->input.context != NULL) {
+            xkb_context_unref(hook->input.context);
+            hook->input.context = NULL;
+        }
+        #endif
+
+        XCloseDisplay(hook->display);
+        hook->display = NULL;
+    } else {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: XOpenDisplay failure!\n",
+                __FUNCTION__, __LINE__);
+
+        status = UIOHOOK_ERROR_X_OPEN_DISPLAY;
+    }
+
+    return status;
+}
+
+int run_native_hook() {
+    // Hook data for future cleanup.
+    hook = calloc(1, sizeof(hook_info));
+    if (hook == NULL) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to allocate memory for hook structure!\n",
+                __FUNCTION__, __LINE__);
+
+        return UIOHOOK_ERROR_OUT_OF_MEMORY;
+    }
+
+    hook->input.mouse.click.button = MOUSE_NOBUTTON;
+
+    // Pointer control changes are not announced, so start with fresh values.
+    invalidate_property_cache();
+
+    if (pipe(hook->stop_fd) != 0) {
+        logger(LOG_LEVEL_ERROR, "%s [%u]: pipe failure! (%i)\n",
+                __FUNCTION__, __LINE__, errno);
+
+        free(hook);
+        hook = NULL;
+
+        return UIOHOOK_FAILURE;
+    }
+
+    // Non-blocking so hook_stop() never waits on a full pipe.
+    for (int i = 0; i < 2; i++) {
+        fcntl(hook->stop_fd[i], F_SETFL, fcntl(hook->stop_fd[i], F_GETFL) | O_NONBLOCK);
+        fcntl(hook->stop_fd[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    int status = xinput_start();
+
+    close(hook->stop_fd[0]);
+    close(hook->stop_fd[1]);
+
+    // Free data associated with this hook.
+    free(hook);
+    hook = NULL;
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Something, something, something, complete.\n",
+            __FUNCTION__, __LINE__);
+
+    return status;
+}
+
+int stop_native_hook() {
+    int status = UIOHOOK_FAILURE;
+
+    if (hook != NULL && hook->display != NULL) {
+        // Wake the event loop so it returns.
+        char stop = 1;
+        if (write(hook->stop_fd[1], &stop, sizeof(stop)) == sizeof(stop) || errno == EAGAIN) {
+            status = UIOHOOK_SUCCESS;
+        } else {
+            logger(LOG_LEVEL_ERROR, "%s [%u]: Failed to wake the XInput loop! (%i)\n",
+                    __FUNCTION__, __LINE__, errno);
+        }
+    }
+
+    logger(LOG_LEVEL_DEBUG, "%s [%u]: Status: %#X.\n",
+            __FUNCTION__, __LINE__, status);
+
+    return status;
+}
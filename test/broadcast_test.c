@@ -0,0 +1,105 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <uiohook.h>
+
+#include "minunit.h"
+
+#define BROADCAST_TEST_NAME     "broadcast-test"
+#define BROADCAST_TEST_SLOTS    16
+
+static void fill_events(uiohook_event *events, size_t count, uint64_t first) {
+    memset(events, 0, sizeof(uiohook_event) * count);
+    for (size_t i = 0; i < count; i++) {
+        events[i].type = EVENT_KEY_PRESSED;
+        events[i].time = first + i;
+        events[i].data.keyboard.keycode = VC_A;
+    }
+}
+
+static char * test_broadcast_history() {
+    broadcast_publisher *publisher = hook_broadcast_open_publisher(BROADCAST_TEST_NAME, BROADCAST_TEST_SLOTS);
+    mu_assert("error, could not open broadcast publisher", publisher != NULL);
+
+    uiohook_event events[BROADCAST_TEST_SLOTS * 2];
+    fill_events(events, 4, 100);
+    mu_assert("error, could not publish events", hook_broadcast_publish(publisher, events, 4) == UIOHOOK_SUCCESS);
+
+    broadcast_subscriber *history = hook_broadcast_open_subscriber(BROADCAST_TEST_NAME, true);
+    broadcast_subscriber *live = hook_broadcast_open_subscriber(BROADCAST_TEST_NAME, false);
+    mu_assert("error, could not open broadcast subscribers", history != NULL && live != NULL);
+
+    uiohook_event received[BROADCAST_TEST_SLOTS * 2];
+    mu_assert("error, live subscriber saw earlier events", hook_broadcast_read(live, received, 8) == 0);
+    mu_assert("error, wait did not time out", hook_broadcast_wait(live, 0) == UIOHOOK_FAILURE);
+
+    size_t count = hook_broadcast_read(history, received, 8);
+    mu_assert("error, history subscriber missed events", count == 4);
+    for (size_t i = 0; i < count; i++) {
+        mu_assert("error, history event out of order", received[i].time == 100 + i);
+    }
+
+    fill_events(events, 2, 200);
+    hook_broadcast_publish(publisher, events, 2);
+    mu_assert("error, wait did not see new events", hook_broadcast_wait(live, 10) == UIOHOOK_SUCCESS);
+    mu_assert("error, live subscriber missed events", hook_broadcast_read(live, received, 8) == 2);
+    mu_assert("error, live event out of order", received[0].time == 200 && received[1].time == 201);
+    mu_assert("error, history subscriber missed new events", hook_broadcast_read(history, received, 8) == 2);
+
+    hook_broadcast_close_subscriber(live);
+    hook_broadcast_close_subscriber(history);
+    hook_broadcast_close_publisher(publisher);
+
+    return NULL;
+}
+
+static char * test_broadcast_lapped() {
+    broadcast_publisher *publisher = hook_broadcast_open_publisher(BROADCAST_TEST_NAME, BROADCAST_TEST_SLOTS);
+    mu_assert("error, could not open broadcast publisher", publisher != NULL);
+
+    broadcast_subscriber *subscriber = hook_broadcast_open_subscriber(BROADCAST_TEST_NAME, true);
+    mu_assert("error, could not open broadcast subscriber", subscriber != NULL);
+
+    // Publish more than the ring holds so the oldest events are overwritten.
+    uiohook_event events[BROADCAST_TEST_SLOTS + 5];
+    fill_events(events, BROADCAST_TEST_SLOTS + 5, 0);
+    hook_broadcast_publish(publisher, events, BROADCAST_TEST_SLOTS + 5);
+
+    uiohook_event received[BROADCAST_TEST_SLOTS + 5];
+    size_t count = hook_broadcast_read(subscriber, received, BROADCAST_TEST_SLOTS + 5);
+    mu_assert("error, lapped subscriber read the wrong number of events", count == BROADCAST_TEST_SLOTS);
+    mu_assert("error, lapped subscriber did not skip to the oldest event", received[0].time == 5);
+    mu_assert("error, lapped events were not counted as dropped", hook_broadcast_dropped(subscriber) == 5);
+
+    hook_broadcast_close_subscriber(subscriber);
+    hook_broadcast_close_publisher(publisher);
+
+    mu_assert("error, closed broadcast could still be opened", hook_broadcast_open_subscriber(BROADCAST_TEST_NAME, false) == NULL);
+
+    return NULL;
+}
+
+char * broadcast_tests() {
+    mu_run_test(test_broadcast_history);
+    mu_run_test(test_broadcast_lapped);
+
+    return NULL;
+}
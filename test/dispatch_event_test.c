@@ -0,0 +1,263 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <uiohook.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "dispatch_event.h"
+#include "event_clock.h"
+#include "minunit.h"
+
+static uiohook_event received[8];
+static volatile size_t received_count = 0;
+
+// Capture times of the test events are milliseconds after this monotonic time.
+static uint64_t capture_base = 0;
+
+static void record_proc(uiohook_event * const event, void *user_data) {
+    if (received_count < sizeof(received) / sizeof(uiohook_event)) {
+        received[received_count++] = *event;
+    }
+}
+
+static void send_event(event_type type, uint64_t time, int16_t x) {
+    uiohook_event event = { .type = type, .time = time, .capture_time = capture_base + time * NSEC_PER_MSEC };
+    event.data.mouse.x = x;
+
+    dispatch_event(&event);
+}
+
+static void sleep_ms(unsigned int ms) {
+    #ifdef _WIN32
+    Sleep(ms);
+    #else
+    struct timespec ts = { .tv_sec = ms / 1000, .tv_nsec = (long) (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+    #endif
+}
+
+static char * test_motion_coalescing() {
+    // The held motion deadline is far enough ahead of the real clock that
+    // only the events below deliver it.
+    capture_base = get_monotonic_time();
+    received_count = 0;
+    hook_set_dispatch_proc(record_proc, NULL);
+    hook_set_motion_coalescing(10 * 1000);
+
+    send_event(EVENT_MOUSE_MOVED, 100, 1);
+    mu_assert("error, first motion was held", received_count == 1);
+
+    send_event(EVENT_MOUSE_MOVED, 102, 2);
+    send_event(EVENT_MOUSE_MOVED, 105, 3);
+    mu_assert("error, motion inside the window was delivered", received_count == 1);
+
+    send_event(EVENT_MOUSE_PRESSED, 106, 3);
+    mu_assert("error, held motion was not flushed", received_count == 3);
+    mu_assert("error, held motion is not the latest", received[1].type == EVENT_MOUSE_MOVED && received[1].data.mouse.x == 3);
+    mu_assert("error, button event delivered out of order", received[2].type == EVENT_MOUSE_PRESSED);
+
+    send_event(EVENT_MOUSE_DRAGGED, 120, 4);
+    mu_assert("error, motion after the window was held", received_count == 4);
+
+    hook_set_motion_coalescing(0);
+    send_event(EVENT_MOUSE_DRAGGED, 121, 5);
+    mu_assert("error, motion held with coalescing disabled", received_count == 5);
+
+    hook_set_dispatch_proc(NULL, NULL);
+
+    return NULL;
+}
+
+static char * test_motion_trailing_edge() {
+    // Time the events on the real clock so the window runs out while waiting.
+    capture_base = get_monotonic_time();
+    received_count = 0;
+    hook_set_dispatch_proc(record_proc, NULL);
+    hook_set_motion_coalescing(10 * 1000);
+
+    send_event(EVENT_MOUSE_MOVED, 0, 1);
+    send_event(EVENT_MOUSE_MOVED, 1, 2);
+    mu_assert("error, motion inside the window was delivered", received_count == 1);
+
+    // The mouse stopped, the held position arrives once the window is over.
+    for (int i = 0; i < 1000 && received_count < 2; i++) {
+        sleep_ms(1);
+    }
+
+    hook_set_motion_coalescing(0);
+    hook_set_dispatch_proc(NULL, NULL);
+
+    mu_assert("error, held motion was not delivered after the window", received_count == 2);
+    mu_assert("error, trailing motion is not the latest", received[1].data.mouse.x == 2);
+
+    return NULL;
+}
+
+static char * test_event_mask() {
+    received_count = 0;
+    hook_set_dispatch_proc(record_proc, NULL);
+    hook_set_event_mask(EVENT_MASK_KEYBOARD | EVENT_MASK_MOUSE_BUTTON);
+
+    send_event(EVENT_MOUSE_MOVED, 200, 1);
+    send_event(EVENT_MOUSE_WHEEL, 201, 1);
+    mu_assert("error, unsubscribed event was delivered", received_count == 0);
+
+    send_event(EVENT_KEY_PRESSED, 202, 0);
+    send_event(EVENT_MOUSE_CLICKED, 203, 1);
+    mu_assert("error, subscribed event was dropped", received_count == 2);
+
+    hook_set_event_mask(0);
+    send_event(EVENT_HOOK_ENABLED, 204, 0);
+    mu_assert("error, hook state event was dropped", received_count == 3);
+
+    hook_set_event_mask(EVENT_MASK_ALL);
+    hook_set_dispatch_proc(NULL, NULL);
+
+    return NULL;
+}
+
+static void consume_proc(uiohook_event * const event, void *user_data) {
+    if (event->type == EVENT_KEY_PRESSED) {
+        event->reserved = 0x01;
+    }
+}
+
+static char * test_stats() {
+    hook_stats stats;
+
+    hook_set_dispatch_proc(consume_proc, NULL);
+    hook_reset_stats();
+
+    hook_get_stats(&stats);
+    mu_assert("error, stats not cleared by reset", stats.events[EVENT_MOUSE_MOVED] == 0 && stats.consumed == 0);
+
+    send_event(EVENT_KEY_PRESSED, 300, 0);
+    send_event(EVENT_KEY_RELEASED, 301, 0);
+    send_event(EVENT_MOUSE_MOVED, 302, 1);
+    send_event(EVENT_MOUSE_MOVED, 303, 2);
+
+    hook_get_stats(&stats);
+    mu_assert("error, key events not counted", stats.events[EVENT_KEY_PRESSED] == 1 && stats.events[EVENT_KEY_RELEASED] == 1);
+    mu_assert("error, motion events not counted", stats.events[EVENT_MOUSE_MOVED] == 2);
+    mu_assert("error, consumed event not counted", stats.consumed == 1);
+
+    uint64_t samples = 0;
+    for (size_t i = 0; i < HOOK_STATS_BUCKETS; i++) {
+        samples += stats.dispatch_time[i];
+    }
+    mu_assert("error, dispatcher time not sampled per event", samples == 4);
+
+    hook_reset_stats();
+    hook_get_stats(&stats);
+    mu_assert("error, stats not cleared by reset", stats.events[EVENT_KEY_PRESSED] == 0 && stats.consumed == 0);
+
+    hook_set_dispatch_proc(NULL, NULL);
+
+    return NULL;
+}
+
+static char * test_listen_only() {
+    hook_stats stats;
+
+    hook_set_dispatch_proc(consume_proc, NULL);
+    hook_set_listen_only(true);
+    hook_reset_stats();
+
+    uiohook_event event = { .type = EVENT_KEY_PRESSED, .time = 400 };
+    dispatch_event(&event);
+
+    hook_get_stats(&stats);
+    mu_assert("error, listen only event was consumed", (event.reserved & 0x01) == 0);
+    mu_assert("error, listen only event counted as consumed", stats.consumed == 0);
+
+    hook_set_listen_only(false);
+
+    event.reserved = 0x00;
+    dispatch_event(&event);
+    mu_assert("error, event not consumed after listen only was disabled", (event.reserved & 0x01) == 1);
+
+    hook_set_dispatch_proc(NULL, NULL);
+
+    return NULL;
+}
+
+static size_t context_received_count = 0;
+
+static void context_record_proc(uiohook_event * const event, void *user_data) {
+    context_received_count++;
+}
+
+static char * test_contexts() {
+    received_count = 0;
+    context_received_count = 0;
+    hook_set_dispatch_proc(record_proc, NULL);
+
+    uiohook_ctx *ctx = hook_ctx_create();
+    mu_assert("error, could not create hook context", ctx != NULL);
+    hook_ctx_set_dispatch_proc(ctx, context_record_proc, NULL);
+    hook_ctx_set_event_mask(ctx, EVENT_MASK_KEYBOARD);
+
+    // Run the native hook on behalf of the new context.
+    set_driver_context(ctx);
+    set_context_running(ctx, true);
+    mu_assert("error, running context was destroyed", hook_ctx_destroy(ctx) == UIOHOOK_FAILURE);
+    mu_assert("error, native mask is not the running context mask", get_event_mask() == EVENT_MASK_KEYBOARD);
+
+    send_event(EVENT_KEY_PRESSED, 500, 0);
+    send_event(EVENT_MOUSE_MOVED, 501, 1);
+    mu_assert("error, context did not receive its events", context_received_count == 1);
+    mu_assert("error, default context received events while not running", received_count == 0);
+
+    // Share the native hook with the default context.
+    set_context_running(get_default_context(), true);
+    send_event(EVENT_KEY_RELEASED, 502, 0);
+    send_event(EVENT_MOUSE_MOVED, 503, 2);
+    mu_assert("error, shared context did not receive its events", context_received_count == 2);
+    mu_assert("error, default context did not receive every event", received_count == 2);
+
+    lock_contexts();
+    stop_contexts();
+    unlock_contexts();
+    set_driver_context(NULL);
+
+    mu_assert("error, stopped context was not destroyed", hook_ctx_destroy(ctx) == UIOHOOK_SUCCESS);
+    mu_assert("error, default context was destroyed", hook_ctx_destroy(hook_ctx_get_default()) == UIOHOOK_FAILURE);
+
+    hook_set_dispatch_proc(NULL, NULL);
+
+    return NULL;
+}
+
+char * dispatch_event_tests() {
+    mu_run_test(test_motion_coalescing);
+    mu_run_test(test_motion_trailing_edge);
+    mu_run_test(test_event_mask);
+    mu_run_test(test_stats);
+    mu_run_test(test_listen_only);
+    mu_run_test(test_contexts);
+
+    return NULL;
+}
@@ -0,0 +1,55 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <uiohook.h>
+
+#include "event_clock.h"
+#include "minunit.h"
+
+static char * test_monotonic_time() {
+    uint64_t first = get_monotonic_time();
+    uint64_t second = get_monotonic_time();
+    mu_assert("error, monotonic clock went backwards", second >= first);
+
+    // The epoch offset should land within a few seconds of time().
+    int64_t epoch = ((int64_t) second + get_realtime_offset()) / (int64_t) NSEC_PER_SEC;
+    int64_t now = (int64_t) time(NULL);
+    mu_assert("error, realtime offset is not near the epoch", epoch > now - 5 && epoch < now + 5);
+
+    return NULL;
+}
+
+static char * test_capture_time_conversion() {
+    uint64_t capture_time = get_monotonic_time();
+
+    uint64_t earlier = hook_capture_time_to_event_time(capture_time);
+    uint64_t later = hook_capture_time_to_event_time(capture_time + NSEC_PER_SEC);
+    mu_assert("error, converted capture times are out of order", later > earlier);
+
+    return NULL;
+}
+
+char * event_clock_tests() {
+    mu_run_test(test_monotonic_time);
+    mu_run_test(test_capture_time_conversion);
+
+    return NULL;
+}
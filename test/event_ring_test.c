@@ -0,0 +1,72 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <uiohook.h>
+
+#include "event_ring.h"
+#include "minunit.h"
+
+static char * test_push_poll_order() {
+    uiohook_event event = { .type = EVENT_MOUSE_MOVED };
+    for (int i = 0; i < 100; i++) {
+        event.data.mouse.x = i;
+        mu_assert("error, could not push event", event_ring_push(&event));
+    }
+
+    uiohook_event events[64];
+    int expected = 0;
+    size_t count;
+    while ((count = hook_poll_events(events, sizeof(events) / sizeof(uiohook_event))) > 0) {
+        for (size_t i = 0; i < count; i++) {
+            mu_assert("error, event polled out of order", events[i].data.mouse.x == expected);
+            expected++;
+        }
+    }
+    mu_assert("error, events were lost", expected == 100);
+
+    return NULL;
+}
+
+static char * test_overflow_drops() {
+    uint64_t dropped = event_ring_get_dropped();
+
+    uiohook_event event = { .type = EVENT_KEY_PRESSED };
+    for (int i = 0; i < UIOHOOK_EVENT_RING_SIZE; i++) {
+        mu_assert("error, ring filled early", event_ring_push(&event));
+    }
+    mu_assert("error, full ring accepted event", !event_ring_push(&event));
+    mu_assert("error, dropped event not counted", event_ring_get_dropped() == dropped + 1);
+
+    uiohook_event events[256];
+    size_t total = 0, count;
+    while ((count = hook_poll_events(events, sizeof(events) / sizeof(uiohook_event))) > 0) {
+        total += count;
+    }
+    mu_assert("error, ring did not drain", total == UIOHOOK_EVENT_RING_SIZE);
+
+    return NULL;
+}
+
+char * event_ring_tests() {
+    mu_run_test(test_push_poll_order);
+    mu_run_test(test_overflow_drops);
+
+    return NULL;
+}
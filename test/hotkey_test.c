@@ -0,0 +1,151 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <uiohook.h>
+
+#include "dispatch_event.h"
+#include "event_clock.h"
+#include "minunit.h"
+
+static size_t delivered_count = 0;
+static uint32_t matched[8];
+static size_t matched_count = 0;
+
+static uiohook_event received[8];
+static size_t received_count = 0;
+
+static void count_proc(uiohook_event * const event, void *user_data) {
+    delivered_count++;
+}
+
+static void record_proc(uiohook_event * const event, void *user_data) {
+    if (received_count < sizeof(received) / sizeof(uiohook_event)) {
+        received[received_count++] = *event;
+    }
+}
+
+static void hotkey_proc(uint32_t id, uiohook_event * const event, void *user_data) {
+    if (matched_count < sizeof(matched) / sizeof(uint32_t)) {
+        matched[matched_count++] = id;
+    }
+}
+
+static bool send_key(event_type type, uint64_t time, uint16_t mask, uint16_t keycode) {
+    uiohook_event event = { .type = type, .time = time, .mask = mask, .capture_time = time * NSEC_PER_MSEC };
+    event.data.keyboard.keycode = keycode;
+
+    dispatch_event(&event);
+
+    return (event.reserved & 0x01) != 0;
+}
+
+static char * test_hotkey_match() {
+    delivered_count = 0;
+    matched_count = 0;
+    hook_set_dispatch_proc(count_proc, NULL);
+    mu_assert("error, could not start hotkey thread", hook_set_hotkey_proc(hotkey_proc, NULL) == UIOHOOK_SUCCESS);
+
+    hotkey_stroke save = { .mask = MASK_CTRL, .keycode = VC_S };
+    hotkey_stroke quit[] = { { .mask = MASK_CTRL_L, .keycode = VC_K }, { .mask = MASK_CTRL_L, .keycode = VC_Q } };
+    mu_assert("error, could not register hotkey", hook_register_hotkey(1, &save, 1, HOTKEY_CONSUME) == UIOHOOK_SUCCESS);
+    mu_assert("error, could not register chord", hook_register_hotkey(2, quit, 2, HOTKEY_CONSUME) == UIOHOOK_SUCCESS);
+
+    // Either control key completes MASK_CTRL, the press and release are consumed.
+    mu_assert("error, modifier press was consumed", !send_key(EVENT_KEY_PRESSED, 10, MASK_CTRL_R, VC_CONTROL_R));
+    mu_assert("error, hotkey press was not consumed", send_key(EVENT_KEY_PRESSED, 11, MASK_CTRL_R, VC_S));
+    mu_assert("error, hotkey release was not consumed", send_key(EVENT_KEY_RELEASED, 12, MASK_CTRL_R, VC_S));
+    mu_assert("error, consumed events were delivered", delivered_count == 1);
+
+    // Extra modifiers do not match.
+    mu_assert("error, hotkey matched extra modifiers", !send_key(EVENT_KEY_PRESSED, 20, MASK_CTRL_L | MASK_SHIFT_L, VC_S));
+    send_key(EVENT_KEY_RELEASED, 21, MASK_CTRL_L | MASK_SHIFT_L, VC_S);
+
+    // The chord needs both strokes in order and in time.
+    mu_assert("error, chord prefix was not consumed", send_key(EVENT_KEY_PRESSED, 30, MASK_CTRL_L, VC_K));
+    send_key(EVENT_KEY_RELEASED, 31, MASK_CTRL_L, VC_K);
+    mu_assert("error, chord was not completed", send_key(EVENT_KEY_PRESSED, 32, MASK_CTRL_L, VC_Q));
+    send_key(EVENT_KEY_RELEASED, 33, MASK_CTRL_L, VC_Q);
+
+    send_key(EVENT_KEY_PRESSED, 40, MASK_CTRL_L, VC_K);
+    mu_assert("error, chord survived an unrelated key", !send_key(EVENT_KEY_PRESSED, 41, MASK_CTRL_L, VC_A));
+    mu_assert("error, broken chord completed", !send_key(EVENT_KEY_PRESSED, 42, MASK_CTRL_L, VC_Q));
+
+    send_key(EVENT_KEY_PRESSED, 50, MASK_CTRL_L, VC_K);
+    mu_assert("error, chord completed after the timeout", !send_key(EVENT_KEY_PRESSED, 5000, MASK_CTRL_L, VC_Q));
+
+    mu_assert("error, could not unregister hotkey", hook_unregister_hotkey(1) == UIOHOOK_SUCCESS);
+    mu_assert("error, unregistered hotkey matched", !send_key(EVENT_KEY_PRESSED, 9000, MASK_CTRL_L, VC_S));
+    hook_clear_hotkeys();
+
+    // Stopping the thread delivers whatever is still queued.
+    hook_set_hotkey_proc(NULL, NULL);
+    hook_set_dispatch_proc(NULL, NULL);
+
+    mu_assert("error, wrong number of hotkey matches", matched_count == 2);
+    mu_assert("error, hotkey matches out of order", matched[0] == 1 && matched[1] == 2);
+
+    return NULL;
+}
+
+static char * test_hotkey_flushes_motion() {
+    // The held motion deadline is far enough ahead of the real clock that
+    // only the events below deliver it.
+    uint64_t capture_base = get_monotonic_time() + 100 * NSEC_PER_MSEC;
+    received_count = 0;
+    hook_set_dispatch_proc(record_proc, NULL);
+    mu_assert("error, could not start hotkey thread", hook_set_hotkey_proc(hotkey_proc, NULL) == UIOHOOK_SUCCESS);
+
+    hotkey_stroke save = { .mask = MASK_CTRL, .keycode = VC_S };
+    mu_assert("error, could not register hotkey", hook_register_hotkey(3, &save, 1, HOTKEY_CONSUME) == UIOHOOK_SUCCESS);
+    send_key(EVENT_KEY_PRESSED, 10, MASK_CTRL_L, VC_CONTROL_L);
+
+    hook_set_motion_coalescing(10 * 1000);
+
+    uiohook_event motion = { .type = EVENT_MOUSE_MOVED, .capture_time = capture_base };
+    motion.data.mouse.x = 1;
+    dispatch_event(&motion);
+
+    motion.capture_time = capture_base + NSEC_PER_MSEC;
+    motion.data.mouse.x = 2;
+    dispatch_event(&motion);
+    mu_assert("error, motion inside the window was delivered", received_count == 2);
+
+    // The consumed hotkey must not leave the earlier motion held behind it.
+    mu_assert("error, hotkey press was not consumed", send_key(EVENT_KEY_PRESSED, 11, MASK_CTRL_L, VC_S));
+    mu_assert("error, held motion was not delivered before the hotkey", received_count == 3);
+    mu_assert("error, held motion is not the latest", received[2].type == EVENT_MOUSE_MOVED && received[2].data.mouse.x == 2);
+
+    send_key(EVENT_KEY_RELEASED, 12, MASK_CTRL_L, VC_S);
+    send_key(EVENT_KEY_RELEASED, 13, 0x0000, VC_CONTROL_L);
+
+    hook_set_motion_coalescing(0);
+    hook_clear_hotkeys();
+    hook_set_hotkey_proc(NULL, NULL);
+    hook_set_dispatch_proc(NULL, NULL);
+
+    return NULL;
+}
+
+char * hotkey_tests() {
+    mu_run_test(test_hotkey_match);
+    mu_run_test(test_hotkey_flushes_motion);
+
+    return NULL;
+}
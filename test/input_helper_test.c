@@ -43,11 +43,13 @@ static char * test_bidirectional_keycode() {
             uint16_t keycode = (uint16_t) scancode_to_keycode(scancode);
             printf("\treproduced keycode\t%3u\t[0x%04X]\n", keycode, keycode);
 
+            #if defined(__APPLE__) && defined(__MACH__)
             // If the returned virtual scancode > 127, we used an offset to
             // calculate the keycode index used above.
             if (scancode > 127) {
                 printf("\t\tusing offset\t%3u\t[0x%04X]\n", (scancode & 0x7F) | 0x80, (scancode & 0x7F) | 0x80);
             }
+            #endif
 
             printf("\n");
 
@@ -62,6 +64,30 @@ static char * test_bidirectional_keycode() {
     return NULL;
 }
 
+/* Make sure every native keycode survives a trip through the inverse table */
+static char * test_keycode_round_trip() {
+    for (unsigned int i = 0; i < 256; i++) {
+        #ifdef _WIN32
+        // Mouse buttons, the generic modifiers and VK_OEM_CLEAR share their
+        // scancode with another virtual key.
+        if (i <= VK_XBUTTON2 || i == VK_SHIFT || i == VK_CONTROL || i == VK_MENU || i == VK_OEM_CLEAR) {
+            continue;
+        }
+
+        uint16_t scancode = keycode_to_scancode(i, 0x0);
+        #else
+        uint16_t scancode = keycode_to_scancode(i);
+        #endif
+
+        if (scancode != VC_UNDEFINED) {
+            mu_assert("error, keycode did not round trip through its scancode", (unsigned int) scancode_to_keycode(scancode) == i);
+        }
+    }
+
+    return NULL;
+}
+
+#if defined(__APPLE__) && defined(__MACH__)
 /* Make sure all virtual scancodes map to native keycodes */
 static char * test_bidirectional_scancode() {
     for (unsigned short i = 0; i < 256; i++) {
@@ -88,21 +114,44 @@ static char * test_bidirectional_scancode() {
         }
 
         printf("\n");
-        
-        #if defined(__APPLE__) && defined(__MACH__)
+
         if (keycode != 255) {
-        #else
-        if (keycode != 0x0000) {
-        #endif    
             mu_assert("error, scancode to keycode failed to convert back", i == scancode);
         }
     }
 
     return NULL;
 }
+#else
+/* Make sure every virtual scancode maps to a native keycode that produces it */
+static char * test_bidirectional_scancode() {
+    for (unsigned int i = 0; i <= UINT16_MAX; i++) {
+        // Lookup the native keycode...
+        uint16_t keycode = (uint16_t) scancode_to_keycode((uint16_t) i);
+        if (keycode == 0x0000) {
+            continue;
+        }
+
+        // Lookup the virtual scancode...
+        #ifdef _WIN32
+        uint16_t scancode = keycode_to_scancode(keycode, 0x0);
+        #else
+        uint16_t scancode = keycode_to_scancode(keycode);
+        #endif
+        printf("Testing scancode\t\t%5u\t[0x%04X]\n", i, i);
+        printf("\treproduced keycode\t%3u\t[0x%04X]\n", keycode, keycode);
+        printf("\tproduced scancode\t%5u\t[0x%04X]\n\n", scancode, scancode);
+
+        mu_assert("error, scancode to keycode failed to convert back", i == scancode);
+    }
+
+    return NULL;
+}
+#endif
 
 char * input_helper_tests() {
     mu_run_test(test_bidirectional_keycode);
+    mu_run_test(test_keycode_round_trip);
     mu_run_test(test_bidirectional_scancode);
 
     return NULL;
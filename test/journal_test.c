@@ -0,0 +1,100 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <uiohook.h>
+
+#include "minunit.h"
+
+#define JOURNAL_TEST_FILE "uiohook_journal_test.bin"
+
+static bool events_equal(uiohook_event *a, uiohook_event *b) {
+    if (a->type != b->type || a->time != b->time || a->mask != b->mask) {
+        return false;
+    }
+
+    switch (a->type) {
+        case EVENT_KEY_TYPED:
+        case EVENT_KEY_PRESSED:
+        case EVENT_KEY_RELEASED:
+            return memcmp(&a->data.keyboard, &b->data.keyboard, sizeof(keyboard_event_data)) == 0;
+
+        case EVENT_MOUSE_WHEEL:
+            return a->data.wheel.clicks == b->data.wheel.clicks
+                    && a->data.wheel.x == b->data.wheel.x && a->data.wheel.y == b->data.wheel.y
+                    && a->data.wheel.type == b->data.wheel.type && a->data.wheel.amount == b->data.wheel.amount
+                    && a->data.wheel.rotation == b->data.wheel.rotation && a->data.wheel.direction == b->data.wheel.direction;
+
+        case EVENT_HOOK_ENABLED:
+        case EVENT_HOOK_DISABLED:
+            return true;
+
+        default:
+            return memcmp(&a->data.mouse, &b->data.mouse, sizeof(mouse_event_data)) == 0;
+    }
+}
+
+static char * test_journal_round_trip() {
+    uiohook_event events[6] = {
+        { .type = EVENT_HOOK_ENABLED, .time = 1650000000000 },
+        { .type = EVENT_KEY_PRESSED, .time = 1650000000010, .mask = MASK_SHIFT_L,
+                .data.keyboard = { .keycode = VC_A, .rawcode = 0x41, .keychar = 0 } },
+        { .type = EVENT_MOUSE_MOVED, .time = 1650000000011, .mask = MASK_SHIFT_L,
+                .data.mouse = { .button = MOUSE_NOBUTTON, .clicks = 0, .x = -1200, .y = 300 } },
+        { .type = EVENT_MOUSE_DRAGGED, .time = 1650000000009, .mask = MASK_BUTTON1,
+                .data.mouse = { .button = MOUSE_NOBUTTON, .clicks = 1, .x = -1199, .y = 302 } },
+        { .type = EVENT_MOUSE_WHEEL, .time = 1650000000020,
+                .data.wheel = { .clicks = 1, .x = 5, .y = 6, .type = WHEEL_UNIT_SCROLL, .amount = 3, .rotation = -1, .direction = WHEEL_VERTICAL_DIRECTION } },
+        { .type = EVENT_HOOK_DISABLED, .time = 1650000000030 }
+    };
+
+    remove(JOURNAL_TEST_FILE);
+
+    // Write the events across two segments to exercise appending.
+    for (int segment = 0; segment < 2; segment++) {
+        journal_writer *writer = hook_journal_open_writer(JOURNAL_TEST_FILE);
+        mu_assert("error, could not open journal writer", writer != NULL);
+        mu_assert("error, could not write journal", hook_journal_write(writer, &events[segment * 3], 3) == UIOHOOK_SUCCESS);
+        hook_journal_close_writer(writer);
+    }
+
+    journal_reader *reader = hook_journal_open_reader(JOURNAL_TEST_FILE);
+    mu_assert("error, could not open journal reader", reader != NULL);
+
+    uiohook_event decoded[8];
+    size_t count = hook_journal_read(reader, decoded, 4);
+    count += hook_journal_read(reader, &decoded[count], 4);
+    hook_journal_close_reader(reader);
+    remove(JOURNAL_TEST_FILE);
+
+    mu_assert("error, wrong number of journal events", count == 6);
+    for (size_t i = 0; i < count; i++) {
+        mu_assert("error, journal event did not round trip", events_equal(&events[i], &decoded[i]));
+    }
+
+    return NULL;
+}
+
+char * journal_tests() {
+    mu_run_test(test_journal_round_trip);
+
+    return NULL;
+}
@@ -0,0 +1,82 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <uiohook.h>
+
+#include "dispatch_event.h"
+#include "key_state.h"
+#include "minunit.h"
+
+static void send_input(event_type type, uint16_t code) {
+    uiohook_event event = { .type = type };
+    if (type == EVENT_MOUSE_PRESSED || type == EVENT_MOUSE_RELEASED) {
+        event.data.mouse.button = code;
+    } else {
+        event.data.keyboard.keycode = code;
+    }
+
+    dispatch_event(&event);
+}
+
+static char * test_key_state_index() {
+    mu_assert("error, undefined key has an index", hook_key_state_index(VC_UNDEFINED) == -1);
+    mu_assert("error, base key index", hook_key_state_index(VC_A) == VC_A);
+    mu_assert("error, extended key shares a base index", hook_key_state_index(VC_CONTROL_R) != hook_key_state_index(VC_CONTROL_L));
+    mu_assert("error, extended key index out of range", hook_key_state_index(VC_UP) >= 0 && hook_key_state_index(VC_UP) < KEY_STATE_SIZE * 8);
+    mu_assert("error, keypad navigation is not the keypad key", hook_key_state_index(VC_KP_END) == hook_key_state_index(VC_KP_1));
+
+    return NULL;
+}
+
+static char * test_key_state_tracking() {
+    reset_key_state(MASK_SHIFT_L | MASK_BUTTON1);
+    mu_assert("error, seeded modifier is not held", hook_get_key_state(VC_SHIFT_L));
+    mu_assert("error, seeded button is not held", hook_get_button_state() == MASK_BUTTON1);
+
+    send_input(EVENT_KEY_PRESSED, VC_A);
+    send_input(EVENT_KEY_PRESSED, VC_RIGHT);
+    send_input(EVENT_MOUSE_PRESSED, MOUSE_BUTTON3);
+    send_input(EVENT_MOUSE_RELEASED, MOUSE_BUTTON1);
+    mu_assert("error, pressed key is not held", hook_get_key_state(VC_A) && hook_get_key_state(VC_RIGHT));
+    mu_assert("error, unpressed key is held", !hook_get_key_state(VC_B));
+
+    uint8_t bitmap[KEY_STATE_SIZE];
+    uint16_t buttons = hook_copy_key_state(bitmap);
+    int index = hook_key_state_index(VC_RIGHT);
+    mu_assert("error, copied button state", buttons == MASK_BUTTON3);
+    mu_assert("error, copied key state", (bitmap[index / 8] >> (index % 8)) & 1);
+
+    send_input(EVENT_KEY_RELEASED, VC_A);
+    mu_assert("error, released key is held", !hook_get_key_state(VC_A));
+
+    // The state is cleared once the hook stops.
+    send_input(EVENT_HOOK_DISABLED, 0);
+    buttons = hook_copy_key_state(bitmap);
+    mu_assert("error, key state survived the hook", !hook_get_key_state(VC_RIGHT) && !hook_get_key_state(VC_SHIFT_L) && buttons == 0);
+
+    return NULL;
+}
+
+char * key_state_tests() {
+    mu_run_test(test_key_state_index);
+    mu_run_test(test_key_state_tracking);
+
+    return NULL;
+}
@@ -0,0 +1,63 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdint.h>
+#include <stdio.h>
+#include <uiohook.h>
+
+#include "minunit.h"
+
+static char * test_replay_empty() {
+    replay_context *replay = hook_replay_start(NULL, 0);
+    mu_assert("error, could not start empty replay", replay != NULL);
+
+    replay_stats stats;
+    mu_assert("error, empty replay failed", hook_replay_wait(replay, &stats) == UIOHOOK_SUCCESS);
+    mu_assert("error, empty replay posted events", stats.posted == 0 && stats.failed == 0);
+
+    return NULL;
+}
+
+static char * test_replay_invalid_events() {
+    // Hook state events can not be posted, so nothing reaches the system.
+    uiohook_event events[3] = {
+        { .type = EVENT_HOOK_ENABLED, .time = 1000 },
+        { .type = EVENT_HOOK_ENABLED, .time = 1010 },
+        { .type = EVENT_HOOK_ENABLED, .time = 1020 }
+    };
+
+    replay_context *replay = hook_replay_start(events, sizeof(events) / sizeof(uiohook_event));
+    mu_assert("error, could not start replay", replay != NULL);
+
+    replay_stats stats;
+    mu_assert("error, invalid events reported success", hook_replay_wait(replay, &stats) != UIOHOOK_SUCCESS);
+    mu_assert("error, invalid events were posted", stats.posted == 0 && stats.failed == 3);
+
+    fprintf(stdout, "Replay drift: mean %llu ns, max %llu ns\n",
+            (unsigned long long) stats.mean_drift, (unsigned long long) stats.max_drift);
+
+    return NULL;
+}
+
+char * replay_tests() {
+    mu_run_test(test_replay_empty);
+    mu_run_test(test_replay_invalid_events);
+
+    return NULL;
+}
@@ -0,0 +1,149 @@
+/* libUIOHook: Cross-platform keyboard and mouse hooking from userland.
+ * Copyright (C) 2006-2022 Alexander Barker.  All Rights Reserved.
+ * https://github.com/kwhat/libuiohook/
+ *
+ * libUIOHook is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * libUIOHook is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <uiohook.h>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "dispatch_event.h"
+#include "minunit.h"
+
+#define SINK_TEST_SOCKET    "uiohook_sink_test.sock"
+#define SINK_TEST_MISSING   "uiohook_sink_missing.sock"
+#define SINK_TEST_JOURNAL   "uiohook_sink_test.bin"
+
+// Enough motion to need more than one datagram.
+#define SINK_TEST_EVENTS    600
+
+static void ignore_proc(uiohook_event * const event, void *user_data) {
+}
+
+static void send_motion(size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uiohook_event event = { .type = EVENT_MOUSE_MOVED, .time = 1000 + i };
+        event.data.mouse.x = (int16_t) i;
+        event.data.mouse.y = (int16_t) -i;
+
+        dispatch_event(&event);
+    }
+}
+
+static char * test_sink_address() {
+    mu_assert("error, UDP sink accepted an address without a port", hook_add_sink(UIOHOOK_SINK_UDP, "localhost") == NULL);
+    mu_assert("error, sink accepted a NULL address", hook_add_sink(UIOHOOK_SINK_UDP, NULL) == NULL);
+
+    return NULL;
+}
+
+#ifndef _WIN32
+static char * test_sink_stream() {
+    struct sockaddr_un address = { .sun_family = AF_UNIX };
+    strcpy(address.sun_path, SINK_TEST_SOCKET);
+    unlink(SINK_TEST_SOCKET);
+
+    int receiver = socket(AF_UNIX, SOCK_DGRAM, 0);
+    mu_assert("error, could not create receiver socket", receiver >= 0);
+    mu_assert("error, could not bind receiver socket", bind(receiver, (struct sockaddr *) &address, sizeof(address)) == 0);
+
+    hook_set_dispatch_proc(ignore_proc, NULL);
+    event_sink *sink = hook_add_sink(UIOHOOK_SINK_UNIX_DGRAM, SINK_TEST_SOCKET);
+    mu_assert("error, could not add unix sink", sink != NULL);
+
+    send_motion(SINK_TEST_EVENTS);
+
+    // Removing the sink sends everything still queued.
+    hook_remove_sink(sink);
+    hook_set_dispatch_proc(NULL, NULL);
+
+    // Every datagram is a journal segment, so the payloads form a journal.
+    FILE *journal = fopen(SINK_TEST_JOURNAL, "wb");
+    mu_assert("error, could not create journal", journal != NULL);
+
+    size_t datagrams = 0;
+    uint8_t buffer[2048];
+    ssize_t size;
+    while ((size = recv(receiver, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+        fwrite(buffer, (size_t) size, 1, journal);
+        datagrams++;
+    }
+    fclose(journal);
+    close(receiver);
+    unlink(SINK_TEST_SOCKET);
+
+    mu_assert("error, events were not coalesced into datagrams", datagrams > 1 && datagrams < SINK_TEST_EVENTS);
+
+    journal_reader *reader = hook_journal_open_reader(SINK_TEST_JOURNAL);
+    mu_assert("error, could not open journal reader", reader != NULL);
+
+    uiohook_event events[SINK_TEST_EVENTS + 1];
+    size_t count = hook_journal_read(reader, events, SINK_TEST_EVENTS + 1);
+    hook_journal_close_reader(reader);
+    remove(SINK_TEST_JOURNAL);
+
+    mu_assert("error, wrong number of streamed events", count == SINK_TEST_EVENTS);
+    for (size_t i = 0; i < count; i++) {
+        mu_assert("error, streamed event did not round trip", events[i].type == EVENT_MOUSE_MOVED
+                && events[i].time == 1000 + i
+                && events[i].data.mouse.x == (int16_t) i && events[i].data.mouse.y == (int16_t) -i);
+    }
+
+    return NULL;
+}
+
+static char * test_sink_dropped() {
+    unlink(SINK_TEST_MISSING);
+
+    hook_set_dispatch_proc(ignore_proc, NULL);
+    event_sink *sink = hook_add_sink(UIOHOOK_SINK_UNIX_DGRAM, SINK_TEST_MISSING);
+    mu_assert("error, could not add unix sink", sink != NULL);
+
+    // Nobody is listening, so every event is dropped once the sink sends it.
+    send_motion(10);
+
+    struct timespec delay = { .tv_sec = 0, .tv_nsec = 1000000 };
+    for (int i = 0; i < 1000 && hook_sink_dropped(sink) < 10; i++) {
+        nanosleep(&delay, NULL);
+    }
+
+    uint64_t dropped = hook_sink_dropped(sink);
+    hook_remove_sink(sink);
+    hook_set_dispatch_proc(NULL, NULL);
+
+    mu_assert("error, undelivered events were not counted", dropped == 10);
+
+    return NULL;
+}
+#endif
+
+char * sink_tests() {
+    mu_run_test(test_sink_address);
+    #ifndef _WIN32
+    mu_run_test(test_sink_stream);
+    mu_run_test(test_sink_dropped);
+    #endif
+
+    return NULL;
+}
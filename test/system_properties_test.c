@@ -16,11 +16,20 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <uiohook.h>
 
 #include "minunit.h"
+#include "property_cache.h"
+
+static int property_query_count = 0;
+
+static long int counted_property_query() {
+    return ++property_query_count;
+}
 
 static char * test_auto_repeat_rate() {
     long int i = hook_get_auto_repeat_rate();
@@ -76,7 +85,78 @@ static char * test_multi_click_time() {
     return NULL;
 }
 
+static char * test_property_cache() {
+    property_query_count = 0;
+    track_property_changes(false);
+
+    long int untracked = get_cached_property(PROPERTY_MULTI_CLICK_TIME, counted_property_query);
+    untracked = get_cached_property(PROPERTY_MULTI_CLICK_TIME, counted_property_query);
+    mu_assert("error, untracked property was cached", property_query_count == 2 && untracked == 2);
+
+    property_query_count = 0;
+    track_property_changes(true);
+
+    long int first = get_cached_property(PROPERTY_MULTI_CLICK_TIME, counted_property_query);
+    long int second = get_cached_property(PROPERTY_MULTI_CLICK_TIME, counted_property_query);
+    mu_assert("error, cached property was queried twice", property_query_count == 1 && first == second);
+
+    invalidate_property_cache();
+    long int third = get_cached_property(PROPERTY_MULTI_CLICK_TIME, counted_property_query);
+    mu_assert("error, invalidated property was not queried", property_query_count == 2 && third == 2);
+
+    // Leave the cache clean for the native property tests.
+    invalidate_property_cache();
+
+    return NULL;
+}
+
+static char * test_screen_snapshot() {
+    const screen_snapshot *snapshot = hook_acquire_screen_snapshot();
+    mu_assert("error, could not acquire screen snapshot", snapshot != NULL);
+
+    fprintf(stdout, "Screen snapshot %u: %u screen(s)\n", snapshot->version, snapshot->count);
+
+    unsigned char count = 0;
+    screen_data *screens = hook_create_screen_info(&count);
+    mu_assert("error, screen info does not match the snapshot", count == snapshot->count);
+
+    for (uint8_t i = 0; i < snapshot->count; i++) {
+        const screen_data *screen = &snapshot->screens[i];
+        mu_assert("error, screen info does not match the snapshot",
+                screens[i].number == screen->number && screens[i].x == screen->x && screens[i].y == screen->y);
+
+        if (screen->width > 0 && screen->height > 0) {
+            int16_t x = screen->x + screen->width / 2;
+            int16_t y = screen->y + screen->height / 2;
+
+            // Overlapping screens may report either number, but it must contain the point.
+            uint8_t number = hook_screen_at(x, y);
+            bool is_found = false;
+            for (uint8_t j = 0; j < snapshot->count; j++) {
+                const screen_data *match = &snapshot->screens[j];
+                if (match->number == number && x >= match->x && x < match->x + match->width
+                        && y >= match->y && y < match->y + match->height) {
+                    is_found = true;
+                }
+            }
+            mu_assert("error, screen lookup did not find the screen center", is_found);
+        }
+    }
+
+    free(screens);
+
+    // The released snapshot must stay readable while another reference is held.
+    const screen_snapshot *second = hook_acquire_screen_snapshot();
+    hook_release_screen_snapshot(snapshot);
+    mu_assert("error, snapshot version went backwards", second != NULL && second->version >= 1);
+    hook_release_screen_snapshot(second);
+
+    return NULL;
+}
+
 char * system_properties_tests() {
+    mu_run_test(test_property_cache);
+
     mu_run_test(test_auto_repeat_rate);
     mu_run_test(test_auto_repeat_delay);
 
@@ -86,5 +166,7 @@ char * system_properties_tests() {
 
     mu_run_test(test_multi_click_time);
 
+    mu_run_test(test_screen_snapshot);
+
     return NULL;
 }
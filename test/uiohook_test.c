@@ -18,7 +18,7 @@
 
 #include <stdio.h>
 
-#if !defined(__APPLE__) && !defined(__MACH__) && !defined(_WIN32)
+#ifdef USE_X11
 #include <X11/Xlib.h>
 #endif
 
@@ -27,16 +27,24 @@
 
 extern char * system_properties_tests();
 extern char * input_helper_tests();
-
-#if !defined(__APPLE__) && !defined(__MACH__) && !defined(_WIN32)
+extern char * event_ring_tests();
+extern char * dispatch_event_tests();
+extern char * replay_tests();
+extern char * journal_tests();
+extern char * event_clock_tests();
+extern char * broadcast_tests();
+extern char * hotkey_tests();
+extern char * key_state_tests();
+extern char * sink_tests();
+
+#ifdef USE_X11
 static Display *disp;
 #endif
 
 int tests_run = 0;
 
 static char * init_tests() {
-    #if !defined(__APPLE__) && !defined(__MACH__) && !defined(_WIN32)
-    // TODO Create our own AC_DEFINE for this value.  Currently defaults to X11 platforms.
+    #ifdef USE_X11
     Display *disp = XOpenDisplay(XDisplayName(NULL));
     mu_assert("error, could not open X display", disp != NULL);
 
@@ -49,7 +57,7 @@ static char * init_tests() {
 }
 
 static char * cleanup_tests() {
-    #if !defined(__APPLE__) && !defined(__MACH__) && !defined(_WIN32)
+    #ifdef USE_X11
     if (disp != NULL) {
         XCloseDisplay(disp);
         disp = NULL;
@@ -66,6 +74,15 @@ static char * all_tests() {
 
     mu_run_test(system_properties_tests);
     mu_run_test(input_helper_tests);
+    mu_run_test(event_ring_tests);
+    mu_run_test(dispatch_event_tests);
+    mu_run_test(replay_tests);
+    mu_run_test(journal_tests);
+    mu_run_test(event_clock_tests);
+    mu_run_test(broadcast_tests);
+    mu_run_test(hotkey_tests);
+    mu_run_test(key_state_tests);
+    mu_run_test(sink_tests);
 
     mu_run_test(cleanup_tests);
 